@@ -77,6 +77,10 @@ void printMemoryReport();
 
 void launchMemoryChecker(int64_t maxMB, double checkInterval);
 
+// returns the pages that lie completely within [data, data + size) to the OS. the memory stays valid,
+// but its content is undefined until it is written again
+void discardMemory(void* data, int64_t size);
+
 class punct_facet : public std::numpunct<char> {
 protected:
 	char do_decimal_point() const { return '.'; };
@@ -113,13 +117,30 @@ struct Buffer {
 	int64_t id = 0;
 	int64_t size = 0;
 	int64_t pos = 0;
+	int64_t alignment = 0;
 
 	Buffer() {
 		this->id = Buffer::createID();
 	}
 
-	Buffer(int64_t size) {
-		data = malloc(size);
+	// alignment > 0 for memory that has to start at a page or sector boundary, e.g. for unbuffered reads
+	Buffer(int64_t size, int64_t alignment = 0) {
+
+		this->alignment = alignment;
+
+		if (alignment > 0) {
+			// aligned allocations need a non-zero size that is a multiple of the alignment
+			int64_t alignedSize = ((size + alignment - 1) / alignment) * alignment;
+			alignedSize = std::max(alignedSize, alignment);
+
+			#if defined(_WIN32)
+			data = _aligned_malloc(alignedSize, alignment);
+			#else
+			data = aligned_alloc(alignment, alignedSize);
+			#endif
+		} else {
+			data = malloc(size);
+		}
 
 		if (data == nullptr) {
 			auto memory = getMemoryData();
@@ -175,6 +196,14 @@ struct Buffer {
 	}
 
 	~Buffer() {
+		#if defined(_WIN32)
+		if (alignment > 0) {
+			_aligned_free(data);
+
+			return;
+		}
+		#endif
+
 		free(data);
 	}
 
@@ -449,6 +478,64 @@ inline void readBinaryFile(string path, uint64_t start, uint64_t size, void* tar
 	}
 }
 
+// read-only memory mapping of a whole file. 
+// data stays valid until the MappedFile is destroyed. 
+// implemented in unsuck_platform_specific.cpp
+struct MappedFile {
+
+	string path;
+	uint8_t* data = nullptr;
+	int64_t size = 0;
+
+	// platform specific handles
+	void* handle_file = nullptr;
+	void* handle_mapping = nullptr;
+	int fd = -1;
+
+	MappedFile(string path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// hint that the range will be read front to back, once
+	void adviseSequential(int64_t offset, int64_t size);
+
+	// hint that the range will be read soon, so the OS can start paging it in
+	void adviseWillNeed(int64_t offset, int64_t size);
+
+};
+
+// covers the logical block sizes of common disks and the page size
+constexpr int64_t DIRECT_IO_ALIGNMENT = 4096;
+
+// file handle for positional reads that don't share a file pointer between threads. 
+// implemented in unsuck_platform_specific.cpp
+struct ReadOnlyFile {
+
+	string path;
+
+	// unbuffered files bypass the OS page cache (O_DIRECT, FILE_FLAG_NO_BUFFERING).
+	// offsets, sizes and target addresses of their reads must be multiples of DIRECT_IO_ALIGNMENT
+	bool isUnbuffered = false;
+
+	// platform specific handles
+	void* handle = nullptr;
+	int fd = -1;
+
+	ReadOnlyFile(string path, bool unbuffered = false);
+	~ReadOnlyFile();
+
+	ReadOnlyFile(const ReadOnlyFile&) = delete;
+	ReadOnlyFile& operator=(const ReadOnlyFile&) = delete;
+
+	bool isOpen();
+
+	// returns the number of bytes read, less than size at the end of the file
+	int64_t readAt(void* target, int64_t offset, int64_t size);
+
+};
+
 // writing smaller batches of 1-4MB seems to be faster sometimes?!?
 // it's not very significant, though. ~0.94s instead of 0.96s.
 template<typename T>
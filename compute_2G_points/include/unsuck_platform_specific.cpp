@@ -105,6 +105,141 @@ void launchMemoryChecker(int64_t maxMB, double checkInterval) {
 
 }
 
+MappedFile::MappedFile(string path){
+	this->path = path;
+
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+	if(file == INVALID_HANDLE_VALUE){
+		GENERATE_ERROR_MESSAGE << "could not open file " << path << endl;
+		return;
+	}
+
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(file, &fileSize);
+	this->handle_file = file;
+
+	// can't map empty files
+	if(fileSize.QuadPart == 0){
+		return;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+	if(mapping == nullptr){
+		GENERATE_ERROR_MESSAGE << "could not map file " << path << endl;
+		return;
+	}
+
+	this->handle_mapping = mapping;
+	this->data = reinterpret_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+
+	if(this->data == nullptr){
+		GENERATE_ERROR_MESSAGE << "could not map file " << path << endl;
+		return;
+	}
+
+	this->size = fileSize.QuadPart;
+}
+
+MappedFile::~MappedFile(){
+	if(data != nullptr){
+		UnmapViewOfFile(data);
+	}
+	if(handle_mapping != nullptr){
+		CloseHandle(handle_mapping);
+	}
+	if(handle_file != nullptr){
+		CloseHandle(handle_file);
+	}
+}
+
+void MappedFile::adviseSequential(int64_t offset, int64_t size){
+	// windows only takes this hint when opening the file (FILE_FLAG_SEQUENTIAL_SCAN)
+}
+
+void MappedFile::adviseWillNeed(int64_t offset, int64_t size){
+	if(data == nullptr){
+		return;
+	}
+
+	offset = std::clamp(offset, int64_t(0), this->size);
+	size = std::min(size, this->size - offset);
+
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = data + offset;
+	range.NumberOfBytes = size;
+
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+void discardMemory(void* data, int64_t size){
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	uintptr_t pageSize = info.dwPageSize;
+
+	uintptr_t begin = ((reinterpret_cast<uintptr_t>(data) + pageSize - 1) / pageSize) * pageSize;
+	uintptr_t end = ((reinterpret_cast<uintptr_t>(data) + size) / pageSize) * pageSize;
+
+	if(size > 0 && end > begin){
+		VirtualAlloc(reinterpret_cast<void*>(begin), end - begin, MEM_RESET, PAGE_READWRITE);
+	}
+}
+
+ReadOnlyFile::ReadOnlyFile(string path, bool unbuffered){
+	this->path = path;
+	this->isUnbuffered = unbuffered;
+
+	DWORD flags = unbuffered ? FILE_FLAG_NO_BUFFERING : FILE_ATTRIBUTE_NORMAL;
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+
+	if(file == INVALID_HANDLE_VALUE){
+		GENERATE_ERROR_MESSAGE << "could not open file " << path << endl;
+		return;
+	}
+
+	this->handle = file;
+}
+
+ReadOnlyFile::~ReadOnlyFile(){
+	if(handle != nullptr){
+		CloseHandle(handle);
+	}
+}
+
+bool ReadOnlyFile::isOpen(){
+	return handle != nullptr;
+}
+
+int64_t ReadOnlyFile::readAt(void* target, int64_t offset, int64_t size){
+
+	if(handle == nullptr){
+		return 0;
+	}
+
+	int64_t bytesRead = 0;
+
+	// ReadFile reads at most 4GB per call, 1GB steps keep unbuffered reads aligned
+	while(bytesRead < size){
+		DWORD request = DWORD(std::min(size - bytesRead, int64_t(1) << 30));
+		DWORD received = 0;
+
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = DWORD((offset + bytesRead) & 0xFFFFFFFF);
+		overlapped.OffsetHigh = DWORD((offset + bytesRead) >> 32);
+
+		BOOL success = ReadFile(handle, reinterpret_cast<uint8_t*>(target) + bytesRead, request, &received, &overlapped);
+
+		if(!success || received == 0){
+			break;
+		}
+
+		bytesRead += received;
+	}
+
+	return bytesRead;
+}
+
 static ULARGE_INTEGER lastCPU, lastSysCPU, lastUserCPU;
 static int numProcessors;
 static HANDLE self;
@@ -165,6 +300,12 @@ CpuData getCpuData() {
 
 #include "sys/types.h"
 #include "sys/sysinfo.h"
+#include "sys/mman.h"
+#include "sys/stat.h"
+#include "sys/uio.h"
+#include "fcntl.h"
+#include "unistd.h"
+#include "errno.h"
 
 #include "stdlib.h"
 #include "stdio.h"
@@ -312,6 +453,137 @@ void launchMemoryChecker(int64_t maxMB, double checkInterval) {
 
 }
 
+MappedFile::MappedFile(string path){
+	this->path = path;
+
+	fd = open(path.c_str(), O_RDONLY);
+
+	if(fd == -1){
+		GENERATE_ERROR_MESSAGE << "could not open file " << path << endl;
+		return;
+	}
+
+	struct stat st;
+	fstat(fd, &st);
+
+	// can't map empty files
+	if(st.st_size == 0){
+		return;
+	}
+
+	void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+	if(mapped == MAP_FAILED){
+		GENERATE_ERROR_MESSAGE << "could not map file " << path << endl;
+		return;
+	}
+
+	this->data = reinterpret_cast<uint8_t*>(mapped);
+	this->size = st.st_size;
+}
+
+MappedFile::~MappedFile(){
+	if(data != nullptr){
+		munmap(data, size);
+	}
+	if(fd != -1){
+		close(fd);
+	}
+}
+
+// madvise wants page aligned addresses
+static void adviseRange(uint8_t* data, int64_t dataSize, int64_t offset, int64_t size, int advice){
+	if(data == nullptr){
+		return;
+	}
+
+	static int64_t pageSize = sysconf(_SC_PAGESIZE);
+
+	offset = std::clamp(offset, int64_t(0), dataSize);
+	size = std::min(size, dataSize - offset);
+
+	int64_t alignedOffset = offset - (offset % pageSize);
+	int64_t alignedSize = size + (offset - alignedOffset);
+
+	madvise(data + alignedOffset, alignedSize, advice);
+}
+
+void MappedFile::adviseSequential(int64_t offset, int64_t size){
+	adviseRange(data, this->size, offset, size, MADV_SEQUENTIAL);
+}
+
+void MappedFile::adviseWillNeed(int64_t offset, int64_t size){
+	adviseRange(data, this->size, offset, size, MADV_WILLNEED);
+}
+
+void discardMemory(void* data, int64_t size){
+	static uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+
+	uintptr_t begin = ((reinterpret_cast<uintptr_t>(data) + pageSize - 1) / pageSize) * pageSize;
+	uintptr_t end = ((reinterpret_cast<uintptr_t>(data) + size) / pageSize) * pageSize;
+
+	if(size > 0 && end > begin){
+		madvise(reinterpret_cast<void*>(begin), end - begin, MADV_DONTNEED);
+	}
+}
+
+ReadOnlyFile::ReadOnlyFile(string path, bool unbuffered){
+	this->path = path;
+	this->isUnbuffered = unbuffered;
+
+	fd = open(path.c_str(), O_RDONLY | (unbuffered ? O_DIRECT : 0));
+
+	// some file systems (e.g. tmpfs) don't do O_DIRECT
+	if(fd == -1 && unbuffered && errno == EINVAL){
+		GENERATE_WARN_MESSAGE << "O_DIRECT not supported, using buffered reads for " << path << endl;
+
+		isUnbuffered = false;
+		fd = open(path.c_str(), O_RDONLY);
+	}
+
+	if(fd == -1){
+		GENERATE_ERROR_MESSAGE << "could not open file " << path << endl;
+		return;
+	}
+}
+
+ReadOnlyFile::~ReadOnlyFile(){
+	if(fd != -1){
+		close(fd);
+	}
+}
+
+bool ReadOnlyFile::isOpen(){
+	return fd != -1;
+}
+
+int64_t ReadOnlyFile::readAt(void* target, int64_t offset, int64_t size){
+
+	if(fd == -1){
+		return 0;
+	}
+
+	int64_t bytesRead = 0;
+
+	while(bytesRead < size){
+		struct iovec iov;
+		iov.iov_base = reinterpret_cast<uint8_t*>(target) + bytesRead;
+		iov.iov_len = size - bytesRead;
+
+		ssize_t received = preadv(fd, &iov, 1, offset + bytesRead);
+
+		if(received == -1 && errno == EINTR){
+			continue;
+		}else if(received <= 0){
+			break;
+		}
+
+		bytesRead += received;
+	}
+
+	return bytesRead;
+}
+
 static int numProcessors;
 static bool initialized = false;
 static unsigned long long lastTotalUser, lastTotalUserLow, lastTotalSys, lastTotalIdle;
@@ -201,6 +201,10 @@ void render_gui(Renderer * renderer) {
 			checked = Debug::colorizeChunks;
 			ImGui::Checkbox("colorize chunks", &checked);
 			Debug::colorizeChunks = checked;
+
+			checked = Debug::enableEDL;
+			ImGui::Checkbox("eye-dome lighting", &checked);
+			Debug::enableEDL = checked;
 		}
 
 		if (ImGui::Button("copy camera")) {
@@ -215,6 +219,11 @@ void render_gui(Renderer * renderer) {
 			ss << "renderer->controls->radius = " << controls->radius << ";" << endl;
 			ss << "renderer->controls->target = {" << target.x << ", " << target.y << ", " << target.z << "};" << endl;
 
+			// a frame of a camera path for --render
+			ss << std::setprecision(6);
+			ss << "{\"yaw\": " << controls->yaw << ", \"pitch\": " << controls->pitch << ", \"radius\": " << controls->radius
+				<< ", \"target\": [" << target.x << ", " << target.y << ", " << target.z << "]}" << endl;
+
 			string str = ss.str();
 			toClipboard(str);
 		}
@@ -225,6 +234,36 @@ void render_gui(Renderer * renderer) {
 		ImGui::End();
 	}
 
+	{ // FRAME STATS
+		ImGui::SetNextWindowPos(ImVec2(10, 240), ImGuiCond_FirstUseEver);
+		ImGui::SetNextWindowSize(ImVec2(490, 300), ImGuiCond_FirstUseEver);
+
+		ImGui::Begin("Frame Stats");
+
+		if(ImGui::BeginTable("frame stats", 2)){
+			for(auto& [key, value] : Debug::frameStats){
+
+				ImGui::TableNextRow();
+
+				if(key == "divider"){
+					ImGui::TableNextColumn();
+					ImGui::Separator();
+					ImGui::TableNextColumn();
+					ImGui::Separator();
+				}else{
+					ImGui::TableNextColumn();
+					ImGui::TextUnformatted(key.c_str());
+					ImGui::TableNextColumn();
+					ImGui::TextUnformatted(value.c_str());
+				}
+			}
+
+			ImGui::EndTable();
+		}
+
+		ImGui::End();
+	}
+
 	{
 		auto source = views[0].framebuffer;
 		glBlitNamedFramebuffer(
@@ -6,6 +6,7 @@
 #include <vector>
 #include <mutex>
 #include <thread>
+#include <climits>
 
 #include "glm/common.hpp"
 #include "glm/matrix.hpp"
@@ -48,6 +49,7 @@ struct ComputeLoop : public Method{
 		ivec2 imageSize;
 		int colorizeChunks;
 		int colorizeOverdraw;
+		int enableEDL;
 	};
 
 	struct DebugData{
@@ -96,7 +98,9 @@ struct ComputeLoop : public Method{
 
 		this->renderer = renderer;
 
-		ssFilesBuffer = make_shared<Buffer>(10'000 * 128);
+		// 256 bytes per file index, grows in render() if more files are added
+		ssFilesBuffer = make_shared<Buffer>(256 * 1'000);
+		memset(ssFilesBuffer->data, 0, ssFilesBuffer->size);
 
 		ssDebug = renderer->createBuffer(256);
 		ssBoundingBoxes = renderer->createBuffer(48 * 1'000'000);
@@ -150,18 +154,36 @@ struct ComputeLoop : public Method{
 				uniformData.transformFrustum = worldViewProj;
 			}
 			uniformData.pointsPerThread = POINTS_PER_THREAD;
-			uniformData.numPoints = pc->numPointsLoaded;
+			uniformData.numPoints = std::min(pc->numPointsLoaded, int64_t(INT_MAX));
 			uniformData.enableFrustumCulling = Debug::frustumCullingEnabled ? 1 : 0;
 			uniformData.showBoundingBox = Debug::showBoundingBox ? 1 : 0;
 			uniformData.imageSize = {fbo->width, fbo->height};
 			uniformData.colorizeChunks = Debug::colorizeChunks;
 			uniformData.colorizeOverdraw = Debug::colorizeOverdraw;
+			uniformData.enableEDL = Debug::enableEDL;
 
 			glNamedBufferSubData(uniformBuffer.handle, 0, sizeof(UniformData), &uniformData);
 		}
 
 		{ // update file buffer
 
+			// indices of removed files are reused, so they may have gaps
+			int64_t numFileIndices = 0;
+			for(auto pcfile : pc->files){
+				numFileIndices = std::max(numFileIndices, pcfile->fileIndex + 1);
+			}
+
+			// make new buffer twice as large to have some reserves for more files
+			if(256 * numFileIndices > ssFilesBuffer->size){
+				auto grown = make_shared<Buffer>(2 * 256 * numFileIndices);
+				memset(grown->data, 0, grown->size);
+				memcpy(grown->data, ssFilesBuffer->data, ssFilesBuffer->size);
+				ssFilesBuffer = grown;
+
+				glDeleteBuffers(1, &ssFiles.handle);
+				ssFiles = renderer->createBuffer(ssFilesBuffer->size);
+			}
+
 			for(int i = 0; i < pc->files.size(); i++){
 				auto pcfile = pc->files[i];
 
@@ -193,7 +215,7 @@ struct ComputeLoop : public Method{
 
 			}
 
-			glNamedBufferSubData(ssFiles.handle, 0, 256 * pc->files.size(), ssFilesBuffer->data);
+			glNamedBufferSubData(ssFiles.handle, 0, 256 * numFileIndices, ssFilesBuffer->data);
 		}
 
 		if(Debug::enableShaderDebugValue){
@@ -215,21 +237,27 @@ struct ComputeLoop : public Method{
 			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 30, ssDebug.handle);
 			glBindBufferBase(GL_UNIFORM_BUFFER, 31, uniformBuffer.handle);
 
-			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 40, pc->ssBatches.handle);
-			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 41, pc->ssXyzHig.handle);
-			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 42, pc->ssXyzMed.handle);
-			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 43, pc->ssXyzLow.handle);
-			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 44, pc->ssColors.handle);
 			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 45, ssFiles.handle);
 
 			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 50, ssBoundingBoxes.handle);
 
 			glBindImageTexture(0, fbo->colorAttachments[0]->handle, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA8UI);
 
-			// int numBatches = ceil(double(pc->numPointsLoaded) / double(POINTS_PER_WORKGROUP));
-			int numBatches = pc->numBatchesLoaded;
-			
-			glDispatchCompute(numBatches, 1, 1);
+			// one dispatch per segment, batches index points within the buffers of their segment
+			for(auto& segment : pc->segments){
+
+				if(segment.numBatches == 0){
+					continue;
+				}
+
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 40, segment.ssBatches.handle);
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 41, segment.ssXyzHig.handle);
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 42, segment.ssXyzMed.handle);
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 43, segment.ssXyzLow.handle);
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 44, segment.ssColors.handle);
+
+				glDispatchCompute(segment.numBatches, 1, 1);
+			}
 
 			GLTimerQueries::timestamp("draw-end");
 		}
@@ -243,7 +271,6 @@ struct ComputeLoop : public Method{
 			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, ssFramebuffer.handle);
 			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 30, ssDebug.handle);
 			glBindBufferBase(GL_UNIFORM_BUFFER, 31, uniformBuffer.handle);
-			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 44, pc->ssColors.handle);
 
 			glBindImageTexture(0, fbo->colorAttachments[0]->handle, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA8UI);
 
@@ -0,0 +1,90 @@
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "glm/common.hpp"
+#include "glm/matrix.hpp"
+
+#include "unsuck.hpp"
+
+#include "Debug.h"
+#include "Renderer.h"
+#include "GLTimerQueries.h"
+#include "data/point_clouds_loader.h"
+#include "cpu_rasterizer.h"
+
+using namespace std;
+
+// ComputeLoop on the CPU. requires a loader with keepHostCopy
+struct CpuLoop : public Method{
+
+	shared_ptr<PointCloudLoader> pc = nullptr;
+	shared_ptr<CpuRasterizer> rasterizer = nullptr;
+
+	Renderer* renderer = nullptr;
+
+	CpuLoop(Renderer* renderer, shared_ptr<PointCloudLoader> pc){
+
+		this->name = "cpu-loop";
+		this->description = R"ER01(
+		- render.cs and resolve.cs on the CPU
+		- threads take batches from a shared counter
+		- 64 bit atomicMin of depth and color
+		)ER01";
+		this->pc = pc;
+		this->group = "10-10-10 bit encoded";
+		this->renderer = renderer;
+
+		rasterizer = make_shared<CpuRasterizer>();
+	}
+
+	void update(Renderer* renderer) {
+	}
+
+	void render(Renderer* renderer) {
+		GLTimerQueries::timestamp("cpu-loop-start");
+
+		pc->process();
+
+		if(pc->numPointsLoaded == 0 || !pc->hasHostBuffers()){
+			return;
+		}
+
+		auto fbo = renderer->views[0].framebuffer;
+
+		CpuRenderSettings settings;
+		settings.view = renderer->views[0].view;
+		settings.proj = renderer->views[0].proj;
+		settings.imageSize = {fbo->width, fbo->height};
+		settings.enableFrustumCulling = Debug::frustumCullingEnabled;
+		settings.colorizeChunks = Debug::colorizeChunks;
+		settings.enableEDL = Debug::enableEDL;
+
+		rasterizer->render(*pc, settings);
+
+		glTextureSubImage2D(fbo->colorAttachments[0]->handle, 0, 0, 0, fbo->width, fbo->height,
+			GL_RGBA, GL_UNSIGNED_BYTE, rasterizer->image.data());
+
+		if(Debug::enableShaderDebugValue){
+			auto& stats = rasterizer->stats;
+			auto dbg = Debug::getInstance();
+
+			dbg->pushFrameStat("#nodes processed"        , formatNumber(stats.numNodesProcessed));
+			dbg->pushFrameStat("#nodes rendered"         , formatNumber(stats.numNodesRendered));
+			dbg->pushFrameStat("#points processed"       , formatNumber(stats.numPointsProcessed));
+			dbg->pushFrameStat("#points rendered"        , formatNumber(stats.numPointsRendered));
+			dbg->pushFrameStat("divider" , "");
+			dbg->pushFrameStat("#points visible"         , formatNumber(stats.numPointsVisible));
+			dbg->pushFrameStat("divider" , "");
+			dbg->pushFrameStat("clear"                   , formatNumber(stats.clearMillis, 2) + " ms");
+			dbg->pushFrameStat("render"                  , formatNumber(stats.renderMillis, 2) + " ms");
+			dbg->pushFrameStat("resolve"                 , formatNumber(stats.resolveMillis, 2) + " ms");
+			dbg->pushFrameStat("edl"                     , formatNumber(stats.edlMillis, 2) + " ms");
+		}
+
+		GLTimerQueries::timestamp("cpu-loop-end");
+	}
+
+};
@@ -0,0 +1,774 @@
+
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include "glm/gtc/type_ptr.hpp"
+#include <glm/gtx/transform.hpp>
+
+#include "cpu_rasterizer.h"
+#include "point_projection.h"
+#include "Camera.h"
+#include "OrbitControls.h"
+#include "../data/point_clouds_loader.h"
+
+using glm::mat4;
+using glm::vec2;
+using glm::vec3;
+using glm::vec4;
+
+// the batch records of the segments, see Batch in render.cs
+struct BatchRecord{
+	int32_t state;
+	float min[3];
+	float max[3];
+	int32_t numPoints;
+	int32_t firstPoint;
+	int32_t fileIndex;
+	int32_t segment;
+	int32_t padding[5];
+};
+
+static_assert(sizeof(BatchRecord) == 64);
+
+// File in render.cs
+struct FileTransform{
+	mat4 transform;
+	mat4 world;
+	bool exists = false;
+};
+
+// -Infinity in both halves, as ComputeLoop clears ssFramebuffer
+constexpr uint64_t CLEAR_VALUE = 0xFF800000'FF800000ull;
+constexpr uint32_t BACKGROUND_COLOR = 0x00443322;
+
+// batches that a thread takes from the shared counter at once
+constexpr int64_t BATCHES_PER_TASK = 16;
+
+// points that are projected at once, their candidates stay in L1
+constexpr int64_t PROJECTION_BLOCK_SIZE = 1024;
+
+CpuWorkers::CpuWorkers(int numThreads){
+
+	for(int i = 1; i < numThreads; i++){
+		threads.emplace_back([this, i](){
+			int64_t lastGeneration = 0;
+
+			while(true){
+				function<void(int)> current;
+
+				{
+					unique_lock<mutex> lock(mtx);
+					cvStart.wait(lock, [&](){ return isClosing || generation != lastGeneration; });
+
+					if(isClosing){
+						break;
+					}
+
+					lastGeneration = generation;
+					current = job;
+				}
+
+				current(i);
+
+				{
+					lock_guard<mutex> lock(mtx);
+					numRunning--;
+				}
+				cvDone.notify_all();
+			}
+		});
+	}
+}
+
+CpuWorkers::~CpuWorkers(){
+
+	{
+		lock_guard<mutex> lock(mtx);
+		isClosing = true;
+	}
+	cvStart.notify_all();
+
+	for(auto& t : threads){
+		t.join();
+	}
+}
+
+void CpuWorkers::run(function<void(int)> job){
+
+	{
+		lock_guard<mutex> lock(mtx);
+		this->job = job;
+		numRunning = int(threads.size());
+		generation++;
+	}
+	cvStart.notify_all();
+
+	job(0);
+
+	unique_lock<mutex> lock(mtx);
+	cvDone.wait(lock, [&](){ return numRunning == 0; });
+}
+
+struct FrustumPlane{
+	vec3 normal;
+	float constant;
+};
+
+FrustumPlane create_plane(float x, float y, float z, float w){
+
+	float nLength = glm::length(vec3(x, y, z));
+
+	FrustumPlane plane;
+	plane.normal = vec3(x, y, z) / nLength;
+	plane.constant = w / nLength;
+
+	return plane;
+}
+
+// intersectsFrustum() in render.cs, in float
+bool intersects_frustum(const mat4& worldViewProj, vec3 wgMin, vec3 wgMax){
+
+	const float* m = glm::value_ptr(worldViewProj);
+
+	FrustumPlane planes[6] = {
+		create_plane(m[3] - m[0], m[7] - m[4], m[11] -  m[8], m[15] - m[12]),
+		create_plane(m[3] + m[0], m[7] + m[4], m[11] +  m[8], m[15] + m[12]),
+		create_plane(m[3] + m[1], m[7] + m[5], m[11] +  m[9], m[15] + m[13]),
+		create_plane(m[3] - m[1], m[7] - m[5], m[11] -  m[9], m[15] - m[13]),
+		create_plane(m[3] - m[2], m[7] - m[6], m[11] - m[10], m[15] - m[14]),
+		create_plane(m[3] + m[2], m[7] + m[6], m[11] + m[10], m[15] + m[14]),
+	};
+
+	for(FrustumPlane& plane : planes){
+		vec3 corner = {
+			plane.normal.x > 0.0f ? wgMax.x : wgMin.x,
+			plane.normal.y > 0.0f ? wgMax.y : wgMin.y,
+			plane.normal.z > 0.0f ? wgMax.z : wgMin.z,
+		};
+
+		if(glm::dot(plane.normal, corner) + plane.constant < 0.0f){
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// getPrecisionLevel() in render.cs
+int precision_level(vec3 wgMin, vec3 wgMax, const mat4& world, const mat4& view, const mat4& proj, ivec2 imageSize){
+
+	vec3 wgCenter = (wgMin + wgMax) / 2.0f;
+	float wgRadius = glm::distance(wgMin, wgMax);
+
+	vec4 viewCenter = view * world * vec4(wgCenter, 1.0f);
+	vec4 viewEdge = viewCenter + vec4(wgRadius, 0.0f, 0.0f, 0.0f);
+
+	vec4 projCenter = proj * viewCenter;
+	vec4 projEdge = proj * viewEdge;
+
+	vec2 ndcCenter = vec2(projCenter) / projCenter.w;
+	vec2 ndcEdge = vec2(projEdge) / projEdge.w;
+
+	vec2 screenCenter = vec2(imageSize) * (ndcCenter + 1.0f) / 2.0f;
+	vec2 screenEdge = vec2(imageSize) * (ndcEdge + 1.0f) / 2.0f;
+	float pixelSize = glm::distance(screenEdge, screenCenter);
+
+	if(pixelSize < 100.0f){
+		return 4;
+	}else if(pixelSize < 200.0f){
+		return 3;
+	}else if(pixelSize < 500.0f){
+		return 2;
+	}else if(pixelSize < 10000.0f){
+		return 1;
+	}else{
+		return 0;
+	}
+}
+
+CpuRasterizer::CpuRasterizer(int numThreads){
+	workers = make_shared<CpuWorkers>(std::max(numThreads, 1));
+}
+
+void CpuRasterizer::resize(ivec2 size){
+
+	int64_t numPixels = int64_t(size.x) * int64_t(size.y);
+
+	if(framebufferCapacity < numPixels){
+		framebuffer.reset(new atomic<uint64_t>[numPixels]);
+		framebufferCapacity = numPixels;
+	}
+
+	imageSize = size;
+	image.resize(numPixels);
+}
+
+void CpuRasterizer::clear(){
+
+	int64_t numPixels = int64_t(imageSize.x) * int64_t(imageSize.y);
+	int numThreads = workers->numThreads();
+
+	workers->run([&](int threadIndex){
+		int64_t first = (numPixels * threadIndex) / numThreads;
+		int64_t last = (numPixels * (threadIndex + 1)) / numThreads;
+
+		for(int64_t i = first; i < last; i++){
+			framebuffer[i].store(CLEAR_VALUE, std::memory_order_relaxed);
+		}
+	});
+}
+
+// projects the points of all visible batches, a block at a time, and passes the candidates of each block to
+// emit(threadIndex, candidates, pixelIDs, numCandidates, colors, chunkColor) on the thread that projected them
+template<typename Emit>
+void project_batches(CpuWorkers& workers, PointCloudLoader& loader, const CpuRenderSettings& settings, SimdLevel simdLevel,
+	vector<CpuRenderStats>& threadStats, Emit emit)
+{
+	mat4 view = settings.view;
+	mat4 proj = settings.proj;
+	ivec2 size = settings.imageSize;
+
+	// indices of removed files are reused, so they may have gaps
+	vector<FileTransform> files;
+	for(auto& pcfile : loader.files){
+		if(pcfile->fileIndex >= int64_t(files.size())){
+			files.resize(pcfile->fileIndex + 1);
+		}
+
+		dmat4 world = glm::translate(dmat4(), pcfile->boxMin);
+
+		FileTransform& file = files[pcfile->fileIndex];
+		file.transform = settings.proj * settings.view * world;
+		file.world = world;
+		file.exists = true;
+	}
+
+	// segments and the first batch of each task
+	struct Task{
+		int64_t segment;
+		int64_t firstBatch;
+	};
+
+	vector<Task> tasks;
+	for(int64_t segmentIndex = 0; segmentIndex < int64_t(loader.segments.size()); segmentIndex++){
+		PointSegment& segment = loader.segments[segmentIndex];
+
+		if(segment.host.batches == nullptr){
+			continue;
+		}
+
+		for(int64_t batch = 0; batch < segment.numBatches; batch += BATCHES_PER_TASK){
+			tasks.push_back({segmentIndex, batch});
+		}
+	}
+
+	atomic<int64_t> nextTask = 0;
+
+	workers.run([&](int threadIndex){
+
+		CpuRenderStats& counters = threadStats[threadIndex];
+
+		vector<uint64_t> candidates(PROJECTION_BLOCK_SIZE + 16);
+		vector<uint32_t> pixelIDs(PROJECTION_BLOCK_SIZE + 16);
+
+		while(true){
+			int64_t taskIndex = nextTask++;
+
+			if(taskIndex >= int64_t(tasks.size())){
+				break;
+			}
+
+			Task task = tasks[taskIndex];
+			PointSegment& segment = loader.segments[task.segment];
+			HostBuffers& host = segment.host;
+			int64_t lastBatch = std::min(task.firstBatch + BATCHES_PER_TASK, segment.numBatches);
+
+			const uint32_t* xyzLow = host.xyzLow->data_u32;
+			const uint32_t* xyzMed = host.xyzMed->data_u32;
+			const uint32_t* xyzHig = host.xyzHig->data_u32;
+			const uint32_t* colors = host.colors->data_u32;
+
+			for(int64_t batchIndex = task.firstBatch; batchIndex < lastBatch; batchIndex++){
+
+				BatchRecord batch;
+				memcpy(&batch, host.batches->data_u8 + 64 * batchIndex, 64);
+
+				// points of evicted batches are no longer in memory, free slots belong to removed files
+				if(batch.state != int32_t(BatchState::RESIDENT) || batch.fileIndex >= int32_t(files.size()) || !files[batch.fileIndex].exists){
+					continue;
+				}
+
+				counters.numNodesProcessed++;
+
+				const FileTransform& file = files[batch.fileIndex];
+				vec3 wgMin = {batch.min[0], batch.min[1], batch.min[2]};
+				vec3 wgMax = {batch.max[0], batch.max[1], batch.max[2]};
+
+				if(settings.enableFrustumCulling && !intersects_frustum(file.transform, wgMin, wgMax)){
+					continue;
+				}
+
+				counters.numNodesRendered++;
+
+				ProjectionParams params;
+				params.transform = file.transform;
+				params.wgMin = wgMin;
+				params.wgMax = wgMax;
+				params.imageSize = size;
+				params.level = precision_level(wgMin, wgMax, file.world, view, proj, size);
+
+				uint32_t chunkColor = uint32_t((batchIndex + batch.segment * 7919) * 1234567);
+
+				for(int64_t blockStart = 0; blockStart < batch.numPoints; blockStart += PROJECTION_BLOCK_SIZE){
+
+					int64_t blockSize = std::min(int64_t(batch.numPoints) - blockStart, PROJECTION_BLOCK_SIZE);
+
+					int64_t numCandidates = project_points(xyzLow, xyzMed, xyzHig, int64_t(batch.firstPoint) + blockStart, blockSize,
+						params, candidates.data(), pixelIDs.data(), simdLevel);
+
+					counters.numPointsProcessed += blockSize;
+
+					emit(threadIndex, candidates.data(), pixelIDs.data(), numCandidates, colors, chunkColor);
+				}
+			}
+		}
+	});
+}
+
+void CpuRasterizer::renderAtomic(PointCloudLoader& loader, const CpuRenderSettings& settings, vector<CpuRenderStats>& threadStats){
+
+	bool colorizeChunks = settings.colorizeChunks;
+
+	project_batches(*workers, loader, settings, simdLevel, threadStats,
+		[&](int threadIndex, const uint64_t* candidates, const uint32_t* pixelIDs, int64_t numCandidates, const uint32_t* colors, uint32_t chunkColor){
+
+		int64_t numRendered = 0;
+
+		for(int64_t i = 0; i < numCandidates; i++){
+			uint32_t pixelID = pixelIDs[i];
+			uint64_t depthComponent = candidates[i] & 0xFFFFFFFF'00000000ull;
+
+			// colors are only fetched for points that may be closer than the current one
+			uint64_t oldPoint = framebuffer[pixelID].load(std::memory_order_relaxed);
+
+			if(depthComponent < oldPoint){
+				uint32_t index = uint32_t(candidates[i]);
+				uint32_t color = colorizeChunks ? chunkColor : colors[index];
+				uint64_t newPoint = depthComponent | uint64_t(color);
+
+				while(newPoint < oldPoint && !framebuffer[pixelID].compare_exchange_weak(oldPoint, newPoint, std::memory_order_relaxed)){}
+
+				numRendered++;
+			}
+		}
+
+		threadStats[threadIndex].numPointsRendered += numRendered;
+	});
+}
+
+void CpuRasterizer::renderBinned(PointCloudLoader& loader, const CpuRenderSettings& settings, vector<CpuRenderStats>& threadStats){
+
+	bool colorizeChunks = settings.colorizeChunks;
+	int numThreads = workers->numThreads();
+	uint32_t width = imageSize.x;
+	// pixelID / width as a multiplication, exact as long as pixelID * width < 2^48
+	uint64_t divideByWidth = ((1ull << 48) + width - 1) / width;
+	uint32_t tilesX = (imageSize.x + CPU_TILE_SIZE - 1) / CPU_TILE_SIZE;
+	uint32_t tilesY = (imageSize.y + CPU_TILE_SIZE - 1) / CPU_TILE_SIZE;
+	int64_t numTiles = int64_t(tilesX) * int64_t(tilesY);
+
+	// bins keep their capacity from previous frames
+	bins.resize(numThreads);
+	for(auto& threadBins : bins){
+		threadBins.resize(numTiles);
+
+		for(auto& bin : threadBins){
+			bin.points.clear();
+			bin.pixels.clear();
+		}
+	}
+
+	double tStart = now();
+
+	// phase one: append candidates to the bins of the projecting thread
+	project_batches(*workers, loader, settings, simdLevel, threadStats,
+		[&](int threadIndex, const uint64_t* candidates, const uint32_t* pixelIDs, int64_t numCandidates, const uint32_t* colors, uint32_t chunkColor){
+
+		vector<CpuTileBin>& threadBins = bins[threadIndex];
+
+		for(int64_t i = 0; i < numCandidates; i++){
+			uint32_t pixelID = pixelIDs[i];
+			uint32_t y = uint32_t((uint64_t(pixelID) * divideByWidth) >> 48);
+			uint32_t x = pixelID - y * width;
+
+			uint32_t tileIndex = (x / CPU_TILE_SIZE) + (y / CPU_TILE_SIZE) * tilesX;
+			uint16_t pixelInTile = (x % CPU_TILE_SIZE) + (y % CPU_TILE_SIZE) * CPU_TILE_SIZE;
+
+			uint32_t index = uint32_t(candidates[i]);
+			uint32_t color = colorizeChunks ? chunkColor : colors[index];
+			uint64_t point = (candidates[i] & 0xFFFFFFFF'00000000ull) | uint64_t(color);
+
+			CpuTileBin& bin = threadBins[tileIndex];
+			bin.points.push_back(point);
+			bin.pixels.push_back(pixelInTile);
+		}
+	});
+
+	stats.binMillis = 1000.0 * (now() - tStart);
+
+	// phase two: each tile is owned by one thread, which merges the bins of all threads with a plain min
+	// and writes every pixel of the tile, so the framebuffer needs no clear
+	atomic<int64_t> nextTile = 0;
+
+	workers->run([&](int threadIndex){
+
+		vector<uint64_t> tile(CPU_TILE_SIZE * CPU_TILE_SIZE);
+		int64_t numRendered = 0;
+
+		while(true){
+			int64_t tileIndex = nextTile++;
+
+			if(tileIndex >= numTiles){
+				break;
+			}
+
+			std::fill(tile.begin(), tile.end(), CLEAR_VALUE);
+
+			for(auto& threadBins : bins){
+				CpuTileBin& bin = threadBins[tileIndex];
+
+				for(int64_t i = 0; i < int64_t(bin.points.size()); i++){
+					uint64_t point = bin.points[i];
+					uint64_t& current = tile[bin.pixels[i]];
+
+					numRendered += point < current ? 1 : 0;
+					current = std::min(current, point);
+				}
+			}
+
+			int64_t tileX = (tileIndex % tilesX) * CPU_TILE_SIZE;
+			int64_t tileY = (tileIndex / tilesX) * CPU_TILE_SIZE;
+			int64_t sizeX = std::min(int64_t(CPU_TILE_SIZE), imageSize.x - tileX);
+			int64_t sizeY = std::min(int64_t(CPU_TILE_SIZE), imageSize.y - tileY);
+
+			for(int64_t y = 0; y < sizeY; y++){
+				int64_t rowStart = tileX + (tileY + y) * imageSize.x;
+
+				for(int64_t x = 0; x < sizeX; x++){
+					framebuffer[rowStart + x].store(tile[x + y * CPU_TILE_SIZE], std::memory_order_relaxed);
+				}
+			}
+		}
+
+		threadStats[threadIndex].numPointsRendered += numRendered;
+	});
+}
+
+void CpuRasterizer::renderBatches(PointCloudLoader& loader, const CpuRenderSettings& settings){
+
+	vector<CpuRenderStats> threadStats(workers->numThreads());
+
+	if(settings.rasterMode == CpuRasterMode::BINNED){
+		renderBinned(loader, settings, threadStats);
+	}else{
+		renderAtomic(loader, settings, threadStats);
+	}
+
+	for(auto& counters : threadStats){
+		stats.numNodesProcessed += counters.numNodesProcessed;
+		stats.numNodesRendered += counters.numNodesRendered;
+		stats.numPointsProcessed += counters.numPointsProcessed;
+		stats.numPointsRendered += counters.numPointsRendered;
+	}
+}
+
+void CpuRasterizer::resolve(const CpuRenderSettings& settings){
+
+	int numThreads = workers->numThreads();
+	vector<int64_t> numVisible(numThreads, 0);
+
+	// the depths are written while the framebuffer is read anyway, so that edl() doesn't read it again
+	int64_t planeStride = int64_t(imageSize.x) + 2;
+	int64_t planeSize = planeStride * (int64_t(imageSize.y) + 2);
+	float* plane = nullptr;
+
+	if(settings.enableEDL){
+		// the border is only written here, the interior each frame
+		if(int64_t(depthPlane.size()) != planeSize){
+			depthPlane.assign(planeSize, EDL_EMPTY_DEPTH);
+		}
+
+		plane = depthPlane.data();
+	}
+
+	workers->run([&](int threadIndex){
+		int64_t first = (int64_t(imageSize.y) * threadIndex) / numThreads;
+		int64_t last = (int64_t(imageSize.y) * (threadIndex + 1)) / numThreads;
+
+		for(int64_t y = first; y < last; y++){
+			for(int64_t x = 0; x < imageSize.x; x++){
+				int64_t pixelID = x + y * imageSize.x;
+
+				uint64_t data = framebuffer[pixelID].load(std::memory_order_relaxed);
+				uint32_t uDepth = uint32_t(data >> 32);
+				float depth;
+				memcpy(&depth, &uDepth, 4);
+
+				bool hasPoint = depth > 0.0f && depth < 1000000.0f;
+
+				image[pixelID] = hasPoint ? uint32_t(data & 0xFFFFFFFF) : BACKGROUND_COLOR;
+				numVisible[threadIndex] += hasPoint ? 1 : 0;
+
+				if(plane){
+					plane[(y + 1) * planeStride + x + 1] = hasPoint ? depth : EDL_EMPTY_DEPTH;
+				}
+			}
+		}
+	});
+
+	for(int64_t count : numVisible){
+		stats.numPointsVisible += count;
+	}
+}
+
+void CpuRasterizer::edl(const CpuRenderSettings& settings){
+
+	int numThreads = workers->numThreads();
+	int64_t planeStride = int64_t(imageSize.x) + 2;
+
+	workers->run([&](int threadIndex){
+		int64_t first = (int64_t(imageSize.y) * threadIndex) / numThreads;
+		int64_t last = (int64_t(imageSize.y) * (threadIndex + 1)) / numThreads;
+
+		for(int64_t y = first; y < last; y++){
+			const float* row = depthPlane.data() + (y + 1) * planeStride + 1;
+			uint32_t* colors = image.data() + y * imageSize.x;
+
+			edl_shade_row(row - planeStride, row, row + planeStride, imageSize.x, settings.edlStrength, colors, simdLevel);
+		}
+	});
+}
+
+void CpuRasterizer::render(PointCloudLoader& loader, const CpuRenderSettings& settings){
+
+	stats = CpuRenderStats();
+
+	double tStart = now();
+	resize(settings.imageSize);
+
+	// binned rendering writes every pixel
+	if(settings.rasterMode == CpuRasterMode::ATOMIC){
+		clear();
+	}
+
+	double tRender = now();
+	renderBatches(loader, settings);
+
+	double tResolve = now();
+	resolve(settings);
+
+	double tEDL = now();
+	if(settings.enableEDL){
+		edl(settings);
+	}
+
+	double tEnd = now();
+
+	stats.clearMillis = 1000.0 * (tRender - tStart);
+	stats.renderMillis = 1000.0 * (tResolve - tRender);
+	stats.resolveMillis = 1000.0 * (tEDL - tResolve);
+	stats.edlMillis = 1000.0 * (tEnd - tEDL);
+}
+
+shared_ptr<PointCloudLoader> load_headless(vector<string> files){
+
+	auto loader = make_shared<PointCloudLoader>(nullptr);
+	loader->add(files, [](vector<shared_ptr<PointCloud>>){});
+
+	// rather than until numPointsLoaded reaches numPoints, which truncated or corrupt files never do
+	while(!loader->isIdle()){
+		loader->process();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	loader->process();
+
+	return loader;
+}
+
+// loads the files without a renderer and returns the settings of the camera that main.cpp starts with
+shared_ptr<PointCloudLoader> load_for_benchmark(vector<string> files, CpuRenderSettings& settings){
+
+	auto loader = load_headless(files);
+
+	if(loader->files.empty()){
+		return nullptr;
+	}
+
+	auto pc = loader->files[0];
+	OrbitControls controls;
+	controls.yaw = 0.53;
+	controls.pitch = -0.68;
+	controls.radius = glm::length(pc->boxMax - pc->boxMin) / 1.5;
+	controls.target = (pc->boxMax + pc->boxMin) / 2.0;
+	controls.update();
+
+	Camera camera;
+	camera.setSize(1920, 1080);
+	camera.world = controls.world;
+	camera.update();
+
+	settings.view = camera.view;
+	settings.proj = camera.proj;
+	settings.imageSize = {1920, 1080};
+
+	return loader;
+}
+
+// average stats of numFrames frames, after one that faults in the framebuffer and bins
+CpuRenderStats measure_frames(CpuRasterizer& rasterizer, PointCloudLoader& loader, const CpuRenderSettings& settings, int numFrames){
+
+	rasterizer.render(loader, settings);
+
+	CpuRenderStats total = rasterizer.stats;
+	total.clearMillis = 0.0;
+	total.renderMillis = 0.0;
+	total.binMillis = 0.0;
+	total.resolveMillis = 0.0;
+	total.edlMillis = 0.0;
+
+	for(int i = 0; i < numFrames; i++){
+		rasterizer.render(loader, settings);
+
+		total.clearMillis += rasterizer.stats.clearMillis / numFrames;
+		total.renderMillis += rasterizer.stats.renderMillis / numFrames;
+		total.binMillis += rasterizer.stats.binMillis / numFrames;
+		total.resolveMillis += rasterizer.stats.resolveMillis / numFrames;
+		total.edlMillis += rasterizer.stats.edlMillis / numFrames;
+	}
+
+	return total;
+}
+
+void benchmark_cpu_render(vector<string> files){
+
+	CpuRenderSettings settings;
+	auto loader = load_for_benchmark(files, settings);
+
+	if(!loader){
+		return;
+	}
+
+	CpuRasterizer rasterizer;
+
+	cout << formatNumber(loader->numPointsLoaded) << " points, 1920 x 1080, " << rasterizer.workers->numThreads() << " threads, "
+		<< toString(rasterizer.simdLevel) << endl;
+
+	vector<uint32_t> reference;
+
+	for(CpuRasterMode mode : {CpuRasterMode::ATOMIC, CpuRasterMode::BINNED}){
+		settings.rasterMode = mode;
+
+		CpuRenderStats stats = measure_frames(rasterizer, *loader, settings, 10);
+		double frameMillis = stats.clearMillis + stats.renderMillis + stats.resolveMillis;
+
+		cout << toString(mode) << endl;
+		cout << "    batches: " << formatNumber(stats.numNodesProcessed) << " processed, " << formatNumber(stats.numNodesRendered) << " rendered" << endl;
+		cout << "    points : " << formatNumber(stats.numPointsProcessed) << " processed, " << formatNumber(stats.numPointsRendered) << " rendered, "
+			<< formatNumber(stats.numPointsVisible) << " visible" << endl;
+		cout << "    clear  : " << formatNumber(stats.clearMillis, 2) << " ms" << endl;
+		cout << "    render : " << formatNumber(stats.renderMillis, 2) << " ms, "
+			<< formatNumber(double(stats.numPointsProcessed) / stats.renderMillis / 1000.0, 1) << " M points/s";
+		if(mode == CpuRasterMode::BINNED){
+			cout << ", binning " << formatNumber(stats.binMillis, 2) << " ms";
+		}
+		cout << endl;
+		cout << "    resolve: " << formatNumber(stats.resolveMillis, 2) << " ms" << endl;
+		cout << "    frame  : " << formatNumber(frameMillis, 2) << " ms" << endl;
+
+		// both modes and the scalar kernel must produce the same image
+		if(reference.empty()){
+			reference = rasterizer.image;
+		}else{
+			cout << "    identical to atomic: " << (rasterizer.image == reference ? "yes" : "NO") << endl;
+		}
+	}
+
+	{ // eye-dome lighting on top of the atomic frame
+		settings.rasterMode = CpuRasterMode::ATOMIC;
+		settings.enableEDL = true;
+
+		CpuRenderStats stats = measure_frames(rasterizer, *loader, settings, 10);
+		double frameMillis = stats.clearMillis + stats.renderMillis + stats.resolveMillis + stats.edlMillis;
+
+		cout << "atomic with edl" << endl;
+		cout << "    clear  : " << formatNumber(stats.clearMillis, 2) << " ms" << endl;
+		cout << "    render : " << formatNumber(stats.renderMillis, 2) << " ms" << endl;
+		cout << "    resolve: " << formatNumber(stats.resolveMillis, 2) << " ms, with depth plane" << endl;
+		cout << "    edl    : " << formatNumber(stats.edlMillis, 2) << " ms, "
+			<< formatNumber(1920.0 * 1080.0 / stats.edlMillis / 1000.0, 1) << " M pixels/s" << endl;
+		cout << "    frame  : " << formatNumber(frameMillis, 2) << " ms" << endl;
+	}
+
+	vector<uint32_t> edlReference = rasterizer.image;
+
+	if(rasterizer.simdLevel != SimdLevel::SCALAR){
+		rasterizer.simdLevel = SimdLevel::SCALAR;
+
+		settings.enableEDL = false;
+		rasterizer.render(*loader, settings);
+
+		cout << "scalar kernels" << endl;
+		cout << "    render : " << formatNumber(rasterizer.stats.renderMillis, 2) << " ms"
+			<< ", identical to atomic: " << (rasterizer.image == reference ? "yes" : "NO") << endl;
+
+		settings.enableEDL = true;
+		rasterizer.render(*loader, settings);
+
+		cout << "    edl    : " << formatNumber(rasterizer.stats.edlMillis, 2) << " ms"
+			<< ", identical to simd: " << (rasterizer.image == edlReference ? "yes" : "NO") << endl;
+	}
+}
+
+void benchmark_cpu_scaling(vector<string> files){
+
+	CpuRenderSettings settings;
+	auto loader = load_for_benchmark(files, settings);
+
+	if(!loader){
+		return;
+	}
+
+	int numProcessors = getCpuData().numProcessors;
+
+	vector<int> threadCounts;
+	for(int numThreads = 1; numThreads < numProcessors; numThreads *= 2){
+		threadCounts.push_back(numThreads);
+	}
+	threadCounts.push_back(numProcessors);
+
+	cout << formatNumber(loader->numPointsLoaded) << " points, 1920 x 1080, render pass in ms" << endl;
+	cout << "threads      atomic    speedup      binned    speedup" << endl;
+
+	double atomic1 = 0.0;
+	double binned1 = 0.0;
+
+	for(int numThreads : threadCounts){
+		CpuRasterizer rasterizer(numThreads);
+
+		settings.rasterMode = CpuRasterMode::ATOMIC;
+		double atomic = measure_frames(rasterizer, *loader, settings, 5).renderMillis;
+
+		settings.rasterMode = CpuRasterMode::BINNED;
+		double binned = measure_frames(rasterizer, *loader, settings, 5).renderMillis;
+
+		if(numThreads == 1){
+			atomic1 = atomic;
+			binned1 = binned;
+		}
+
+		cout << leftPad(formatNumber(numThreads), 7)
+			<< leftPad(formatNumber(atomic, 1), 12) << leftPad(formatNumber(atomic1 / atomic, 2), 11)
+			<< leftPad(formatNumber(binned, 1), 12) << leftPad(formatNumber(binned1 / binned, 2), 11) << endl;
+	}
+}
@@ -0,0 +1,161 @@
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "glm/common.hpp"
+#include "glm/matrix.hpp"
+
+#include "unsuck.hpp"
+#include "../data/batch_encoder.h"
+#include "edl.h"
+
+using namespace std;
+using glm::dmat4;
+using glm::ivec2;
+
+struct PointCloudLoader;
+
+// render.cs and resolve.cs on the CPU, for machines without a GPU and as a reference for the shaders.
+//
+// renders the host buffers of a PointCloudLoader, i.e. one without a renderer or with keepHostCopy, with the same
+// batch culling, precision levels, 10/20/30 bit decoding and projection as render.cs, into a framebuffer of
+// 64-bit depth|color values. threads take batches from a shared counter and project blocks of points with the simd
+// kernels of point_projection.h. the candidates are merged either with a 64-bit atomic min, or binned into
+// CPU_TILE_SIZE tiles and merged tile by tile without atomics, see CpuRasterMode.
+// the resolve pass then turns the framebuffer into colors, like resolve.cs. with EDL enabled, it also extracts a plane
+// of float depths that the edl pass shades the colors with, see edl.h.
+
+// how threads merge points into the framebuffer
+enum class CpuRasterMode{
+	// a 64-bit atomic min per point, like render.cs
+	ATOMIC,
+	// points are binned into per-thread tile bins first, then each tile is merged by one thread with a plain min
+	BINNED
+};
+
+inline string toString(CpuRasterMode mode){
+	if(mode == CpuRasterMode::ATOMIC) return "atomic";
+	if(mode == CpuRasterMode::BINNED) return "binned";
+
+	return "unknown";
+}
+
+// the uniforms of render.cs
+struct CpuRenderSettings{
+	dmat4 view;
+	dmat4 proj;
+	ivec2 imageSize = {0, 0};
+	bool enableFrustumCulling = true;
+	bool colorizeChunks = false;
+	CpuRasterMode rasterMode = CpuRasterMode::ATOMIC;
+	bool enableEDL = false;
+	float edlStrength = EDL_DEFAULT_STRENGTH;
+};
+
+// the debug counters of render.cs and resolve.cs, and the duration of each pass
+struct CpuRenderStats{
+	int64_t numNodesProcessed = 0;
+	int64_t numNodesRendered = 0;
+	int64_t numPointsProcessed = 0;
+	int64_t numPointsRendered = 0;
+	int64_t numPointsVisible = 0;
+
+	double clearMillis = 0.0;
+	double renderMillis = 0.0;
+	// the binning phase of renderMillis, if binned
+	double binMillis = 0.0;
+	// includes the depth plane, if EDL is enabled
+	double resolveMillis = 0.0;
+	double edlMillis = 0.0;
+};
+
+// threads that are started once and run a job per pass, so that a frame doesn't pay for starting threads
+struct CpuWorkers{
+	vector<thread> threads;
+	mutex mtx;
+	condition_variable cvStart;
+	condition_variable cvDone;
+	function<void(int)> job;
+	int64_t generation = 0;
+	int numRunning = 0;
+	bool isClosing = false;
+
+	// numThreads includes the thread that calls run()
+	CpuWorkers(int numThreads);
+	~CpuWorkers();
+
+	int numThreads(){
+		return int(threads.size()) + 1;
+	}
+
+	// runs job(threadIndex) on every thread and returns once all are done
+	void run(function<void(int)> job);
+};
+
+// 64 x 64 pixels of depth|color fit into L1 or L2
+constexpr uint32_t CPU_TILE_SIZE = 64;
+
+// the points of one thread that fall into one tile
+struct CpuTileBin{
+	// depth|color
+	vector<uint64_t> points;
+	// x + y * CPU_TILE_SIZE within the tile
+	vector<uint16_t> pixels;
+};
+
+struct CpuRasterizer{
+
+	shared_ptr<CpuWorkers> workers = nullptr;
+
+	// depth in the upper, color in the lower 32 bits, like ssFramebuffer
+	unique_ptr<atomic<uint64_t>[]> framebuffer = nullptr;
+	int64_t framebufferCapacity = 0;
+	ivec2 imageSize = {0, 0};
+
+	// resolved RGBA8 colors, rows from bottom to top
+	vector<uint32_t> image;
+
+	// depths of the resolved pixels for EDL, EDL_EMPTY_DEPTH where there is no point.
+	// rows of imageSize.x + 2 with a border of one pixel around the image
+	vector<float> depthPlane;
+
+	// by thread and tile, for binned rendering
+	vector<vector<CpuTileBin>> bins;
+
+	CpuRenderStats stats;
+
+	// of the projection and edl kernels, see point_projection.h and edl.h
+	SimdLevel simdLevel = detect_simd_level();
+
+	CpuRasterizer(int numThreads = getCpuData().numProcessors);
+
+	// clears, renders all resident batches of the loader and resolves them into image.
+	// call from the thread that calls process(), uploads may move the host buffers
+	void render(PointCloudLoader& loader, const CpuRenderSettings& settings);
+
+	void resize(ivec2 size);
+	void clear();
+	void renderBatches(PointCloudLoader& loader, const CpuRenderSettings& settings);
+	void renderAtomic(PointCloudLoader& loader, const CpuRenderSettings& settings, vector<CpuRenderStats>& threadStats);
+	void renderBinned(PointCloudLoader& loader, const CpuRenderSettings& settings, vector<CpuRenderStats>& threadStats);
+	void resolve(const CpuRenderSettings& settings);
+	void edl(const CpuRenderSettings& settings);
+};
+
+// loads the files without a renderer and returns once all points that the files deliver are in the host buffers
+shared_ptr<PointCloudLoader> load_headless(vector<string> files);
+
+// loads the files without a renderer, renders them from the default camera on the CPU and prints the cost of each pass,
+// without and with EDL
+void benchmark_cpu_render(vector<string> files);
+
+// renders the files atomic and binned with 1, 2, 4, ... up to all cores and prints the render pass of each
+void benchmark_cpu_scaling(vector<string> files);
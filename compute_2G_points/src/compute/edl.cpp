@@ -0,0 +1,311 @@
+
+#include "edl.h"
+
+#include <vector>
+#include <random>
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include "unsuck.hpp"
+
+#if defined(_M_X64) || defined(__x86_64__)
+	#define EDL_X64
+	#include <immintrin.h>
+#endif
+
+// msvc compiles intrinsics of any ISA, gcc and clang need them enabled per function
+#if defined(__GNUC__) || defined(__clang__)
+	#define TARGET_AVX2 __attribute__((target("avx2")))
+	#define TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+	#define TARGET_AVX2
+	#define TARGET_AVX512
+#endif
+
+// exp(x) for x <= 0 as 2^i * p(f), with t = x * log2(e) = i + f and a polynomial for 2^f on [0, 1).
+// the relative error is below 1e-6, far less than the 8-bit colors it scales.
+// the simd versions perform the same float operations in the same order.
+
+constexpr float EXP_MIN = -87.0f;
+constexpr float LOG2E = 1.44269504f;
+constexpr float EXP_C1 = 0.693147182f;
+constexpr float EXP_C2 = 0.240226492f;
+constexpr float EXP_C3 = 0.0555036917f;
+constexpr float EXP_C4 = 0.00961881271f;
+constexpr float EXP_C5 = 0.00133335581f;
+
+inline float exp_negative(float x){
+	x = std::max(x, EXP_MIN);
+
+	float t = x * LOG2E;
+	float i = std::floor(t);
+	float f = t - i;
+
+	float p = EXP_C5;
+	p = p * f + EXP_C4;
+	p = p * f + EXP_C3;
+	p = p * f + EXP_C2;
+	p = p * f + EXP_C1;
+	p = p * f + 1.0f;
+
+	uint32_t bits = uint32_t(int32_t(i) + 127) << 23;
+	float scale;
+	memcpy(&scale, &bits, 4);
+
+	return p * scale;
+}
+
+void edl_shade_row_scalar(const float* above, const float* row, const float* below, int64_t begin, int64_t end, float strength, uint32_t* colors){
+
+	for(int64_t x = begin; x < end; x++){
+		float depth = row[x];
+
+		if(!(depth < EDL_EMPTY_DEPTH)){
+			continue;
+		}
+
+		float sum = 0.0f;
+		for(const float* neighbours : {above, row, below}){
+			sum += std::max(depth - neighbours[x - 1], 0.0f);
+			sum += std::max(depth - neighbours[x + 0], 0.0f);
+			sum += std::max(depth - neighbours[x + 1], 0.0f);
+		}
+
+		float shade = exp_negative(sum / 9.0f * -300.0f * strength);
+
+		uint32_t color = colors[x];
+		uint32_t R = uint32_t(float((color >>  0) & 0xFF) * shade);
+		uint32_t G = uint32_t(float((color >>  8) & 0xFF) * shade);
+		uint32_t B = uint32_t(float((color >> 16) & 0xFF) * shade);
+
+		colors[x] = R | (G << 8) | (B << 16);
+	}
+}
+
+#ifdef EDL_X64
+
+// AVX2, 8 pixels per iteration
+
+TARGET_AVX2
+inline __m256 exp_negative_avx2(__m256 x){
+	x = _mm256_max_ps(x, _mm256_set1_ps(EXP_MIN));
+
+	__m256 t = _mm256_mul_ps(x, _mm256_set1_ps(LOG2E));
+	__m256 i = _mm256_floor_ps(t);
+	__m256 f = _mm256_sub_ps(t, i);
+
+	__m256 p = _mm256_set1_ps(EXP_C5);
+	p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(EXP_C4));
+	p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(EXP_C3));
+	p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(EXP_C2));
+	p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(EXP_C1));
+	p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(1.0f));
+
+	__m256i bits = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(i), _mm256_set1_epi32(127)), 23);
+
+	return _mm256_mul_ps(p, _mm256_castsi256_ps(bits));
+}
+
+TARGET_AVX2
+inline __m256i scale_channel_avx2(__m256i colors, int shift, __m256 shade){
+	__m256i channel = _mm256_and_si256(_mm256_srli_epi32(colors, shift), _mm256_set1_epi32(0xFF));
+	channel = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(channel), shade));
+
+	return _mm256_slli_epi32(channel, shift);
+}
+
+TARGET_AVX2
+void edl_shade_row_avx2(const float* above, const float* row, const float* below, int64_t numPixels, float strength, uint32_t* colors){
+
+	__m256 zero = _mm256_setzero_ps();
+	__m256 empty = _mm256_set1_ps(EDL_EMPTY_DEPTH);
+	__m256 nine = _mm256_set1_ps(9.0f);
+	__m256 factor = _mm256_set1_ps(-300.0f);
+	__m256 vStrength = _mm256_set1_ps(strength);
+
+	int64_t x = 0;
+	for(; x + 8 <= numPixels; x += 8){
+		__m256 depth = _mm256_loadu_ps(row + x);
+		__m256 hasPoint = _mm256_cmp_ps(depth, empty, _CMP_LT_OQ);
+
+		if(_mm256_movemask_ps(hasPoint) == 0){
+			continue;
+		}
+
+		__m256 sum = zero;
+		for(const float* neighbours : {above, row, below}){
+			sum = _mm256_add_ps(sum, _mm256_max_ps(_mm256_sub_ps(depth, _mm256_loadu_ps(neighbours + x - 1)), zero));
+			sum = _mm256_add_ps(sum, _mm256_max_ps(_mm256_sub_ps(depth, _mm256_loadu_ps(neighbours + x + 0)), zero));
+			sum = _mm256_add_ps(sum, _mm256_max_ps(_mm256_sub_ps(depth, _mm256_loadu_ps(neighbours + x + 1)), zero));
+		}
+
+		__m256 shade = exp_negative_avx2(_mm256_mul_ps(_mm256_mul_ps(_mm256_div_ps(sum, nine), factor), vStrength));
+
+		__m256i color = _mm256_loadu_si256((const __m256i*)(colors + x));
+		__m256i shaded = _mm256_or_si256(
+			scale_channel_avx2(color, 0, shade),
+			_mm256_or_si256(scale_channel_avx2(color, 8, shade), scale_channel_avx2(color, 16, shade)));
+
+		color = _mm256_blendv_epi8(color, shaded, _mm256_castps_si256(hasPoint));
+
+		_mm256_storeu_si256((__m256i*)(colors + x), color);
+	}
+
+	edl_shade_row_scalar(above, row, below, x, numPixels, strength, colors);
+}
+
+// AVX-512, 16 pixels per iteration
+
+TARGET_AVX512
+inline __m512 exp_negative_avx512(__m512 x){
+	x = _mm512_max_ps(x, _mm512_set1_ps(EXP_MIN));
+
+	__m512 t = _mm512_mul_ps(x, _mm512_set1_ps(LOG2E));
+	__m512 i = _mm512_roundscale_ps(t, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+	__m512 f = _mm512_sub_ps(t, i);
+
+	__m512 p = _mm512_set1_ps(EXP_C5);
+	p = _mm512_add_ps(_mm512_mul_ps(p, f), _mm512_set1_ps(EXP_C4));
+	p = _mm512_add_ps(_mm512_mul_ps(p, f), _mm512_set1_ps(EXP_C3));
+	p = _mm512_add_ps(_mm512_mul_ps(p, f), _mm512_set1_ps(EXP_C2));
+	p = _mm512_add_ps(_mm512_mul_ps(p, f), _mm512_set1_ps(EXP_C1));
+	p = _mm512_add_ps(_mm512_mul_ps(p, f), _mm512_set1_ps(1.0f));
+
+	__m512i bits = _mm512_slli_epi32(_mm512_add_epi32(_mm512_cvtps_epi32(i), _mm512_set1_epi32(127)), 23);
+
+	return _mm512_mul_ps(p, _mm512_castsi512_ps(bits));
+}
+
+TARGET_AVX512
+inline __m512i scale_channel_avx512(__m512i colors, int shift, __m512 shade){
+	__m512i channel = _mm512_and_si512(_mm512_srli_epi32(colors, shift), _mm512_set1_epi32(0xFF));
+	channel = _mm512_cvttps_epi32(_mm512_mul_ps(_mm512_cvtepi32_ps(channel), shade));
+
+	return _mm512_slli_epi32(channel, shift);
+}
+
+TARGET_AVX512
+void edl_shade_row_avx512(const float* above, const float* row, const float* below, int64_t numPixels, float strength, uint32_t* colors){
+
+	__m512 zero = _mm512_setzero_ps();
+	__m512 empty = _mm512_set1_ps(EDL_EMPTY_DEPTH);
+	__m512 nine = _mm512_set1_ps(9.0f);
+	__m512 factor = _mm512_set1_ps(-300.0f);
+	__m512 vStrength = _mm512_set1_ps(strength);
+
+	int64_t x = 0;
+	for(; x + 16 <= numPixels; x += 16){
+		__m512 depth = _mm512_loadu_ps(row + x);
+		__mmask16 hasPoint = _mm512_cmp_ps_mask(depth, empty, _CMP_LT_OQ);
+
+		if(hasPoint == 0){
+			continue;
+		}
+
+		__m512 sum = zero;
+		for(const float* neighbours : {above, row, below}){
+			sum = _mm512_add_ps(sum, _mm512_max_ps(_mm512_sub_ps(depth, _mm512_loadu_ps(neighbours + x - 1)), zero));
+			sum = _mm512_add_ps(sum, _mm512_max_ps(_mm512_sub_ps(depth, _mm512_loadu_ps(neighbours + x + 0)), zero));
+			sum = _mm512_add_ps(sum, _mm512_max_ps(_mm512_sub_ps(depth, _mm512_loadu_ps(neighbours + x + 1)), zero));
+		}
+
+		__m512 shade = exp_negative_avx512(_mm512_mul_ps(_mm512_mul_ps(_mm512_div_ps(sum, nine), factor), vStrength));
+
+		__m512i color = _mm512_loadu_si512(colors + x);
+		__m512i shaded = _mm512_or_si512(
+			scale_channel_avx512(color, 0, shade),
+			_mm512_or_si512(scale_channel_avx512(color, 8, shade), scale_channel_avx512(color, 16, shade)));
+
+		_mm512_mask_storeu_epi32(colors + x, hasPoint, shaded);
+	}
+
+	edl_shade_row_scalar(above, row, below, x, numPixels, strength, colors);
+}
+
+#endif
+
+void edl_shade_row(const float* above, const float* row, const float* below, int64_t numPixels, float strength,
+	uint32_t* colors, SimdLevel level)
+{
+
+#ifdef EDL_X64
+	if(level == SimdLevel::AVX512){
+		edl_shade_row_avx512(above, row, below, numPixels, strength, colors);
+
+		return;
+	}else if(level == SimdLevel::AVX2){
+		edl_shade_row_avx2(above, row, below, numPixels, strength, colors);
+
+		return;
+	}
+#endif
+
+	edl_shade_row_scalar(above, row, below, 0, numPixels, strength, colors);
+}
+
+void benchmark_edl(){
+
+	// a depth plane with a border, slopes and steps between 10 and 100 meters, a third of the pixels empty
+	int64_t width = 1920;
+	int64_t height = 1080;
+	int64_t stride = width + 2;
+	int numRepetitions = 50;
+
+	vector<float> plane(stride * (height + 2), EDL_EMPTY_DEPTH);
+	vector<uint32_t> colors(width * height);
+	mt19937 rng(123);
+	uniform_real_distribution<float> distribution(0.0f, 1.0f);
+
+	for(int64_t y = 0; y < height; y++){
+		for(int64_t x = 0; x < width; x++){
+			bool isEmpty = distribution(rng) < 0.33f;
+			float depth = 10.0f + 0.02f * float(x) + 30.0f * float((x / 64 + y / 48) % 3) + distribution(rng);
+
+			plane[(y + 1) * stride + x + 1] = isEmpty ? EDL_EMPTY_DEPTH : depth;
+			colors[y * width + x] = uint32_t(rng());
+		}
+	}
+
+	auto shade = [&](SimdLevel level, vector<uint32_t>& target){
+		for(int64_t y = 0; y < height; y++){
+			const float* row = plane.data() + (y + 1) * stride + 1;
+
+			edl_shade_row(row - stride, row, row + stride, width, EDL_DEFAULT_STRENGTH, target.data() + y * width, level);
+		}
+	};
+
+	vector<uint32_t> reference = colors;
+	shade(SimdLevel::SCALAR, reference);
+
+	SimdLevel supported = detect_simd_level();
+
+	cout << "benchmark edl: " << width << " x " << height << " x " << numRepetitions
+		<< ", one thread, supported: " << toString(supported) << endl;
+
+	for(SimdLevel level : {SimdLevel::SCALAR, SimdLevel::AVX2, SimdLevel::AVX512}){
+
+		if(int(level) > int(supported)){
+			continue;
+		}
+
+		vector<uint32_t> shaded;
+		double duration = 0.0;
+
+		for(int i = 0; i < numRepetitions; i++){
+			shaded = colors;
+
+			double tStart = now();
+			shade(level, shaded);
+			duration += now() - tStart;
+		}
+
+		double millis = 1000.0 * duration / numRepetitions;
+		double mpixelsPerSecond = double(width * height) / (duration / numRepetitions) / 1'000'000.0;
+
+		cout << leftPad(toString(level), 7)
+			<< ": " << formatNumber(millis, 2) << " ms, " << formatNumber(mpixelsPerSecond, 1) << " Mpixels/s"
+			<< ", identical to scalar: " << (shaded == reference ? "yes" : "NO") << endl;
+	}
+}
@@ -0,0 +1,420 @@
+
+#include "headless_render.h"
+
+#include <fstream>
+#include <filesystem>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+#include "nlohmann/json.hpp"
+
+#include "Camera.h"
+#include "OrbitControls.h"
+#include "../data/point_clouds_loader.h"
+
+using nlohmann::json;
+
+namespace fs = std::filesystem;
+
+shared_ptr<CameraPath> load_camera_path(string path){
+
+	if(!fs::exists(path)){
+		GENERATE_WARN_MESSAGE << "camera path not found: " << path << endl;
+
+		return nullptr;
+	}
+
+	json js = json::parse(readFile(path), nullptr, false);
+
+	// a plain array of frames is accepted as well
+	if(js.is_array()){
+		js = json{{"frames", js}};
+	}
+
+	// all keys are optional, but value() and get() throw if they have another type
+	auto isNumber = [](const json& object, const char* key){
+		return !object.contains(key) || object[key].is_number();
+	};
+	auto isString = [](const json& object, const char* key){
+		return !object.contains(key) || object[key].is_string();
+	};
+	auto isBoolean = [](const json& object, const char* key){
+		return !object.contains(key) || object[key].is_boolean();
+	};
+	auto isValidFrame = [&](const json& jsFrame){
+		if(!jsFrame.is_object()){
+			return false;
+		}
+
+		if(jsFrame.contains("target")){
+			const json& jsTarget = jsFrame["target"];
+
+			if(!jsTarget.is_array() || jsTarget.size() != 3
+				|| !jsTarget[0].is_number() || !jsTarget[1].is_number() || !jsTarget[2].is_number())
+			{
+				return false;
+			}
+		}
+
+		return isNumber(jsFrame, "yaw") && isNumber(jsFrame, "pitch") && isNumber(jsFrame, "radius");
+	};
+
+	bool isValid = !js.is_discarded() && js.is_object() && js.contains("frames") && js["frames"].is_array()
+		&& isNumber(js, "width") && isNumber(js, "height")
+		&& isString(js, "format") && isString(js, "mode") && isBoolean(js, "edl")
+		&& std::all_of(js["frames"].begin(), js["frames"].end(), isValidFrame);
+
+	if(!isValid){
+		GENERATE_WARN_MESSAGE << "could not parse camera path " << path << endl;
+
+		return nullptr;
+	}
+
+	auto cameraPath = make_shared<CameraPath>();
+	cameraPath->imageSize.x = js.value("width", cameraPath->imageSize.x);
+	cameraPath->imageSize.y = js.value("height", cameraPath->imageSize.y);
+	cameraPath->format = js.value("format", cameraPath->format);
+
+	string mode = js.value("mode", toString(cameraPath->rasterMode));
+	cameraPath->rasterMode = mode == "binned" ? CpuRasterMode::BINNED : CpuRasterMode::ATOMIC;
+	cameraPath->enableEDL = js.value("edl", cameraPath->enableEDL);
+
+	if(cameraPath->imageSize.x <= 0 || cameraPath->imageSize.y <= 0 || (cameraPath->format != "png" && cameraPath->format != "ppm")){
+		GENERATE_WARN_MESSAGE << "invalid size or format in camera path " << path << endl;
+
+		return nullptr;
+	}
+
+	for(auto& jsFrame : js["frames"]){
+		CameraPathFrame frame;
+
+		frame.yaw = jsFrame.value("yaw", frame.yaw);
+		frame.pitch = jsFrame.value("pitch", frame.pitch);
+		frame.radius = jsFrame.value("radius", frame.radius);
+
+		if(jsFrame.contains("target")){
+			const json& jsTarget = jsFrame["target"];
+			frame.target = {jsTarget[0].get<double>(), jsTarget[1].get<double>(), jsTarget[2].get<double>()};
+		}
+
+		cameraPath->frames.push_back(frame);
+	}
+
+	return cameraPath;
+}
+
+void write_ppm(string path, const vector<uint32_t>& image, ivec2 size){
+
+	string header = "P6\n" + to_string(size.x) + " " + to_string(size.y) + "\n255\n";
+
+	vector<uint8_t> pixels(3 * int64_t(size.x) * int64_t(size.y));
+
+	for(int64_t y = 0; y < size.y; y++){
+		const uint32_t* row = image.data() + (size.y - y - 1) * int64_t(size.x);
+		uint8_t* target = pixels.data() + 3 * y * int64_t(size.x);
+
+		for(int64_t x = 0; x < size.x; x++){
+			target[3 * x + 0] = (row[x] >>  0) & 0xFF;
+			target[3 * x + 1] = (row[x] >>  8) & 0xFF;
+			target[3 * x + 2] = (row[x] >> 16) & 0xFF;
+		}
+	}
+
+	ofstream file(path, ios::binary);
+	file.write(header.data(), header.size());
+	file.write((const char*)pixels.data(), pixels.size());
+}
+
+// deflate with the fixed huffman codes and greedy LZ77 matches, enough for renderings with large uniform areas
+struct DeflateWriter{
+
+	vector<uint8_t> bytes;
+	uint64_t bitBuffer = 0;
+	int numBits = 0;
+
+	void writeBits(uint32_t value, int count){
+		bitBuffer |= uint64_t(value) << numBits;
+		numBits += count;
+
+		while(numBits >= 8){
+			bytes.push_back(bitBuffer & 0xFF);
+			bitBuffer >>= 8;
+			numBits -= 8;
+		}
+	}
+
+	// huffman codes are stored starting with their most significant bit
+	void writeCode(uint32_t code, int length){
+		uint32_t reversed = 0;
+
+		for(int i = 0; i < length; i++){
+			reversed |= ((code >> i) & 1) << (length - i - 1);
+		}
+
+		writeBits(reversed, length);
+	}
+
+	void writeLiteral(uint32_t symbol){
+		if(symbol < 144){
+			writeCode(0x30 + symbol, 8);
+		}else if(symbol < 256){
+			writeCode(0x190 + symbol - 144, 9);
+		}else if(symbol < 280){
+			writeCode(symbol - 256, 7);
+		}else{
+			writeCode(0xC0 + symbol - 280, 8);
+		}
+	}
+
+	void writeMatch(int length, int distance){
+		static const int lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+		static const int lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+		static const int distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+		static const int distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+		int lengthCode = 28;
+		while(lengthBase[lengthCode] > length){
+			lengthCode--;
+		}
+
+		int distanceCode = 29;
+		while(distanceBase[distanceCode] > distance){
+			distanceCode--;
+		}
+
+		writeLiteral(257 + lengthCode);
+		writeBits(length - lengthBase[lengthCode], lengthExtra[lengthCode]);
+		writeCode(distanceCode, 5);
+		writeBits(distance - distanceBase[distanceCode], distanceExtra[distanceCode]);
+	}
+
+	void compress(const uint8_t* data, int64_t size){
+
+		constexpr int64_t WINDOW_SIZE = 32768;
+		constexpr int64_t MIN_MATCH = 3;
+		constexpr int64_t MAX_MATCH = 258;
+		constexpr int HASH_BITS = 15;
+
+		vector<int64_t> head(1 << HASH_BITS, -1);
+
+		auto hash = [&](int64_t i){
+			uint32_t value = data[i] | (data[i + 1] << 8) | (data[i + 2] << 16);
+
+			return (value * 2654435761u) >> (32 - HASH_BITS);
+		};
+
+		// one final block with fixed codes
+		writeBits(1, 1);
+		writeBits(1, 2);
+
+		int64_t i = 0;
+		while(i < size){
+
+			int64_t matchLength = 0;
+			int64_t matchDistance = 0;
+
+			if(i + MIN_MATCH <= size){
+				uint32_t h = hash(i);
+				int64_t candidate = head[h];
+				head[h] = i;
+
+				if(candidate >= 0 && i - candidate <= WINDOW_SIZE){
+					int64_t maxLength = std::min(MAX_MATCH, size - i);
+
+					while(matchLength < maxLength && data[candidate + matchLength] == data[i + matchLength]){
+						matchLength++;
+					}
+
+					matchDistance = i - candidate;
+				}
+			}
+
+			if(matchLength >= MIN_MATCH){
+				writeMatch(matchLength, matchDistance);
+
+				// index the positions within the match, so that following runs find it
+				for(int64_t j = i + 1; j < i + matchLength && j + MIN_MATCH <= size; j++){
+					head[hash(j)] = j;
+				}
+
+				i += matchLength;
+			}else{
+				writeLiteral(data[i]);
+				i++;
+			}
+		}
+
+		writeLiteral(256);
+
+		if(numBits > 0){
+			writeBits(0, 8 - numBits);
+		}
+	}
+};
+
+void write_png(string path, const vector<uint32_t>& image, ivec2 size){
+
+	auto crc32 = [](const uint8_t* data, int64_t size, uint32_t crc){
+		static uint32_t table[256] = {};
+
+		if(table[1] == 0){
+			for(uint32_t n = 0; n < 256; n++){
+				uint32_t c = n;
+
+				for(int k = 0; k < 8; k++){
+					c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+				}
+
+				table[n] = c;
+			}
+		}
+
+		crc = ~crc;
+		for(int64_t i = 0; i < size; i++){
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+
+		return ~crc;
+	};
+
+	auto pushBigEndian = [](vector<uint8_t>& target, uint32_t value){
+		target.push_back(value >> 24);
+		target.push_back(value >> 16);
+		target.push_back(value >> 8);
+		target.push_back(value >> 0);
+	};
+
+	// scanlines from top to bottom, each with filter type 0
+	int64_t rowSize = 1 + 3 * int64_t(size.x);
+	vector<uint8_t> scanlines(rowSize * size.y);
+
+	for(int64_t y = 0; y < size.y; y++){
+		const uint32_t* row = image.data() + (size.y - y - 1) * int64_t(size.x);
+		uint8_t* target = scanlines.data() + y * rowSize;
+
+		target[0] = 0;
+		for(int64_t x = 0; x < size.x; x++){
+			target[1 + 3 * x + 0] = (row[x] >>  0) & 0xFF;
+			target[1 + 3 * x + 1] = (row[x] >>  8) & 0xFF;
+			target[1 + 3 * x + 2] = (row[x] >> 16) & 0xFF;
+		}
+	}
+
+	// zlib stream: header, deflate data, adler32
+	DeflateWriter deflate;
+	deflate.bytes = {0x78, 0x01};
+	deflate.compress(scanlines.data(), scanlines.size());
+
+	uint32_t a = 1;
+	uint32_t b = 0;
+	for(uint8_t value : scanlines){
+		a = (a + value) % 65521;
+		b = (b + a) % 65521;
+	}
+	pushBigEndian(deflate.bytes, (b << 16) | a);
+
+	vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+	auto writeChunk = [&](const char* type, const vector<uint8_t>& data){
+		pushBigEndian(png, uint32_t(data.size()));
+
+		int64_t typeOffset = png.size();
+		png.insert(png.end(), type, type + 4);
+		png.insert(png.end(), data.begin(), data.end());
+
+		pushBigEndian(png, crc32(png.data() + typeOffset, 4 + data.size(), 0));
+	};
+
+	// 8 bit RGB
+	vector<uint8_t> header;
+	pushBigEndian(header, size.x);
+	pushBigEndian(header, size.y);
+	header.insert(header.end(), {8, 2, 0, 0, 0});
+
+	writeChunk("IHDR", header);
+	writeChunk("IDAT", deflate.bytes);
+	writeChunk("IEND", {});
+
+	ofstream file(path, ios::binary);
+	file.write((const char*)png.data(), png.size());
+}
+
+void render_camera_path(vector<string> files, string cameraPathFile, string outputDir){
+
+	auto cameraPath = load_camera_path(cameraPathFile);
+
+	if(!cameraPath){
+		return;
+	}
+
+	std::error_code ec;
+	fs::create_directories(outputDir, ec);
+
+	if(ec){
+		GENERATE_WARN_MESSAGE << "could not create " << outputDir << ": " << ec.message() << endl;
+
+		return;
+	}
+
+	double tLoad = now();
+	auto loader = load_headless(files);
+
+	cout << "loaded " << formatNumber(loader->numPointsLoaded) << " points in " << formatNumber(now() - tLoad, 3) << "s" << endl;
+
+	ivec2 size = cameraPath->imageSize;
+	CpuRasterizer rasterizer;
+
+	stringstream csv;
+	csv << "frame,clear_ms,render_ms,bin_ms,resolve_ms,edl_ms,write_ms,points_processed,points_rendered,points_visible" << endl;
+
+	for(int64_t frameIndex = 0; frameIndex < int64_t(cameraPath->frames.size()); frameIndex++){
+		CameraPathFrame& frame = cameraPath->frames[frameIndex];
+
+		OrbitControls controls;
+		controls.yaw = frame.yaw;
+		controls.pitch = frame.pitch;
+		controls.radius = frame.radius;
+		controls.target = frame.target;
+		controls.update();
+
+		Camera camera;
+		camera.setSize(size.x, size.y);
+		camera.world = controls.world;
+		camera.update();
+
+		CpuRenderSettings settings;
+		settings.view = camera.view;
+		settings.proj = camera.proj;
+		settings.imageSize = size;
+		settings.rasterMode = cameraPath->rasterMode;
+		settings.enableEDL = cameraPath->enableEDL;
+
+		rasterizer.render(*loader, settings);
+
+		stringstream ssName;
+		ssName << "frame_" << std::setw(4) << std::setfill('0') << frameIndex << "." << cameraPath->format;
+		string imagePath = (fs::path(outputDir) / ssName.str()).string();
+
+		double tWrite = now();
+
+		if(cameraPath->format == "ppm"){
+			write_ppm(imagePath, rasterizer.image, size);
+		}else{
+			write_png(imagePath, rasterizer.image, size);
+		}
+
+		double writeMillis = 1000.0 * (now() - tWrite);
+
+		CpuRenderStats& stats = rasterizer.stats;
+
+		csv << frameIndex << std::fixed << std::setprecision(3)
+			<< "," << stats.clearMillis << "," << stats.renderMillis << "," << stats.binMillis
+			<< "," << stats.resolveMillis << "," << stats.edlMillis << "," << writeMillis
+			<< "," << stats.numPointsProcessed << "," << stats.numPointsRendered << "," << stats.numPointsVisible << endl;
+
+		cout << imagePath << ": " << formatNumber(stats.clearMillis + stats.renderMillis + stats.resolveMillis + stats.edlMillis, 2) << " ms" << endl;
+	}
+
+	writeFile((fs::path(outputDir) / "frames.csv").string(), csv.str());
+}
@@ -0,0 +1,55 @@
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "glm/common.hpp"
+
+#include "unsuck.hpp"
+#include "cpu_rasterizer.h"
+
+using namespace std;
+using glm::dvec3;
+using glm::ivec2;
+
+// renders point clouds along a camera path with the CPU rasterizer, without a window or GL context,
+// e.g. for thumbnails and for perf regression runs. camera paths are JSON files like
+//
+//     {
+//         "width": 1920, "height": 1080, "format": "png", "mode": "atomic", "edl": false,
+//         "frames": [
+//             {"yaw": 0.53, "pitch": -0.68, "radius": 1200.0, "target": [637.5, 851.3, 12.1]},
+//             ...
+//         ]
+//     }
+//
+// where frames are the orbit camera values that "copy camera" prints. everything but frames is optional.
+// each frame is written to outputDir/frame_<index>.<format>, the timings of all frames to outputDir/frames.csv.
+
+struct CameraPathFrame{
+	double yaw = 0.0;
+	double pitch = 0.0;
+	double radius = 1.0;
+	dvec3 target = {0.0, 0.0, 0.0};
+};
+
+struct CameraPath{
+	ivec2 imageSize = {1920, 1080};
+	// png or ppm
+	string format = "png";
+	CpuRasterMode rasterMode = CpuRasterMode::ATOMIC;
+	bool enableEDL = false;
+	vector<CameraPathFrame> frames;
+};
+
+// null if the file can't be parsed
+shared_ptr<CameraPath> load_camera_path(string path);
+
+// RGBA8 pixels with rows from bottom to top, as in CpuRasterizer::image. alpha is dropped
+void write_ppm(string path, const vector<uint32_t>& image, ivec2 size);
+void write_png(string path, const vector<uint32_t>& image, ivec2 size);
+
+// loads the files, waits until all points are loaded and renders each frame of the camera path
+void render_camera_path(vector<string> files, string cameraPathFile, string outputDir);
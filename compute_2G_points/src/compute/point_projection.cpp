@@ -0,0 +1,489 @@
+
+#include "point_projection.h"
+
+#include <vector>
+#include <random>
+#include <iostream>
+#include <bit>
+#include <cstring>
+#include <algorithm>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "unsuck.hpp"
+
+#if defined(_M_X64) || defined(__x86_64__)
+	#define POINT_PROJECTION_X64
+	#include <immintrin.h>
+#endif
+
+// msvc compiles intrinsics of any ISA, gcc and clang need them enabled per function
+#if defined(__GNUC__) || defined(__clang__)
+	#define TARGET_AVX2 __attribute__((target("avx2")))
+	#define TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+	#define TARGET_AVX2
+	#define TARGET_AVX512
+#endif
+
+// like batch_encoder.cpp, the simd kernels perform the scalar float operations in the same order
+// and the comparisons are ordered, so NaN ends up outside the frustum everywhere.
+
+#define STEPS_30BIT 1073741824
+#define STEPS_10BIT 1024
+#define MASK_10BIT 1023
+
+// the parameters of a run of points, as floats
+struct ProjectionConstants{
+	float m[16];
+	float scale[3];
+	float offset[3];
+	float width;
+	float height;
+	int32_t maxX;
+	int32_t maxY;
+	int32_t imageWidth;
+};
+
+ProjectionConstants projection_constants(const ProjectionParams& params){
+
+	ProjectionConstants c;
+
+	memcpy(c.m, glm::value_ptr(params.transform), 64);
+
+	vec3 boxSize = params.wgMax - params.wgMin;
+	float steps = params.level <= 1 ? float(STEPS_30BIT) : float(STEPS_10BIT);
+
+	for(int axis = 0; axis < 3; axis++){
+		c.scale[axis] = boxSize[axis] / steps;
+		c.offset[axis] = params.wgMin[axis];
+	}
+
+	c.width = float(params.imageSize.x);
+	c.height = float(params.imageSize.y);
+	c.maxX = params.imageSize.x - 1;
+	c.maxY = params.imageSize.y - 1;
+	c.imageWidth = params.imageSize.x;
+
+	return c;
+}
+
+// LEVEL 0: 30 bit, 1: 20 bit, 2: 10 bit per axis
+template<int LEVEL>
+inline uint32_t decode_axis(uint32_t b4, uint32_t b8, uint32_t b12, int shift){
+	uint32_t value = (b4 >> shift) & MASK_10BIT;
+
+	if constexpr(LEVEL == 0){
+		value = (value << 20) | (((b8 >> shift) & MASK_10BIT) << 10) | ((b12 >> shift) & MASK_10BIT);
+	}else if constexpr(LEVEL == 1){
+		value = (value << 20) | (((b8 >> shift) & MASK_10BIT) << 10);
+	}
+
+	return value;
+}
+
+template<int LEVEL>
+int64_t project_points_scalar(const uint32_t* low, const uint32_t* med, const uint32_t* hig, int64_t firstPoint, int64_t begin, int64_t end,
+	const ProjectionConstants& c, int64_t numCandidates, uint64_t* candidates, uint32_t* pixelIDs)
+{
+	const float* m = c.m;
+
+	for(int64_t i = begin; i < end; i++){
+		int64_t index = firstPoint + i;
+
+		uint32_t b4 = low[index];
+		uint32_t b8 = LEVEL <= 1 ? med[index] : 0;
+		uint32_t b12 = LEVEL == 0 ? hig[index] : 0;
+
+		float x = float(int32_t(decode_axis<LEVEL>(b4, b8, b12,  0))) * c.scale[0] + c.offset[0];
+		float y = float(int32_t(decode_axis<LEVEL>(b4, b8, b12, 10))) * c.scale[1] + c.offset[1];
+		float z = float(int32_t(decode_axis<LEVEL>(b4, b8, b12, 20))) * c.scale[2] + c.offset[2];
+
+		float posX = m[0] * x + m[4] * y + m[ 8] * z + m[12];
+		float posY = m[1] * x + m[5] * y + m[ 9] * z + m[13];
+		float posW = m[3] * x + m[7] * y + m[11] * z + m[15];
+
+		float ndcX = posX / posW;
+		float ndcY = posY / posW;
+
+		bool isInsideFrustum = posW > 0.0f && ndcX >= -1.0f && ndcX <= 1.0f && ndcY >= -1.0f && ndcY <= 1.0f;
+
+		if(!isInsideFrustum){
+			continue;
+		}
+
+		// ndc = 1.0 would be the first pixel of the next row
+		int32_t pixelX = std::min(int32_t((ndcX * 0.5f + 0.5f) * c.width), c.maxX);
+		int32_t pixelY = std::min(int32_t((ndcY * 0.5f + 0.5f) * c.height), c.maxY);
+
+		uint32_t depth;
+		memcpy(&depth, &posW, 4);
+
+		candidates[numCandidates] = (uint64_t(depth) << 32) | uint64_t(uint32_t(index));
+		pixelIDs[numCandidates] = uint32_t(pixelX) + uint32_t(pixelY) * uint32_t(c.imageWidth);
+		numCandidates++;
+	}
+
+	return numCandidates;
+}
+
+#ifdef POINT_PROJECTION_X64
+
+// AVX2, 8 points per iteration
+
+// lanes[mask] moves the lanes that are set in mask to the front
+struct CompressTable{
+	alignas(32) uint32_t lanes[256][8];
+
+	CompressTable(){
+		for(int mask = 0; mask < 256; mask++){
+			int numLanes = 0;
+
+			for(int lane = 0; lane < 8; lane++){
+				if(mask & (1 << lane)){
+					lanes[mask][numLanes] = lane;
+					numLanes++;
+				}
+			}
+
+			for(; numLanes < 8; numLanes++){
+				lanes[mask][numLanes] = 0;
+			}
+		}
+	}
+};
+
+const CompressTable COMPRESS_TABLE;
+
+template<int LEVEL, int SHIFT>
+TARGET_AVX2
+inline __m256 decode8_avx2(__m256i b4, __m256i b8, __m256i b12, __m256 scale, __m256 offset){
+	__m256i mask = _mm256_set1_epi32(MASK_10BIT);
+	__m256i value = _mm256_and_si256(_mm256_srli_epi32(b4, SHIFT), mask);
+
+	if constexpr(LEVEL <= 1){
+		__m256i med = _mm256_and_si256(_mm256_srli_epi32(b8, SHIFT), mask);
+		value = _mm256_or_si256(_mm256_slli_epi32(value, 20), _mm256_slli_epi32(med, 10));
+	}
+
+	if constexpr(LEVEL == 0){
+		value = _mm256_or_si256(value, _mm256_and_si256(_mm256_srli_epi32(b12, SHIFT), mask));
+	}
+
+	return _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(value), scale), offset);
+}
+
+// m0 * x + m1 * y + m2 * z + m3
+TARGET_AVX2
+inline __m256 transform8_avx2(const float* m, int row, __m256 x, __m256 y, __m256 z){
+	__m256 value = _mm256_mul_ps(_mm256_set1_ps(m[row + 0]), x);
+	value = _mm256_add_ps(value, _mm256_mul_ps(_mm256_set1_ps(m[row + 4]), y));
+	value = _mm256_add_ps(value, _mm256_mul_ps(_mm256_set1_ps(m[row + 8]), z));
+	value = _mm256_add_ps(value, _mm256_set1_ps(m[row + 12]));
+
+	return value;
+}
+
+template<int LEVEL>
+TARGET_AVX2
+int64_t project_points_avx2(const uint32_t* low, const uint32_t* med, const uint32_t* hig, int64_t firstPoint, int64_t numPoints,
+	const ProjectionConstants& c, uint64_t* candidates, uint32_t* pixelIDs)
+{
+	__m256 scaleX = _mm256_set1_ps(c.scale[0]), offsetX = _mm256_set1_ps(c.offset[0]);
+	__m256 scaleY = _mm256_set1_ps(c.scale[1]), offsetY = _mm256_set1_ps(c.offset[1]);
+	__m256 scaleZ = _mm256_set1_ps(c.scale[2]), offsetZ = _mm256_set1_ps(c.offset[2]);
+
+	__m256 zero = _mm256_setzero_ps();
+	__m256 one = _mm256_set1_ps(1.0f);
+	__m256 minusOne = _mm256_set1_ps(-1.0f);
+	__m256 half = _mm256_set1_ps(0.5f);
+	__m256 width = _mm256_set1_ps(c.width);
+	__m256 height = _mm256_set1_ps(c.height);
+	__m256i maxX = _mm256_set1_epi32(c.maxX);
+	__m256i maxY = _mm256_set1_epi32(c.maxY);
+	__m256i imageWidth = _mm256_set1_epi32(c.imageWidth);
+	__m256i laneIndices = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+	int64_t numCandidates = 0;
+
+	int64_t i = 0;
+	for(; i + 8 <= numPoints; i += 8){
+		int64_t index = firstPoint + i;
+
+		__m256i b4 = _mm256_loadu_si256((const __m256i*)(low + index));
+		__m256i b8 = LEVEL <= 1 ? _mm256_loadu_si256((const __m256i*)(med + index)) : _mm256_setzero_si256();
+		__m256i b12 = LEVEL == 0 ? _mm256_loadu_si256((const __m256i*)(hig + index)) : _mm256_setzero_si256();
+
+		__m256 x = decode8_avx2<LEVEL,  0>(b4, b8, b12, scaleX, offsetX);
+		__m256 y = decode8_avx2<LEVEL, 10>(b4, b8, b12, scaleY, offsetY);
+		__m256 z = decode8_avx2<LEVEL, 20>(b4, b8, b12, scaleZ, offsetZ);
+
+		__m256 posX = transform8_avx2(c.m, 0, x, y, z);
+		__m256 posY = transform8_avx2(c.m, 1, x, y, z);
+		__m256 posW = transform8_avx2(c.m, 3, x, y, z);
+
+		__m256 ndcX = _mm256_div_ps(posX, posW);
+		__m256 ndcY = _mm256_div_ps(posY, posW);
+
+		__m256 inside = _mm256_cmp_ps(posW, zero, _CMP_GT_OQ);
+		inside = _mm256_and_ps(inside, _mm256_cmp_ps(ndcX, minusOne, _CMP_GE_OQ));
+		inside = _mm256_and_ps(inside, _mm256_cmp_ps(ndcX, one, _CMP_LE_OQ));
+		inside = _mm256_and_ps(inside, _mm256_cmp_ps(ndcY, minusOne, _CMP_GE_OQ));
+		inside = _mm256_and_ps(inside, _mm256_cmp_ps(ndcY, one, _CMP_LE_OQ));
+
+		int mask = _mm256_movemask_ps(inside);
+
+		if(mask == 0){
+			continue;
+		}
+
+		__m256i pixelX = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(ndcX, half), half), width));
+		__m256i pixelY = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(ndcY, half), half), height));
+		pixelX = _mm256_min_epi32(pixelX, maxX);
+		pixelY = _mm256_min_epi32(pixelY, maxY);
+
+		__m256i pixelID = _mm256_add_epi32(pixelX, _mm256_mullo_epi32(pixelY, imageWidth));
+		__m256i depth = _mm256_castps_si256(posW);
+		__m256i pointIndex = _mm256_add_epi32(_mm256_set1_epi32(uint32_t(index)), laneIndices);
+
+		// move the points inside to the front and store all lanes, the ones after the candidates are overwritten next
+		__m256i lanes = _mm256_load_si256((const __m256i*)COMPRESS_TABLE.lanes[mask]);
+		pixelID = _mm256_permutevar8x32_epi32(pixelID, lanes);
+		depth = _mm256_permutevar8x32_epi32(depth, lanes);
+		pointIndex = _mm256_permutevar8x32_epi32(pointIndex, lanes);
+
+		__m256i candidatesLo = _mm256_or_si256(
+			_mm256_slli_epi64(_mm256_cvtepu32_epi64(_mm256_castsi256_si128(depth)), 32),
+			_mm256_cvtepu32_epi64(_mm256_castsi256_si128(pointIndex)));
+		__m256i candidatesHi = _mm256_or_si256(
+			_mm256_slli_epi64(_mm256_cvtepu32_epi64(_mm256_extracti128_si256(depth, 1)), 32),
+			_mm256_cvtepu32_epi64(_mm256_extracti128_si256(pointIndex, 1)));
+
+		_mm256_storeu_si256((__m256i*)(pixelIDs + numCandidates), pixelID);
+		_mm256_storeu_si256((__m256i*)(candidates + numCandidates + 0), candidatesLo);
+		_mm256_storeu_si256((__m256i*)(candidates + numCandidates + 4), candidatesHi);
+
+		numCandidates += std::popcount(uint32_t(mask));
+	}
+
+	return project_points_scalar<LEVEL>(low, med, hig, firstPoint, i, numPoints, c, numCandidates, candidates, pixelIDs);
+}
+
+// AVX-512, 16 points per iteration
+
+template<int LEVEL, int SHIFT>
+TARGET_AVX512
+inline __m512 decode16_avx512(__m512i b4, __m512i b8, __m512i b12, __m512 scale, __m512 offset){
+	__m512i mask = _mm512_set1_epi32(MASK_10BIT);
+	__m512i value = _mm512_and_si512(_mm512_srli_epi32(b4, SHIFT), mask);
+
+	if constexpr(LEVEL <= 1){
+		__m512i med = _mm512_and_si512(_mm512_srli_epi32(b8, SHIFT), mask);
+		value = _mm512_or_si512(_mm512_slli_epi32(value, 20), _mm512_slli_epi32(med, 10));
+	}
+
+	if constexpr(LEVEL == 0){
+		value = _mm512_or_si512(value, _mm512_and_si512(_mm512_srli_epi32(b12, SHIFT), mask));
+	}
+
+	return _mm512_add_ps(_mm512_mul_ps(_mm512_cvtepi32_ps(value), scale), offset);
+}
+
+TARGET_AVX512
+inline __m512 transform16_avx512(const float* m, int row, __m512 x, __m512 y, __m512 z){
+	__m512 value = _mm512_mul_ps(_mm512_set1_ps(m[row + 0]), x);
+	value = _mm512_add_ps(value, _mm512_mul_ps(_mm512_set1_ps(m[row + 4]), y));
+	value = _mm512_add_ps(value, _mm512_mul_ps(_mm512_set1_ps(m[row + 8]), z));
+	value = _mm512_add_ps(value, _mm512_set1_ps(m[row + 12]));
+
+	return value;
+}
+
+template<int LEVEL>
+TARGET_AVX512
+int64_t project_points_avx512(const uint32_t* low, const uint32_t* med, const uint32_t* hig, int64_t firstPoint, int64_t numPoints,
+	const ProjectionConstants& c, uint64_t* candidates, uint32_t* pixelIDs)
+{
+	__m512 scaleX = _mm512_set1_ps(c.scale[0]), offsetX = _mm512_set1_ps(c.offset[0]);
+	__m512 scaleY = _mm512_set1_ps(c.scale[1]), offsetY = _mm512_set1_ps(c.offset[1]);
+	__m512 scaleZ = _mm512_set1_ps(c.scale[2]), offsetZ = _mm512_set1_ps(c.offset[2]);
+
+	__m512 zero = _mm512_setzero_ps();
+	__m512 one = _mm512_set1_ps(1.0f);
+	__m512 minusOne = _mm512_set1_ps(-1.0f);
+	__m512 half = _mm512_set1_ps(0.5f);
+	__m512 width = _mm512_set1_ps(c.width);
+	__m512 height = _mm512_set1_ps(c.height);
+	__m512i maxX = _mm512_set1_epi32(c.maxX);
+	__m512i maxY = _mm512_set1_epi32(c.maxY);
+	__m512i imageWidth = _mm512_set1_epi32(c.imageWidth);
+	__m512i laneIndices = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+	int64_t numCandidates = 0;
+
+	int64_t i = 0;
+	for(; i + 16 <= numPoints; i += 16){
+		int64_t index = firstPoint + i;
+
+		__m512i b4 = _mm512_loadu_si512(low + index);
+		__m512i b8 = LEVEL <= 1 ? _mm512_loadu_si512(med + index) : _mm512_setzero_si512();
+		__m512i b12 = LEVEL == 0 ? _mm512_loadu_si512(hig + index) : _mm512_setzero_si512();
+
+		__m512 x = decode16_avx512<LEVEL,  0>(b4, b8, b12, scaleX, offsetX);
+		__m512 y = decode16_avx512<LEVEL, 10>(b4, b8, b12, scaleY, offsetY);
+		__m512 z = decode16_avx512<LEVEL, 20>(b4, b8, b12, scaleZ, offsetZ);
+
+		__m512 posX = transform16_avx512(c.m, 0, x, y, z);
+		__m512 posY = transform16_avx512(c.m, 1, x, y, z);
+		__m512 posW = transform16_avx512(c.m, 3, x, y, z);
+
+		__m512 ndcX = _mm512_div_ps(posX, posW);
+		__m512 ndcY = _mm512_div_ps(posY, posW);
+
+		__mmask16 inside = _mm512_cmp_ps_mask(posW, zero, _CMP_GT_OQ);
+		inside = _mm512_mask_cmp_ps_mask(inside, ndcX, minusOne, _CMP_GE_OQ);
+		inside = _mm512_mask_cmp_ps_mask(inside, ndcX, one, _CMP_LE_OQ);
+		inside = _mm512_mask_cmp_ps_mask(inside, ndcY, minusOne, _CMP_GE_OQ);
+		inside = _mm512_mask_cmp_ps_mask(inside, ndcY, one, _CMP_LE_OQ);
+
+		if(inside == 0){
+			continue;
+		}
+
+		__m512i pixelX = _mm512_cvttps_epi32(_mm512_mul_ps(_mm512_add_ps(_mm512_mul_ps(ndcX, half), half), width));
+		__m512i pixelY = _mm512_cvttps_epi32(_mm512_mul_ps(_mm512_add_ps(_mm512_mul_ps(ndcY, half), half), height));
+		pixelX = _mm512_min_epi32(pixelX, maxX);
+		pixelY = _mm512_min_epi32(pixelY, maxY);
+
+		__m512i pixelID = _mm512_add_epi32(pixelX, _mm512_mullo_epi32(pixelY, imageWidth));
+		__m512i depth = _mm512_castps_si512(posW);
+		__m512i pointIndex = _mm512_add_epi32(_mm512_set1_epi32(uint32_t(index)), laneIndices);
+
+		__m512i candidatesLo = _mm512_or_si512(
+			_mm512_slli_epi64(_mm512_cvtepu32_epi64(_mm512_castsi512_si256(depth)), 32),
+			_mm512_cvtepu32_epi64(_mm512_castsi512_si256(pointIndex)));
+		__m512i candidatesHi = _mm512_or_si512(
+			_mm512_slli_epi64(_mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(depth, 1)), 32),
+			_mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(pointIndex, 1)));
+
+		__mmask8 insideLo = __mmask8(inside & 0xFF);
+		__mmask8 insideHi = __mmask8(inside >> 8);
+		int numLo = std::popcount(uint32_t(insideLo));
+
+		// compress in registers and store all lanes, the ones after the candidates are overwritten next
+		_mm512_storeu_si512(pixelIDs + numCandidates, _mm512_maskz_compress_epi32(inside, pixelID));
+		_mm512_storeu_si512(candidates + numCandidates, _mm512_maskz_compress_epi64(insideLo, candidatesLo));
+		_mm512_storeu_si512(candidates + numCandidates + numLo, _mm512_maskz_compress_epi64(insideHi, candidatesHi));
+
+		numCandidates += std::popcount(uint32_t(inside));
+	}
+
+	return project_points_scalar<LEVEL>(low, med, hig, firstPoint, i, numPoints, c, numCandidates, candidates, pixelIDs);
+}
+
+#endif
+
+template<int LEVEL>
+int64_t project_points_level(const uint32_t* low, const uint32_t* med, const uint32_t* hig, int64_t firstPoint, int64_t numPoints,
+	const ProjectionConstants& c, uint64_t* candidates, uint32_t* pixelIDs, SimdLevel level)
+{
+
+#ifdef POINT_PROJECTION_X64
+	if(level == SimdLevel::AVX512){
+		return project_points_avx512<LEVEL>(low, med, hig, firstPoint, numPoints, c, candidates, pixelIDs);
+	}else if(level == SimdLevel::AVX2){
+		return project_points_avx2<LEVEL>(low, med, hig, firstPoint, numPoints, c, candidates, pixelIDs);
+	}
+#endif
+
+	return project_points_scalar<LEVEL>(low, med, hig, firstPoint, 0, numPoints, c, 0, candidates, pixelIDs);
+}
+
+int64_t project_points(const uint32_t* low, const uint32_t* med, const uint32_t* hig, int64_t firstPoint, int64_t numPoints,
+	const ProjectionParams& params, uint64_t* candidates, uint32_t* pixelIDs, SimdLevel level)
+{
+	ProjectionConstants c = projection_constants(params);
+
+	if(params.level == 0){
+		return project_points_level<0>(low, med, hig, firstPoint, numPoints, c, candidates, pixelIDs, level);
+	}else if(params.level == 1){
+		return project_points_level<1>(low, med, hig, firstPoint, numPoints, c, candidates, pixelIDs, level);
+	}else{
+		return project_points_level<2>(low, med, hig, firstPoint, numPoints, c, candidates, pixelIDs, level);
+	}
+}
+
+void benchmark_projection(){
+
+	// a batch of random points in a 100m box, seen from inside so that about a third is in the frustum and some are behind the camera
+	int64_t numPoints = 1'024'000;
+	int numRepetitions = 20;
+
+	vector<uint32_t> planes(3 * numPoints);
+	mt19937 rng(123);
+	uniform_int_distribution<uint32_t> distribution(0, (1 << 30) - 1);
+
+	for(auto& value : planes){
+		value = distribution(rng);
+	}
+
+	const uint32_t* low = &planes[0];
+	const uint32_t* med = &planes[numPoints];
+	const uint32_t* hig = &planes[2 * numPoints];
+
+	ivec2 imageSize = {1920, 1080};
+	mat4 view = glm::lookAt(glm::vec3(20.0f, 30.0f, 40.0f), glm::vec3(60.0f, 50.0f, 50.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	mat4 proj = glm::perspective(glm::radians(60.0f), float(imageSize.x) / float(imageSize.y), 0.1f, 200'000.0f);
+
+	ProjectionParams params;
+	params.transform = proj * view;
+	params.wgMin = {0.0f, 0.0f, 0.0f};
+	params.wgMax = {100.0f, 100.0f, 100.0f};
+	params.imageSize = imageSize;
+
+	SimdLevel supported = detect_simd_level();
+
+	cout << "benchmark projection: " << formatNumber(numPoints) << " points x " << numRepetitions
+		<< ", one thread, supported: " << toString(supported) << endl;
+
+	for(int precision : {0, 1, 2}){
+		params.level = precision;
+
+		vector<uint64_t> referenceCandidates(numPoints + 16);
+		vector<uint32_t> referencePixels(numPoints + 16);
+		int64_t numReference = project_points(low, med, hig, 0, numPoints, params,
+			referenceCandidates.data(), referencePixels.data(), SimdLevel::SCALAR);
+
+		string bits = precision == 0 ? "30 bit" : (precision == 1 ? "20 bit" : "10 bit");
+		cout << bits << ", " << formatNumber(numReference) << " inside" << endl;
+
+		for(SimdLevel level : {SimdLevel::SCALAR, SimdLevel::AVX2, SimdLevel::AVX512}){
+
+			if(int(level) > int(supported)){
+				continue;
+			}
+
+			vector<uint64_t> candidates(numPoints + 16);
+			vector<uint32_t> pixelIDs(numPoints + 16);
+			int64_t numCandidates = 0;
+
+			double tStart = now();
+
+			for(int i = 0; i < numRepetitions; i++){
+				numCandidates = project_points(low, med, hig, 0, numPoints, params, candidates.data(), pixelIDs.data(), level);
+			}
+
+			double duration = now() - tStart;
+			double mptsPerSecond = double(numPoints * numRepetitions) / duration / 1'000'000.0;
+
+			bool isIdentical = numCandidates == numReference
+				&& memcmp(candidates.data(), referenceCandidates.data(), 8 * numCandidates) == 0
+				&& memcmp(pixelIDs.data(), referencePixels.data(), 4 * numCandidates) == 0;
+
+			cout << leftPad(toString(level), 7)
+				<< ": " << formatNumber(mptsPerSecond, 1) << " Mpts/s"
+				<< ", identical to scalar: " << (isIdentical ? "yes" : "NO") << endl;
+		}
+	}
+}
@@ -0,0 +1,42 @@
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "glm/common.hpp"
+#include "glm/matrix.hpp"
+
+#include "../data/batch_encoder.h"
+
+using namespace std;
+using glm::mat4;
+using glm::vec3;
+using glm::ivec2;
+
+// the per-point work of render.cs for a run of points of one batch, 8 (AVX2) or 16 (AVX-512) points at a time:
+// decode 10, 20 or 30 bit coordinates from the low/med/hig planes, transform them with the file's transform,
+// divide by w, test them against the frustum and compute their pixel.
+//
+// points inside the frustum are appended as candidates, uint64(depth) << 32 | point index, and their pixel id.
+// depth is the float bits of w, so that candidates compare like the values of ssFramebuffer.
+// All levels produce bit-identical output.
+
+struct ProjectionParams{
+	// proj * view * world of the batch's file
+	mat4 transform;
+	// batch bounds, relative to the file's boxMin
+	vec3 wgMin;
+	vec3 wgMax;
+	ivec2 imageSize;
+	// see getPrecisionLevel() in render.cs. 0: low, med and hig, 1: low and med, otherwise only low
+	int level = 4;
+};
+
+// projects points firstPoint to firstPoint + numPoints - 1 of the planes. med and hig are only read at level 0 and 1.
+// candidates and pixelIDs must have room for numPoints + 16 entries. returns the number of candidates
+int64_t project_points(const uint32_t* low, const uint32_t* med, const uint32_t* hig, int64_t firstPoint, int64_t numPoints,
+	const ProjectionParams& params, uint64_t* candidates, uint32_t* pixelIDs, SimdLevel level);
+
+// projects a synthetic batch with each supported level, checks the output against scalar and prints points/s on one core
+void benchmark_projection();
@@ -19,6 +19,12 @@
 
 #define Infinity (1.0 / 0.0)
 
+// Batch.state, see BatchState in residency.h
+#define BATCH_RESIDENT 0
+#define BATCH_EVICTED 1
+#define BATCH_STREAMING 2
+#define BATCH_FREE 3
+
 struct Batch{
 	int state;
 	float min_x;
@@ -29,9 +35,10 @@ struct Batch{
 	float max_z;
 	int numPoints;
 
+	// within the segment, whose buffers are bound to 41 - 44
 	int firstPoint;
 	int fileIndex;
-	int padding3;
+	int segment;
 	int padding4;
 	int padding5;
 	int padding6;
@@ -104,6 +111,7 @@ layout(std140, binding = 31) uniform UniformData{
 	ivec2 imageSize;
 	bool colorizeChunks;
 	bool colorizeOverdraw;
+	bool enableEDL;
 } uniforms;
 
 uint SPECTRAL[5] = {
@@ -238,6 +246,11 @@ void main(){
 
 	uint wgFirstPoint = batch.firstPoint;
 
+	// points of evicted batches are no longer in memory, free slots belong to removed files
+	if(batch.state != BATCH_RESIDENT){
+		return;
+	}
+
 	if(debug.enabled && gl_LocalInvocationID.x == 0){
 		atomicAdd(debug.numNodesProcessed, 1);
 	}
@@ -349,8 +362,8 @@ void main(){
 			uint32_t Z_12 = (b12 >> 20) & MASK_10BIT;
 
 			uint32_t X = (X_4 << 20) | (X_8 << 10) | X_12;
-			uint32_t Y = (Y_4 << 20) | (Y_8 << 10) | X_12;
-			uint32_t Z = (Z_4 << 20) | (Z_8 << 10) | X_12;
+			uint32_t Y = (Y_4 << 20) | (Y_8 << 10) | Y_12;
+			uint32_t Z = (Z_4 << 20) | (Z_8 << 10) | Z_12;
 
 			float x = float(X) * (boxSize.x / STEPS_30BIT) + wgMin.x;
 			float y = float(Y) * (boxSize.y / STEPS_30BIT) + wgMin.y;
@@ -409,19 +422,22 @@ void main(){
 			int pixelID = pixelCoords.x + pixelCoords.y * uniforms.imageSize.x;
 
 			
-			uint64_t colorComponent;
-
-			if(uniforms.colorizeChunks){
-				colorComponent = batchIndex * 1234567;
-			}else{
-				colorComponent = uint64_t(index);
-			}
-
 			uint32_t depth = floatBitsToInt(pos.w);
-			uint64_t newPoint = (uint64_t(depth) << 32UL) | colorComponent;
 
+			// the framebuffer stores colors rather than point indices, which are only unique within a segment.
+			// colors are only fetched for points that may be closer than the current one
 			uint64_t oldPoint = ssFramebuffer[pixelID];
-			if(newPoint < oldPoint){
+			if((uint64_t(depth) << 32UL) < oldPoint){
+
+				uint64_t colorComponent;
+
+				if(uniforms.colorizeChunks){
+					colorComponent = (batchIndex + batch.segment * 7919) * 1234567;
+				}else{
+					colorComponent = ssRGBA[index];
+				}
+
+				uint64_t newPoint = (uint64_t(depth) << 32UL) | (colorComponent & 0xffffffffUL);
 				
 				atomicMin(ssFramebuffer[pixelID], newPoint);
 
@@ -12,8 +12,8 @@
 layout(local_size_x = 16, local_size_y = 16) in;
 
 layout(r32ui , binding =  0) coherent uniform uimage2D uOutput;
+// depth in the upper, color in the lower 32 bits
 layout(std430, binding =  1) buffer abc_0 { uint64_t ssFramebuffer[]; };
-layout(std430, binding = 44) buffer abc_1 { uint32_t ssRGBA[]; };
 
 layout(std140, binding = 31) uniform UniformData{
 	mat4 world;
@@ -28,6 +28,7 @@ layout(std140, binding = 31) uniform UniformData{
 	ivec2 imageSize;
 	bool colorizeChunks;
 	bool colorizeOverdraw;
+	bool enableEDL;
 } uniforms;
 
 layout (std430, binding = 30) buffer abc_2 { 
@@ -40,27 +41,42 @@ layout (std430, binding = 30) buffer abc_2 {
 	uint32_t numPointsVisible;
 } debug;
 
-float getDepthAt(ivec2 pixelCoords, int window){
+// depth of the 16 x 16 pixels of the workgroup and a border of one pixel, for EDL.
+// each framebuffer value is loaded once per workgroup instead of 9 times per pixel.
+// pixels without a point, and outside the image, have a depth of 100000000.0
+shared float sharedDepth[18 * 18];
 
-	float closestDepth = 100000000.0;
+float getDepth(ivec2 pixelCoords){
 
-	for(int ox = -window; ox <= window; ox++){
-	for(int oy = -window; oy <= window; oy++){
+	if(any(lessThan(pixelCoords, ivec2(0, 0))) || any(greaterThanEqual(pixelCoords, uniforms.imageSize))){
+		return 100000000.0;
+	}
 
-		int pixelID = (pixelCoords.x + ox) + (pixelCoords.y + oy) * uniforms.imageSize.x;
+	int pixelID = pixelCoords.x + pixelCoords.y * uniforms.imageSize.x;
 
-		uint64_t data = ssFramebuffer[pixelID];
-		uint32_t uDepth = uint32_t(data >> 32l);
-		uint32_t pointID = uint32_t(data & 0xffffffffl);
-		float depth = uintBitsToFloat(uDepth);
+	uint64_t data = ssFramebuffer[pixelID];
+	uint32_t uDepth = uint32_t(data >> 32l);
+	float depth = uintBitsToFloat(uDepth);
 
-		if(depth > 0.0 && depth < closestDepth){
-			closestDepth = depth;
-		}
+	if(depth > 0.0 && depth < 1000000.0){
+		return depth;
+	}else{
+		return 100000000.0;
 	}
+}
+
+void loadSharedDepth(){
+
+	ivec2 tileOrigin = ivec2(gl_WorkGroupSize.xy * gl_WorkGroupID.xy) - 1;
+	int localIndex = int(gl_LocalInvocationIndex);
+
+	for(int i = localIndex; i < 18 * 18; i += 256){
+		ivec2 tileCoords = ivec2(i % 18, i / 18);
+
+		sharedDepth[i] = getDepth(tileOrigin + tileCoords);
 	}
 
-	return closestDepth;
+	barrier();
 }
 
 void main(){
@@ -71,6 +87,10 @@ void main(){
 
 	ivec2 imgSize = uniforms.imageSize;
 
+	if(uniforms.enableEDL){
+		loadSharedDepth();
+	}
+
 	// { // 1 pixel
 	// 	ivec2 pixelCoords = ivec2(id);
 	// 	ivec2 sourceCoords = ivec2(id);
@@ -106,10 +126,10 @@ void main(){
 		float count = 0;
 
 		int window = 0;
-		int edlWindow = 1;
 
 		float closestDepth = 1000000.0;
-		uint32_t closestPointID = 0;
+		uint32_t closestColor = 0;
+		bool hasPoint = false;
 
 		for(int ox = -window; ox <= window; ox++){
 		for(int oy = -window; oy <= window; oy++){
@@ -118,26 +138,21 @@ void main(){
 
 			uint64_t data = ssFramebuffer[pixelID];
 			uint32_t uDepth = uint32_t(data >> 32l);
-			uint32_t pointID = uint32_t(data & 0xffffffffl);
+			uint32_t pointColor = uint32_t(data & 0xffffffffl);
 			float depth = uintBitsToFloat(uDepth);
 
 			if(depth > 0.0 && depth < closestDepth){
 				closestDepth = depth;
-				closestPointID = pointID;
+				closestColor = pointColor;
+				hasPoint = true;
 			}
 			
 		}
 		}
 
-		uint32_t color = 0;
-		
-		if(uniforms.colorizeChunks){
-			color = closestPointID;
-		}else{
-			color = ssRGBA[closestPointID];
-		}
+		uint32_t color = closestColor;
 
-		if(closestPointID == 0){
+		if(!hasPoint){
 			color = 0x00443322;
 		}else{
 			if(debug.enabled){
@@ -145,37 +160,23 @@ void main(){
 			}
 		}
 
-		if(false)
-		{ // EDL
-			int pixelID = (pixelCoords.x) + (pixelCoords.y) * imgSize.x;
-
-			uint64_t data = ssFramebuffer[pixelID];
-			uint32_t uDepth = uint32_t(data >> 32l);
-			uint32_t pointID = uint32_t(data & 0xffffffffl);
-			float depth = uintBitsToFloat(uDepth);
+		if(uniforms.enableEDL && hasPoint)
+		{ // EDL, see edl.h for the CPU version
+			ivec2 tileCoords = ivec2(gl_LocalInvocationID.xy) + 1;
+			float depth = sharedDepth[tileCoords.x + tileCoords.y * 18];
 
 			float sum = 0.0;
-			for(int ox = -edlWindow; ox <= edlWindow; ox++){
-			for(int oy = -edlWindow; oy <= edlWindow; oy++){
-
-				int pixelID = (pixelCoords.x + ox) + (pixelCoords.y + oy) * imgSize.x;
-
-				// uint64_t data = ssFramebuffer[pixelID];
-				// uint32_t uDepth = uint32_t(data >> 32l);
-				// uint32_t pointID = uint32_t(data & 0xffffffffl);
-				// float neighbourDepth = uintBitsToFloat(uDepth);
-				float neighbourDepth = getDepthAt(pixelCoords + ivec2(ox, oy), window);
+			for(int oy = -1; oy <= 1; oy++){
+			for(int ox = -1; ox <= 1; ox++){
+				float neighbourDepth = sharedDepth[(tileCoords.x + ox) + (tileCoords.y + oy) * 18];
 
 				sum += max(0.0, depth - neighbourDepth);
-
-				
 			}
 			}
 
 			float edlStrength = 0.0005;
 			float response = sum / 9.0;
 			float shade = exp(-response * 300.0 * edlStrength);
-			// shade = 1.0;
 
 			uint R = ((color >>  0) & 0xFF);
 			uint G = ((color >>  8) & 0xFF);
@@ -186,8 +187,6 @@ void main(){
 			B = uint(float(B) * shade);
 
 			color = R | (G << 8) | (B << 16);
-
-			// color = uint(255.0 * shade);
 		}
 
 		imageAtomicExchange(uOutput, pixelCoords, color);
@@ -6,6 +6,9 @@
 #define POINTS_PER_WORKGROUP (POINTS_PER_THREAD * WORKGROUP_SIZE)
 // Adjust this to be something in the order of 1 million points
 #define MAX_POINTS_PER_BATCH (100 * POINTS_PER_WORKGROUP)
+// points are addressed with 64 bits, in segments that have their own buffers and are indexed with 32 bits.
+// 4 bytes per point make 1000 MiB per segment buffer, a multiple of any sparse page size up to 8 MiB
+#define POINTS_PER_SEGMENT (256 * MAX_POINTS_PER_BATCH)
 
 #include "Renderer.h"
 
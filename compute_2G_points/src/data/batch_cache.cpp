@@ -0,0 +1,215 @@
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+
+#include "batch_cache.h"
+#include "Resources.h"
+
+namespace fs = std::filesystem;
+
+static_assert(sizeof(BatchCacheHeader) <= BATCH_CACHE_ALIGNMENT);
+static_assert(sizeof(BatchCacheChunk) == 96);
+
+inline uint64_t rotl(uint64_t value, int bits){
+	return (value << bits) | (value >> (64 - bits));
+}
+
+// xxhash-like. 4 independent lanes of 8 bytes, so that it runs at memory speed
+uint64_t checksum(const void* data, int64_t size, uint64_t seed){
+
+	constexpr uint64_t P1 = 0x9E3779B185EBCA87ull;
+	constexpr uint64_t P2 = 0xC2B2AE3D27D4EB4Full;
+	constexpr uint64_t P3 = 0x165667B19E3779F9ull;
+
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+	uint64_t lanes[4] = {seed + P1 + P2, seed + P2, seed, seed - P1};
+
+	int64_t i = 0;
+	for(; i + 32 <= size; i += 32){
+		for(int lane = 0; lane < 4; lane++){
+			uint64_t word;
+			memcpy(&word, bytes + i + 8 * lane, 8);
+
+			lanes[lane] = rotl(lanes[lane] + word * P2, 31) * P1;
+		}
+	}
+
+	uint64_t hash = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+
+	for(; i < size; i++){
+		hash = rotl(hash ^ (bytes[i] * P3), 11) * P1;
+	}
+
+	hash ^= uint64_t(size);
+	hash ^= hash >> 33;
+	hash *= P2;
+	hash ^= hash >> 29;
+	hash *= P3;
+	hash ^= hash >> 32;
+
+	return hash;
+}
+
+int64_t align_to(int64_t value, int64_t alignment){
+	return ((value + alignment - 1) / alignment) * alignment;
+}
+
+void layout_batch_cache(BatchCacheHeader& header){
+
+	int64_t planeSize = 4 * header.numPointsReserved;
+
+	header.chunksOffset = BATCH_CACHE_ALIGNMENT;
+	header.batchesOffset = align_to(header.chunksOffset + header.numChunks * sizeof(BatchCacheChunk), BATCH_CACHE_ALIGNMENT);
+	header.xyzLowOffset = align_to(header.batchesOffset + 64 * header.numBatchesReserved, BATCH_CACHE_ALIGNMENT);
+	header.xyzMedOffset = align_to(header.xyzLowOffset + planeSize, BATCH_CACHE_ALIGNMENT);
+	header.xyzHigOffset = align_to(header.xyzMedOffset + planeSize, BATCH_CACHE_ALIGNMENT);
+	header.colorsOffset = align_to(header.xyzHigOffset + planeSize, BATCH_CACHE_ALIGNMENT);
+	header.fileSize = align_to(header.colorsOffset + planeSize, BATCH_CACHE_ALIGNMENT);
+}
+
+uint64_t header_checksum(const BatchCacheHeader& header, const vector<BatchCacheChunk>& chunks){
+
+	uint64_t hash = checksum(&header, offsetof(BatchCacheHeader, checksum));
+	hash = checksum(chunks.data(), chunks.size() * sizeof(BatchCacheChunk), hash);
+
+	return hash;
+}
+
+string batch_cache_path(string sourcePath){
+	return sourcePath + ".t2g";
+}
+
+const BatchCacheChunk* BatchCache::findChunk(int64_t point){
+
+	// chunks are sorted by firstPoint
+	auto it = std::upper_bound(chunks.begin(), chunks.end(), point, [](int64_t point, const BatchCacheChunk& chunk){
+		return point < chunk.firstPoint;
+	});
+
+	if(it == chunks.begin()){
+		return nullptr;
+	}
+
+	it--;
+
+	if(point >= it->firstPoint + it->numPoints){
+		return nullptr;
+	}
+
+	return &(*it);
+}
+
+shared_ptr<Buffer> BatchCache::view(int64_t offset, int64_t size){
+
+	// keeps the mapping alive, and doesn't free memory that it doesn't own
+	auto mapping = mappedFile;
+	shared_ptr<Buffer> buffer(new Buffer(), [mapping](Buffer* buffer){
+		buffer->data = nullptr;
+		delete buffer;
+	});
+
+	uint8_t* data = mappedFile->data + offset;
+
+	buffer->data = data;
+	buffer->data_u8 = data;
+	buffer->data_u16 = reinterpret_cast<uint16_t*>(data);
+	buffer->data_u32 = reinterpret_cast<uint32_t*>(data);
+	buffer->data_u64 = reinterpret_cast<uint64_t*>(data);
+	buffer->data_i8 = reinterpret_cast<int8_t*>(data);
+	buffer->data_i16 = reinterpret_cast<int16_t*>(data);
+	buffer->data_i32 = reinterpret_cast<int32_t*>(data);
+	buffer->data_i64 = reinterpret_cast<int64_t*>(data);
+	buffer->data_f32 = reinterpret_cast<float*>(data);
+	buffer->data_f64 = reinterpret_cast<double*>(data);
+	buffer->data_char = reinterpret_cast<char*>(data);
+	buffer->size = size;
+
+	return buffer;
+}
+
+shared_ptr<BatchCache> open_batch_cache(string path, string sourcePath){
+
+	std::error_code ec;
+	int64_t fileSize = fs::file_size(path, ec);
+
+	if(ec || fileSize < int64_t(sizeof(BatchCacheHeader))){
+		return nullptr;
+	}
+
+	auto cache = make_shared<BatchCache>();
+	cache->path = path;
+	cache->mappedFile = make_shared<MappedFile>(path);
+
+	if(cache->mappedFile->data == nullptr){
+		return nullptr;
+	}
+
+	BatchCacheHeader& header = cache->header;
+	memcpy(&header, cache->mappedFile->data, sizeof(BatchCacheHeader));
+
+	if(memcmp(header.magic, "T2G", 4) != 0){
+		GENERATE_WARN_MESSAGE << "not a .t2g file: " << path << endl;
+
+		return nullptr;
+	}
+
+	if(header.version != BATCH_CACHE_VERSION || header.pointsPerBatch != POINTS_PER_WORKGROUP){
+		GENERATE_WARN_MESSAGE << "outdated .t2g file (version " << header.version << ", "
+			<< header.pointsPerBatch << " points per batch), convert it again: " << path << endl;
+
+		return nullptr;
+	}
+
+	// layout fields must be what this version would write
+	BatchCacheHeader expected = header;
+	layout_batch_cache(expected);
+
+	bool hasExpectedLayout = header.numChunks >= 0
+		&& header.chunksOffset == expected.chunksOffset
+		&& header.batchesOffset == expected.batchesOffset
+		&& header.xyzLowOffset == expected.xyzLowOffset
+		&& header.xyzMedOffset == expected.xyzMedOffset
+		&& header.xyzHigOffset == expected.xyzHigOffset
+		&& header.colorsOffset == expected.colorsOffset
+		&& header.fileSize == expected.fileSize;
+
+	if(!hasExpectedLayout || header.fileSize > fileSize){
+		GENERATE_WARN_MESSAGE << "corrupt or truncated .t2g file: " << path << endl;
+
+		return nullptr;
+	}
+
+	cache->chunks.resize(header.numChunks);
+	memcpy(cache->chunks.data(), cache->mappedFile->data + header.chunksOffset, header.numChunks * sizeof(BatchCacheChunk));
+
+	if(header_checksum(header, cache->chunks) != header.checksum){
+		GENERATE_WARN_MESSAGE << "checksum mismatch in the header of " << path << endl;
+
+		return nullptr;
+	}
+
+	for(auto& chunk : cache->chunks){
+		bool isInside = chunk.firstPoint >= 0 && chunk.numPoints >= 0
+			&& chunk.firstPoint + chunk.numPoints <= header.numPointsReserved
+			&& chunk.firstBatch >= 0 && chunk.numBatches >= 0
+			&& chunk.firstBatch + chunk.numBatches <= header.numBatchesReserved;
+
+		if(!isInside){
+			GENERATE_WARN_MESSAGE << "corrupt chunk table in " << path << endl;
+
+			return nullptr;
+		}
+	}
+
+	if(!sourcePath.empty()){
+		int64_t sourceFileSize = fs::file_size(sourcePath, ec);
+		int64_t sourceLastWriteTime = fs::last_write_time(sourcePath, ec).time_since_epoch().count();
+
+		if(ec || sourceFileSize != header.sourceFileSize || sourceLastWriteTime != header.sourceLastWriteTime){
+			return nullptr;
+		}
+	}
+
+	return cache;
+}
@@ -0,0 +1,108 @@
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "unsuck.hpp"
+
+using namespace std;
+
+// .t2g files store what the decoders produce from a LAS/LAZ file: the 64-byte batch records and the
+// xyz low/med/hig and color planes, so that loading them again only maps the file and uploads.
+//
+// layout, every section starts at a multiple of BATCH_CACHE_ALIGNMENT:
+// - BatchCacheHeader
+// - numChunks BatchCacheChunk
+// - batch records
+// - xyz low, med, hig and color planes, 4 bytes per point
+//
+// chunks are the load tasks of the source file. their points start at the same point index as in the
+// source file, and their batches follow those of the previous chunk as if all previous chunks were complete.
+// chunks of truncated files have fewer points than the source header claims, which leaves gaps in the planes
+// but doesn't move the other chunks.
+// the batch records store the point offset, file index and segment as 0, they are set when a chunk is loaded.
+
+#define BATCH_CACHE_VERSION 1
+// the sparse page size of common drivers and the allocation granularity of Windows mappings
+#define BATCH_CACHE_ALIGNMENT 65536
+
+struct BatchCacheHeader{
+	char magic[4] = {'T', '2', 'G', 0};
+	uint32_t version = BATCH_CACHE_VERSION;
+	uint32_t pointsPerBatch = 0;
+	uint32_t padding = 0;
+
+	// of all chunks, without gaps
+	int64_t numPoints = 0;
+	// capacity of the planes and the batch table
+	int64_t numPointsReserved = 0;
+	int64_t numBatchesReserved = 0;
+	int64_t numChunks = 0;
+
+	double scale[3] = {1.0, 1.0, 1.0};
+	double offset[3] = {0.0, 0.0, 0.0};
+	double boxMin[3] = {0.0, 0.0, 0.0};
+	double boxMax[3] = {0.0, 0.0, 0.0};
+
+	// the LAS/LAZ file that was converted, the cache is stale if either changed
+	int64_t sourceFileSize = 0;
+	int64_t sourceLastWriteTime = 0;
+
+	// byte offsets of the sections
+	int64_t chunksOffset = 0;
+	int64_t batchesOffset = 0;
+	int64_t xyzLowOffset = 0;
+	int64_t xyzMedOffset = 0;
+	int64_t xyzHigOffset = 0;
+	int64_t colorsOffset = 0;
+	int64_t fileSize = 0;
+
+	// of the header up to this field and the chunk table
+	uint64_t checksum = 0;
+};
+
+struct BatchCacheChunk{
+	int64_t firstPoint = 0;
+	int64_t numPoints = 0;
+	int64_t firstBatch = 0;
+	int64_t numBatches = 0;
+	double min[3] = {0.0, 0.0, 0.0};
+	double max[3] = {0.0, 0.0, 0.0};
+	// of the batch records and the points of the chunk, checked whenever the chunk is loaded
+	uint64_t checksum = 0;
+	uint64_t padding = 0;
+};
+
+// a mapped .t2g file
+struct BatchCache{
+	string path;
+	shared_ptr<MappedFile> mappedFile = nullptr;
+	BatchCacheHeader header;
+	vector<BatchCacheChunk> chunks;
+
+	// the chunk that contains the point with the given index
+	const BatchCacheChunk* findChunk(int64_t point);
+
+	// memory of the section at offset, valid as long as the cache is.
+	// the buffers aren't copies, uploads read straight from the mapping
+	shared_ptr<Buffer> view(int64_t offset, int64_t size);
+};
+
+// 64-bit hash, continues from seed
+uint64_t checksum(const void* data, int64_t size, uint64_t seed = 0);
+
+int64_t align_to(int64_t value, int64_t alignment);
+
+// fills in the section offsets for the given capacities
+void layout_batch_cache(BatchCacheHeader& header);
+
+uint64_t header_checksum(const BatchCacheHeader& header, const vector<BatchCacheChunk>& chunks);
+
+// next to the source file, e.g. tiles.las.t2g
+string batch_cache_path(string sourcePath);
+
+// null if the file doesn't exist, has a different version or doesn't pass the checks.
+// with sourcePath, also null if the source changed since it was converted
+shared_ptr<BatchCache> open_batch_cache(string path, string sourcePath = "");
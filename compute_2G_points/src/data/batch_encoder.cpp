@@ -0,0 +1,497 @@
+
+#include "batch_encoder.h"
+
+#include <vector>
+#include <random>
+#include <iostream>
+
+#include "unsuck.hpp"
+
+#if defined(_M_X64) || defined(__x86_64__)
+	#define BATCH_ENCODER_X64
+	#include <immintrin.h>
+
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#endif
+
+// msvc compiles intrinsics of any ISA, gcc and clang need them enabled per function
+#if defined(__GNUC__) || defined(__clang__)
+	#define TARGET_AVX2 __attribute__((target("avx2")))
+	#define TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+	#define TARGET_AVX2
+	#define TARGET_AVX512
+#endif
+
+// The simd kernels perform the same double operations as the scalar one, in the same order,
+// so the output is bit-identical as long as the compiler doesn't contract mul + add into fma
+// (msvc's default /fp:precise doesn't).
+
+#define STEPS_30BIT 1073741824
+#define MASK_10BIT 1023
+
+SimdLevel detect_simd_level(){
+
+#ifdef BATCH_ENCODER_X64
+	auto cpuid = [](int leaf, int subleaf, uint32_t regs[4]){
+	#ifdef _MSC_VER
+		int info[4];
+		__cpuidex(info, leaf, subleaf);
+		for(int i = 0; i < 4; i++) regs[i] = info[i];
+	#else
+		__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+	#endif
+	};
+
+	auto xgetbv = []() -> uint64_t {
+	#ifdef _MSC_VER
+		return _xgetbv(0);
+	#else
+		uint32_t eax, edx;
+		__asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return (uint64_t(edx) << 32) | eax;
+	#endif
+	};
+
+	uint32_t regs[4];
+
+	cpuid(0, 0, regs);
+	if(regs[0] < 7){
+		return SimdLevel::SCALAR;
+	}
+
+	cpuid(1, 0, regs);
+	bool hasOSXSAVE = (regs[2] & (1 << 27)) != 0;
+	bool hasAVX = (regs[2] & (1 << 28)) != 0;
+
+	if(!hasOSXSAVE || !hasAVX){
+		return SimdLevel::SCALAR;
+	}
+
+	// the OS must save the ymm and zmm registers on context switches
+	uint64_t xcr0 = xgetbv();
+	bool osSavesYmm = (xcr0 & 0x06) == 0x06;
+	bool osSavesZmm = (xcr0 & 0xE6) == 0xE6;
+
+	cpuid(7, 0, regs);
+	bool hasAVX2 = (regs[1] & (1 << 5)) != 0;
+	bool hasAVX512F = (regs[1] & (1 << 16)) != 0;
+
+	if(hasAVX512F && osSavesZmm){
+		return SimdLevel::AVX512;
+	}else if(hasAVX2 && osSavesYmm){
+		return SimdLevel::AVX2;
+	}
+#endif
+
+	return SimdLevel::SCALAR;
+}
+
+// NaN, from batches with zero extent along an axis, becomes 0
+inline uint32_t quantize_30bit(double value){
+	value = value > 0.0 ? value : 0.0;
+	value = value < double(STEPS_30BIT - 1) ? value : double(STEPS_30BIT - 1);
+
+	return uint32_t(value);
+}
+
+inline uint32_t pack_10bit(uint32_t X30, uint32_t Y30, uint32_t Z30, int shift){
+	uint32_t X = (X30 >> shift) & MASK_10BIT;
+	uint32_t Y = (Y30 >> shift) & MASK_10BIT;
+	uint32_t Z = (Z30 >> shift) & MASK_10BIT;
+
+	return X | (Y << 10) | (Z << 20);
+}
+
+void convert_points_scalar(const uint8_t* source, int64_t stride, int64_t firstPoint, int64_t numPoints, const ConvertParams& p,
+	double* x, double* y, double* z, dvec3& min, dvec3& max)
+{
+	for(int64_t i = firstPoint; i < numPoints; i++){
+		const uint8_t* record = source + i * stride;
+
+		int32_t X, Y, Z;
+		memcpy(&X, record + 0, 4);
+		memcpy(&Y, record + 4, 4);
+		memcpy(&Z, record + 8, 4);
+
+		x[i] = double(X) * p.scale.x + p.offset.x - p.boxMin.x;
+		y[i] = double(Y) * p.scale.y + p.offset.y - p.boxMin.y;
+		z[i] = double(Z) * p.scale.z + p.offset.z - p.boxMin.z;
+
+		min.x = std::min(min.x, x[i]);
+		min.y = std::min(min.y, y[i]);
+		min.z = std::min(min.z, z[i]);
+		max.x = std::max(max.x, x[i]);
+		max.y = std::max(max.y, y[i]);
+		max.z = std::max(max.z, z[i]);
+	}
+}
+
+void quantize_and_pack_scalar(const double* x, const double* y, const double* z, int64_t firstPoint, int64_t numPoints, dvec3 batchMin, dvec3 batchSize,
+	uint32_t* low, uint32_t* med, uint32_t* hig)
+{
+	for(int64_t i = firstPoint; i < numPoints; i++){
+		uint32_t X30 = quantize_30bit(((x[i] - batchMin.x) / batchSize.x) * STEPS_30BIT);
+		uint32_t Y30 = quantize_30bit(((y[i] - batchMin.y) / batchSize.y) * STEPS_30BIT);
+		uint32_t Z30 = quantize_30bit(((z[i] - batchMin.z) / batchSize.z) * STEPS_30BIT);
+
+		low[i] = pack_10bit(X30, Y30, Z30, 20);
+		med[i] = pack_10bit(X30, Y30, Z30, 10);
+		hig[i] = pack_10bit(X30, Y30, Z30, 0);
+	}
+}
+
+#ifdef BATCH_ENCODER_X64
+
+// AVX2, 8 points per iteration
+
+struct ConvertAxis4{
+	__m256d scale;
+	__m256d offset;
+	__m256d boxMin;
+	__m256d min;
+	__m256d max;
+};
+
+TARGET_AVX2
+inline void convert8_avx2(__m256i coordinates, ConvertAxis4& a, double* target){
+	__m256d lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(coordinates));
+	__m256d hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(coordinates, 1));
+
+	lo = _mm256_sub_pd(_mm256_add_pd(_mm256_mul_pd(lo, a.scale), a.offset), a.boxMin);
+	hi = _mm256_sub_pd(_mm256_add_pd(_mm256_mul_pd(hi, a.scale), a.offset), a.boxMin);
+
+	_mm256_storeu_pd(target + 0, lo);
+	_mm256_storeu_pd(target + 4, hi);
+
+	a.min = _mm256_min_pd(a.min, _mm256_min_pd(lo, hi));
+	a.max = _mm256_max_pd(a.max, _mm256_max_pd(lo, hi));
+}
+
+TARGET_AVX2
+inline double reduce_min_avx2(__m256d value){
+	double values[4];
+	_mm256_storeu_pd(values, value);
+
+	return std::min(std::min(values[0], values[1]), std::min(values[2], values[3]));
+}
+
+TARGET_AVX2
+inline double reduce_max_avx2(__m256d value){
+	double values[4];
+	_mm256_storeu_pd(values, value);
+
+	return std::max(std::max(values[0], values[1]), std::max(values[2], values[3]));
+}
+
+TARGET_AVX2
+void convert_points_avx2(const uint8_t* source, int64_t stride, int64_t numPoints, const ConvertParams& p,
+	double* x, double* y, double* z, dvec3& min, dvec3& max)
+{
+	ConvertAxis4 ax = {_mm256_set1_pd(p.scale.x), _mm256_set1_pd(p.offset.x), _mm256_set1_pd(p.boxMin.x), _mm256_set1_pd(min.x), _mm256_set1_pd(max.x)};
+	ConvertAxis4 ay = {_mm256_set1_pd(p.scale.y), _mm256_set1_pd(p.offset.y), _mm256_set1_pd(p.boxMin.y), _mm256_set1_pd(min.y), _mm256_set1_pd(max.y)};
+	ConvertAxis4 az = {_mm256_set1_pd(p.scale.z), _mm256_set1_pd(p.offset.z), _mm256_set1_pd(p.boxMin.z), _mm256_set1_pd(min.z), _mm256_set1_pd(max.z)};
+
+	__m256i recordOffsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(int32_t(stride)));
+
+	int64_t i = 0;
+	for(; i + 8 <= numPoints; i += 8){
+		const uint8_t* records = source + i * stride;
+
+		__m256i X = _mm256_i32gather_epi32((const int*)(records + 0), recordOffsets, 1);
+		__m256i Y = _mm256_i32gather_epi32((const int*)(records + 4), recordOffsets, 1);
+		__m256i Z = _mm256_i32gather_epi32((const int*)(records + 8), recordOffsets, 1);
+
+		convert8_avx2(X, ax, x + i);
+		convert8_avx2(Y, ay, y + i);
+		convert8_avx2(Z, az, z + i);
+	}
+
+	min = {reduce_min_avx2(ax.min), reduce_min_avx2(ay.min), reduce_min_avx2(az.min)};
+	max = {reduce_max_avx2(ax.max), reduce_max_avx2(ay.max), reduce_max_avx2(az.max)};
+
+	convert_points_scalar(source, stride, i, numPoints, p, x, y, z, min, max);
+}
+
+TARGET_AVX2
+inline __m128i quantize4_avx2(const double* source, __m256d batchMin, __m256d batchSize){
+	__m256d steps = _mm256_set1_pd(STEPS_30BIT);
+	__m256d zero = _mm256_setzero_pd();
+	__m256d maxValue = _mm256_set1_pd(STEPS_30BIT - 1);
+
+	__m256d value = _mm256_loadu_pd(source);
+	value = _mm256_mul_pd(_mm256_div_pd(_mm256_sub_pd(value, batchMin), batchSize), steps);
+
+	// maxpd returns the second operand if the first is NaN
+	value = _mm256_max_pd(value, zero);
+	value = _mm256_min_pd(value, maxValue);
+
+	return _mm256_cvttpd_epi32(value);
+}
+
+TARGET_AVX2
+inline __m256i quantize8_avx2(const double* source, __m256d batchMin, __m256d batchSize){
+	__m128i lo = quantize4_avx2(source + 0, batchMin, batchSize);
+	__m128i hi = quantize4_avx2(source + 4, batchMin, batchSize);
+
+	return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+template<int SHIFT>
+TARGET_AVX2
+inline __m256i pack8_10bit_avx2(__m256i X30, __m256i Y30, __m256i Z30){
+	__m256i mask = _mm256_set1_epi32(MASK_10BIT);
+
+	__m256i X = _mm256_and_si256(_mm256_srli_epi32(X30, SHIFT), mask);
+	__m256i Y = _mm256_and_si256(_mm256_srli_epi32(Y30, SHIFT), mask);
+	__m256i Z = _mm256_and_si256(_mm256_srli_epi32(Z30, SHIFT), mask);
+
+	return _mm256_or_si256(X, _mm256_or_si256(_mm256_slli_epi32(Y, 10), _mm256_slli_epi32(Z, 20)));
+}
+
+TARGET_AVX2
+void quantize_and_pack_avx2(const double* x, const double* y, const double* z, int64_t numPoints, dvec3 batchMin, dvec3 batchSize,
+	uint32_t* low, uint32_t* med, uint32_t* hig)
+{
+	__m256d minX = _mm256_set1_pd(batchMin.x), sizeX = _mm256_set1_pd(batchSize.x);
+	__m256d minY = _mm256_set1_pd(batchMin.y), sizeY = _mm256_set1_pd(batchSize.y);
+	__m256d minZ = _mm256_set1_pd(batchMin.z), sizeZ = _mm256_set1_pd(batchSize.z);
+
+	int64_t i = 0;
+	for(; i + 8 <= numPoints; i += 8){
+		__m256i X30 = quantize8_avx2(x + i, minX, sizeX);
+		__m256i Y30 = quantize8_avx2(y + i, minY, sizeY);
+		__m256i Z30 = quantize8_avx2(z + i, minZ, sizeZ);
+
+		_mm256_storeu_si256((__m256i*)(low + i), pack8_10bit_avx2<20>(X30, Y30, Z30));
+		_mm256_storeu_si256((__m256i*)(med + i), pack8_10bit_avx2<10>(X30, Y30, Z30));
+		_mm256_storeu_si256((__m256i*)(hig + i), pack8_10bit_avx2< 0>(X30, Y30, Z30));
+	}
+
+	quantize_and_pack_scalar(x, y, z, i, numPoints, batchMin, batchSize, low, med, hig);
+}
+
+// AVX-512, 16 points per iteration
+
+struct ConvertAxis8{
+	__m512d scale;
+	__m512d offset;
+	__m512d boxMin;
+	__m512d min;
+	__m512d max;
+};
+
+TARGET_AVX512
+inline void convert16_avx512(__m512i coordinates, ConvertAxis8& a, double* target){
+	__m512d lo = _mm512_cvtepi32_pd(_mm512_castsi512_si256(coordinates));
+	__m512d hi = _mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(coordinates, 1));
+
+	lo = _mm512_sub_pd(_mm512_add_pd(_mm512_mul_pd(lo, a.scale), a.offset), a.boxMin);
+	hi = _mm512_sub_pd(_mm512_add_pd(_mm512_mul_pd(hi, a.scale), a.offset), a.boxMin);
+
+	_mm512_storeu_pd(target + 0, lo);
+	_mm512_storeu_pd(target + 8, hi);
+
+	a.min = _mm512_min_pd(a.min, _mm512_min_pd(lo, hi));
+	a.max = _mm512_max_pd(a.max, _mm512_max_pd(lo, hi));
+}
+
+TARGET_AVX512
+void convert_points_avx512(const uint8_t* source, int64_t stride, int64_t numPoints, const ConvertParams& p,
+	double* x, double* y, double* z, dvec3& min, dvec3& max)
+{
+	ConvertAxis8 ax = {_mm512_set1_pd(p.scale.x), _mm512_set1_pd(p.offset.x), _mm512_set1_pd(p.boxMin.x), _mm512_set1_pd(min.x), _mm512_set1_pd(max.x)};
+	ConvertAxis8 ay = {_mm512_set1_pd(p.scale.y), _mm512_set1_pd(p.offset.y), _mm512_set1_pd(p.boxMin.y), _mm512_set1_pd(min.y), _mm512_set1_pd(max.y)};
+	ConvertAxis8 az = {_mm512_set1_pd(p.scale.z), _mm512_set1_pd(p.offset.z), _mm512_set1_pd(p.boxMin.z), _mm512_set1_pd(min.z), _mm512_set1_pd(max.z)};
+
+	__m512i recordOffsets = _mm512_mullo_epi32(
+		_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+		_mm512_set1_epi32(int32_t(stride)));
+
+	int64_t i = 0;
+	for(; i + 16 <= numPoints; i += 16){
+		const uint8_t* records = source + i * stride;
+
+		__m512i X = _mm512_i32gather_epi32(recordOffsets, records + 0, 1);
+		__m512i Y = _mm512_i32gather_epi32(recordOffsets, records + 4, 1);
+		__m512i Z = _mm512_i32gather_epi32(recordOffsets, records + 8, 1);
+
+		convert16_avx512(X, ax, x + i);
+		convert16_avx512(Y, ay, y + i);
+		convert16_avx512(Z, az, z + i);
+	}
+
+	min = {_mm512_reduce_min_pd(ax.min), _mm512_reduce_min_pd(ay.min), _mm512_reduce_min_pd(az.min)};
+	max = {_mm512_reduce_max_pd(ax.max), _mm512_reduce_max_pd(ay.max), _mm512_reduce_max_pd(az.max)};
+
+	convert_points_scalar(source, stride, i, numPoints, p, x, y, z, min, max);
+}
+
+TARGET_AVX512
+inline __m256i quantize8_avx512(const double* source, __m512d batchMin, __m512d batchSize){
+	__m512d steps = _mm512_set1_pd(STEPS_30BIT);
+	__m512d zero = _mm512_setzero_pd();
+	__m512d maxValue = _mm512_set1_pd(STEPS_30BIT - 1);
+
+	__m512d value = _mm512_loadu_pd(source);
+	value = _mm512_mul_pd(_mm512_div_pd(_mm512_sub_pd(value, batchMin), batchSize), steps);
+
+	value = _mm512_max_pd(value, zero);
+	value = _mm512_min_pd(value, maxValue);
+
+	return _mm512_cvttpd_epi32(value);
+}
+
+TARGET_AVX512
+inline __m512i quantize16_avx512(const double* source, __m512d batchMin, __m512d batchSize){
+	__m256i lo = quantize8_avx512(source + 0, batchMin, batchSize);
+	__m256i hi = quantize8_avx512(source + 8, batchMin, batchSize);
+
+	return _mm512_inserti64x4(_mm512_castsi256_si512(lo), hi, 1);
+}
+
+template<int SHIFT>
+TARGET_AVX512
+inline __m512i pack16_10bit_avx512(__m512i X30, __m512i Y30, __m512i Z30){
+	__m512i mask = _mm512_set1_epi32(MASK_10BIT);
+
+	__m512i X = _mm512_and_si512(_mm512_srli_epi32(X30, SHIFT), mask);
+	__m512i Y = _mm512_and_si512(_mm512_srli_epi32(Y30, SHIFT), mask);
+	__m512i Z = _mm512_and_si512(_mm512_srli_epi32(Z30, SHIFT), mask);
+
+	return _mm512_or_si512(X, _mm512_or_si512(_mm512_slli_epi32(Y, 10), _mm512_slli_epi32(Z, 20)));
+}
+
+TARGET_AVX512
+void quantize_and_pack_avx512(const double* x, const double* y, const double* z, int64_t numPoints, dvec3 batchMin, dvec3 batchSize,
+	uint32_t* low, uint32_t* med, uint32_t* hig)
+{
+	__m512d minX = _mm512_set1_pd(batchMin.x), sizeX = _mm512_set1_pd(batchSize.x);
+	__m512d minY = _mm512_set1_pd(batchMin.y), sizeY = _mm512_set1_pd(batchSize.y);
+	__m512d minZ = _mm512_set1_pd(batchMin.z), sizeZ = _mm512_set1_pd(batchSize.z);
+
+	int64_t i = 0;
+	for(; i + 16 <= numPoints; i += 16){
+		__m512i X30 = quantize16_avx512(x + i, minX, sizeX);
+		__m512i Y30 = quantize16_avx512(y + i, minY, sizeY);
+		__m512i Z30 = quantize16_avx512(z + i, minZ, sizeZ);
+
+		_mm512_storeu_si512(low + i, pack16_10bit_avx512<20>(X30, Y30, Z30));
+		_mm512_storeu_si512(med + i, pack16_10bit_avx512<10>(X30, Y30, Z30));
+		_mm512_storeu_si512(hig + i, pack16_10bit_avx512< 0>(X30, Y30, Z30));
+	}
+
+	quantize_and_pack_scalar(x, y, z, i, numPoints, batchMin, batchSize, low, med, hig);
+}
+
+#endif
+
+void convert_points(const uint8_t* source, int64_t stride, int64_t numPoints, const ConvertParams& params,
+	double* x, double* y, double* z, dvec3& min, dvec3& max, SimdLevel level)
+{
+
+#ifdef BATCH_ENCODER_X64
+	if(level == SimdLevel::AVX512){
+		convert_points_avx512(source, stride, numPoints, params, x, y, z, min, max);
+
+		return;
+	}else if(level == SimdLevel::AVX2){
+		convert_points_avx2(source, stride, numPoints, params, x, y, z, min, max);
+
+		return;
+	}
+#endif
+
+	convert_points_scalar(source, stride, 0, numPoints, params, x, y, z, min, max);
+}
+
+void quantize_and_pack(const double* x, const double* y, const double* z, int64_t numPoints, dvec3 batchMin, dvec3 batchSize,
+	uint32_t* low, uint32_t* med, uint32_t* hig, SimdLevel level)
+{
+
+#ifdef BATCH_ENCODER_X64
+	if(level == SimdLevel::AVX512){
+		quantize_and_pack_avx512(x, y, z, numPoints, batchMin, batchSize, low, med, hig);
+
+		return;
+	}else if(level == SimdLevel::AVX2){
+		quantize_and_pack_avx2(x, y, z, numPoints, batchMin, batchSize, low, med, hig);
+
+		return;
+	}
+#endif
+
+	quantize_and_pack_scalar(x, y, z, 0, numPoints, batchMin, batchSize, low, med, hig);
+}
+
+void benchmark_quantize(){
+
+	// one batch of point format 3 records
+	int64_t numPoints = 10'240;
+	int64_t stride = 34;
+	int numRepetitions = 2'000;
+
+	vector<uint8_t> records(numPoints * stride);
+	mt19937 rng(123);
+	uniform_int_distribution<int32_t> distribution(-5'000'000, 5'000'000);
+
+	for(int64_t i = 0; i < numPoints; i++){
+		int32_t xyz[3] = {distribution(rng), distribution(rng), distribution(rng) / 10};
+		memcpy(records.data() + i * stride, xyz, 12);
+	}
+
+	ConvertParams params;
+	params.scale = {0.001, 0.001, 0.001};
+	params.offset = {1000.0, 2000.0, 10.0};
+	params.boxMin = {995.0, 1995.0, 9.5};
+
+	SimdLevel supported = detect_simd_level();
+
+	auto encode = [&](SimdLevel level, vector<double>& scratch, vector<uint32_t>& encoded){
+		double* x = &scratch[0];
+		double* y = &scratch[numPoints];
+		double* z = &scratch[2 * numPoints];
+
+		dvec3 min = {Infinity, Infinity, Infinity};
+		dvec3 max = {-Infinity, -Infinity, -Infinity};
+
+		convert_points(records.data(), stride, numPoints, params, x, y, z, min, max, level);
+		quantize_and_pack(x, y, z, numPoints, min, max - min,
+			&encoded[0], &encoded[numPoints], &encoded[2 * numPoints], level);
+	};
+
+	vector<double> scratch(3 * numPoints);
+	vector<uint32_t> reference(3 * numPoints);
+	encode(SimdLevel::SCALAR, scratch, reference);
+
+	cout << "benchmark quantize: " << formatNumber(numPoints) << " points x " << numRepetitions
+		<< ", supported: " << toString(supported) << endl;
+
+	for(SimdLevel level : {SimdLevel::SCALAR, SimdLevel::AVX2, SimdLevel::AVX512}){
+
+		if(int(level) > int(supported)){
+			continue;
+		}
+
+		vector<uint32_t> encoded(3 * numPoints);
+
+		double tStart = now();
+
+		for(int i = 0; i < numRepetitions; i++){
+			encode(level, scratch, encoded);
+		}
+
+		double duration = now() - tStart;
+		double mptsPerSecond = double(numPoints * numRepetitions) / duration / 1'000'000.0;
+		bool isIdentical = encoded == reference;
+
+		cout << leftPad(toString(level), 7)
+			<< ": " << formatNumber(mptsPerSecond, 1) << " Mpts/s"
+			<< ", identical to scalar: " << (isIdentical ? "yes" : "NO") << endl;
+	}
+
+}
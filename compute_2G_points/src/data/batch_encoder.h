@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "glm/vec3.hpp"
+
+using namespace std;
+using glm::dvec3;
+
+enum class SimdLevel{
+	SCALAR,
+	AVX2,
+	AVX512
+};
+
+inline string toString(SimdLevel level){
+	if(level == SimdLevel::SCALAR) return "scalar";
+	if(level == SimdLevel::AVX2) return "avx2";
+	if(level == SimdLevel::AVX512) return "avx512";
+
+	return "unknown";
+}
+
+// highest level that both the CPU and the OS support
+SimdLevel detect_simd_level();
+
+// Points are encoded in two passes over each batch:
+// 1. convert_points() reads the records once, transforms XYZ to doubles relative to the point cloud's boxMin,
+//    stores them in a scratch buffer and extends the batch bounds.
+// 2. quantize_and_pack() quantizes the scratch coordinates to 30 bits per axis, relative to the batch bounds,
+//    and packs the upper, middle and lower 10 bits of each axis into low, med and hig.
+// The scratch buffer of a batch is small enough to stay in cache between both passes.
+// All levels produce bit-identical output.
+
+// X * scale + offset - boxMin
+struct ConvertParams{
+	dvec3 scale;
+	dvec3 offset;
+	dvec3 boxMin;
+};
+
+// reads XYZ at offset 0, 4 and 8 of numPoints stride-sized records into x, y and z.
+// min and max are extended, not reset
+void convert_points(const uint8_t* source, int64_t stride, int64_t numPoints, const ConvertParams& params,
+	double* x, double* y, double* z, dvec3& min, dvec3& max, SimdLevel level);
+
+void quantize_and_pack(const double* x, const double* y, const double* z, int64_t numPoints, dvec3 batchMin, dvec3 batchSize,
+	uint32_t* low, uint32_t* med, uint32_t* hig, SimdLevel level);
+
+// encodes synthetic records with each supported level, checks them against scalar and prints Mpts/s
+void benchmark_quantize();
@@ -0,0 +1,84 @@
+
+#include "buffer_pool.h"
+
+BufferPool::BufferPool(int64_t maxPooledBytes){
+	this->maxPooledBytes = maxPooledBytes;
+}
+
+BufferPool::~BufferPool(){
+	for(auto& [classSize, buffers] : idleBuffers){
+		for(Buffer* buffer : buffers){
+			delete buffer;
+		}
+	}
+}
+
+int64_t BufferPool::sizeClass(int64_t size){
+
+	int64_t minClass = 4096;
+
+	if(size <= minClass){
+		return minClass;
+	}
+
+	// largest power of two <= size
+	int64_t base = minClass;
+	while(base * 2 <= size){
+		base *= 2;
+	}
+
+	int64_t step = base / 4;
+	int64_t classSize = ((size + step - 1) / step) * step;
+
+	return classSize;
+}
+
+shared_ptr<Buffer> BufferPool::acquire(int64_t size){
+
+	int64_t classSize = sizeClass(size);
+	Buffer* buffer = nullptr;
+
+	{
+		lock_guard<mutex> lock(mtx);
+
+		auto it = idleBuffers.find(classSize);
+		if(it != idleBuffers.end() && it->second.size() > 0){
+			buffer = it->second.back();
+			it->second.pop_back();
+			pooledBytes -= classSize;
+		}
+	}
+
+	if(buffer){
+		numHits++;
+	}else{
+		numMisses++;
+		buffer = new Buffer(classSize);
+	}
+
+	buffer->size = size;
+	buffer->pos = 0;
+
+	auto pool = shared_from_this();
+
+	return shared_ptr<Buffer>(buffer, [pool, classSize](Buffer* buffer){
+		pool->release(buffer, classSize);
+	});
+}
+
+void BufferPool::release(Buffer* buffer, int64_t classSize){
+
+	{
+		lock_guard<mutex> lock(mtx);
+
+		if(pooledBytes + classSize <= maxPooledBytes){
+			idleBuffers[classSize].push_back(buffer);
+			pooledBytes += classSize;
+
+			return;
+		}
+	}
+
+	numDropped++;
+	delete buffer;
+}
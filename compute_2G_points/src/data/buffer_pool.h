@@ -0,0 +1,51 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <memory>
+
+#include "unsuck.hpp"
+
+using namespace std;
+
+// recycles the buffers of decoded chunks, so that steady ingest doesn't malloc, page-fault and free
+// several MB per chunk.
+// - sizes are rounded up to size classes: powers of two, split into 4 steps (at most 25% waste)
+// - acquired buffers return to the pool when their last shared_ptr goes away
+// - idle buffers are kept as long as they fit into maxPooledBytes, others are freed
+struct BufferPool : public enable_shared_from_this<BufferPool>{
+
+	int64_t maxPooledBytes = 0;
+
+	mutex mtx;
+	map<int64_t, vector<Buffer*>> idleBuffers;
+
+	atomic<int64_t> numHits = 0;
+	atomic<int64_t> numMisses = 0;
+	// returned buffers that were freed because the pool was full
+	atomic<int64_t> numDropped = 0;
+	atomic<int64_t> pooledBytes = 0;
+
+	BufferPool(int64_t maxPooledBytes);
+	~BufferPool();
+
+	// buffer->size is the requested size, the allocation may be larger
+	shared_ptr<Buffer> acquire(int64_t size);
+
+	static int64_t sizeClass(int64_t size);
+
+private:
+
+	void release(Buffer* buffer, int64_t classSize);
+};
+
+// allocates from the pool, or with plain malloc if there is none
+inline shared_ptr<Buffer> allocate_buffer(shared_ptr<BufferPool> pool, int64_t size){
+	if(pool){
+		return pool->acquire(size);
+	}else{
+		return make_shared<Buffer>(size);
+	}
+}
@@ -0,0 +1,582 @@
+#include "chunk_reader.h"
+
+#include <thread>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+	#define CHUNK_READER_IO_URING
+	#include <atomic>
+	#include <cerrno>
+	#include <linux/io_uring.h>
+	#include <sys/syscall.h>
+	#include <sys/mman.h>
+	#include <unistd.h>
+#endif
+
+
+ChunkReader::ChunkReader(int queueDepth, int numBuffers){
+	this->queueDepth = queueDepth;
+
+	buffers.resize(numBuffers, nullptr);
+	slots.resize(numBuffers);
+
+	for(int i = numBuffers - 1; i >= 0; i--){
+		freeSlots.push_back(i);
+	}
+}
+
+shared_ptr<ReadOnlyFile> ChunkReader::getFile(string path, bool unbuffered){
+
+	lock_guard<mutex> lock(mtx_files);
+
+	auto& openFiles = unbuffered ? unbufferedFiles : files;
+	auto it = openFiles.find(path);
+
+	if(it != openFiles.end()){
+		return it->second;
+	}
+
+	auto file = make_shared<ReadOnlyFile>(path, unbuffered);
+	openFiles[path] = file;
+
+	return file;
+}
+
+void ChunkReader::close(string path){
+	lock_guard<mutex> lock(mtx_files);
+
+	files.erase(path);
+	unbufferedFiles.erase(path);
+}
+
+int ChunkReader::acquireSlot(int64_t size){
+
+	unique_lock<mutex> lock(mtx_slots);
+
+	cv_slots.wait(lock, [this](){ return freeSlots.size() > 0; });
+
+	int slot = freeSlots.back();
+	freeSlots.pop_back();
+
+	lock.unlock();
+
+	// buffers are allocated lazily and only grow
+	if(buffers[slot] == nullptr || buffers[slot]->size < size){
+		buffers[slot] = make_shared<Buffer>(size, DIRECT_IO_ALIGNMENT);
+	}
+
+	return slot;
+}
+
+void ChunkReader::submit(string path, int64_t offset, int64_t size, int64_t tag, bool unbuffered){
+
+	auto file = getFile(path, unbuffered);
+
+	int64_t readOffset = offset;
+	int64_t readSize = size;
+
+	if(file->isUnbuffered){
+		int64_t begin = offset - (offset % DIRECT_IO_ALIGNMENT);
+		int64_t end = ((offset + size + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT) * DIRECT_IO_ALIGNMENT;
+
+		readOffset = begin;
+		readSize = end - begin;
+	}
+
+	int slot = acquireSlot(readSize);
+
+	slots[slot].head = offset - readOffset;
+	slots[slot].requestedSize = size;
+
+	numInFlight++;
+
+	submitRead(file, slot, readOffset, readSize, tag);
+}
+
+ChunkRead ChunkReader::wait(){
+
+	ChunkRead read = waitCompletion();
+
+	Slot& slot = slots[read.slot];
+
+	// the aligned read may start before the requested range and extend past it, 
+	// or come up short at the end of the file
+	read.data = read.data + slot.head;
+	read.size = std::clamp(read.size - slot.head, int64_t(0), slot.requestedSize);
+
+	return read;
+}
+
+void ChunkReader::release(ChunkRead& read){
+
+	if(read.slot < 0){
+		return;
+	}
+
+	{
+		lock_guard<mutex> lock(mtx_slots);
+		freeSlots.push_back(read.slot);
+	}
+	cv_slots.notify_one();
+
+	read.slot = -1;
+	read.data = nullptr;
+}
+
+
+// queueDepth threads, each blocking in a positional read
+struct PreadChunkReader : public ChunkReader{
+
+	struct Request{
+		shared_ptr<ReadOnlyFile> file;
+		int slot;
+		int64_t offset;
+		int64_t size;
+		int64_t tag;
+	};
+
+	deque<Request> requests;
+	deque<ChunkRead> completed;
+	mutex mtx;
+	condition_variable cv_requests;
+	condition_variable cv_completed;
+	vector<thread> threads;
+	bool isClosing = false;
+
+	PreadChunkReader(int queueDepth, int numBuffers) : ChunkReader(queueDepth, numBuffers){
+		this->name = "preadv";
+
+		for(int i = 0; i < queueDepth; i++){
+			threads.emplace_back([this](){
+				while(true){
+
+					unique_lock<mutex> lock(mtx);
+					cv_requests.wait(lock, [this](){ return isClosing || requests.size() > 0; });
+
+					if(isClosing){
+						break;
+					}
+
+					Request request = requests.front();
+					requests.pop_front();
+
+					lock.unlock();
+
+					uint8_t* target = buffers[request.slot]->data_u8;
+					int64_t bytesRead = request.file->readAt(target, request.offset, request.size);
+
+					ChunkRead read;
+					read.tag = request.tag;
+					read.size = bytesRead;
+					read.data = target;
+					read.slot = request.slot;
+
+					lock.lock();
+					completed.push_back(read);
+					lock.unlock();
+
+					cv_completed.notify_one();
+				}
+			});
+		}
+	}
+
+	~PreadChunkReader(){
+		{
+			lock_guard<mutex> lock(mtx);
+			isClosing = true;
+		}
+		cv_requests.notify_all();
+
+		for(auto& t : threads){
+			t.join();
+		}
+	}
+
+	void submitRead(shared_ptr<ReadOnlyFile> file, int slot, int64_t offset, int64_t size, int64_t tag){
+		{
+			lock_guard<mutex> lock(mtx);
+			requests.push_back({file, slot, offset, size, tag});
+		}
+		cv_requests.notify_one();
+	}
+
+	ChunkRead waitCompletion(){
+		unique_lock<mutex> lock(mtx);
+		cv_completed.wait(lock, [this](){ return completed.size() > 0; });
+
+		ChunkRead read = completed.front();
+		completed.pop_front();
+
+		numInFlight--;
+
+		return read;
+	}
+
+};
+
+
+#if defined(CHUNK_READER_IO_URING)
+
+// io_uring through raw syscalls, so that we don't depend on liburing.
+// see https://unixism.net/loti/low_level.html
+struct IoUringChunkReader : public ChunkReader{
+
+	struct Pending{
+		// keeps the fd open until the read has finished, even if the file was closed meanwhile
+		shared_ptr<ReadOnlyFile> file = nullptr;
+		int fd = -1;
+		int64_t offset = 0;
+		int64_t size = 0;
+		int64_t bytesRead = 0;
+		int64_t tag = 0;
+	};
+
+	int ringFd = -1;
+
+	uint8_t* sqRing = nullptr;
+	uint8_t* cqRing = nullptr;
+	io_uring_sqe* sqes = nullptr;
+	size_t sqRingSize = 0;
+	size_t cqRingSize = 0;
+	size_t sqesSize = 0;
+
+	uint32_t* sqTail = nullptr;
+	uint32_t* sqMask = nullptr;
+	uint32_t* sqArray = nullptr;
+	uint32_t* cqHead = nullptr;
+	uint32_t* cqTail = nullptr;
+	uint32_t* cqMask = nullptr;
+	io_uring_cqe* cqes = nullptr;
+
+	// indexed by buffer slot
+	vector<Pending> pending;
+
+	// slots that complete without a completion entry, i.e. reads done synchronously once the ring is closed
+	deque<int> failed;
+
+	// set if submitting or waiting failed. the ring is closed, reads are done synchronously
+	bool isRingFailed = false;
+
+	// buffers of reads that the kernel held when the ring was closed. it may still write into them
+	// until it has cancelled those reads, so they are only freed with the reader
+	vector<shared_ptr<Buffer>> abandonedBuffers;
+
+	// attempts of io_uring_enter that was interrupted or busy, before giving up
+	static constexpr int MAX_ENTER_ATTEMPTS = 20;
+
+	IoUringChunkReader(int queueDepth, int numBuffers) : ChunkReader(queueDepth, numBuffers){
+		this->name = "io_uring";
+
+		pending.resize(numBuffers);
+	}
+
+	~IoUringChunkReader(){
+		closeRing();
+	}
+
+	void closeRing(){
+		if(sqes != nullptr) munmap(sqes, sqesSize);
+		if(cqRing != nullptr && cqRing != sqRing) munmap(cqRing, cqRingSize);
+		if(sqRing != nullptr) munmap(sqRing, sqRingSize);
+		if(ringFd != -1) ::close(ringFd);
+
+		sqes = nullptr;
+		cqRing = nullptr;
+		sqRing = nullptr;
+		ringFd = -1;
+	}
+
+	// returns false if io_uring is not available, e.g. old kernels or blocked by seccomp
+	bool init(){
+
+		io_uring_params params;
+		memset(&params, 0, sizeof(params));
+
+		ringFd = int(syscall(__NR_io_uring_setup, queueDepth, &params));
+
+		if(ringFd < 0){
+			ringFd = -1;
+			return false;
+		}
+
+		// IORING_OP_READ needs linux 5.6, older kernels fail every read with -EINVAL.
+		// the probe arrived in the same release, so if it fails, reads aren't supported either
+		vector<uint8_t> probeBuffer(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+		io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(probeBuffer.data());
+
+		int probeResult = int(syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probe, 256));
+
+		bool supportsRead = probeResult == 0
+			&& probe->ops_len > IORING_OP_READ
+			&& (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) != 0;
+
+		if(!supportsRead){
+			return false;
+		}
+
+		sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+		cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+		bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if(singleMmap){
+			sqRingSize = std::max(sqRingSize, cqRingSize);
+			cqRingSize = sqRingSize;
+		}
+
+		void* sq = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+		if(sq == MAP_FAILED){
+			return false;
+		}
+		sqRing = reinterpret_cast<uint8_t*>(sq);
+
+		if(singleMmap){
+			cqRing = sqRing;
+		}else{
+			void* cq = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+			if(cq == MAP_FAILED){
+				return false;
+			}
+			cqRing = reinterpret_cast<uint8_t*>(cq);
+		}
+
+		void* sqesMapping = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+		if(sqesMapping == MAP_FAILED){
+			return false;
+		}
+		sqes = reinterpret_cast<io_uring_sqe*>(sqesMapping);
+
+		sqTail  = reinterpret_cast<uint32_t*>(sqRing + params.sq_off.tail);
+		sqMask  = reinterpret_cast<uint32_t*>(sqRing + params.sq_off.ring_mask);
+		sqArray = reinterpret_cast<uint32_t*>(sqRing + params.sq_off.array);
+		cqHead  = reinterpret_cast<uint32_t*>(cqRing + params.cq_off.head);
+		cqTail  = reinterpret_cast<uint32_t*>(cqRing + params.cq_off.tail);
+		cqMask  = reinterpret_cast<uint32_t*>(cqRing + params.cq_off.ring_mask);
+		cqes    = reinterpret_cast<io_uring_cqe*>(cqRing + params.cq_off.cqes);
+
+		return true;
+	}
+
+	// retries interrupted and busy calls up to MAX_ENTER_ATTEMPTS times, returns false on other errors
+	// and if the kernel takes none of the entries
+	bool enter(uint32_t toSubmit, uint32_t minComplete, uint32_t flags){
+
+		for(int attempt = 0; attempt < MAX_ENTER_ATTEMPTS; attempt++){
+			int result = int(syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0));
+
+			if(result >= 0 && uint32_t(result) >= toSubmit){
+				return true;
+			}else if(result > 0){
+				// the kernel took fewer entries than we asked for, submit the rest
+				toSubmit -= result;
+			}else if(result == 0){
+				GENERATE_ERROR_MESSAGE << "io_uring_enter took none of " << toSubmit << " entries" << endl;
+				return false;
+			}else if(errno == EAGAIN){
+				// out of resources for now, back off from 0.1ms up to 10ms
+				std::this_thread::sleep_for(std::chrono::microseconds(100 << std::min(attempt, 7)));
+			}else if(errno != EINTR){
+				GENERATE_ERROR_MESSAGE << "io_uring_enter failed with error " << errno << endl;
+				return false;
+			}
+		}
+
+		GENERATE_ERROR_MESSAGE << "io_uring_enter still interrupted or busy after " << MAX_ENTER_ATTEMPTS << " attempts" << endl;
+
+		return false;
+	}
+
+	// completes the read of slot with whatever it has read so far
+	void fail(int slot){
+		pending[slot].size = pending[slot].bytesRead;
+		failed.push_back(slot);
+	}
+
+	// closes the ring after submitting to or waiting on it failed, so that no completions of its reads can arrive anymore.
+	// the reads that the kernel held are finished synchronously in new buffers
+	void abandonRing(){
+
+		GENERATE_WARN_MESSAGE << "reading without io_uring from now on" << endl;
+		isRingFailed = true;
+
+		for(int slot = 0; slot < pending.size(); slot++){
+			Pending& p = pending[slot];
+			bool isFailed = std::find(failed.begin(), failed.end(), slot) != failed.end();
+
+			if(p.file == nullptr || isFailed){
+				continue;
+			}
+
+			// the kernel doesn't write into the part it has already completed
+			auto buffer = make_shared<Buffer>(buffers[slot]->size, DIRECT_IO_ALIGNMENT);
+			memcpy(buffer->data_u8, buffers[slot]->data_u8, p.bytesRead);
+
+			abandonedBuffers.push_back(buffers[slot]);
+			buffers[slot] = buffer;
+
+			if(p.fd != -1 && p.bytesRead < p.size){
+				p.bytesRead += p.file->readAt(buffer->data_u8 + p.bytesRead, p.offset + p.bytesRead, p.size - p.bytesRead);
+			}
+
+			fail(slot);
+		}
+
+		// the kernel cancels the reads that are still in flight
+		closeRing();
+	}
+
+	// submits a single entry. if the kernel doesn't take it, it is withdrawn and reads continue without the ring
+	void submitEntry(const io_uring_sqe& entry){
+
+		uint32_t tail = *sqTail;
+		uint32_t index = tail & *sqMask;
+
+		sqes[index] = entry;
+		sqArray[index] = index;
+
+		__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+		if(!enter(1, 0, 0)){
+			__atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+			abandonRing();
+		}
+	}
+
+	// queue the remaining bytes of a pending read
+	void push(int slot){
+		Pending& p = pending[slot];
+
+		io_uring_sqe sqe;
+		memset(&sqe, 0, sizeof(io_uring_sqe));
+
+		// a single read is limited to 32 bit lengths, 1GB steps keep unbuffered reads aligned
+		int64_t remaining = std::min(p.size - p.bytesRead, int64_t(1) << 30);
+
+		sqe.opcode = IORING_OP_READ;
+		sqe.fd = p.fd;
+		sqe.off = p.offset + p.bytesRead;
+		sqe.addr = reinterpret_cast<uint64_t>(buffers[slot]->data_u8 + p.bytesRead);
+		sqe.len = uint32_t(remaining);
+		sqe.user_data = slot;
+
+		submitEntry(sqe);
+	}
+
+	void submitRead(shared_ptr<ReadOnlyFile> file, int slot, int64_t offset, int64_t size, int64_t tag){
+		Pending& p = pending[slot];
+		p.file = file;
+		p.fd = file->fd;
+		p.offset = offset;
+		p.size = size;
+		p.bytesRead = 0;
+		p.tag = tag;
+
+		if(isRingFailed){
+			p.bytesRead = p.fd == -1 ? 0 : file->readAt(buffers[slot]->data_u8, offset, size);
+			fail(slot);
+
+			return;
+		}
+
+		if(p.fd == -1){
+			// nothing to read. complete with 0 bytes through a no-op
+			io_uring_sqe sqe;
+			memset(&sqe, 0, sizeof(io_uring_sqe));
+			sqe.opcode = IORING_OP_NOP;
+			sqe.user_data = slot;
+			p.size = 0;
+
+			submitEntry(sqe);
+
+			return;
+		}
+
+		push(slot);
+	}
+
+	ChunkRead complete(int slot){
+		Pending& p = pending[slot];
+
+		numInFlight--;
+		p.file = nullptr;
+
+		ChunkRead read;
+		read.tag = p.tag;
+		read.size = p.bytesRead;
+		read.data = buffers[slot]->data_u8;
+		read.slot = slot;
+
+		return read;
+	}
+
+	ChunkRead waitCompletion(){
+
+		while(true){
+
+			if(failed.size() > 0){
+				int slot = failed.front();
+				failed.pop_front();
+
+				return complete(slot);
+			}
+
+			uint32_t head = *cqHead;
+			uint32_t tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+
+			if(head == tail){
+				if(!enter(0, 1, IORING_ENTER_GETEVENTS)){
+					abandonRing();
+				}
+
+				continue;
+			}
+
+			io_uring_cqe cqe = cqes[head & *cqMask];
+			__atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+
+			int slot = int(cqe.user_data);
+			Pending& p = pending[slot];
+
+			if(cqe.res == -EINTR || cqe.res == -EAGAIN){
+				// try again
+			}else if(cqe.res < 0){
+				GENERATE_ERROR_MESSAGE << "io_uring read failed with error " << -cqe.res << endl;
+				p.size = p.bytesRead;
+			}else if(cqe.res == 0){
+				// end of file
+				p.size = p.bytesRead;
+			}else{
+				p.bytesRead += cqe.res;
+			}
+
+			// short read, queue the rest
+			if(p.bytesRead < p.size){
+				push(slot);
+				continue;
+			}
+
+			return complete(slot);
+		}
+	}
+
+};
+
+#endif
+
+
+shared_ptr<ChunkReader> createChunkReader(int queueDepth, int numBuffers){
+
+	#if defined(CHUNK_READER_IO_URING)
+	{
+		auto reader = make_shared<IoUringChunkReader>(queueDepth, numBuffers);
+
+		if(reader->init()){
+			return reader;
+		}
+
+		GENERATE_WARN_MESSAGE << "io_uring is not available or can't read, falling back to preadv" << endl;
+	}
+	#endif
+
+	return make_shared<PreadChunkReader>(queueDepth, numBuffers);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+
+#include "unsuck.hpp"
+
+using namespace std;
+
+// a finished read. data points to the first requested byte,
+// the buffer stays valid until the read is passed to ChunkReader::release()
+struct ChunkRead{
+	int64_t tag = 0;
+	int64_t size = 0;
+	uint8_t* data = nullptr;
+	int slot = -1;
+};
+
+// asynchronous reads of file ranges into a fixed set of reusable, page-aligned buffers.
+// - submit() and wait() must be called from the same thread
+// - release() and close() may be called from any thread
+// - submit() blocks while all buffers are in use
+// - unbuffered reads are widened to DIRECT_IO_ALIGNMENT, wait() strips the extra head and tail
+struct ChunkReader{
+
+	struct Slot{
+		// bytes between the aligned read offset and the requested offset
+		int64_t head = 0;
+		int64_t requestedSize = 0;
+	};
+
+	string name = "";
+	int queueDepth = 0;
+	int numInFlight = 0;
+
+	vector<shared_ptr<Buffer>> buffers;
+	vector<Slot> slots;
+	vector<int> freeSlots;
+	mutex mtx_slots;
+	condition_variable cv_slots;
+
+	// open handles by path, until close(). reads in flight hold their own reference
+	map<string, shared_ptr<ReadOnlyFile>> files;
+	map<string, shared_ptr<ReadOnlyFile>> unbufferedFiles;
+	mutex mtx_files;
+
+	ChunkReader(int queueDepth, int numBuffers);
+	virtual ~ChunkReader(){}
+
+	void submit(string path, int64_t offset, int64_t size, int64_t tag, bool unbuffered = false);
+
+	// blocks until one of the submitted reads has finished
+	ChunkRead wait();
+
+	void release(ChunkRead& read);
+
+	// drops the cached handles of path, so that the next read opens the file again.
+	// the file is closed once the reads in flight have finished
+	void close(string path);
+
+	// backend specific. completions report the whole read, starting at the buffer
+	virtual void submitRead(shared_ptr<ReadOnlyFile> file, int slot, int64_t offset, int64_t size, int64_t tag) = 0;
+	virtual ChunkRead waitCompletion() = 0;
+
+	shared_ptr<ReadOnlyFile> getFile(string path, bool unbuffered);
+	int acquireSlot(int64_t size);
+};
+
+// io_uring if the platform and kernel support it, a thread based preadv reader otherwise
+shared_ptr<ChunkReader> createChunkReader(int queueDepth, int numBuffers);
@@ -0,0 +1,473 @@
+
+#include <fstream>
+#include <atomic>
+#include <thread>
+#include <filesystem>
+#include <algorithm>
+
+#include "las_catalog.h"
+#include "las_formats.h"
+#include "point_clouds_loader.h"
+#include "nlohmann/json.hpp"
+
+using nlohmann::json;
+namespace fs = std::filesystem;
+
+void LasCatalog::add(CatalogEntry entry){
+
+	auto it = index.find(entry.path);
+
+	if(it != index.end()){
+		entries[it->second] = entry;
+	}else{
+		index[entry.path] = entries.size();
+		entries.push_back(entry);
+	}
+}
+
+const CatalogEntry* LasCatalog::find(string path){
+
+	auto it = index.find(path);
+
+	if(it == index.end()){
+		return nullptr;
+	}
+
+	const CatalogEntry& entry = entries[it->second];
+
+	std::error_code ec;
+	int64_t fileSize = fs::file_size(path, ec);
+	int64_t lastWriteTime = fs::last_write_time(path, ec).time_since_epoch().count();
+
+	if(ec || fileSize != entry.fileSize || lastWriteTime != entry.lastWriteTime){
+		return nullptr;
+	}
+
+	return &entry;
+}
+
+int64_t LasCatalog::numPoints(){
+
+	int64_t sum = 0;
+
+	for(auto& entry : entries){
+		if(entry.isValid()){
+			sum += entry.numPoints;
+		}
+	}
+
+	return sum;
+}
+
+// LAS 1.0 - 1.2 headers end after the bounding box, 1.3 adds the waveform offset, 1.4 the EVLRs and 64-bit counts
+int min_header_size(int versionMinor){
+	if(versionMinor <= 2) return 227;
+	if(versionMinor == 3) return 235;
+
+	return 375;
+}
+
+CatalogEntry scan_las_header(string path){
+
+	CatalogEntry entry;
+	entry.path = path;
+
+	std::error_code ec;
+	entry.fileSize = fs::file_size(path, ec);
+	entry.lastWriteTime = fs::last_write_time(path, ec).time_since_epoch().count();
+
+	if(ec){
+		entry.error = "could not stat file: " + ec.message();
+
+		return entry;
+	}
+
+	ReadOnlyFile file(path);
+
+	if(!file.isOpen()){
+		entry.error = "could not open file";
+
+		return entry;
+	}
+
+	// zero-padded, so that fields of short headers read as 0
+	auto header = make_shared<Buffer>(375);
+	memset(header->data, 0, header->size);
+	int64_t headerBytes = file.readAt(header->data, 0, header->size);
+
+	if(headerBytes < 227){
+		entry.error = "file is smaller than a LAS header";
+
+		return entry;
+	}
+
+	if(memcmp(header->data, "LASF", 4) != 0){
+		entry.error = "missing LASF signature";
+
+		return entry;
+	}
+
+	entry.versionMajor = header->get<uint8_t>(24);
+	entry.versionMinor = header->get<uint8_t>(25);
+
+	if(entry.versionMajor != 1 || entry.versionMinor > 4){
+		entry.error = "unsupported LAS version " + to_string(entry.versionMajor) + "." + to_string(entry.versionMinor);
+
+		return entry;
+	}
+
+	entry.headerSize = header->get<uint16_t>(94);
+	entry.offsetToPointData = header->get<uint32_t>(96);
+	entry.numVLRs = header->get<uint32_t>(100);
+	entry.pointFormat = header->get<uint8_t>(104) & 0b0011'1111;
+	entry.isCompressed = (header->get<uint8_t>(104) & 0b1100'0000) != 0;
+	entry.bytesPerPoint = header->get<uint16_t>(105);
+
+	entry.scale = {header->get<double>(131), header->get<double>(139), header->get<double>(147)};
+	entry.offset = {header->get<double>(155), header->get<double>(163), header->get<double>(171)};
+	entry.max = {header->get<double>(179), header->get<double>(195), header->get<double>(211)};
+	entry.min = {header->get<double>(187), header->get<double>(203), header->get<double>(219)};
+
+	int64_t legacyNumPoints = header->get<uint32_t>(107);
+
+	if(entry.versionMinor < 4){
+		entry.numPoints = legacyNumPoints;
+	}else{
+		entry.numPoints = header->get<uint64_t>(247);
+		entry.numEVLRs = header->get<uint32_t>(243);
+	}
+
+	if(entry.headerSize < min_header_size(entry.versionMinor) || entry.headerSize > entry.fileSize){
+		entry.error = "invalid header size " + to_string(entry.headerSize)
+			+ " for LAS 1." + to_string(entry.versionMinor);
+
+		return entry;
+	}
+
+	if(entry.offsetToPointData < entry.headerSize || entry.offsetToPointData > entry.fileSize){
+		entry.error = "invalid offset to point data " + to_string(entry.offsetToPointData);
+
+		return entry;
+	}
+
+	if(!isSupportedLasFormat(entry.pointFormat, entry.bytesPerPoint)){
+		entry.error = "unsupported point format " + to_string(entry.pointFormat)
+			+ " with " + to_string(entry.bytesPerPoint) + " bytes per point";
+
+		return entry;
+	}
+
+	// 1.4 writers may keep the legacy count for compatibility, it must be 0 or match
+	if(entry.versionMinor == 4 && legacyNumPoints != 0 && legacyNumPoints != entry.numPoints){
+		entry.error = "legacy point count " + to_string(legacyNumPoints)
+			+ " doesn't match " + to_string(entry.numPoints);
+
+		return entry;
+	}
+
+	{ // VLRs, between header and point data
+		int64_t vlrOffset = entry.headerSize;
+
+		for(int64_t i = 0; i < entry.numVLRs; i++){
+
+			uint8_t vlrHeader[54];
+
+			if(vlrOffset + 54 > entry.offsetToPointData || file.readAt(vlrHeader, vlrOffset, 54) != 54){
+				entry.error = "VLR " + to_string(i) + " of " + to_string(entry.numVLRs) + " overlaps the point data";
+
+				return entry;
+			}
+
+			string userID = string((const char*)(vlrHeader + 2), strnlen((const char*)(vlrHeader + 2), 16));
+			int recordID = 0;
+			int64_t recordLength = 0;
+			memcpy(&recordID, vlrHeader + 18, 2);
+			memcpy(&recordLength, vlrHeader + 20, 2);
+
+			if(vlrOffset + 54 + recordLength > entry.offsetToPointData){
+				entry.error = "VLR " + to_string(i) + " of " + to_string(entry.numVLRs) + " overlaps the point data";
+
+				return entry;
+			}
+
+			bool isLaszipVLR = userID == "laszip encoded" && recordID == 22204;
+			if(isLaszipVLR && recordLength >= 16 && entry.isCompressed){
+				uint32_t chunkSize = 0;
+				file.readAt(&chunkSize, vlrOffset + 54 + 12, 4);
+
+				entry.lazChunkSize = chunkSize == 0xFFFFFFFF ? 0 : chunkSize;
+			}
+
+			vlrOffset += 54 + recordLength;
+		}
+	}
+
+	int64_t pointDataEnd = entry.offsetToPointData;
+
+	if(!entry.isCompressed){
+		pointDataEnd = entry.offsetToPointData + entry.numPoints * entry.bytesPerPoint;
+
+		if(pointDataEnd > entry.fileSize){
+			int64_t numAvailable = (entry.fileSize - entry.offsetToPointData) / entry.bytesPerPoint;
+
+			entry.error = "truncated, " + to_string(numAvailable) + " of " + to_string(entry.numPoints) + " points";
+
+			return entry;
+		}
+	}
+
+	if(entry.numEVLRs > 0){ // EVLRs, after the point data
+		int64_t evlrOffset = header->get<uint64_t>(235);
+
+		if(evlrOffset < pointDataEnd){
+			entry.error = "EVLRs start inside the point data";
+
+			return entry;
+		}
+
+		for(int64_t i = 0; i < entry.numEVLRs; i++){
+
+			uint8_t evlrHeader[60];
+
+			if(evlrOffset + 60 > entry.fileSize || file.readAt(evlrHeader, evlrOffset, 60) != 60){
+				entry.error = "EVLR " + to_string(i) + " of " + to_string(entry.numEVLRs) + " exceeds the file";
+
+				return entry;
+			}
+
+			uint64_t recordLength = 0;
+			memcpy(&recordLength, evlrHeader + 20, 8);
+
+			if(recordLength > uint64_t(entry.fileSize - evlrOffset - 60)){
+				entry.error = "EVLR " + to_string(i) + " of " + to_string(entry.numEVLRs) + " exceeds the file";
+
+				return entry;
+			}
+
+			evlrOffset += 60 + recordLength;
+		}
+	}
+
+	return entry;
+}
+
+shared_ptr<LasCatalog> build_catalog(vector<string> paths, shared_ptr<LasCatalog> previous){
+
+	double tStart = now();
+
+	vector<string> files;
+
+	for(string path : paths){
+		std::error_code ec;
+
+		if(fs::is_directory(path, ec)){
+			vector<string> directoryFiles;
+
+			for(auto& item : fs::recursive_directory_iterator(path, ec)){
+				string file = item.path().string();
+
+				if(item.is_regular_file() && (iEndsWith(file, ".las") || iEndsWith(file, ".laz"))){
+					directoryFiles.push_back(file);
+				}
+			}
+
+			// iteration order depends on the file system
+			std::sort(directoryFiles.begin(), directoryFiles.end());
+			files.insert(files.end(), directoryFiles.begin(), directoryFiles.end());
+		}else{
+			files.push_back(path);
+		}
+	}
+
+	vector<CatalogEntry> entries(files.size());
+	atomic<int64_t> nextFile = 0;
+	atomic<int64_t> numReused = 0;
+
+	// headers are small, scattered reads. more threads than cores keep more of them in flight
+	int numThreads = std::min(4 * int(getCpuData().numProcessors), 64);
+	vector<thread> threads;
+
+	for(int i = 0; i < numThreads; i++){
+		threads.emplace_back([&](){
+			while(true){
+				int64_t fileIndex = nextFile++;
+
+				if(fileIndex >= int64_t(files.size())){
+					break;
+				}
+
+				const CatalogEntry* known = previous ? previous->find(files[fileIndex]) : nullptr;
+
+				if(known){
+					entries[fileIndex] = *known;
+					numReused++;
+				}else{
+					entries[fileIndex] = scan_las_header(files[fileIndex]);
+				}
+			}
+		});
+	}
+
+	for(auto& t : threads){
+		t.join();
+	}
+
+	auto catalog = make_shared<LasCatalog>();
+	int64_t numInvalid = 0;
+
+	for(auto& entry : entries){
+		if(!entry.isValid()){
+			numInvalid++;
+		}
+
+		catalog->add(entry);
+	}
+
+	double duration = now() - tStart;
+
+	cout << "catalog: " << formatNumber(int64_t(files.size())) << " files (" << formatNumber(numReused.load()) << " unchanged, "
+		<< formatNumber(numInvalid) << " invalid), " << formatNumber(catalog->numPoints()) << " points, "
+		<< formatNumber(duration, 3) << "s, " << formatNumber(double(files.size()) / duration, 0) << " files/s" << endl;
+
+	return catalog;
+}
+
+json to_json(dvec3 value){
+	return json::array({value.x, value.y, value.z});
+}
+
+dvec3 to_dvec3(const json& value){
+	if(!value.is_array() || value.size() != 3){
+		return {0.0, 0.0, 0.0};
+	}
+
+	return {value[0].get<double>(), value[1].get<double>(), value[2].get<double>()};
+}
+
+void save_catalog(shared_ptr<LasCatalog> catalog, string path){
+
+	json jsFiles = json::array();
+
+	for(auto& entry : catalog->entries){
+		json jsEntry = {
+			{"path", entry.path},
+			{"fileSize", entry.fileSize},
+			{"lastWriteTime", entry.lastWriteTime},
+			{"version", to_string(entry.versionMajor) + "." + to_string(entry.versionMinor)},
+			{"headerSize", entry.headerSize},
+			{"offsetToPointData", entry.offsetToPointData},
+			{"pointFormat", entry.pointFormat},
+			{"compressed", entry.isCompressed},
+			{"bytesPerPoint", entry.bytesPerPoint},
+			{"numPoints", entry.numPoints},
+			{"numVLRs", entry.numVLRs},
+			{"numEVLRs", entry.numEVLRs},
+			{"lazChunkSize", entry.lazChunkSize},
+			{"scale", to_json(entry.scale)},
+			{"offset", to_json(entry.offset)},
+			{"min", to_json(entry.min)},
+			{"max", to_json(entry.max)},
+		};
+
+		if(!entry.isValid()){
+			jsEntry["error"] = entry.error;
+		}
+
+		jsFiles.push_back(jsEntry);
+	}
+
+	// one file per line, compact but still diffable
+	string text = "{\"version\":1,\"files\":[\n";
+	for(int64_t i = 0; i < jsFiles.size(); i++){
+		text += jsFiles[i].dump() + (i + 1 < jsFiles.size() ? ",\n" : "\n");
+	}
+	text += "]}\n";
+
+	writeFile(path, text);
+}
+
+shared_ptr<LasCatalog> load_catalog(string path){
+
+	if(!fs::exists(path)){
+		return nullptr;
+	}
+
+	json js = json::parse(readFile(path), nullptr, false);
+
+	if(js.is_discarded() || !js.is_object() || js.value("version", 0) != 1 || !js["files"].is_array()){
+		GENERATE_WARN_MESSAGE << "could not parse catalog " << path << endl;
+
+		return nullptr;
+	}
+
+	auto catalog = make_shared<LasCatalog>();
+
+	for(auto& jsEntry : js["files"]){
+		CatalogEntry entry;
+
+		string version = jsEntry.value("version", "0.0");
+
+		entry.path = jsEntry.value("path", "");
+		entry.fileSize = jsEntry.value("fileSize", int64_t(0));
+		entry.lastWriteTime = jsEntry.value("lastWriteTime", int64_t(0));
+		entry.versionMajor = version[0] - '0';
+		entry.versionMinor = version.size() > 2 ? version[2] - '0' : 0;
+		entry.headerSize = jsEntry.value("headerSize", 0);
+		entry.offsetToPointData = jsEntry.value("offsetToPointData", uint32_t(0));
+		entry.pointFormat = jsEntry.value("pointFormat", 0);
+		entry.isCompressed = jsEntry.value("compressed", false);
+		entry.bytesPerPoint = jsEntry.value("bytesPerPoint", uint32_t(0));
+		entry.numPoints = jsEntry.value("numPoints", int64_t(0));
+		entry.numVLRs = jsEntry.value("numVLRs", int64_t(0));
+		entry.numEVLRs = jsEntry.value("numEVLRs", int64_t(0));
+		entry.lazChunkSize = jsEntry.value("lazChunkSize", int64_t(0));
+		entry.scale = to_dvec3(jsEntry["scale"]);
+		entry.offset = to_dvec3(jsEntry["offset"]);
+		entry.min = to_dvec3(jsEntry["min"]);
+		entry.max = to_dvec3(jsEntry["max"]);
+		entry.error = jsEntry.value("error", "");
+
+		catalog->add(entry);
+	}
+
+	return catalog;
+}
+
+shared_ptr<PointCloud> point_cloud_from_catalog(const CatalogEntry& entry){
+
+	auto pc = make_shared<PointCloud>();
+	pc->path = entry.path;
+	pc->mappedFile = make_shared<MappedFile>(entry.path);
+	pc->isCompressed = entry.isCompressed;
+	pc->lazChunkSize = entry.lazChunkSize;
+	pc->numPoints = entry.numPoints;
+	pc->offsetToPointData = entry.offsetToPointData;
+	pc->pointFormat = entry.pointFormat;
+	pc->bytesPerPoint = entry.bytesPerPoint;
+	pc->scale = entry.scale;
+	pc->offset = entry.offset;
+	pc->boxMin = entry.min;
+	pc->boxMax = entry.max;
+
+	if(!pc->isCompressed){
+		pc->mappedFile->adviseSequential(pc->offsetToPointData, pc->numPoints * pc->bytesPerPoint);
+	}
+
+	return pc;
+}
+
+void update_catalog(string catalogPath, vector<string> paths){
+
+	auto previous = load_catalog(catalogPath);
+	auto catalog = build_catalog(paths, previous);
+
+	for(auto& entry : catalog->entries){
+		if(!entry.isValid()){
+			cout << "invalid: " << entry.path << ": " << entry.error << endl;
+		}
+	}
+
+	save_catalog(catalog, catalogPath);
+
+	cout << "saved " << catalogPath << endl;
+}
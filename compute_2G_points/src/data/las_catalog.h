@@ -0,0 +1,82 @@
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#include "glm/common.hpp"
+#include "unsuck.hpp"
+
+using namespace std;
+using glm::dvec3;
+
+struct PointCloud;
+
+// header info of a LAS/LAZ file, enough to add it to a PointCloudLoader without reading the header again
+struct CatalogEntry{
+	string path;
+	// an entry is stale if either changed since the scan
+	int64_t fileSize = 0;
+	int64_t lastWriteTime = 0;
+
+	int versionMajor = 0;
+	int versionMinor = 0;
+	int headerSize = 0;
+	uint32_t offsetToPointData = 0;
+	int pointFormat = 0;
+	bool isCompressed = false;
+	uint32_t bytesPerPoint = 0;
+	int64_t numPoints = 0;
+	int64_t numVLRs = 0;
+	int64_t numEVLRs = 0;
+	// points per LAZ chunk, 0 if chunks are variably sized or the file isn't compressed
+	int64_t lazChunkSize = 0;
+
+	dvec3 scale = {1.0, 1.0, 1.0};
+	dvec3 offset = {0.0, 0.0, 0.0};
+	dvec3 min = {0.0, 0.0, 0.0};
+	dvec3 max = {0.0, 0.0, 0.0};
+
+	// empty if the header is valid
+	string error;
+
+	bool isValid() const {
+		return error.empty();
+	}
+};
+
+struct LasCatalog{
+
+	vector<CatalogEntry> entries;
+
+	// by path
+	unordered_map<string, int64_t> index;
+
+	void add(CatalogEntry entry);
+
+	// null if the file isn't in the catalog, or if it changed since it was scanned
+	const CatalogEntry* find(string path);
+
+	int64_t numPoints();
+};
+
+// reads and validates the header, VLRs and EVLRs of a LAS 1.0 - 1.4 file
+CatalogEntry scan_las_header(string path);
+
+// scans files and directories (recursively, for .las and .laz files) in parallel.
+// unchanged files whose entries are in previous aren't read again
+shared_ptr<LasCatalog> build_catalog(vector<string> paths, shared_ptr<LasCatalog> previous = nullptr);
+
+// json, one object per file
+void save_catalog(shared_ptr<LasCatalog> catalog, string path);
+
+// null if the file doesn't exist or can't be parsed
+shared_ptr<LasCatalog> load_catalog(string path);
+
+// maps the file, with the header info of the entry
+shared_ptr<PointCloud> point_cloud_from_catalog(const CatalogEntry& entry);
+
+// rescans the changed files of the catalog at catalogPath (or creates it) and lists invalid files
+void update_catalog(string catalogPath, vector<string> paths);
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+// layout of the point data records of LAS 1.0 - 1.4, point formats 0 - 10.
+// files may append extra bytes to each record, so the stride is the header's bytesPerPoint, not recordSize
+struct LasRecordFormat{
+	int format;
+	// size without extra bytes
+	int recordSize;
+	int offsetIntensity;
+	// -1 if the format doesn't store colors
+	int offsetRGB;
+};
+
+constexpr int MAX_LAS_POINT_FORMAT = 10;
+
+constexpr LasRecordFormat LAS_RECORD_FORMATS[MAX_LAS_POINT_FORMAT + 1] = {
+	// legacy formats, LAS 1.0 - 1.3
+	{ 0, 20, 12, -1},
+	{ 1, 28, 12, -1},  // + gps time
+	{ 2, 26, 12, 20},  // + rgb
+	{ 3, 34, 12, 28},  // + gps time, rgb
+	{ 4, 57, 12, -1},  // + gps time, wave packets
+	{ 5, 63, 12, 28},  // + gps time, rgb, wave packets
+
+	// LAS 1.4 formats, with extended returns and classification
+	{ 6, 30, 12, -1},
+	{ 7, 36, 12, 30},  // + rgb
+	{ 8, 38, 12, 30},  // + rgb, nir
+	{ 9, 59, 12, -1},  // + wave packets
+	{10, 67, 12, 30},  // + rgb, nir, wave packets
+};
+
+inline bool isSupportedLasFormat(int format, int bytesPerPoint){
+	if(format < 0 || format > MAX_LAS_POINT_FORMAT){
+		return false;
+	}
+
+	return bytesPerPoint >= LAS_RECORD_FORMATS[format].recordSize;
+}
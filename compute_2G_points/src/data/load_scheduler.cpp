@@ -0,0 +1,36 @@
+
+#include "load_scheduler.h"
+
+bool ViewPriority::set(dmat4 view, dmat4 proj){
+
+	dmat4 viewProj = proj * view;
+
+	if(isSet && viewProj == this->viewProj){
+		return false;
+	}
+
+	this->isSet = true;
+	this->viewProj = viewProj;
+	this->position = dvec3(glm::inverse(view)[3]);
+	this->frustum.set(viewProj);
+
+	return true;
+}
+
+LoadPriority ViewPriority::priority(Box bounds, int64_t order){
+
+	LoadPriority priority;
+	priority.order = order;
+
+	if(!isSet){
+		return priority;
+	}
+
+	// distance to the closest point of the box, 0 if the camera is inside
+	dvec3 closest = glm::clamp(position, bounds.min, bounds.max);
+
+	priority.tier = frustum.intersectsBox(bounds) ? 0 : 1;
+	priority.distance = glm::length(position - closest);
+
+	return priority;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "glm/common.hpp"
+#include "glm/matrix.hpp"
+#include "unsuck.hpp"
+#include "Frustum.h"
+#include "Box.h"
+
+using namespace std;
+using glm::dmat4;
+using glm::dvec3;
+
+// chunks are loaded by
+// 1. whether their estimated bounds intersect the view frustum
+// 2. distance from the camera to their bounds
+// 3. their position in the files, so that chunks of equal priority (e.g. without a view) load front to back
+struct LoadPriority{
+	int tier = 0;
+	double distance = 0.0;
+	int64_t order = 0;
+
+	bool operator<(const LoadPriority& other) const {
+		if(tier != other.tier) return tier < other.tier;
+		if(distance != other.distance) return distance < other.distance;
+
+		return order < other.order;
+	}
+};
+
+struct ViewPriority{
+
+	bool isSet = false;
+	dmat4 viewProj;
+	dvec3 position;
+	Frustum frustum;
+
+	// returns false if the view didn't change
+	bool set(dmat4 view, dmat4 proj);
+
+	LoadPriority priority(Box bounds, int64_t order);
+};
+
+// queue of pending chunks, T needs "Box bounds", "int64_t order" and "LoadPriority priority".
+// setView() is cheap, queued chunks are re-prioritized by the next pop() after a view change.
+template<typename T>
+struct LoadScheduler{
+
+	vector<T> tasks;
+	ViewPriority view;
+	bool isOutdated = false;
+	// times that queued chunks were re-prioritized
+	int64_t numReprioritized = 0;
+
+	// min-heap on priority
+	static bool compare(const T& a, const T& b){
+		return b.priority < a.priority;
+	}
+
+	void setView(dmat4 view, dmat4 proj){
+		if(this->view.set(view, proj)){
+			isOutdated = true;
+		}
+	}
+
+	void push(T task){
+		task.priority = view.priority(task.bounds, task.order);
+
+		tasks.push_back(task);
+		push_heap(tasks.begin(), tasks.end(), compare);
+	}
+
+	T pop(){
+		if(isOutdated){
+			for(T& task : tasks){
+				task.priority = view.priority(task.bounds, task.order);
+			}
+			make_heap(tasks.begin(), tasks.end(), compare);
+
+			isOutdated = false;
+			numReprioritized++;
+		}
+
+		pop_heap(tasks.begin(), tasks.end(), compare);
+		T task = tasks.back();
+		tasks.pop_back();
+
+		return task;
+	}
+
+	int64_t size(){
+		return tasks.size();
+	}
+
+	// removes queued chunks for which predicate returns true
+	template<typename Predicate>
+	int64_t removeIf(Predicate predicate){
+		int64_t numBefore = tasks.size();
+
+		tasks.erase(std::remove_if(tasks.begin(), tasks.end(), predicate), tasks.end());
+		make_heap(tasks.begin(), tasks.end(), compare);
+
+		return numBefore - tasks.size();
+	}
+
+};
@@ -0,0 +1,484 @@
+
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+
+#include "obj_loader.h"
+
+// every power of ten up to 10^22 is exactly representable as a double
+constexpr double POWERS_OF_TEN[23] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+inline bool is_digit(char c){
+	return c >= '0' && c <= '9';
+}
+
+inline bool is_blank(char c){
+	return c == ' ' || c == '\t';
+}
+
+const char* parse_double(const char* pos, const char* end, double& value){
+
+	const char* start = pos;
+
+	bool isNegative = false;
+	if(pos < end && (*pos == '-' || *pos == '+')){
+		isNegative = *pos == '-';
+		pos++;
+	}
+
+	uint64_t mantissa = 0;
+	int numDigits = 0;
+	int exponent = 0;
+	bool hasDigits = false;
+	bool isTruncated = false;
+
+	// significant digits go into the mantissa, leading zeros don't count
+	for(; pos < end && is_digit(*pos); pos++){
+		hasDigits = true;
+		int digit = *pos - '0';
+
+		if(numDigits < 19){
+			mantissa = 10 * mantissa + digit;
+			numDigits += mantissa > 0 ? 1 : 0;
+		}else{
+			exponent++;
+			isTruncated = isTruncated || digit != 0;
+		}
+	}
+
+	if(pos < end && *pos == '.'){
+		pos++;
+
+		for(; pos < end && is_digit(*pos); pos++){
+			hasDigits = true;
+			int digit = *pos - '0';
+
+			if(numDigits < 19){
+				mantissa = 10 * mantissa + digit;
+				numDigits += mantissa > 0 ? 1 : 0;
+				exponent--;
+			}else{
+				isTruncated = isTruncated || digit != 0;
+			}
+		}
+	}
+
+	if(hasDigits && pos < end && (*pos == 'e' || *pos == 'E')){
+		const char* exponentPos = pos + 1;
+
+		bool isNegativeExponent = false;
+		if(exponentPos < end && (*exponentPos == '-' || *exponentPos == '+')){
+			isNegativeExponent = *exponentPos == '-';
+			exponentPos++;
+		}
+
+		// "1e" is 1, followed by an "e"
+		if(exponentPos < end && is_digit(*exponentPos)){
+			int explicitExponent = 0;
+
+			for(; exponentPos < end && is_digit(*exponentPos); exponentPos++){
+				explicitExponent = std::min(10 * explicitExponent + (*exponentPos - '0'), 100'000);
+			}
+
+			exponent += isNegativeExponent ? -explicitExponent : explicitExponent;
+			pos = exponentPos;
+		}
+	}
+
+	bool isFastPath = hasDigits && !isTruncated
+		&& mantissa <= (uint64_t(1) << 53)
+		&& exponent >= -22 && exponent <= 22;
+
+	if(isFastPath){
+		// both operands are exact, so the result is rounded once, like strtod does
+		double result = double(mantissa);
+		result = exponent < 0 ? result / POWERS_OF_TEN[-exponent] : result * POWERS_OF_TEN[exponent];
+
+		value = isNegative ? -result : result;
+
+		return pos;
+	}
+
+	// long mantissas, large exponents, inf and nan
+	char token[64];
+	int64_t tokenSize = std::min(int64_t(end - start), int64_t(sizeof(token) - 1));
+	memcpy(token, start, tokenSize);
+	token[tokenSize] = 0;
+
+	char* tokenEnd = nullptr;
+	value = strtod(token, &tokenEnd);
+
+	if(tokenEnd == token){
+		return nullptr;
+	}
+
+	return start + (tokenEnd - token);
+}
+
+// number of values on the line, up to maxValues. pos is after the "v"
+template<bool STRTOD>
+inline int parse_values(const char* pos, const char* lineEnd, double* values, int maxValues){
+
+	int numValues = 0;
+
+	while(numValues < maxValues){
+		while(pos < lineEnd && is_blank(*pos)){
+			pos++;
+		}
+
+		if(pos >= lineEnd || *pos == '#' || *pos == '\r'){
+			break;
+		}
+
+		const char* next = nullptr;
+
+		if constexpr (STRTOD){
+			// strtod needs a terminated string, lines end with a newline, or with the end of the file
+			char token[64];
+			const char* tokenEnd = pos;
+			while(tokenEnd < lineEnd && !is_blank(*tokenEnd) && *tokenEnd != '\r' && tokenEnd - pos < 63){
+				tokenEnd++;
+			}
+
+			memcpy(token, pos, tokenEnd - pos);
+			token[tokenEnd - pos] = 0;
+
+			char* parsedEnd = nullptr;
+			values[numValues] = strtod(token, &parsedEnd);
+			next = parsedEnd == token ? nullptr : pos + (parsedEnd - token);
+		}else{
+			next = parse_double(pos, lineEnd, values[numValues]);
+		}
+
+		if(next == nullptr){
+			break;
+		}
+
+		numValues++;
+		pos = next;
+	}
+
+	return numValues;
+}
+
+// "v" followed by a blank, after optional leading blanks
+inline const char* vertex_values(const char* line, const char* lineEnd){
+
+	while(line < lineEnd && is_blank(*line)){
+		line++;
+	}
+
+	if(lineEnd - line >= 2 && line[0] == 'v' && is_blank(line[1])){
+		return line + 2;
+	}
+
+	return nullptr;
+}
+
+inline const char* line_end(const char* pos, const char* end){
+	const char* newline = reinterpret_cast<const char*>(memchr(pos, '\n', end - pos));
+
+	return newline ? newline : end;
+}
+
+shared_ptr<ObjFile> index_obj(string path, int64_t pointsPerChunk, int numThreads){
+
+	auto obj = make_shared<ObjFile>();
+	obj->path = path;
+	obj->mappedFile = make_shared<MappedFile>(path);
+
+	auto mappedFile = obj->mappedFile;
+
+	if(mappedFile->data == nullptr){
+		return nullptr;
+	}
+
+	const char* data = reinterpret_cast<const char*>(mappedFile->data);
+	int64_t fileSize = mappedFile->size;
+
+	mappedFile->adviseSequential(0, fileSize);
+
+	// ranges start at the beginning of a line
+	constexpr int64_t RANGE_SIZE = 16 * 1024 * 1024;
+	vector<int64_t> rangeStarts = {0};
+
+	for(int64_t nominal = RANGE_SIZE; nominal < fileSize; nominal += RANGE_SIZE){
+		int64_t start = line_end(data + nominal, data + fileSize) - data + 1;
+
+		if(start > rangeStarts.back() && start < fileSize){
+			rangeStarts.push_back(start);
+		}
+	}
+	rangeStarts.push_back(fileSize);
+
+	int64_t numRanges = rangeStarts.size() - 1;
+
+	struct RangeResult{
+		vector<ObjChunk> chunks;
+		bool hasColors = false;
+		double maxColor = 0.0;
+	};
+
+	vector<RangeResult> results(numRanges);
+	atomic<int64_t> nextRange = 0;
+
+	auto scan = [&](){
+		while(true){
+			int64_t rangeIndex = nextRange++;
+
+			if(rangeIndex >= numRanges){
+				break;
+			}
+
+			RangeResult& result = results[rangeIndex];
+			const char* pos = data + rangeStarts[rangeIndex];
+			const char* end = data + rangeStarts[rangeIndex + 1];
+
+			ObjChunk chunk;
+			chunk.byteOffset = pos - data;
+
+			while(pos < end){
+				const char* lineEnd = line_end(pos, end);
+				const char* values = vertex_values(pos, lineEnd);
+
+				if(values){
+					if(chunk.numPoints == pointsPerChunk){
+						chunk.byteSize = (pos - data) - chunk.byteOffset;
+						result.chunks.push_back(chunk);
+
+						chunk = ObjChunk();
+						chunk.byteOffset = pos - data;
+					}
+
+					if(chunk.numPoints % 64 == 0){
+						double sample[7] = {};
+						int numValues = parse_values<false>(values, lineEnd, sample, 7);
+
+						bool isFinite = numValues >= 3
+							&& std::isfinite(sample[0]) && std::isfinite(sample[1]) && std::isfinite(sample[2]);
+
+						if(isFinite){
+							chunk.bounds.expand(dvec3(sample[0], sample[1], sample[2]));
+						}
+
+						if(numValues == 6 || numValues == 7){
+							result.hasColors = true;
+							result.maxColor = std::max({result.maxColor, sample[numValues - 3], sample[numValues - 2], sample[numValues - 1]});
+						}
+					}
+
+					chunk.numPoints++;
+				}
+
+				pos = lineEnd + 1;
+			}
+
+			if(chunk.numPoints > 0){
+				chunk.byteSize = (end - data) - chunk.byteOffset;
+				result.chunks.push_back(chunk);
+			}
+		}
+	};
+
+	vector<thread> threads;
+	for(int i = 0; i < numThreads; i++){
+		threads.emplace_back(scan);
+	}
+	for(auto& t : threads){
+		t.join();
+	}
+
+	double maxColor = 0.0;
+	for(auto& result : results){
+		for(auto& chunk : result.chunks){
+			chunk.firstPoint = obj->numPoints;
+			obj->numPoints += chunk.numPoints;
+			obj->bounds.expand(chunk.bounds);
+			obj->chunks.push_back(chunk);
+		}
+
+		obj->hasColors = obj->hasColors || result.hasColors;
+		maxColor = std::max(maxColor, result.maxColor);
+	}
+
+	obj->colorScale = maxColor > 1.0 ? 1.0 : 255.0;
+
+	if(obj->numPoints == 0){
+		obj->bounds.min = {0.0, 0.0, 0.0};
+		obj->bounds.max = {0.0, 0.0, 0.0};
+	}
+
+	return obj;
+}
+
+template<bool STRTOD>
+int64_t parse_obj_points(ObjFile& obj, int64_t firstPoint, int64_t numPoints, dvec3 origin,
+	double* x, double* y, double* z, uint32_t* colors)
+{
+	// first chunk that contains points of the range
+	auto it = std::upper_bound(obj.chunks.begin(), obj.chunks.end(), firstPoint, [](int64_t point, const ObjChunk& chunk){
+		return point < chunk.firstPoint;
+	});
+
+	if(it == obj.chunks.begin()){
+		return 0;
+	}
+	it--;
+
+	const char* data = reinterpret_cast<const char*>(obj.mappedFile->data);
+	int64_t numParsed = 0;
+
+	for(; it != obj.chunks.end() && numParsed < numPoints; it++){
+		const ObjChunk& chunk = *it;
+
+		obj.mappedFile->adviseWillNeed(chunk.byteOffset, chunk.byteSize);
+
+		const char* pos = data + chunk.byteOffset;
+		const char* end = pos + chunk.byteSize;
+		int64_t pointIndex = chunk.firstPoint;
+
+		while(pos < end && numParsed < numPoints){
+			const char* lineEnd = line_end(pos, end);
+			const char* values = vertex_values(pos, lineEnd);
+
+			if(values && pointIndex >= firstPoint){
+				double v[7] = {0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 1.0};
+				int numValues = parse_values<STRTOD>(values, lineEnd, v, 7);
+
+				// "inf" and "nan" can't be quantized, such vertices end up at the origin
+				if(!std::isfinite(v[0]) || !std::isfinite(v[1]) || !std::isfinite(v[2])){
+					v[0] = origin.x;
+					v[1] = origin.y;
+					v[2] = origin.z;
+				}
+
+				x[numParsed] = v[0] - origin.x;
+				y[numParsed] = v[1] - origin.y;
+				z[numParsed] = v[2] - origin.z;
+
+				// "v x y z r g b" or, with an explicit w, "v x y z w r g b"
+				uint32_t color = 0x00FFFFFF;
+				if(numValues == 6 || numValues == 7){
+					double* rgb = v + numValues - 3;
+
+					auto channel = [&obj](double value){
+						return uint32_t(std::clamp(value * obj.colorScale + 0.5, 0.0, 255.0));
+					};
+
+					color = channel(rgb[0]) | (channel(rgb[1]) << 8) | (channel(rgb[2]) << 16);
+				}
+				colors[numParsed] = color;
+
+				numParsed++;
+			}
+
+			if(values){
+				pointIndex++;
+			}
+
+			pos = lineEnd + 1;
+		}
+	}
+
+	return numParsed;
+}
+
+int64_t parse_obj_points(ObjFile& obj, int64_t firstPoint, int64_t numPoints, dvec3 origin,
+	double* x, double* y, double* z, uint32_t* colors, bool useStrtod)
+{
+	if(useStrtod){
+		return parse_obj_points<true>(obj, firstPoint, numPoints, origin, x, y, z, colors);
+	}else{
+		return parse_obj_points<false>(obj, firstPoint, numPoints, origin, x, y, z, colors);
+	}
+}
+
+void benchmark_obj(vector<string> files){
+
+	int numThreads = getCpuData().numProcessors;
+
+	for(string file : files){
+
+		double tIndex = now();
+		auto obj = index_obj(file, 1'000'000, numThreads);
+		double indexDuration = now() - tIndex;
+
+		if(!obj){
+			continue;
+		}
+
+		double MB = double(obj->mappedFile->size) / (1024.0 * 1024.0);
+
+		cout << file << ": " << formatNumber(obj->numPoints) << " vertices, " << formatNumber(MB, 1) << " MB, "
+			<< obj->chunks.size() << " chunks, " << (obj->hasColors ? "with" : "without") << " colors" << endl;
+		cout << "    index:  " << formatNumber(indexDuration, 3) << "s, " << formatNumber(MB / indexDuration, 1) << " MB/s" << endl;
+
+		// both parsers into separate buffers, so that they can be compared
+		struct Parsed{
+			vector<double> x, y, z;
+			vector<uint32_t> colors;
+		};
+
+		Parsed parsed[2];
+
+		for(int useStrtod : {0, 1}){
+			Parsed& target = parsed[useStrtod];
+			target.x.resize(obj->numPoints);
+			target.y.resize(obj->numPoints);
+			target.z.resize(obj->numPoints);
+			target.colors.resize(obj->numPoints);
+
+			atomic<int64_t> nextChunk = 0;
+			double tStart = now();
+
+			vector<thread> threads;
+			for(int i = 0; i < numThreads; i++){
+				threads.emplace_back([&](){
+					while(true){
+						int64_t chunkIndex = nextChunk++;
+
+						if(chunkIndex >= int64_t(obj->chunks.size())){
+							break;
+						}
+
+						const ObjChunk& chunk = obj->chunks[chunkIndex];
+						int64_t first = chunk.firstPoint;
+
+						parse_obj_points(*obj, first, chunk.numPoints, {0.0, 0.0, 0.0},
+							target.x.data() + first, target.y.data() + first, target.z.data() + first,
+							target.colors.data() + first, useStrtod == 1);
+					}
+				});
+			}
+			for(auto& t : threads){
+				t.join();
+			}
+
+			double duration = now() - tStart;
+
+			cout << "    " << (useStrtod ? "strtod" : "fast  ") << ": " << formatNumber(duration, 3) << "s, "
+				<< formatNumber(MB / duration, 1) << " MB/s, "
+				<< formatNumber(double(obj->numPoints) / duration / 1'000'000.0, 1) << " M vertices/s, "
+				<< numThreads << " threads" << endl;
+		}
+
+		int64_t numMismatches = 0;
+		for(int64_t i = 0; i < obj->numPoints; i++){
+			// bitwise, so that -0.0 and 0.0 differ
+			bool isSame = memcmp(&parsed[0].x[i], &parsed[1].x[i], sizeof(double)) == 0
+				&& memcmp(&parsed[0].y[i], &parsed[1].y[i], sizeof(double)) == 0
+				&& memcmp(&parsed[0].z[i], &parsed[1].z[i], sizeof(double)) == 0
+				&& parsed[0].colors[i] == parsed[1].colors[i];
+
+			numMismatches += isSame ? 0 : 1;
+		}
+
+		cout << "    vertices that differ between parsers: " << formatNumber(numMismatches) << endl;
+	}
+}
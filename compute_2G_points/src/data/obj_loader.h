@@ -0,0 +1,55 @@
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "glm/common.hpp"
+#include "unsuck.hpp"
+#include "Box.h"
+
+using namespace std;
+using glm::dvec3;
+
+// Wavefront OBJ files, as point clouds of their "v x y z [r g b]" lines. faces, normals and texture coordinates are ignored.
+//
+// text has no fixed record size, so a file is indexed once when it's added: it's split into line-aligned ranges
+// that are scanned in parallel for vertex lines. every chunk of the index covers up to pointsPerChunk vertices,
+// and is loaded like a chunk of a LAS file. bounds are estimated from every 64th vertex.
+
+struct ObjChunk{
+	int64_t byteOffset = 0;
+	int64_t byteSize = 0;
+	int64_t firstPoint = 0;
+	int64_t numPoints = 0;
+	// of the sampled vertices
+	Box bounds;
+};
+
+struct ObjFile{
+	string path;
+	shared_ptr<MappedFile> mappedFile = nullptr;
+	vector<ObjChunk> chunks;
+	int64_t numPoints = 0;
+	Box bounds;
+	bool hasColors = false;
+	// colors are written as 0 - 1 by most tools, but some write 0 - 255
+	double colorScale = 255.0;
+};
+
+// parses a decimal floating point number, like strtod but without locale and with the same, correctly rounded result.
+// numbers with up to 19 significant digits and exponents that fit a double exactly are converted without strtod.
+// returns the position after the number, or nullptr if there is none at pos
+const char* parse_double(const char* pos, const char* end, double& value);
+
+// null if the file can't be opened
+shared_ptr<ObjFile> index_obj(string path, int64_t pointsPerChunk, int numThreads);
+
+// parses numPoints vertices, starting at vertex firstPoint, into coordinates relative to origin and colors.
+// vertices without colors are white. returns the number of vertices that were parsed
+int64_t parse_obj_points(ObjFile& obj, int64_t firstPoint, int64_t numPoints, dvec3 origin,
+	double* x, double* y, double* z, uint32_t* colors, bool useStrtod = false);
+
+// indexes the files and parses them with parse_double() and with strtod on all cores, prints MB/s and checks that both agree
+void benchmark_obj(vector<string> files);
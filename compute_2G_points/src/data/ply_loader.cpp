@@ -0,0 +1,1066 @@
+
+#include <cstring>
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <type_traits>
+
+#include "ply_loader.h"
+#include "obj_loader.h"
+
+// names in the order of PlyType, with their aliases
+constexpr const char* PLY_TYPE_NAMES[8][2] = {
+	{"char", "int8"},
+	{"uchar", "uint8"},
+	{"short", "int16"},
+	{"ushort", "uint16"},
+	{"int", "int32"},
+	{"uint", "uint32"},
+	{"float", "float32"},
+	{"double", "float64"},
+};
+
+// property names of x, y, z, red, green, blue
+const vector<vector<string>> PLY_ATTRIBUTE_NAMES = {
+	{"x"},
+	{"y"},
+	{"z"},
+	{"red", "r", "diffuse_red"},
+	{"green", "g", "diffuse_green"},
+	{"blue", "b", "diffuse_blue"},
+};
+
+int64_t ply_type_size(PlyType type){
+	switch(type){
+		case PlyType::INT8:    return 1;
+		case PlyType::UINT8:   return 1;
+		case PlyType::INT16:   return 2;
+		case PlyType::UINT16:  return 2;
+		case PlyType::INT32:   return 4;
+		case PlyType::UINT32:  return 4;
+		case PlyType::FLOAT32: return 4;
+		case PlyType::FLOAT64: return 8;
+	}
+
+	return 0;
+}
+
+bool parse_ply_type(const string& name, PlyType& type){
+
+	for(int i = 0; i < 8; i++){
+		if(name == PLY_TYPE_NAMES[i][0] || name == PLY_TYPE_NAMES[i][1]){
+			type = PlyType(i);
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+template<typename T>
+inline T load_value(const uint8_t* source){
+	T value;
+	memcpy(&value, source, sizeof(T));
+
+	return value;
+}
+
+template<typename T>
+inline T load_value(const uint8_t* source, bool swap){
+
+	if(!swap){
+		return load_value<T>(source);
+	}
+
+	uint8_t bytes[sizeof(T)];
+	for(size_t i = 0; i < sizeof(T); i++){
+		bytes[i] = source[sizeof(T) - 1 - i];
+	}
+
+	return load_value<T>(bytes);
+}
+
+double read_ply_value(PlyType type, const uint8_t* source, bool swap){
+	switch(type){
+		case PlyType::INT8:    return load_value<int8_t>(source);
+		case PlyType::UINT8:   return load_value<uint8_t>(source);
+		case PlyType::INT16:   return load_value<int16_t>(source, swap);
+		case PlyType::UINT16:  return load_value<uint16_t>(source, swap);
+		case PlyType::INT32:   return load_value<int32_t>(source, swap);
+		case PlyType::UINT32:  return load_value<uint32_t>(source, swap);
+		case PlyType::FLOAT32: return load_value<float>(source, swap);
+		case PlyType::FLOAT64: return load_value<double>(source, swap);
+	}
+
+	return 0.0;
+}
+
+// 8-bit channel of a color value. 16-bit colors keep their high byte, float colors are 0 - 1
+inline uint32_t color_channel(PlyType type, double value){
+	switch(type){
+		case PlyType::UINT16:  return uint32_t(value) >> 8;
+		case PlyType::FLOAT32:
+		case PlyType::FLOAT64: return uint32_t(std::clamp(value * 255.0 + 0.5, 0.0, 255.0));
+		default:               return uint32_t(std::clamp(value, 0.0, 255.0));
+	}
+}
+
+// "inf" and "nan" can't be quantized, such vertices end up at the origin
+inline void write_position(double px, double py, double pz, dvec3 origin, double* x, double* y, double* z){
+
+	if(!std::isfinite(px) || !std::isfinite(py) || !std::isfinite(pz)){
+		px = origin.x;
+		py = origin.y;
+		pz = origin.z;
+	}
+
+	*x = px - origin.x;
+	*y = py - origin.y;
+	*z = pz - origin.z;
+}
+
+struct NoColors{};
+
+// little endian vertices whose x, y, z and colors each have the same type.
+// types are known at compile time, so each attribute is a single load at a fixed offset
+template<typename XYZ, typename COLOR>
+void decode_ply_records(const uint8_t* records, const PlyLayout& layout, int64_t numPoints, dvec3 origin,
+	double* x, double* y, double* z, uint32_t* colors)
+{
+	int64_t stride = layout.stride;
+	int64_t offsetX = layout.offsets[0];
+	int64_t offsetY = layout.offsets[1];
+	int64_t offsetZ = layout.offsets[2];
+	int64_t offsetR = layout.offsets[3];
+	int64_t offsetG = layout.offsets[4];
+	int64_t offsetB = layout.offsets[5];
+
+	for(int64_t i = 0; i < numPoints; i++){
+		const uint8_t* record = records + i * stride;
+
+		write_position(
+			double(load_value<XYZ>(record + offsetX)),
+			double(load_value<XYZ>(record + offsetY)),
+			double(load_value<XYZ>(record + offsetZ)),
+			origin, x + i, y + i, z + i);
+
+		if constexpr (std::is_same_v<COLOR, NoColors>){
+			colors[i] = 0x00FFFFFF;
+		}else{
+			constexpr int shift = std::is_same_v<COLOR, uint16_t> ? 8 : 0;
+
+			uint32_t r = uint32_t(load_value<COLOR>(record + offsetR)) >> shift;
+			uint32_t g = uint32_t(load_value<COLOR>(record + offsetG)) >> shift;
+			uint32_t b = uint32_t(load_value<COLOR>(record + offsetB)) >> shift;
+
+			colors[i] = r | (g << 8) | (b << 16);
+		}
+	}
+}
+
+// any types and byte order
+void decode_ply_records_generic(const uint8_t* records, const PlyLayout& layout, bool swap, int64_t numPoints, dvec3 origin,
+	double* x, double* y, double* z, uint32_t* colors)
+{
+	bool hasColors = layout.hasColors();
+
+	for(int64_t i = 0; i < numPoints; i++){
+		const uint8_t* record = records + i * layout.stride;
+
+		double values[6];
+		for(int attribute = 0; attribute < (hasColors ? 6 : 3); attribute++){
+			values[attribute] = read_ply_value(layout.types[attribute], record + layout.offsets[attribute], swap);
+		}
+
+		write_position(values[0], values[1], values[2], origin, x + i, y + i, z + i);
+
+		if(hasColors){
+			uint32_t r = color_channel(layout.types[3], values[3]);
+			uint32_t g = color_channel(layout.types[4], values[4]);
+			uint32_t b = color_channel(layout.types[5], values[5]);
+
+			colors[i] = r | (g << 8) | (b << 16);
+		}else{
+			colors[i] = 0x00FFFFFF;
+		}
+	}
+}
+
+typedef void (*DecodePlyKernel)(const uint8_t*, const PlyLayout&, int64_t, dvec3, double*, double*, double*, uint32_t*);
+
+template<typename XYZ>
+DecodePlyKernel select_ply_kernel(const PlyLayout& layout){
+
+	if(!layout.hasColors()){
+		return decode_ply_records<XYZ, NoColors>;
+	}
+
+	bool isUniform = layout.types[3] == layout.types[4] && layout.types[3] == layout.types[5];
+
+	if(isUniform && layout.types[3] == PlyType::UINT8){
+		return decode_ply_records<XYZ, uint8_t>;
+	}else if(isUniform && layout.types[3] == PlyType::UINT16){
+		return decode_ply_records<XYZ, uint16_t>;
+	}
+
+	return nullptr;
+}
+
+// the specialized decoder for the layout, or null if there is none
+DecodePlyKernel select_ply_kernel(const PlyFile& ply){
+
+	const PlyLayout& layout = ply.layout;
+
+	if(ply.format != PlyFormat::BINARY_LITTLE_ENDIAN){
+		return nullptr;
+	}
+
+	bool isUniform = layout.types[0] == layout.types[1] && layout.types[0] == layout.types[2];
+
+	if(isUniform && layout.types[0] == PlyType::FLOAT32){
+		return select_ply_kernel<float>(layout);
+	}else if(isUniform && layout.types[0] == PlyType::FLOAT64){
+		return select_ply_kernel<double>(layout);
+	}
+
+	return nullptr;
+}
+
+void decode_ply_binary(const PlyFile& ply, const uint8_t* records, int64_t numPoints, dvec3 origin,
+	double* x, double* y, double* z, uint32_t* colors, bool useGeneric)
+{
+	DecodePlyKernel kernel = useGeneric ? nullptr : select_ply_kernel(ply);
+
+	if(kernel){
+		kernel(records, ply.layout, numPoints, origin, x, y, z, colors);
+	}else{
+		bool swap = ply.format == PlyFormat::BINARY_BIG_ENDIAN;
+
+		decode_ply_records_generic(records, ply.layout, swap, numPoints, origin, x, y, z, colors);
+	}
+}
+
+inline const char* line_end(const char* pos, const char* end){
+	const char* newline = reinterpret_cast<const char*>(memchr(pos, '\n', end - pos));
+
+	return newline ? newline : end;
+}
+
+inline const char* skip_blanks(const char* pos, const char* end){
+	while(pos < end && (*pos == ' ' || *pos == '\t')){
+		pos++;
+	}
+
+	return pos;
+}
+
+inline const char* skip_token(const char* pos, const char* end){
+	while(pos < end && *pos != ' ' && *pos != '\t' && *pos != '\r'){
+		pos++;
+	}
+
+	return pos;
+}
+
+// values of x, y, z, red, green, blue in an ASCII vertex line. false if the line has too few values
+bool parse_ascii_vertex(const PlyFile& ply, const char* pos, const char* end, double values[6]){
+
+	const PlyElement& vertex = ply.elements[ply.vertexElement];
+	const PlyLayout& layout = ply.layout;
+	int numAttributes = layout.hasColors() ? 6 : 3;
+	int lastIndex = *std::max_element(layout.indices, layout.indices + numAttributes);
+
+	for(int propertyIndex = 0; propertyIndex <= lastIndex; propertyIndex++){
+		const PlyProperty& property = vertex.properties[propertyIndex];
+
+		pos = skip_blanks(pos, end);
+
+		if(property.isList){
+			double count = 0.0;
+			pos = parse_double(pos, end, count);
+
+			if(!pos){
+				return false;
+			}
+
+			for(int64_t i = 0; i < int64_t(count); i++){
+				pos = skip_token(skip_blanks(pos, end), end);
+			}
+
+			continue;
+		}
+
+		int attribute = -1;
+		for(int i = 0; i < numAttributes; i++){
+			attribute = layout.indices[i] == propertyIndex ? i : attribute;
+		}
+
+		if(attribute < 0){
+			pos = skip_token(pos, end);
+
+			continue;
+		}
+
+		pos = parse_double(pos, end, values[attribute]);
+
+		if(!pos){
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// byte size of count binary records of element, starting at offset. lists make records variable-sized,
+// they're walked record by record. -1 if the file ends before them
+int64_t binary_element_size(const PlyFile& ply, const PlyElement& element, int64_t offset){
+
+	const uint8_t* data = ply.mappedFile->data;
+	int64_t fileSize = ply.mappedFile->size;
+	bool swap = ply.format == PlyFormat::BINARY_BIG_ENDIAN;
+
+	bool hasLists = std::any_of(element.properties.begin(), element.properties.end(), [](const PlyProperty& property){
+		return property.isList;
+	});
+
+	if(!hasLists){
+		int64_t stride = 0;
+		for(auto& property : element.properties){
+			stride += ply_type_size(property.type);
+		}
+
+		return offset + element.count * stride <= fileSize ? element.count * stride : -1;
+	}
+
+	int64_t pos = offset;
+	for(int64_t i = 0; i < element.count; i++){
+		for(auto& property : element.properties){
+			if(property.isList){
+				int64_t countSize = ply_type_size(property.countType);
+
+				if(pos + countSize > fileSize){
+					return -1;
+				}
+
+				int64_t count = int64_t(read_ply_value(property.countType, data + pos, swap));
+				pos += countSize + std::max(count, int64_t(0)) * ply_type_size(property.type);
+			}else{
+				pos += ply_type_size(property.type);
+			}
+		}
+
+		if(pos > fileSize){
+			return -1;
+		}
+	}
+
+	return pos - offset;
+}
+
+shared_ptr<PlyFile> read_ply(string path, int64_t pointsPerChunk){
+
+	auto ply = make_shared<PlyFile>();
+	ply->path = path;
+	ply->mappedFile = make_shared<MappedFile>(path);
+
+	auto mappedFile = ply->mappedFile;
+
+	if(mappedFile->data == nullptr){
+		return nullptr;
+	}
+
+	const char* data = reinterpret_cast<const char*>(mappedFile->data);
+	int64_t fileSize = mappedFile->size;
+
+	auto invalid = [&path](string error) -> shared_ptr<PlyFile> {
+		GENERATE_WARN_MESSAGE << "invalid PLY file (" << error << "): " << path << endl;
+
+		return nullptr;
+	};
+
+	if(fileSize < 4 || memcmp(data, "ply", 3) != 0){
+		return invalid("no ply signature");
+	}
+
+	// HEADER
+	int64_t headerSize = 0;
+	bool hasFormat = false;
+
+	for(const char* pos = data; pos < data + fileSize && headerSize == 0; ){
+		const char* lineEnd = line_end(pos, data + fileSize);
+		const char* contentEnd = lineEnd > pos && lineEnd[-1] == '\r' ? lineEnd - 1 : lineEnd;
+
+		stringstream line(string(pos, contentEnd));
+		string keyword;
+		line >> keyword;
+
+		if(keyword == "format"){
+			string format;
+			line >> format;
+
+			if(format == "ascii"){
+				ply->format = PlyFormat::ASCII;
+			}else if(format == "binary_little_endian"){
+				ply->format = PlyFormat::BINARY_LITTLE_ENDIAN;
+			}else if(format == "binary_big_endian"){
+				ply->format = PlyFormat::BINARY_BIG_ENDIAN;
+			}else{
+				return invalid("unknown format " + format);
+			}
+
+			hasFormat = true;
+		}else if(keyword == "element"){
+			PlyElement element;
+			line >> element.name >> element.count;
+
+			if(line.fail() || element.count < 0){
+				return invalid("bad element declaration");
+			}
+
+			ply->elements.push_back(element);
+		}else if(keyword == "property"){
+			PlyProperty property;
+			string type;
+			line >> type;
+
+			bool isValid = false;
+			if(type == "list"){
+				string countType;
+				line >> countType >> type >> property.name;
+
+				property.isList = true;
+				isValid = parse_ply_type(countType, property.countType) && parse_ply_type(type, property.type);
+			}else{
+				line >> property.name;
+
+				isValid = parse_ply_type(type, property.type);
+			}
+
+			if(ply->elements.empty() || line.fail() || !isValid){
+				return invalid("bad property declaration");
+			}
+
+			ply->elements.back().properties.push_back(property);
+		}else if(keyword == "end_header"){
+			headerSize = lineEnd + 1 - data;
+		}
+
+		pos = lineEnd + 1;
+	}
+
+	if(headerSize == 0 || !hasFormat){
+		return invalid("incomplete header");
+	}
+
+	// LAYOUT
+	for(int i = 0; i < int(ply->elements.size()); i++){
+		if(ply->elements[i].name == "vertex"){
+			ply->vertexElement = i;
+
+			break;
+		}
+	}
+
+	if(ply->vertexElement < 0){
+		return invalid("no vertex element");
+	}
+
+	PlyElement& vertex = ply->elements[ply->vertexElement];
+	PlyLayout& layout = ply->layout;
+	bool hasVertexLists = false;
+
+	for(int propertyIndex = 0; propertyIndex < int(vertex.properties.size()); propertyIndex++){
+		PlyProperty& property = vertex.properties[propertyIndex];
+
+		for(int attribute = 0; attribute < 6; attribute++){
+			auto& names = PLY_ATTRIBUTE_NAMES[attribute];
+			bool isAttribute = std::find(names.begin(), names.end(), property.name) != names.end();
+
+			if(isAttribute && !property.isList && layout.indices[attribute] < 0){
+				layout.indices[attribute] = propertyIndex;
+				layout.offsets[attribute] = layout.stride;
+				layout.types[attribute] = property.type;
+			}
+		}
+
+		hasVertexLists = hasVertexLists || property.isList;
+		layout.stride += ply_type_size(property.type);
+	}
+
+	if(layout.indices[0] < 0 || layout.indices[1] < 0 || layout.indices[2] < 0){
+		return invalid("vertices without x, y, z");
+	}
+
+	if(ply->format != PlyFormat::ASCII && hasVertexLists){
+		return invalid("binary vertices with list properties");
+	}
+
+	// CHUNKS
+	int64_t vertexCount = vertex.count;
+
+	if(ply->format != PlyFormat::ASCII){
+
+		ply->vertexOffset = headerSize;
+		for(int i = 0; i < ply->vertexElement; i++){
+			int64_t size = binary_element_size(*ply, ply->elements[i], ply->vertexOffset);
+
+			if(size < 0){
+				return invalid("truncated before the vertices");
+			}
+
+			ply->vertexOffset += size;
+		}
+
+		ply->numPoints = std::min(vertexCount, (fileSize - ply->vertexOffset) / layout.stride);
+
+		// bounds of a few vertices spread over each chunk, like estimate_chunk_bounds()
+		bool swap = ply->format == PlyFormat::BINARY_BIG_ENDIAN;
+
+		for(int64_t firstPoint = 0; firstPoint < ply->numPoints; firstPoint += pointsPerChunk){
+			PlyChunk chunk;
+			chunk.firstPoint = firstPoint;
+			chunk.numPoints = std::min(pointsPerChunk, ply->numPoints - firstPoint);
+			chunk.byteOffset = ply->vertexOffset + firstPoint * layout.stride;
+			chunk.byteSize = chunk.numPoints * layout.stride;
+
+			int64_t numSamples = std::min(chunk.numPoints, int64_t(64));
+			for(int64_t i = 0; i < numSamples; i++){
+				int64_t pointIndex = (i * chunk.numPoints) / numSamples;
+				const uint8_t* record = mappedFile->data + chunk.byteOffset + pointIndex * layout.stride;
+
+				dvec3 position = {
+					read_ply_value(layout.types[0], record + layout.offsets[0], swap),
+					read_ply_value(layout.types[1], record + layout.offsets[1], swap),
+					read_ply_value(layout.types[2], record + layout.offsets[2], swap),
+				};
+
+				if(std::isfinite(position.x) && std::isfinite(position.y) && std::isfinite(position.z)){
+					chunk.bounds.expand(position);
+				}
+			}
+
+			ply->bounds.expand(chunk.bounds);
+			ply->chunks.push_back(chunk);
+		}
+	}else{
+		const char* end = data + fileSize;
+		const char* pos = data + headerSize;
+
+		// every record of an ASCII element is a line
+		for(int i = 0; i < ply->vertexElement; i++){
+			for(int64_t j = 0; j < ply->elements[i].count && pos < end; j++){
+				pos = line_end(pos, end) + 1;
+			}
+		}
+
+		ply->vertexOffset = std::min(pos, end) - data;
+		mappedFile->adviseSequential(ply->vertexOffset, fileSize - ply->vertexOffset);
+
+		PlyChunk chunk;
+		chunk.byteOffset = ply->vertexOffset;
+
+		for(int64_t pointIndex = 0; pointIndex < vertexCount && pos < end; pointIndex++){
+			const char* lineEnd = line_end(pos, end);
+
+			if(chunk.numPoints == pointsPerChunk){
+				chunk.byteSize = (pos - data) - chunk.byteOffset;
+				ply->bounds.expand(chunk.bounds);
+				ply->chunks.push_back(chunk);
+
+				chunk = PlyChunk();
+				chunk.byteOffset = pos - data;
+				chunk.firstPoint = pointIndex;
+			}
+
+			if(chunk.numPoints % 64 == 0){
+				double values[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+				bool isParsed = parse_ascii_vertex(*ply, pos, lineEnd, values);
+				bool isFinite = std::isfinite(values[0]) && std::isfinite(values[1]) && std::isfinite(values[2]);
+
+				if(isParsed && isFinite){
+					chunk.bounds.expand(dvec3(values[0], values[1], values[2]));
+				}
+			}
+
+			chunk.numPoints++;
+			ply->numPoints++;
+			pos = lineEnd + 1;
+		}
+
+		if(chunk.numPoints > 0){
+			chunk.byteSize = std::min(pos, end) - data - chunk.byteOffset;
+			ply->bounds.expand(chunk.bounds);
+			ply->chunks.push_back(chunk);
+		}
+	}
+
+	if(ply->numPoints < vertexCount){
+		GENERATE_WARN_MESSAGE << "truncated PLY file, " << ply->numPoints << " of " << vertexCount << " vertices: " << path << endl;
+	}
+
+	if(ply->numPoints == 0){
+		return invalid("no vertices");
+	}
+
+	if(ply->bounds.min.x > ply->bounds.max.x){
+		ply->bounds.min = {0.0, 0.0, 0.0};
+		ply->bounds.max = {0.0, 0.0, 0.0};
+	}
+
+	return ply;
+}
+
+int64_t parse_ply_ascii(const PlyFile& ply, int64_t firstPoint, int64_t numPoints, dvec3 origin,
+	double* x, double* y, double* z, uint32_t* colors)
+{
+	// first chunk that contains points of the range
+	auto it = std::upper_bound(ply.chunks.begin(), ply.chunks.end(), firstPoint, [](int64_t point, const PlyChunk& chunk){
+		return point < chunk.firstPoint;
+	});
+
+	if(it == ply.chunks.begin()){
+		return 0;
+	}
+	it--;
+
+	const char* data = reinterpret_cast<const char*>(ply.mappedFile->data);
+	const PlyLayout& layout = ply.layout;
+	bool hasColors = layout.hasColors();
+	int64_t numParsed = 0;
+
+	for(; it != ply.chunks.end() && numParsed < numPoints; it++){
+		const PlyChunk& chunk = *it;
+
+		ply.mappedFile->adviseWillNeed(chunk.byteOffset, chunk.byteSize);
+
+		const char* pos = data + chunk.byteOffset;
+		const char* end = pos + chunk.byteSize;
+		int64_t pointIndex = chunk.firstPoint;
+
+		while(pos < end && numParsed < numPoints){
+			const char* lineEnd = line_end(pos, end);
+
+			if(pointIndex >= firstPoint){
+				double values[6] = {0.0, 0.0, 0.0, 255.0, 255.0, 255.0};
+				parse_ascii_vertex(ply, pos, lineEnd, values);
+
+				write_position(values[0], values[1], values[2], origin, x + numParsed, y + numParsed, z + numParsed);
+
+				if(hasColors){
+					uint32_t r = color_channel(layout.types[3], values[3]);
+					uint32_t g = color_channel(layout.types[4], values[4]);
+					uint32_t b = color_channel(layout.types[5], values[5]);
+
+					colors[numParsed] = r | (g << 8) | (b << 16);
+				}else{
+					colors[numParsed] = 0x00FFFFFF;
+				}
+
+				numParsed++;
+			}
+
+			pointIndex++;
+			pos = lineEnd + 1;
+		}
+	}
+
+	return numParsed;
+}
+
+void benchmark_ply(vector<string> files){
+
+	int numThreads = getCpuData().numProcessors;
+	const char* formatNames[] = {"ascii", "binary_little_endian", "binary_big_endian"};
+	const char* attributeNames[] = {"x", "y", "z", "red", "green", "blue"};
+
+	for(string file : files){
+
+		double tIndex = now();
+		auto ply = read_ply(file, 1'000'000);
+		double indexDuration = now() - tIndex;
+
+		if(!ply){
+			continue;
+		}
+
+		const PlyElement& vertex = ply->elements[ply->vertexElement];
+		const PlyLayout& layout = ply->layout;
+		bool isAscii = ply->format == PlyFormat::ASCII;
+		double MB = 0.0;
+
+		for(auto& chunk : ply->chunks){
+			MB += double(chunk.byteSize) / (1024.0 * 1024.0);
+		}
+
+		cout << file << ": " << formatNumber(ply->numPoints) << " vertices, " << formatNumber(MB, 1) << " MB, "
+			<< formatNames[int(ply->format)] << ", " << ply->chunks.size() << " chunks" << endl;
+
+		cout << "    properties:";
+		for(auto& property : vertex.properties){
+			cout << " " << PLY_TYPE_NAMES[int(property.type)][0] << (property.isList ? "[] " : " ") << property.name;
+		}
+		cout << endl;
+
+		cout << "    layout:";
+		for(int attribute = 0; attribute < (layout.hasColors() ? 6 : 3); attribute++){
+			cout << " " << attributeNames[attribute] << "@" << layout.offsets[attribute];
+		}
+		cout << ", stride " << layout.stride << ", " << (isAscii ? "parsed" : select_ply_kernel(*ply) ? "specialized decoder" : "generic decoder") << endl;
+		cout << "    header: " << formatNumber(indexDuration, 3) << "s" << endl;
+
+		struct Decoded{
+			vector<double> x, y, z;
+			vector<uint32_t> colors;
+		};
+
+		Decoded decoded[2];
+
+		for(int useGeneric : {0, 1}){
+
+			if(isAscii && useGeneric){
+				break;
+			}
+
+			Decoded& target = decoded[useGeneric];
+			target.x.resize(ply->numPoints);
+			target.y.resize(ply->numPoints);
+			target.z.resize(ply->numPoints);
+			target.colors.resize(ply->numPoints);
+
+			atomic<int64_t> nextChunk = 0;
+			double tStart = now();
+
+			vector<thread> threads;
+			for(int i = 0; i < numThreads; i++){
+				threads.emplace_back([&](){
+					while(true){
+						int64_t chunkIndex = nextChunk++;
+
+						if(chunkIndex >= int64_t(ply->chunks.size())){
+							break;
+						}
+
+						const PlyChunk& chunk = ply->chunks[chunkIndex];
+						int64_t first = chunk.firstPoint;
+
+						if(isAscii){
+							parse_ply_ascii(*ply, first, chunk.numPoints, {0.0, 0.0, 0.0},
+								target.x.data() + first, target.y.data() + first, target.z.data() + first,
+								target.colors.data() + first);
+						}else{
+							decode_ply_binary(*ply, ply->mappedFile->data + chunk.byteOffset, chunk.numPoints, {0.0, 0.0, 0.0},
+								target.x.data() + first, target.y.data() + first, target.z.data() + first,
+								target.colors.data() + first, useGeneric == 1);
+						}
+					}
+				});
+			}
+			for(auto& t : threads){
+				t.join();
+			}
+
+			double duration = now() - tStart;
+
+			cout << "    " << (isAscii ? "parse  " : useGeneric ? "generic" : "layout ") << ": " << formatNumber(duration, 3) << "s, "
+				<< formatNumber(MB / duration, 1) << " MB/s, "
+				<< formatNumber(double(ply->numPoints) / duration / 1'000'000.0, 1) << " M vertices/s, "
+				<< numThreads << " threads" << endl;
+		}
+
+		if(isAscii){
+			continue;
+		}
+
+		int64_t numMismatches = 0;
+		for(int64_t i = 0; i < ply->numPoints; i++){
+			// bitwise, so that -0.0 and 0.0 differ
+			bool isSame = memcmp(&decoded[0].x[i], &decoded[1].x[i], sizeof(double)) == 0
+				&& memcmp(&decoded[0].y[i], &decoded[1].y[i], sizeof(double)) == 0
+				&& memcmp(&decoded[0].z[i], &decoded[1].z[i], sizeof(double)) == 0
+				&& decoded[0].colors[i] == decoded[1].colors[i];
+
+			numMismatches += isSame ? 0 : 1;
+		}
+
+		cout << "    vertices that differ between decoders: " << formatNumber(numMismatches) << endl;
+	}
+}
+
+// writes value as type, in the byte order of the format
+void write_ply_value(vector<uint8_t>& target, PlyType type, double value, bool swap){
+
+	uint8_t bytes[8];
+	int64_t size = ply_type_size(type);
+
+	switch(type){
+		case PlyType::INT8:    { int8_t v = int8_t(value);     memcpy(bytes, &v, size); } break;
+		case PlyType::UINT8:   { uint8_t v = uint8_t(value);   memcpy(bytes, &v, size); } break;
+		case PlyType::INT16:   { int16_t v = int16_t(value);   memcpy(bytes, &v, size); } break;
+		case PlyType::UINT16:  { uint16_t v = uint16_t(value); memcpy(bytes, &v, size); } break;
+		case PlyType::INT32:   { int32_t v = int32_t(value);   memcpy(bytes, &v, size); } break;
+		case PlyType::UINT32:  { uint32_t v = uint32_t(value); memcpy(bytes, &v, size); } break;
+		case PlyType::FLOAT32: { float v = float(value);       memcpy(bytes, &v, size); } break;
+		case PlyType::FLOAT64: { double v = value;             memcpy(bytes, &v, size); } break;
+	}
+
+	if(swap){
+		std::reverse(bytes, bytes + size);
+	}
+
+	target.insert(target.end(), bytes, bytes + size);
+}
+
+bool check_ply(){
+
+	struct Layout{
+		string name;
+		// type and name of each vertex property
+		vector<pair<string, string>> properties;
+		// an element before the vertices, that has to be skipped
+		bool hasLeadingElement = false;
+	};
+
+	vector<Layout> layouts = {
+		{"xyz float", {{"float", "x"}, {"float", "y"}, {"float", "z"}}},
+		{"xyz float, rgb uchar", {{"float", "x"}, {"float", "y"}, {"float", "z"}, {"uchar", "red"}, {"uchar", "green"}, {"uchar", "blue"}}},
+		{"xyz float, normals, rgba uchar", {{"float", "x"}, {"float", "y"}, {"float", "z"}, {"float", "nx"}, {"float", "ny"}, {"float", "nz"},
+			{"uchar", "red"}, {"uchar", "green"}, {"uchar", "blue"}, {"uchar", "alpha"}}},
+		{"normals first, xyz double, rgb ushort", {{"float", "nx"}, {"float", "ny"}, {"float", "nz"}, {"double", "x"}, {"double", "y"}, {"double", "z"},
+			{"ushort", "red"}, {"ushort", "green"}, {"ushort", "blue"}}},
+		{"interleaved xyz float, rgb uchar", {{"uchar", "red"}, {"float", "x"}, {"uchar", "green"}, {"float", "y"}, {"uchar", "blue"}, {"float", "z"}}},
+		{"xyz float, rgb float, intensity", {{"float", "x"}, {"float", "y"}, {"float", "z"}, {"float", "intensity"},
+			{"float", "diffuse_red"}, {"float", "diffuse_green"}, {"float", "diffuse_blue"}}},
+		{"xyz int32, rgb uchar aliases, leading element", {{"int", "x"}, {"int", "y"}, {"int", "z"}, {"uint8", "r"}, {"uint8", "g"}, {"uint8", "b"}}, true},
+	};
+
+	const char* formatNames[] = {"ascii", "binary_little_endian", "binary_big_endian"};
+	int64_t numVertices = 100;
+	// several chunks, the last one partially filled
+	int64_t pointsPerChunk = 7;
+	string path = (fs::temp_directory_path() / "check_ply.ply").string();
+	bool allPassed = true;
+
+	cout << "check ply: " << numVertices << " vertices per layout and format, " << pointsPerChunk << " per chunk" << endl;
+
+	for(int layoutIndex = 0; layoutIndex < int(layouts.size()); layoutIndex++){
+	for(PlyFormat format : {PlyFormat::ASCII, PlyFormat::BINARY_LITTLE_ENDIAN, PlyFormat::BINARY_BIG_ENDIAN}){
+
+		const Layout& layout = layouts[layoutIndex];
+		bool isAscii = format == PlyFormat::ASCII;
+		bool swap = format == PlyFormat::BINARY_BIG_ENDIAN;
+		mt19937 rng(10 * layoutIndex + int(format));
+
+		// HEADER
+		stringstream header;
+		header << "ply\n";
+		header << "format " << formatNames[int(format)] << " 1.0\n";
+		header << "comment synthetic vertices of check_ply()\n";
+		if(layout.hasLeadingElement){
+			header << "element camera 2\n";
+			header << "property float view_px\n";
+			header << "property float view_py\n";
+		}
+		header << "element vertex " << numVertices << "\n";
+		for(auto& [type, name] : layout.properties){
+			header << "property " << type << " " << name << "\n";
+		}
+		header << "element face 1\n";
+		header << "property list uchar int vertex_indices\n";
+		header << "end_header\n";
+
+		string headerString = header.str();
+		vector<uint8_t> body;
+		stringstream ascii;
+		ascii << std::setprecision(17);
+
+		auto write = [&](PlyType type, double value){
+			if(isAscii){
+				ascii << value;
+			}else{
+				write_ply_value(body, type, value, swap);
+			}
+		};
+
+		if(layout.hasLeadingElement){
+			for(int i = 0; i < 2; i++){
+				write(PlyType::FLOAT32, 1.5);
+				if(isAscii) ascii << " ";
+				write(PlyType::FLOAT32, -2.5);
+				if(isAscii) ascii << "\n";
+			}
+		}
+
+		// BODY
+		vector<dvec3> expectedPositions;
+		vector<uint32_t> expectedColors;
+
+		for(int64_t i = 0; i < numVertices; i++){
+			dvec3 position;
+			uint32_t channels[3] = {255, 255, 255};
+			bool hasColors = false;
+
+			for(int propertyIndex = 0; propertyIndex < int(layout.properties.size()); propertyIndex++){
+				auto& [typeName, name] = layout.properties[propertyIndex];
+
+				PlyType type;
+				parse_ply_type(typeName, type);
+				bool isFloat = type == PlyType::FLOAT32 || type == PlyType::FLOAT64;
+
+				int attribute = -1;
+				for(int j = 0; j < 6; j++){
+					auto& names = PLY_ATTRIBUTE_NAMES[j];
+					attribute = std::find(names.begin(), names.end(), name) != names.end() ? j : attribute;
+				}
+
+				double value = 0.0;
+
+				if(attribute >= 0 && attribute < 3){
+					// exactly representable as float, negative too
+					value = isFloat ? double(int(rng() % 8000) - 4000) * 0.25 : double(int(rng() % 200'000) - 100'000);
+					position[attribute] = value;
+				}else if(attribute >= 3){
+					uint32_t channel = rng() % 256;
+					channels[attribute - 3] = channel;
+					hasColors = true;
+
+					if(type == PlyType::UINT16){
+						value = double(channel * 256 + rng() % 256);
+					}else if(isFloat){
+						value = double(float(channel / 255.0));
+					}else{
+						value = double(channel);
+					}
+				}else{
+					value = isFloat ? double(float(double(rng() % 1000) / 1000.0)) : double(rng() % 100);
+				}
+
+				if(isAscii && propertyIndex > 0){
+					ascii << " ";
+				}
+
+				write(type, value);
+			}
+
+			if(isAscii){
+				ascii << (i % 2 == 0 ? "\n" : "\r\n");
+			}
+
+			expectedPositions.push_back(position);
+			expectedColors.push_back(hasColors ? channels[0] | (channels[1] << 8) | (channels[2] << 16) : 0x00FFFFFF);
+		}
+
+		// a face after the vertices, that doesn't count
+		if(isAscii){
+			ascii << "3 0 1 2\n";
+		}else{
+			write_ply_value(body, PlyType::UINT8, 3, swap);
+			for(int index : {0, 1, 2}){
+				write_ply_value(body, PlyType::INT32, index, swap);
+			}
+		}
+
+		{
+			ofstream stream(path, ios::out | ios::binary | ios::trunc);
+			stream << headerString;
+
+			if(isAscii){
+				stream << ascii.str();
+			}else{
+				stream.write(reinterpret_cast<const char*>(body.data()), body.size());
+			}
+		}
+
+		// READ
+		vector<string> failures;
+		auto ply = read_ply(path, pointsPerChunk);
+
+		if(!ply){
+			failures.push_back("not parsed");
+		}else if(ply->format != format || ply->numPoints != numVertices || ply->layout.hasColors() != (expectedColors[0] != 0x00FFFFFF)){
+			failures.push_back("header");
+		}else{
+			vector<double> x(numVertices), y(numVertices), z(numVertices);
+			vector<uint32_t> colors(numVertices);
+
+			bool chunksMatch = true;
+			int64_t nextPoint = 0;
+			for(auto& chunk : ply->chunks){
+				chunksMatch = chunksMatch && chunk.firstPoint == nextPoint && chunk.numPoints <= pointsPerChunk;
+				nextPoint += chunk.numPoints;
+			}
+			chunksMatch = chunksMatch && nextPoint == numVertices;
+
+			if(!chunksMatch){
+				failures.push_back("chunks");
+			}
+
+			// binary files with the specialized decoder, if the layout has one, and the generic decoder
+			bool hasKernel = select_ply_kernel(*ply) != nullptr;
+
+			for(bool useGeneric : {false, true}){
+
+				if(useGeneric && !hasKernel){
+					break;
+				}
+
+				std::fill(colors.begin(), colors.end(), 0);
+
+				for(auto& chunk : ply->chunks){
+					int64_t first = chunk.firstPoint;
+
+					if(isAscii){
+						int64_t numParsed = parse_ply_ascii(*ply, first, chunk.numPoints, {0.0, 0.0, 0.0},
+							x.data() + first, y.data() + first, z.data() + first, colors.data() + first);
+
+						if(numParsed != chunk.numPoints){
+							failures.push_back("parsed vertices");
+						}
+					}else{
+						decode_ply_binary(*ply, ply->mappedFile->data + chunk.byteOffset, chunk.numPoints, {0.0, 0.0, 0.0},
+							x.data() + first, y.data() + first, z.data() + first, colors.data() + first, useGeneric);
+					}
+				}
+
+				int64_t numWrongPositions = 0;
+				int64_t numWrongColors = 0;
+				for(int64_t i = 0; i < numVertices; i++){
+					numWrongPositions += dvec3(x[i], y[i], z[i]) == expectedPositions[i] ? 0 : 1;
+					numWrongColors += colors[i] == expectedColors[i] ? 0 : 1;
+				}
+
+				string decoder = isAscii ? "" : (useGeneric || !hasKernel) ? " (generic)" : " (specialized)";
+
+				if(numWrongPositions > 0){
+					failures.push_back(formatNumber(numWrongPositions) + " wrong positions" + decoder);
+				}
+				if(numWrongColors > 0){
+					failures.push_back(formatNumber(numWrongColors) + " wrong colors" + decoder);
+				}
+			}
+		}
+
+		// release the mapping before the next write
+		ply = nullptr;
+
+		cout << "    " << rightPad(layout.name, 48) << rightPad(formatNames[int(format)], 22);
+		if(failures.empty()){
+			cout << "ok" << endl;
+		}else{
+			for(int i = 0; i < int(failures.size()); i++){
+				cout << (i > 0 ? ", " : "") << failures[i];
+			}
+			cout << " FAILED" << endl;
+		}
+
+		allPassed = allPassed && failures.empty();
+	}
+	}
+
+	fs::remove(path);
+
+	return allPassed;
+}
@@ -0,0 +1,115 @@
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "glm/common.hpp"
+#include "unsuck.hpp"
+#include "Box.h"
+
+using namespace std;
+using glm::dvec3;
+
+// PLY files, as point clouds of their "vertex" element. x, y, z and, if present, red, green, blue are read,
+// all other elements and properties are skipped.
+//
+// the header is parsed into a layout of the vertex properties. binary vertices have a fixed stride, so their
+// chunks are read like the records of a LAS file, and decoded by a decoder that is specialized for the types of
+// the common layouts. ASCII vertices are lines, they're indexed into chunks once when the file is added.
+// bounds are estimated from samples, like those of LAS chunks.
+
+enum class PlyFormat{
+	ASCII,
+	BINARY_LITTLE_ENDIAN,
+	BINARY_BIG_ENDIAN,
+};
+
+enum class PlyType{
+	INT8,
+	UINT8,
+	INT16,
+	UINT16,
+	INT32,
+	UINT32,
+	FLOAT32,
+	FLOAT64,
+};
+
+struct PlyProperty{
+	string name;
+	PlyType type = PlyType::FLOAT32;
+	// lists store a count of type countType, followed by count values of type
+	bool isList = false;
+	PlyType countType = PlyType::UINT8;
+};
+
+struct PlyElement{
+	string name;
+	int64_t count = 0;
+	vector<PlyProperty> properties;
+};
+
+// where the attributes of a vertex are
+struct PlyLayout{
+	// byte size of a binary vertex
+	int64_t stride = 0;
+
+	// x, y, z, red, green, blue. index into the vertex properties, or -1
+	int indices[6] = {-1, -1, -1, -1, -1, -1};
+	// byte offsets in binary vertices
+	int64_t offsets[6] = {0, 0, 0, 0, 0, 0};
+	PlyType types[6] = {};
+
+	bool hasColors() const {
+		return indices[3] >= 0 && indices[4] >= 0 && indices[5] >= 0;
+	}
+};
+
+struct PlyChunk{
+	int64_t byteOffset = 0;
+	int64_t byteSize = 0;
+	int64_t firstPoint = 0;
+	int64_t numPoints = 0;
+	// of the sampled vertices
+	Box bounds;
+};
+
+struct PlyFile{
+	string path;
+	shared_ptr<MappedFile> mappedFile = nullptr;
+	PlyFormat format = PlyFormat::ASCII;
+	vector<PlyElement> elements;
+	int vertexElement = -1;
+	PlyLayout layout;
+
+	// byte offset of the first vertex
+	int64_t vertexOffset = 0;
+	// vertices in the file, fewer than the header claims if it's truncated
+	int64_t numPoints = 0;
+	vector<PlyChunk> chunks;
+	Box bounds;
+};
+
+int64_t ply_type_size(PlyType type);
+
+// parses the header and indexes the vertices into chunks of up to pointsPerChunk.
+// null if the file can't be opened, isn't a PLY file or has no usable vertices
+shared_ptr<PlyFile> read_ply(string path, int64_t pointsPerChunk);
+
+// decodes numPoints binary vertices, starting at records, into coordinates relative to origin and colors.
+// vertices without colors are white. the specialized decoders are used unless useGeneric is set
+void decode_ply_binary(const PlyFile& ply, const uint8_t* records, int64_t numPoints, dvec3 origin,
+	double* x, double* y, double* z, uint32_t* colors, bool useGeneric = false);
+
+// parses numPoints ASCII vertices, starting at vertex firstPoint. returns the number of vertices that were parsed
+int64_t parse_ply_ascii(const PlyFile& ply, int64_t firstPoint, int64_t numPoints, dvec3 origin,
+	double* x, double* y, double* z, uint32_t* colors);
+
+// decodes the files with the specialized and the generic decoders on all cores, prints MB/s and checks that both agree
+void benchmark_ply(vector<string> files);
+
+// writes small PLY files with common vertex layouts, each as ASCII and binary little and big endian, reads them back
+// with the parser and both binary decoders and compares positions and colors. returns false if any layout fails
+bool check_ply();
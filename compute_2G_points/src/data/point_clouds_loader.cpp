@@ -1,5 +1,12 @@
 
 #include "point_clouds_loader.h"
+#include "las_formats.h"
+#include "las_catalog.h"
+#include "batch_cache.h"
+#include "obj_loader.h"
+#include "ply_loader.h"
+#include "procedural_source.h"
+#include "batch_encoder.h"
 #include "unsuck.hpp"
 
 
@@ -12,6 +19,9 @@
 
 mutex mtx_debug;
 
+// the widest quantize-and-pack kernel that this machine supports
+const SimdLevel SIMD_LEVEL = detect_simd_level();
+
 
 struct LoadResult{
 	shared_ptr<Buffer> bBatches;
@@ -20,6 +30,7 @@ struct LoadResult{
 	shared_ptr<Buffer> bXyzHig;
 	shared_ptr<Buffer> bColors;
 	int64_t sparse_pointOffset;
+	int64_t numPoints;
 	int64_t numBatches;
 };
 
@@ -34,8 +45,7 @@ struct Batch{
 	dvec3 max = {-Infinity, -Infinity, -Infinity};
 };
 
-vector<Batch> make_batches(shared_ptr<PointCloud> pc, int64_t firstPoint, int64_t numPoints) {
-	int64_t sparse_pointOffset = pc->sparse_point_offset + firstPoint;
+vector<Batch> make_batches(int64_t firstPoint, int64_t numPoints, int64_t sparse_pointOffset) {
 
 	// compute batch metadata
 	int64_t numBatches = numPoints / POINTS_PER_WORKGROUP;
@@ -66,29 +76,12 @@ vector<Batch> make_batches(shared_ptr<PointCloud> pc, int64_t firstPoint, int64_
 	return batches;
 }
 
-void compute_batch_info_bbox(shared_ptr <Buffer> source,  shared_ptr<PointCloud> pc, Batch& batch) {
-	dvec3 boxMin = pc->boxMin;
-	dvec3 cScale = pc->scale;
-	dvec3 cOffset = pc->offset;
-	// compute batch bounding box (cpu batches)
-	for (int i = 0; i < batch.numPoints; i++) {
-		int index_pointFile = batch.chunk_pointOffset + i;
-
-		int32_t X = source->get<int32_t>(index_pointFile * pc->bytesPerPoint + 0);
-		int32_t Y = source->get<int32_t>(index_pointFile * pc->bytesPerPoint + 4);
-		int32_t Z = source->get<int32_t>(index_pointFile * pc->bytesPerPoint + 8);
-
-		double x = double(X) * cScale.x + cOffset.x - boxMin.x;
-		double y = double(Y) * cScale.y + cOffset.y - boxMin.y;
-		double z = double(Z) * cScale.z + cOffset.z - boxMin.z;
+template<class T>
+inline T read_record(const uint8_t* source, int64_t position) {
+	T value;
+	memcpy(&value, source + position, sizeof(T));
 
-		batch.min.x = std::min(batch.min.x, x);
-		batch.min.y = std::min(batch.min.y, y);
-		batch.min.z = std::min(batch.min.z, z);
-		batch.max.x = std::max(batch.max.x, x);
-		batch.max.y = std::max(batch.max.y, y);
-		batch.max.z = std::max(batch.max.z, z);
-	}
+	return value;
 }
 
 void store_batch_info_in_buffer(shared_ptr <Buffer> bBatches, shared_ptr<PointCloud> pc, Batch& batch, int batchIndex) {
@@ -97,6 +90,7 @@ void store_batch_info_in_buffer(shared_ptr <Buffer> bBatches, shared_ptr<PointCl
 	{
 		int64_t batchByteOffset = 64 * batchIndex;
 
+		bBatches->set<uint32_t>(uint32_t(BatchState::RESIDENT), batchByteOffset + 0);
 		bBatches->set<float>(batch.min.x, batchByteOffset + 4);
 		bBatches->set<float>(batch.min.y, batchByteOffset + 8);
 		bBatches->set<float>(batch.min.z, batchByteOffset + 12);
@@ -104,131 +98,172 @@ void store_batch_info_in_buffer(shared_ptr <Buffer> bBatches, shared_ptr<PointCl
 		bBatches->set<float>(batch.max.y, batchByteOffset + 20);
 		bBatches->set<float>(batch.max.z, batchByteOffset + 24);
 		bBatches->set<uint32_t>(batch.numPoints, batchByteOffset + 28);
-		bBatches->set<uint32_t>(batch.sparse_pointOffset, batchByteOffset + 32);
+		bBatches->set<uint32_t>(batch.sparse_pointOffset % POINTS_PER_SEGMENT, batchByteOffset + 32);
 		bBatches->set<uint32_t>(pc->fileIndex, batchByteOffset + 36);
+		bBatches->set<uint32_t>(batch.sparse_pointOffset / POINTS_PER_SEGMENT, batchByteOffset + 40);
 	}
 }
 
-void write_batch_points_to_buffers(shared_ptr <Buffer> source, shared_ptr<PointCloud> pc, Batch& batch,
-	shared_ptr<Buffer> bXyzLow,
-	shared_ptr<Buffer> bXyzMed,
-	shared_ptr<Buffer> bXyzHig,
-	shared_ptr<Buffer> bColors)
-{
-	dvec3 boxMin = pc->boxMin;
-	dvec3 cScale = pc->scale;
-	dvec3 cOffset = pc->offset;
-
-	// TODO modularize storing batch data
-	dvec3 batchBoxSize = batch.max - batch.min;
+template<int FORMAT>
+void write_colors(const uint8_t* source, int64_t stride, int64_t numPoints, uint32_t* colors){
 
-	int offset_rgb = 0;
-	if (pc->pointFormat == 2) {
-		offset_rgb = 20;
-	}
-	else if (pc->pointFormat == 3) {
-		offset_rgb = 28;
-	}
-	else if (pc->pointFormat == 7) {
-		offset_rgb = 30;
-	}
-	else if (pc->pointFormat == 8) {
-		offset_rgb = 30;
-	}
+	constexpr LasRecordFormat record = LAS_RECORD_FORMATS[FORMAT];
 
-	// load data
-	for (int i = 0; i < batch.numPoints; i++) {
-		int index_pointFile = batch.chunk_pointOffset + i;
+	for (int64_t i = 0; i < numPoints; i++) {
+		const uint8_t* pointRecord = source + i * stride;
 
-		int32_t X = source->get<int32_t>(index_pointFile * pc->bytesPerPoint + 0);
-		int32_t Y = source->get<int32_t>(index_pointFile * pc->bytesPerPoint + 4);
-		int32_t Z = source->get<int32_t>(index_pointFile * pc->bytesPerPoint + 8);
+		if constexpr (record.offsetRGB >= 0) { // RGB
+			int R = read_record<uint16_t>(pointRecord, record.offsetRGB + 0);
+			int G = read_record<uint16_t>(pointRecord, record.offsetRGB + 2);
+			int B = read_record<uint16_t>(pointRecord, record.offsetRGB + 4);
 
-		double x = double(X) * cScale.x + cOffset.x - boxMin.x;
-		double y = double(Y) * cScale.y + cOffset.y - boxMin.y;
-		double z = double(Z) * cScale.z + cOffset.z - boxMin.z;
+			R = R < 256 ? R : R / 256;
+			G = G < 256 ? G : G / 256;
+			B = B < 256 ? B : B / 256;
 
-		uint32_t X30 = uint32_t(((x - batch.min.x) / batchBoxSize.x) * STEPS_30BIT);
-		uint32_t Y30 = uint32_t(((y - batch.min.y) / batchBoxSize.y) * STEPS_30BIT);
-		uint32_t Z30 = uint32_t(((z - batch.min.z) / batchBoxSize.z) * STEPS_30BIT);
+			colors[i] = R | (G << 8) | (B << 16);
+		} else { // formats without colors are shaded by intensity
+			int I = read_record<uint16_t>(pointRecord, record.offsetIntensity);
 
-		X30 = min(X30, uint32_t(STEPS_30BIT - 1));
-		Y30 = min(Y30, uint32_t(STEPS_30BIT - 1));
-		Z30 = min(Z30, uint32_t(STEPS_30BIT - 1));
+			I = I < 256 ? I : I / 256;
 
-		{ // low
-			uint32_t X_low = (X30 >> 20) & MASK_10BIT;
-			uint32_t Y_low = (Y30 >> 20) & MASK_10BIT;
-			uint32_t Z_low = (Z30 >> 20) & MASK_10BIT;
+			colors[i] = I | (I << 8) | (I << 16);
+		}
+	}
+}
 
-			uint32_t encoded = X_low | (Y_low << 10) | (Z_low << 20);
+// computes the bounding box of the batch and writes its encoded points.
+// one instantiation per point format, so that record offsets are constants and the loops don't branch on the format.
+// records are read from memory once, in blocks that stay in L1 while both XYZ and colors are decoded.
+// the converted coordinates of the whole batch stay in a cache-resident scratch buffer until the bounds are known
+template<int FORMAT>
+void encode_batch(const uint8_t* source, shared_ptr<PointCloud> pc, Batch& batch,
+	shared_ptr<Buffer> bXyzLow,
+	shared_ptr<Buffer> bXyzMed,
+	shared_ptr<Buffer> bXyzHig,
+	shared_ptr<Buffer> bColors)
+{
+	constexpr int64_t BLOCK_SIZE = 512;
 
-			bXyzLow->set<uint32_t>(encoded, 4 * index_pointFile);
-		}
+	thread_local vector<double> scratch(3 * POINTS_PER_WORKGROUP);
 
-		{ // med
-			uint32_t X_med = (X30 >> 10) & MASK_10BIT;
-			uint32_t Y_med = (Y30 >> 10) & MASK_10BIT;
-			uint32_t Z_med = (Z30 >> 10) & MASK_10BIT;
+	double* x = scratch.data() + 0 * POINTS_PER_WORKGROUP;
+	double* y = scratch.data() + 1 * POINTS_PER_WORKGROUP;
+	double* z = scratch.data() + 2 * POINTS_PER_WORKGROUP;
 
-			uint32_t encoded = X_med | (Y_med << 10) | (Z_med << 20);
+	const int64_t stride = pc->bytesPerPoint;
+	const uint8_t* records = source + batch.chunk_pointOffset * stride;
+	uint32_t* colors = reinterpret_cast<uint32_t*>(bColors->data) + batch.chunk_pointOffset;
 
-			bXyzMed->set<uint32_t>(encoded, 4 * index_pointFile);
-		}
+	ConvertParams params;
+	params.scale = pc->scale;
+	params.offset = pc->offset;
+	params.boxMin = pc->boxMin;
 
-		{ // hig
-			uint32_t X_hig = (X30 >> 0) & MASK_10BIT;
-			uint32_t Y_hig = (Y30 >> 0) & MASK_10BIT;
-			uint32_t Z_hig = (Z30 >> 0) & MASK_10BIT;
+	// pass 1: records to scratch coordinates, bounds and colors
+	for(int64_t blockStart = 0; blockStart < batch.numPoints; blockStart += BLOCK_SIZE){
+		int64_t blockSize = std::min(BLOCK_SIZE, batch.numPoints - blockStart);
+		const uint8_t* blockRecords = records + blockStart * stride;
 
-			uint32_t encoded = X_hig | (Y_hig << 10) | (Z_hig << 20);
+		convert_points(blockRecords, stride, blockSize, params,
+			x + blockStart, y + blockStart, z + blockStart,
+			batch.min, batch.max, SIMD_LEVEL);
 
-			bXyzHig->set<uint32_t>(encoded, 4 * index_pointFile);
-		}
+		write_colors<FORMAT>(blockRecords, stride, blockSize, colors + blockStart);
+	}
 
-		{ // RGB
+	// pass 2: scratch coordinates to 10-10-10
+	quantize_and_pack(x, y, z, batch.numPoints, batch.min, batch.max - batch.min,
+		reinterpret_cast<uint32_t*>(bXyzLow->data) + batch.chunk_pointOffset,
+		reinterpret_cast<uint32_t*>(bXyzMed->data) + batch.chunk_pointOffset,
+		reinterpret_cast<uint32_t*>(bXyzHig->data) + batch.chunk_pointOffset,
+		SIMD_LEVEL);
+}
 
+using EncodeBatchKernel = void(*)(const uint8_t*, shared_ptr<PointCloud>, Batch&,
+	shared_ptr<Buffer>, shared_ptr<Buffer>, shared_ptr<Buffer>, shared_ptr<Buffer>);
+
+constexpr EncodeBatchKernel ENCODE_BATCH_KERNELS[MAX_LAS_POINT_FORMAT + 1] = {
+	encode_batch<0>,
+	encode_batch<1>,
+	encode_batch<2>,
+	encode_batch<3>,
+	encode_batch<4>,
+	encode_batch<5>,
+	encode_batch<6>,
+	encode_batch<7>,
+	encode_batch<8>,
+	encode_batch<9>,
+	encode_batch<10>,
+};
 
-			int R = source->get<uint16_t>(index_pointFile * pc->bytesPerPoint + offset_rgb + 0);
-			int G = source->get<uint16_t>(index_pointFile * pc->bytesPerPoint + offset_rgb + 2);
-			int B = source->get<uint16_t>(index_pointFile * pc->bytesPerPoint + offset_rgb + 4);
 
-			R = R < 256 ? R : R / 256;
-			G = G < 256 ? G : G / 256;
-			B = B < 256 ? B : B / 256;
 
-			uint32_t color = R | (G << 8) | (B << 16);
+// encodes numPoints point records, starting at source, into batches whose points start at address sparse_pointOffset.
+// result buffers are taken from pool, if given
+shared_ptr<LoadResult> encode_points(shared_ptr<PointCloud> pc, const uint8_t* source, int64_t firstPoint, int64_t numPoints, int64_t sparse_pointOffset, shared_ptr<BufferPool> pool){
 
-			bColors->set<uint32_t>(color, 4 * index_pointFile);
-		}
-	}
+	vector<Batch> batches = make_batches(firstPoint, numPoints, sparse_pointOffset);
+	int64_t numBatches = batches.size();
 
-}
+	auto bBatches = allocate_buffer(pool, 64 * numBatches); 
+	auto bXyzLow  = allocate_buffer(pool, 4 * numPoints);
+	auto bXyzMed  = allocate_buffer(pool, 4 * numPoints);
+	auto bXyzHig  = allocate_buffer(pool, 4 * numPoints);
+	auto bColors  = allocate_buffer(pool, 4 * numPoints);
 
+	// formats are validated when the header is read
+	EncodeBatchKernel encode_batch = ENCODE_BATCH_KERNELS[pc->pointFormat];
 
+	// load batches/points
+	for(int batchIndex = 0; batchIndex < numBatches; batchIndex++){
+		Batch& batch = batches[batchIndex];
+		encode_batch(source, pc, batch, bXyzLow, bXyzMed, bXyzHig, bColors);
+		store_batch_info_in_buffer(bBatches, pc, batch, batchIndex);
+	}
 
-shared_ptr<LoadResult> load_pointcloud_from_file(shared_ptr<PointCloud> pc, int64_t firstPoint, int64_t numPoints){
+	auto result = make_shared<LoadResult>();
+	result->bXyzLow = bXyzLow;
+	result->bXyzMed = bXyzMed;
+	result->bXyzHig = bXyzHig;
+	result->bColors = bColors;
+	result->bBatches = bBatches;
+	result->numPoints = numPoints;
+	result->numBatches = numBatches;
+	result->sparse_pointOffset = sparse_pointOffset;
 
-	string path = pc->path;
-	int64_t file_byteOffset = pc->offsetToPointData + firstPoint * pc->bytesPerPoint;
-	int64_t file_byteSize = numPoints * pc->bytesPerPoint;
-	auto source = readBinaryFile(path, file_byteOffset, file_byteSize);
+	return result;
+}
 
-	vector<Batch> batches = make_batches(pc, firstPoint, numPoints);
+// like encode_points(), for formats that aren't LAS records. x, y and z are relative to pc->boxMin
+shared_ptr<LoadResult> encode_parsed_points(shared_ptr<PointCloud> pc, const double* x, const double* y, const double* z, const uint32_t* colors,
+	int64_t firstPoint, int64_t numPoints, int64_t sparse_pointOffset, shared_ptr<BufferPool> pool)
+{
+	vector<Batch> batches = make_batches(firstPoint, numPoints, sparse_pointOffset);
 	int64_t numBatches = batches.size();
 
-	auto bBatches = make_shared<Buffer>(64 * numBatches); 
-	auto bXyzLow  = make_shared<Buffer>(4 * numPoints);
-	auto bXyzMed  = make_shared<Buffer>(4 * numPoints);
-	auto bXyzHig  = make_shared<Buffer>(4 * numPoints);
-	auto bColors  = make_shared<Buffer>(4 * numPoints);
+	auto bBatches = allocate_buffer(pool, 64 * numBatches); 
+	auto bXyzLow  = allocate_buffer(pool, 4 * numPoints);
+	auto bXyzMed  = allocate_buffer(pool, 4 * numPoints);
+	auto bXyzHig  = allocate_buffer(pool, 4 * numPoints);
+	auto bColors  = allocate_buffer(pool, 4 * numPoints);
 
-	// load batches/points
 	for(int batchIndex = 0; batchIndex < numBatches; batchIndex++){
 		Batch& batch = batches[batchIndex];
-		compute_batch_info_bbox(source, pc, batch);
+		int64_t first = batch.chunk_pointOffset;
+
+		for(int64_t i = first; i < first + batch.numPoints; i++){
+			batch.min = glm::min(batch.min, dvec3(x[i], y[i], z[i]));
+			batch.max = glm::max(batch.max, dvec3(x[i], y[i], z[i]));
+		}
+
+		quantize_and_pack(x + first, y + first, z + first, batch.numPoints, batch.min, batch.max - batch.min,
+			bXyzLow->data_u32 + first, bXyzMed->data_u32 + first, bXyzHig->data_u32 + first,
+			SIMD_LEVEL);
+
+		memcpy(bColors->data_u32 + first, colors + first, 4 * batch.numPoints);
+
 		store_batch_info_in_buffer(bBatches, pc, batch, batchIndex);
-		write_batch_points_to_buffers(source, pc, batch, bXyzLow, bXyzMed, bXyzHig, bColors);
 	}
 
 	auto result = make_shared<LoadResult>();
@@ -237,270 +272,2717 @@ shared_ptr<LoadResult> load_pointcloud_from_file(shared_ptr<PointCloud> pc, int6
 	result->bXyzHig = bXyzHig;
 	result->bColors = bColors;
 	result->bBatches = bBatches;
+	result->numPoints = numPoints;
 	result->numBatches = numBatches;
-	result->sparse_pointOffset = pc->sparse_point_offset + firstPoint;
+	result->sparse_pointOffset = sparse_pointOffset;
 
 	return result;
 }
 
+shared_ptr<LoadResult> load_pointcloud_from_file(shared_ptr<PointCloud> pc, int64_t firstPoint, int64_t numPoints, int64_t sparse_pointOffset, shared_ptr<BufferPool> pool){
 
-PointCloudLoader::PointCloudLoader(shared_ptr<Renderer> renderer){
+	auto mappedFile = pc->mappedFile;
+	int64_t file_byteOffset = pc->offsetToPointData + firstPoint * pc->bytesPerPoint;
 
-	this->renderer = renderer;
+	// don't read past the end of truncated files
+	int64_t availablePoints = (mappedFile->size - file_byteOffset) / int64_t(pc->bytesPerPoint);
+	numPoints = std::max(std::min(numPoints, availablePoints), int64_t(0));
 
-	int pageSize = 0;
-	glGetIntegerv(GL_SPARSE_BUFFER_PAGE_SIZE_ARB, &pageSize);
-	PAGE_SIZE = pageSize;
+	int64_t file_byteSize = numPoints * pc->bytesPerPoint;
+	mappedFile->adviseWillNeed(file_byteOffset, file_byteSize);
+	const uint8_t* source = mappedFile->data + file_byteOffset;
 
-	{ // create (sparse) buffers
-		this->ssBatches = renderer->createBuffer(64 * 200'000);
-		this->ssXyzLow = renderer->createSparseBuffer(4 * MAX_POINTS);
-		this->ssXyzMed = renderer->createSparseBuffer(4 * MAX_POINTS);
-		this->ssXyzHig = renderer->createSparseBuffer(4 * MAX_POINTS);
-		this->ssColors = renderer->createSparseBuffer(4 * MAX_POINTS);
-		this->ssLoadBuffer = renderer->createBuffer(200 * MAX_POINTS_PER_BATCH);
+	return encode_points(pc, source, firstPoint, numPoints, sparse_pointOffset, pool);
+}
 
-		GLuint zero = 0;
-		glClearNamedBufferData(this->ssBatches.handle, GL_R32UI, GL_RED, GL_UNSIGNED_INT, &zero);
+// decompresses numPoints points, starting at firstPoint, into uncompressed records and encodes them.
+// each call opens its own laszip reader, so that chunks of the same file decompress in parallel
+shared_ptr<LoadResult> load_pointcloud_from_laz(shared_ptr<PointCloud> pc, int64_t firstPoint, int64_t numPoints, int64_t sparse_pointOffset, shared_ptr<BufferPool> pool){
+
+	// only XYZ, intensity and RGB are encoded into batches, the remaining fields stay uninitialized
+	auto records = allocate_buffer(pool, numPoints * pc->bytesPerPoint);
+	const LasRecordFormat& record = LAS_RECORD_FORMATS[pc->pointFormat];
+
+	ifstream stream(pc->path, ios::in | ios::binary);
+
+	laszip_POINTER laszip_reader = nullptr;
+	laszip_create(&laszip_reader);
+
+	// LAS 1.4 formats compress fields in separate layers, skip the ones we don't need
+	laszip_decompress_selective(laszip_reader,
+		laszip_DECOMPRESS_SELECTIVE_CHANNEL_RETURNS_XY
+		| laszip_DECOMPRESS_SELECTIVE_Z
+		| laszip_DECOMPRESS_SELECTIVE_INTENSITY
+		| laszip_DECOMPRESS_SELECTIVE_RGB);
+
+	laszip_BOOL is_compressed = 0;
+	bool isOpen = laszip_open_reader_stream(laszip_reader, stream, &is_compressed) == 0;
+
+	int64_t numRead = 0;
+
+	// seeking to the first point of a chunk jumps there through the chunk table
+	if(isOpen && laszip_seek_point(laszip_reader, firstPoint) == 0){
+
+		laszip_point_struct* point = nullptr;
+		laszip_get_point_pointer(laszip_reader, &point);
+
+		for(; numRead < numPoints; numRead++){
+
+			if(laszip_read_point(laszip_reader) != 0){
+				break;
+			}
+
+			int64_t recordOffset = numRead * pc->bytesPerPoint;
+
+			records->set<int32_t>(point->X, recordOffset + 0);
+			records->set<int32_t>(point->Y, recordOffset + 4);
+			records->set<int32_t>(point->Z, recordOffset + 8);
+			records->set<uint16_t>(point->intensity, recordOffset + record.offsetIntensity);
+
+			if(record.offsetRGB >= 0){
+				records->set<uint16_t>(point->rgb[0], recordOffset + record.offsetRGB + 0);
+				records->set<uint16_t>(point->rgb[1], recordOffset + record.offsetRGB + 2);
+				records->set<uint16_t>(point->rgb[2], recordOffset + record.offsetRGB + 4);
+			}
+		}
 	}
 
-	int numThreads = 1;
-	auto cpuData = getCpuData();
+	if(numRead < numPoints){
+		laszip_CHAR* error = nullptr;
+		laszip_get_error(laszip_reader, &error);
 
-	if(cpuData.numProcessors == 1) numThreads = 1;
-	if(cpuData.numProcessors == 2) numThreads = 1;
-	if(cpuData.numProcessors == 3) numThreads = 2;
-	if(cpuData.numProcessors == 4) numThreads = 3;
-	if(cpuData.numProcessors == 5) numThreads = 4;
-	if(cpuData.numProcessors == 6) numThreads = 4;
-	if(cpuData.numProcessors == 7) numThreads = 5;
-	if(cpuData.numProcessors == 8) numThreads = 5;
-	if(cpuData.numProcessors  > 8) numThreads = (cpuData.numProcessors / 2) + 1;
+		GENERATE_WARN_MESSAGE << "decompressed " << numRead << " of " << numPoints 
+			<< " points of " << pc->path << ": " << (error ? error : "") << endl;
+	}
 
-	cout << "start loading points with " << numThreads << " threads" << endl;
+	if(isOpen){
+		laszip_close_reader(laszip_reader);
+	}
+	laszip_destroy(laszip_reader);
 
-	 spawnLoader();
+	return encode_points(pc, records->data_u8, firstPoint, numRead, sparse_pointOffset, pool);
 }
 
-void PointCloudLoader::add(vector<string> files, std::function<void(vector<shared_ptr<PointCloud>>)> callback){
+// parses the vertices of an OBJ file and encodes them
+shared_ptr<LoadResult> load_pointcloud_from_obj(shared_ptr<PointCloud> pc, int64_t firstPoint, int64_t numPoints, int64_t sparse_pointOffset, shared_ptr<BufferPool> pool){
 
-	vector<shared_ptr<PointCloud>> pcs;
-	static mutex mtx_lasfiles;
+	auto xyz = allocate_buffer(pool, 3 * 8 * numPoints);
+	auto colors = allocate_buffer(pool, 4 * numPoints);
 
-	struct Task{
-		string file;
-		int fileIndex;
+	double* x = xyz->data_f64;
+	double* y = x + numPoints;
+	double* z = y + numPoints;
+
+	int64_t numParsed = parse_obj_points(*pc->obj, firstPoint, numPoints, pc->boxMin, x, y, z, colors->data_u32);
+
+	return encode_parsed_points(pc, x, y, z, colors->data_u32, firstPoint, numParsed, sparse_pointOffset, pool);
+}
+
+// decodes the vertices of a PLY file and encodes them. binary vertices are decoded from records,
+// ASCII vertices are parsed from the mapping
+shared_ptr<LoadResult> load_pointcloud_from_ply(shared_ptr<PointCloud> pc, const uint8_t* records, int64_t firstPoint, int64_t numPoints, int64_t sparse_pointOffset, shared_ptr<BufferPool> pool){
+
+	auto xyz = allocate_buffer(pool, 3 * 8 * numPoints);
+	auto colors = allocate_buffer(pool, 4 * numPoints);
+
+	double* x = xyz->data_f64;
+	double* y = x + numPoints;
+	double* z = y + numPoints;
+
+	if(records){
+		decode_ply_binary(*pc->ply, records, numPoints, pc->boxMin, x, y, z, colors->data_u32);
+	}else{
+		numPoints = parse_ply_ascii(*pc->ply, firstPoint, numPoints, pc->boxMin, x, y, z, colors->data_u32);
+	}
+
+	return encode_parsed_points(pc, x, y, z, colors->data_u32, firstPoint, numPoints, sparse_pointOffset, pool);
+}
+
+// generates the points of a procedural source and encodes them
+shared_ptr<LoadResult> load_pointcloud_from_procedural(shared_ptr<PointCloud> pc, int64_t firstPoint, int64_t numPoints, int64_t sparse_pointOffset, shared_ptr<BufferPool> pool){
+
+	auto xyz = allocate_buffer(pool, 3 * 8 * numPoints);
+	auto colors = allocate_buffer(pool, 4 * numPoints);
+
+	double* x = xyz->data_f64;
+	double* y = x + numPoints;
+	double* z = y + numPoints;
+
+	generate_procedural_points(*pc->procedural, firstPoint, numPoints, pc->boxMin, x, y, z, colors->data_u32);
+
+	return encode_parsed_points(pc, x, y, z, colors->data_u32, firstPoint, numPoints, sparse_pointOffset, pool);
+}
+
+// batches and points of a .t2g file, numPoints starting at firstPoint. the planes aren't copied, uploads read
+// them from the mapping. ranges that cover whole chunks are checked against the checksum of the chunk, which also
+// faults their pages in on this thread instead of the upload thread
+shared_ptr<LoadResult> load_pointcloud_from_cache(shared_ptr<PointCloud> pc, int64_t firstPoint, int64_t numPoints, int64_t sparse_pointOffset, shared_ptr<BufferPool> pool){
+
+	auto cache = pc->cache;
+	const BatchCacheHeader& header = cache->header;
+	const BatchCacheChunk* chunk = cache->findChunk(firstPoint);
+
+	auto result = make_shared<LoadResult>();
+	result->sparse_pointOffset = sparse_pointOffset;
+	result->numPoints = 0;
+	result->numBatches = 0;
+	result->bBatches = make_shared<Buffer>(0);
+	result->bXyzLow = make_shared<Buffer>(0);
+	result->bXyzMed = make_shared<Buffer>(0);
+	result->bXyzHig = make_shared<Buffer>(0);
+	result->bColors = make_shared<Buffer>(0);
+
+	// all but the last batch of a range are full, so batches of consecutive points follow each other
+	int64_t chunkOffset = chunk ? firstPoint - chunk->firstPoint : 0;
+	int64_t firstBatch = chunk ? chunk->firstBatch + chunkOffset / POINTS_PER_WORKGROUP : 0;
+	int64_t numBatches = (numPoints + POINTS_PER_WORKGROUP - 1) / POINTS_PER_WORKGROUP;
+
+	bool isValidRange = chunk != nullptr
+		&& chunkOffset % POINTS_PER_WORKGROUP == 0
+		&& firstPoint + numPoints <= header.numPointsReserved
+		&& firstBatch + numBatches <= header.numBatchesReserved;
+
+	if(!isValidRange){
+		GENERATE_WARN_MESSAGE << "points " << firstPoint << " to " << (firstPoint + numPoints) 
+			<< " aren't in the chunks of " << cache->path << endl;
+
+		return result;
+	}
+
+	auto mappedFile = cache->mappedFile;
+	int64_t batchesOffset = header.batchesOffset + 64 * firstBatch;
+	vector<int64_t> planeOffsets = {
+		header.xyzLowOffset + 4 * firstPoint,
+		header.xyzMedOffset + 4 * firstPoint,
+		header.xyzHigOffset + 4 * firstPoint,
+		header.colorsOffset + 4 * firstPoint,
 	};
 
-	auto ref = this;
+	for(int64_t offset : planeOffsets){
+		mappedFile->adviseWillNeed(offset, 4 * numPoints);
+	}
 
-	auto processor = [ref, &pcs](shared_ptr<Task> task){
+	// re-streamed ranges were checked when they were loaded for the first time
+	bool isWholeChunk = chunkOffset == 0 && numPoints == chunk->numPoints;
+	if(isWholeChunk){
+		uint64_t hash = checksum(mappedFile->data + batchesOffset, 64 * numBatches);
 
-		auto lasfile = make_shared<PointCloud>();
-		lasfile->fileIndex = task->fileIndex;
-		lasfile->path = task->file;
+		for(int64_t offset : planeOffsets){
+			hash = checksum(mappedFile->data + offset, 4 * numPoints, hash);
+		}
 
-		auto buffer_header = readBinaryFile(lasfile->path, 0, 375);
-		int versionMajor = buffer_header->get<uint8_t>(24);
-		int versionMinor = buffer_header->get<uint8_t>(25);
-		if(versionMajor == 1 && versionMinor < 4){
-			lasfile->numPoints = buffer_header->get<uint32_t>(107);
-		}else{
-			lasfile->numPoints = buffer_header->get<uint64_t>(247);
-		}
-
-		lasfile->numPoints = min(lasfile->numPoints, 1'000'000'000ll);
-		lasfile->offsetToPointData = buffer_header->get<uint32_t>(96);
-		lasfile->pointFormat = buffer_header->get<uint8_t>(104) % 128;
-		lasfile->bytesPerPoint = buffer_header->get<uint16_t>(105);
-		
-		lasfile->scale.x = buffer_header->get<double>(131);
-		lasfile->scale.y = buffer_header->get<double>(139);
-		lasfile->scale.z = buffer_header->get<double>(147);
-		
-		lasfile->offset.x = buffer_header->get<double>(155);
-		lasfile->offset.y = buffer_header->get<double>(163);
-		lasfile->offset.z = buffer_header->get<double>(171);
-		
-		lasfile->boxMin.x = buffer_header->get<double>(187);
-		lasfile->boxMin.y = buffer_header->get<double>(203);
-		lasfile->boxMin.z = buffer_header->get<double>(219);
-		
-		lasfile->boxMax.x = buffer_header->get<double>(179);
-		lasfile->boxMax.y = buffer_header->get<double>(195);
-		lasfile->boxMax.z = buffer_header->get<double>(211);
-
-		
-		
-		{
-			unique_lock<mutex> lock1(mtx_lasfiles);
-			
-			lasfile->numBatches = lasfile->numPoints / POINTS_PER_WORKGROUP + 1;
+		if(hash != chunk->checksum){
+			GENERATE_WARN_MESSAGE << "checksum mismatch in chunk at point " << firstPoint 
+				<< " of " << cache->path << ", skipping it. convert the file again" << endl;
 
-			lasfile->sparse_point_offset = ref->numPoints;
-			
-			ref->files.push_back(lasfile);
-			ref->numPoints += lasfile->numPoints;
-			ref->numBatches += lasfile->numBatches;
+			return result;
+		}
+	}
 
-			pcs.push_back(lasfile);
+	// records are small, copy them to set where their points go
+	auto bBatches = allocate_buffer(pool, 64 * numBatches);
+	memcpy(bBatches->data, mappedFile->data + batchesOffset, 64 * numBatches);
 
-			stringstream ss;
-			ss << "load file " << task->file << endl;
-			ss << "numPoints: " << lasfile->numPoints << "\n";
-			ss << "numBatches: " << lasfile->numBatches << "\n";
-			ss << "sparse_point_offset: " << lasfile->sparse_point_offset << "\n";
+	int64_t batch_pointOffset = sparse_pointOffset;
+	for(int64_t i = 0; i < numBatches; i++){
+		bBatches->set<uint32_t>(batch_pointOffset % POINTS_PER_SEGMENT, 64 * i + 32);
+		bBatches->set<uint32_t>(pc->fileIndex, 64 * i + 36);
+		bBatches->set<uint32_t>(batch_pointOffset / POINTS_PER_SEGMENT, 64 * i + 40);
 
-			cout << ss.str() << endl;
+		batch_pointOffset += bBatches->get<uint32_t>(64 * i + 28);
+	}
+
+	result->bBatches = bBatches;
+	result->bXyzLow = cache->view(planeOffsets[0], 4 * numPoints);
+	result->bXyzMed = cache->view(planeOffsets[1], 4 * numPoints);
+	result->bXyzHig = cache->view(planeOffsets[2], 4 * numPoints);
+	result->bColors = cache->view(planeOffsets[3], 4 * numPoints);
+	result->numPoints = numPoints;
+	result->numBatches = numBatches;
+
+	return result;
+}
+
+// chunk size from the "laszip encoded" VLR, 0 if it's missing or chunks are variably sized
+int64_t read_laz_chunk_size(shared_ptr<MappedFile> mappedFile){
+
+	auto data = mappedFile->data;
+	int64_t fileSize = mappedFile->size;
+
+	if(fileSize < 104){
+		return 0;
+	}
+
+	int64_t headerSize = read_record<uint16_t>(data, 94);
+	int64_t numVLRs = read_record<uint32_t>(data, 100);
+
+	int64_t vlrOffset = headerSize;
+	for(int64_t i = 0; i < numVLRs; i++){
+
+		if(vlrOffset + 54 > fileSize){
+			break;
 		}
 
-		{ // create load tasks
+		string userID = string((const char*)(data + vlrOffset + 2), strnlen((const char*)(data + vlrOffset + 2), 16));
+		int recordID = read_record<uint16_t>(data, vlrOffset + 18);
+		int64_t recordLength = read_record<uint16_t>(data, vlrOffset + 20);
 
-			unique_lock<mutex> lock2(ref->mtx_load);
-			
-			int64_t pointOffset = 0;
+		bool isLaszipVLR = userID == "laszip encoded" && recordID == 22204;
+		if(isLaszipVLR && recordLength >= 16 && vlrOffset + 54 + 16 <= fileSize){
+			uint32_t chunkSize = read_record<uint32_t>(data, vlrOffset + 54 + 12);
 
-			while(pointOffset < lasfile->numPoints){
+			return chunkSize == 0xFFFFFFFF ? 0 : chunkSize;
+		}
 
-				int64_t remaining = lasfile->numPoints - pointOffset;
-				int64_t pointsInBatch = min(int64_t(MAX_POINTS_PER_BATCH), remaining);
+		vlrOffset += 54 + recordLength;
+	}
 
-				LoadTask task;
-				task.lasfile = lasfile;
-				task.firstPoint = pointOffset;
-				task.numPoints = pointsInBatch;
+	return 0;
+}
 
-				ref->loadTasks.push_back(task);
+// LAZ tasks cover whole chunks, so that no chunk is decompressed by two tasks
+int64_t points_per_task(shared_ptr<PointCloud> pc){
 
-				pointOffset += pointsInBatch;
-			}
+	int64_t chunkSize = pc->lazChunkSize;
+
+	if(pc->isCompressed && chunkSize > 0 && chunkSize <= MAX_POINTS_PER_BATCH){
+		return (MAX_POINTS_PER_BATCH / chunkSize) * chunkSize;
+	}else{
+		return MAX_POINTS_PER_BATCH;
+	}
+}
+
+// bounds of a few points spread over the chunk. cheap enough to do for every chunk when a file is added,
+// and close enough for load priorities since points of nearby records are usually close to each other.
+// LAZ records can't be sampled without decompressing, they get the bounds of the file.
+Box estimate_chunk_bounds(shared_ptr<PointCloud> pc, int64_t firstPoint, int64_t numPoints){
+
+	Box fileBounds;
+	fileBounds.min = pc->boxMin;
+	fileBounds.max = pc->boxMax;
+
+	if(pc->isCompressed || numPoints == 0){
+		return fileBounds;
+	}
+
+	int64_t numSamples = std::min(numPoints, int64_t(64));
+	auto data = pc->mappedFile->data;
+	int64_t fileSize = pc->mappedFile->size;
+
+	Box bounds;
+	for(int64_t i = 0; i < numSamples; i++){
+		int64_t pointIndex = firstPoint + (i * numPoints) / numSamples;
+		int64_t byteOffset = pc->offsetToPointData + pointIndex * pc->bytesPerPoint;
+
+		if(byteOffset + 12 > fileSize){
+			break;
 		}
 
-	};
+		dvec3 position = {
+			read_record<int32_t>(data, byteOffset + 0) * pc->scale.x + pc->offset.x,
+			read_record<int32_t>(data, byteOffset + 4) * pc->scale.y + pc->offset.y,
+			read_record<int32_t>(data, byteOffset + 8) * pc->scale.z + pc->offset.z,
+		};
 
-	auto cpuData = getCpuData();
-	int numThreads = cpuData.numProcessors;
+		bounds.expand(position);
+	}
 
-	TaskPool<Task> pool(numThreads, processor);
+	if(bounds.min.x > bounds.max.x){
+		return fileBounds;
+	}
 
-	for(auto file : files){
-		auto task = make_shared<Task>();
-		task->file = file;
-		task->fileIndex = this->numFiles;
-		this->numFiles++;
+	return bounds;
+}
 
-		pool.addTask(task);
+shared_ptr<PointCloud> read_las_header(string path){
+
+	auto lasfile = make_shared<PointCloud>();
+	lasfile->path = path;
+	lasfile->mappedFile = make_shared<MappedFile>(path);
+
+	auto mappedFile = lasfile->mappedFile;
+
+	// zero-padded copy so that fields of short (LAS 1.0 - 1.3) headers read as 0
+	auto buffer_header = make_shared<Buffer>(375);
+	memset(buffer_header->data, 0, buffer_header->size);
+	memcpy(buffer_header->data, mappedFile->data, std::min(mappedFile->size, buffer_header->size));
+
+	int versionMajor = buffer_header->get<uint8_t>(24);
+	int versionMinor = buffer_header->get<uint8_t>(25);
+	if(versionMajor == 1 && versionMinor < 4){
+		lasfile->numPoints = buffer_header->get<uint32_t>(107);
+	}else{
+		lasfile->numPoints = buffer_header->get<uint64_t>(247);
 	}
 
-	pool.close();
-	pool.waitTillEmpty();
+	lasfile->offsetToPointData = buffer_header->get<uint32_t>(96);
+	// laszip flags compressed files in the upper bits of the point format
+	lasfile->pointFormat = buffer_header->get<uint8_t>(104) & 0b0011'1111;
+	lasfile->isCompressed = (buffer_header->get<uint8_t>(104) & 0b1100'0000) != 0;
+	lasfile->bytesPerPoint = buffer_header->get<uint16_t>(105);
+	
+	lasfile->scale.x = buffer_header->get<double>(131);
+	lasfile->scale.y = buffer_header->get<double>(139);
+	lasfile->scale.z = buffer_header->get<double>(147);
+	
+	lasfile->offset.x = buffer_header->get<double>(155);
+	lasfile->offset.y = buffer_header->get<double>(163);
+	lasfile->offset.z = buffer_header->get<double>(171);
+	
+	lasfile->boxMin.x = buffer_header->get<double>(187);
+	lasfile->boxMin.y = buffer_header->get<double>(203);
+	lasfile->boxMin.z = buffer_header->get<double>(219);
+	
+	lasfile->boxMax.x = buffer_header->get<double>(179);
+	lasfile->boxMax.y = buffer_header->get<double>(195);
+	lasfile->boxMax.z = buffer_header->get<double>(211);
+
+	if(lasfile->isCompressed){
+		lasfile->lazChunkSize = read_laz_chunk_size(mappedFile);
+	}else{
+		int64_t pointDataSize = lasfile->numPoints * lasfile->bytesPerPoint;
+		mappedFile->adviseSequential(lasfile->offsetToPointData, pointDataSize);
+	}
 
-	callback(pcs);
+	return lasfile;
+}
 
+shared_ptr<PointCloud> point_cloud_from_cache(shared_ptr<BatchCache> cache){
+
+	const BatchCacheHeader& header = cache->header;
+
+	auto pc = make_shared<PointCloud>();
+	pc->path = cache->path;
+	pc->mappedFile = cache->mappedFile;
+	pc->cache = cache;
+	pc->numPoints = header.numPoints;
+	pc->bytesPerPoint = 16;
+	pc->scale = {header.scale[0], header.scale[1], header.scale[2]};
+	pc->offset = {header.offset[0], header.offset[1], header.offset[2]};
+	pc->boxMin = {header.boxMin[0], header.boxMin[1], header.boxMin[2]};
+	pc->boxMax = {header.boxMax[0], header.boxMax[1], header.boxMax[2]};
+
+	return pc;
 }
 
-void PointCloudLoader::spawnLoader(){
+shared_ptr<PointCloud> point_cloud_from_obj(shared_ptr<ObjFile> obj){
 
-	auto ref = this;
+	auto pc = make_shared<PointCloud>();
+	pc->path = obj->path;
+	pc->mappedFile = obj->mappedFile;
+	pc->obj = obj;
+	pc->numPoints = obj->numPoints;
+	pc->boxMin = obj->bounds.min;
+	pc->boxMax = obj->bounds.max;
 
-	thread t([ref](){
+	return pc;
+}
 
-		while(true){
+shared_ptr<PointCloud> point_cloud_from_ply(shared_ptr<PlyFile> ply){
 
-			std::this_thread::sleep_for(10ms);
+	auto pc = make_shared<PointCloud>();
+	pc->path = ply->path;
+	pc->mappedFile = ply->mappedFile;
+	pc->ply = ply;
+	pc->numPoints = ply->numPoints;
+	pc->offsetToPointData = ply->vertexOffset;
+	pc->bytesPerPoint = ply->layout.stride;
+	pc->boxMin = ply->bounds.min;
+	pc->boxMax = ply->bounds.max;
 
-			unique_lock<mutex> lock_load(ref->mtx_load);
-			
-			if(ref->loadTasks.size() == 0){
-				lock_load.unlock();
+	return pc;
+}
 
-				continue;
-			}
+shared_ptr<PointCloud> point_cloud_from_procedural(shared_ptr<ProceduralSource> source){
 
-			auto task = ref->loadTasks.back();
-			ref->loadTasks.pop_back();
+	auto pc = make_shared<PointCloud>();
+	pc->path = source->path;
+	pc->procedural = source;
+	pc->numPoints = source->numPoints;
+	pc->boxMin = source->bounds.min;
+	pc->boxMax = source->bounds.max;
 
-			lock_load.unlock();
+	return pc;
+}
 
-			shared_ptr<LoadResult> result = nullptr; 
-			
+PointCloudLoader::PointCloudLoader(shared_ptr<Renderer> renderer, int ioQueueDepth, int numThreads){
 
-			if(iEndsWith(task.lasfile->path, "las")){
-				result = load_pointcloud_from_file(task.lasfile, task.firstPoint, task.numPoints);
-			}
-			UploadTask uploadTask;
-			uploadTask.lasfile = task.lasfile;
-			uploadTask.sparse_pointOffset = result->sparse_pointOffset;
-			uploadTask.numPoints = task.numPoints;
-			uploadTask.numBatches = result->numBatches;
-			uploadTask.bXyzLow = result->bXyzLow;
-			uploadTask.bXyzMed = result->bXyzMed;
-			uploadTask.bXyzHig = result->bXyzHig;
-			uploadTask.bColors = result->bColors;
-			uploadTask.bBatches = result->bBatches;
-			
-			unique_lock<mutex> lock_upload(ref->mtx_upload);
-			ref->uploadTasks.push_back(uploadTask);
-			lock_upload.unlock();
+	this->renderer = renderer;
+	this->ioQueueDepth = ioQueueDepth;
+
+	if(renderer){ // create (sparse) buffers
+		int pageSize = 0;
+		glGetIntegerv(GL_SPARSE_BUFFER_PAGE_SIZE_ARB, &pageSize);
+		PAGE_SIZE = pageSize;
+		residency.pageSize = PAGE_SIZE;
+
+		this->ssLoadBuffer = renderer->createBuffer(200 * MAX_POINTS_PER_BATCH);
+	}
+
+	auto cpuData = getCpuData();
+
+	if(numThreads <= 0){
+		if(cpuData.numProcessors == 1) numThreads = 1;
+		if(cpuData.numProcessors == 2) numThreads = 1;
+		if(cpuData.numProcessors == 3) numThreads = 2;
+		if(cpuData.numProcessors == 4) numThreads = 3;
+		if(cpuData.numProcessors == 5) numThreads = 4;
+		if(cpuData.numProcessors == 6) numThreads = 4;
+		if(cpuData.numProcessors == 7) numThreads = 5;
+		if(cpuData.numProcessors == 8) numThreads = 5;
+		if(cpuData.numProcessors  > 8) numThreads = (cpuData.numProcessors / 2) + 1;
+	}
+
+	this->numThreads = numThreads;
+
+	// bounds the memory of chunks that are being read, decoded or wait for upload
+	maxTasksInFlight = 2 * numThreads + ioQueueDepth;
+
+	// every in-flight task is in at most one queue, so pushing never blocks
+	decodeQueue = make_shared<RingQueue<DecodeTask>>(maxTasksInFlight);
+	uploadQueue = make_shared<RingQueue<UploadTask>>(maxTasksInFlight);
 
+	// every in-flight task holds at most one read buffer, so submitting never blocks on buffers
+	reader = createChunkReader(ioQueueDepth, maxTasksInFlight);
+
+	// enough for the buffers of all in-flight chunks of LAS and LAZ files
+	bufferPool = make_shared<BufferPool>(512 * 1024 * 1024);
+
+	cout << "async reads with " << reader->name << ", queue depth: " << ioQueueDepth << endl;
+
+	cout << "start loading points with " << numThreads << " threads, encoding with " << toString(SIMD_LEVEL) << endl;
+
+	spawnLoader();
+}
+
+PointCloudLoader::~PointCloudLoader(){
+
+	{ // headers that are still being read
+		lock_guard<mutex> lock(mtx_add);
+
+		for(auto& request : addRequests){
+			request.worker.join();
 		}
-		
+	}
+
+	{
+		unique_lock<mutex> lock(mtx_load);
+		isClosing = true;
+	}
+	cv_load.notify_all();
+	decodeQueue->close();
+
+	readerThread.join();
+
+	for(auto& t : loaderThreads){
+		t.join();
+	}
+}
+
+void PointCloudLoader::add(vector<string> files, std::function<void(vector<shared_ptr<PointCloud>>)> callback, ReadMode readMode){
+
+	vector<shared_ptr<PointCloud>> pcs = addFiles(files, readMode);
+
+	publishFiles();
+
+	callback(pcs);
+}
+
+shared_future<vector<shared_ptr<PointCloud>>> PointCloudLoader::addAsync(vector<string> files, ReadMode readMode){
+
+	auto promise = make_shared<std::promise<vector<shared_ptr<PointCloud>>>>();
+	shared_future<vector<shared_ptr<PointCloud>>> future = promise->get_future().share();
+
+	lock_guard<mutex> lock(mtx_add);
+
+	AddRequest request;
+	request.result = future;
+	request.worker = thread([this, files, readMode, promise](){
+		promise->set_value(addFiles(files, readMode));
 	});
-	t.detach();
 
+	addRequests.push_back(std::move(request));
+
+	return future;
 }
 
-void PointCloudLoader::process(){
+vector<shared_ptr<PointCloud>> PointCloudLoader::addFiles(vector<string> files, ReadMode readMode){
+
+	vector<shared_ptr<PointCloud>> pcs;
+	mutex mtx_lasfiles;
+
+	struct Task{
+		string file;
+	};
 
-	// static int numProcessed = 0;
+	auto ref = this;
 
-	// FETCH TASK
-	unique_lock<mutex> lock(mtx_upload);
-	// unique_lock<mutex> lock_dbg(mtx_debug);
+	auto processor = [ref, &pcs, &mtx_lasfiles, readMode](shared_ptr<Task> task){
 
-	if(uploadTasks.size() == 0){
-		return;
-	}
+		bool isCache = iEndsWith(task->file, "t2g");
+		bool isObj = iEndsWith(task->file, "obj");
+		bool isPly = iEndsWith(task->file, "ply");
+		bool isProcedural = is_procedural_path(task->file);
+
+		if(!iEndsWith(task->file, "las") && !iEndsWith(task->file, "laz") && !isCache && !isObj && !isPly && !isProcedural){
+			GENERATE_WARN_MESSAGE << "unsupported file format, skipping " << task->file << endl;
 
-	auto task = uploadTasks.back();
-	uploadTasks.pop_back();
+			return;
+		}
 
-	lock.unlock();
+		// an up-to-date .t2g next to the source file replaces it
+		shared_ptr<BatchCache> cache = nullptr;
+		if(isCache){
+			cache = open_batch_cache(task->file);
 
-	// UPLOAD DATA TO GPU
+			if(!cache){
+				GENERATE_WARN_MESSAGE << "could not open, skipping " << task->file << endl;
 
-	{ // commit physical memory in sparse buffers
-		int64_t offset = 4 * task.sparse_pointOffset;
-		int64_t pageAlignedOffset = offset - (offset % PAGE_SIZE);
+				return;
+			}
+		}else if(!isObj && !isPly && !isProcedural){
+			cache = open_batch_cache(batch_cache_path(task->file), task->file);
+		}
 
-		int64_t size = 4 * task.numPoints;
-		int64_t pageAlignedSize = size - (size % PAGE_SIZE) + PAGE_SIZE;
-		pageAlignedSize = std::min(pageAlignedSize, 4 * MAX_POINTS);
+		shared_ptr<ObjFile> obj = nullptr;
+		if(isObj && !cache){
+			obj = index_obj(task->file, MAX_POINTS_PER_BATCH, getCpuData().numProcessors);
 
-		//cout << "commiting, offset: " << formatNumber(pageAlignedOffset) << ", size: " << formatNumber(pageAlignedSize) << endl;
+			if(!obj){
+				GENERATE_WARN_MESSAGE << "could not open, skipping " << task->file << endl;
 
-		for(auto glBuffer : {ssXyzLow, ssXyzMed, ssXyzHig, ssColors}){
-			glBindBuffer(GL_SHADER_STORAGE_BUFFER, glBuffer.handle);
-			glBufferPageCommitmentARB(GL_SHADER_STORAGE_BUFFER, pageAlignedOffset, pageAlignedSize, GL_TRUE);
-			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+				return;
+			}
 		}
-	}
-	// upload batch metadata
-	glNamedBufferSubData(ssBatches.handle, 
-		64 * this->numBatchesLoaded, 
-		task.bBatches->size, 
-		task.bBatches->data);
 
-	// upload batch points
-	glNamedBufferSubData(ssXyzLow.handle, 4 * task.sparse_pointOffset, 4 * task.numPoints, task.bXyzLow->data);
-	glNamedBufferSubData(ssXyzMed.handle, 4 * task.sparse_pointOffset, 4 * task.numPoints, task.bXyzMed->data);
-	glNamedBufferSubData(ssXyzHig.handle, 4 * task.sparse_pointOffset, 4 * task.numPoints, task.bXyzHig->data);
-	glNamedBufferSubData(ssColors.handle, 4 * task.sparse_pointOffset, 4 * task.numPoints, task.bColors->data);
+		shared_ptr<PlyFile> ply = nullptr;
+		if(isPly){
+			ply = read_ply(task->file, MAX_POINTS_PER_BATCH);
 
-	//cout << "uploading, offset: " << formatNumber(4 * task.sparse_pointOffset) << ", size: " << formatNumber(4 * task.numPoints) << endl;
+			if(!ply){
+				GENERATE_WARN_MESSAGE << "could not load, skipping " << task->file << endl;
+
+				return;
+			}
+		}
 
-	this->numBatchesLoaded += task.numBatches;
-	this->numPointsLoaded += task.numPoints;
-	task.lasfile->numPointsLoaded += task.numPoints;
+		shared_ptr<ProceduralSource> procedural = nullptr;
+		if(isProcedural){
+			procedural = parse_procedural(task->file, MAX_POINTS_PER_BATCH);
 
-}
\ No newline at end of file
+			if(!procedural){
+				return;
+			}
+		}
+
+		// the catalog already validated the header, unless the file changed since
+		bool isLas = !cache && !obj && !ply && !procedural;
+		const CatalogEntry* entry = ref->catalog && isLas ? ref->catalog->find(task->file) : nullptr;
+
+		if(entry && !entry->isValid()){
+			GENERATE_WARN_MESSAGE << "invalid file (" << entry->error << "), skipping " << task->file << endl;
+
+			return;
+		}
+
+		shared_ptr<PointCloud> lasfile = nullptr;
+		if(cache){
+			lasfile = point_cloud_from_cache(cache);
+		}else if(obj){
+			lasfile = point_cloud_from_obj(obj);
+		}else if(ply){
+			lasfile = point_cloud_from_ply(ply);
+		}else if(procedural){
+			lasfile = point_cloud_from_procedural(procedural);
+		}else if(entry){
+			lasfile = point_cloud_from_catalog(*entry);
+		}else{
+			lasfile = read_las_header(task->file);
+		}
+
+		if(isLas && !isSupportedLasFormat(lasfile->pointFormat, lasfile->bytesPerPoint)){
+			GENERATE_WARN_MESSAGE << "unsupported point format " << lasfile->pointFormat 
+				<< " (" << lasfile->bytesPerPoint << " bytes per point), skipping " << task->file << endl;
+
+			return;
+		}
+
+		// only files that passed all checks take an index, skipped files would leave holes
+		lasfile->fileIndex = ref->allocateFileIndex();
+		lasfile->readMode = readMode;
+		lasfile->numBatches = lasfile->numPoints / POINTS_PER_WORKGROUP + 1;
+
+		{
+			unique_lock<mutex> lock1(mtx_lasfiles);
+
+			pcs.push_back(lasfile);
+
+			stringstream ss;
+			ss << "load file " << task->file << endl;
+			ss << "numPoints: " << lasfile->numPoints << "\n";
+			ss << "numBatches: " << lasfile->numBatches << "\n";
+
+			cout << ss.str() << endl;
+		}
+
+		// sampling bounds touches the file, do it before locking out the frame loop
+		vector<LoadTask> tasks;
+		int64_t pointsPerTask = points_per_task(lasfile);
+
+		// the chunks of a .t2g file, with their exact bounds
+		if(cache){
+			lasfile->numBatches = 0;
+
+			for(const BatchCacheChunk& chunk : cache->chunks){
+				if(chunk.numPoints == 0){
+					continue;
+				}
+
+				LoadTask task;
+				task.lasfile = lasfile;
+				task.readMode = readMode;
+				task.firstPoint = chunk.firstPoint;
+				task.numPoints = chunk.numPoints;
+				task.bounds.min = {chunk.min[0], chunk.min[1], chunk.min[2]};
+				task.bounds.max = {chunk.max[0], chunk.max[1], chunk.max[2]};
+
+				tasks.push_back(task);
+				lasfile->numBatches += chunk.numBatches;
+			}
+		}
+
+		// the chunks of the OBJ index, with the bounds of their sampled vertices
+		if(obj){
+			for(const ObjChunk& chunk : obj->chunks){
+				LoadTask task;
+				task.lasfile = lasfile;
+				task.readMode = readMode;
+				task.firstPoint = chunk.firstPoint;
+				task.numPoints = chunk.numPoints;
+				task.bounds = chunk.bounds;
+
+				tasks.push_back(task);
+			}
+		}
+
+		// the chunks of a PLY file, with the bounds of their sampled vertices
+		if(ply){
+			for(const PlyChunk& chunk : ply->chunks){
+				LoadTask task;
+				task.lasfile = lasfile;
+				task.readMode = readMode;
+				task.firstPoint = chunk.firstPoint;
+				task.numPoints = chunk.numPoints;
+				task.bounds = chunk.bounds;
+
+				tasks.push_back(task);
+			}
+		}
+
+		// one chunk per tile of a procedural source, with the bounds that its points can have
+		if(procedural){
+			for(int64_t tile = 0; tile < procedural->numTiles; tile++){
+				LoadTask task;
+				task.lasfile = lasfile;
+				task.readMode = readMode;
+				task.firstPoint = tile * procedural->pointsPerTile;
+				task.numPoints = std::min(procedural->pointsPerTile, procedural->numPoints - task.firstPoint);
+				task.bounds = procedural_tile_bounds(*procedural, tile);
+
+				tasks.push_back(task);
+			}
+		}
+
+		for(int64_t pointOffset = 0; pointOffset < lasfile->numPoints && isLas; pointOffset += pointsPerTask){
+
+			int64_t remaining = lasfile->numPoints - pointOffset;
+			int64_t pointsInBatch = min(pointsPerTask, remaining);
+
+			LoadTask task;
+			task.lasfile = lasfile;
+			task.readMode = readMode;
+			task.firstPoint = pointOffset;
+			task.numPoints = pointsInBatch;
+			task.bounds = estimate_chunk_bounds(lasfile, pointOffset, pointsInBatch);
+
+			tasks.push_back(task);
+		}
+
+		{ // queue load tasks
+			unique_lock<mutex> lock2(ref->mtx_load);
+
+			for(LoadTask& task : tasks){
+				task.sparse_pointOffset = ref->allocatePoints(task.numPoints);
+				task.order = task.sparse_pointOffset;
+
+				lasfile->pointRanges.push_back({task.sparse_pointOffset, task.numPoints});
+
+				ref->loadTasks.push(task);
+			}
+
+			if(tasks.size() > 0){
+				lasfile->sparse_point_offset = tasks[0].sparse_pointOffset;
+			}
+
+			// the frame loop takes it from here, see publishFiles()
+			ref->addedFiles.push_back(lasfile);
+		}
+
+		ref->cv_load.notify_all();
+
+	};
+
+	auto cpuData = getCpuData();
+	int numThreads = cpuData.numProcessors;
+
+	TaskPool<Task> pool(numThreads, processor);
+
+	for(auto file : files){
+		auto task = make_shared<Task>();
+		task->file = file;
+
+		pool.addTask(task);
+	}
+
+	pool.close();
+	pool.waitTillEmpty();
+
+	return pcs;
+}
+
+int64_t PointCloudLoader::allocateFileIndex(){
+
+	lock_guard<mutex> lock(mtx_load);
+
+	if(freeFileIndices.size() > 0){
+		int64_t fileIndex = freeFileIndices.back();
+		freeFileIndices.pop_back();
+
+		return fileIndex;
+	}
+
+	int64_t fileIndex = numFiles;
+	numFiles++;
+
+	return fileIndex;
+}
+
+void PointCloudLoader::publishFiles(){
+
+	{
+		lock_guard<mutex> lock(mtx_load);
+
+		for(auto pc : addedFiles){
+			files.push_back(pc);
+			numPoints += pc->numPoints;
+			numBatches += pc->numBatches;
+		}
+
+		addedFiles.clear();
+	}
+
+	{ // join add threads that are done
+		lock_guard<mutex> lock(mtx_add);
+
+		for(auto it = addRequests.begin(); it != addRequests.end();){
+			bool isDone = it->result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+
+			if(isDone){
+				it->worker.join();
+				it = addRequests.erase(it);
+			}else{
+				it++;
+			}
+		}
+	}
+}
+
+void PointCloudLoader::remove(shared_ptr<PointCloud> pc){
+
+	// chunks that are currently read or decoded are dropped once they reach process()
+	pc->isRemoved = true;
+
+	{ // cancel queued chunks, recycle the file index and addresses
+		lock_guard<mutex> lock(mtx_load);
+
+		loadTasks.removeIf([pc](const LoadTask& task){
+			return task.lasfile == pc;
+		});
+
+		auto it = std::find(addedFiles.begin(), addedFiles.end(), pc);
+		if(it != addedFiles.end()){
+			addedFiles.erase(it);
+		}
+
+		for(PointRange range : pc->pointRanges){
+			freePoints(range);
+		}
+		pc->pointRanges.clear();
+
+		freeFileIndices.push_back(pc->fileIndex);
+	}
+
+	// close the cached file handles, so that fds don't pile up and a rewritten file that is added again isn't read
+	// through the old handle. chunks that were submitted before isRemoved was set keep their handle until they are read
+	reader->close(pc->path);
+
+	auto it = std::find(files.begin(), files.end(), pc);
+	if(it != files.end()){
+		files.erase(it);
+
+		numPoints -= pc->numPoints;
+		numBatches -= pc->numBatches;
+		numPointsLoaded -= pc->numPointsLoaded;
+	}
+
+	// free the batch slots of the file, so that the shaders skip them until they are reused
+	vector<PageRange> decommit;
+	vector<int64_t> slots = residency.remove(pc, decommit);
+
+	numBatchesLoaded -= slots.size();
+
+	if(renderer){
+		commitPages(decommit, false);
+	}
+
+	for(int64_t i = 0; i < slots.size();){
+
+		// runs of consecutive records within a batch table are cleared at once
+		int64_t numSlots = 1;
+		while(i + numSlots < slots.size() && isSlotRun(slots[i], slots[i + numSlots], numSlots)){
+			numSlots++;
+		}
+
+		BatchLocation location = batchLocations[slots[i]];
+		PointSegment& segment = segments[location.segment];
+
+		auto records = make_shared<Buffer>(64 * numSlots);
+		memset(records->data, 0, records->size);
+		for(int64_t j = 0; j < numSlots; j++){
+			records->set<uint32_t>(uint32_t(BatchState::FREE), 64 * j);
+		}
+
+		if(renderer){
+			glNamedBufferSubData(segment.ssBatches.handle, 64 * location.index, records->size, records->data);
+		}
+
+		if(hasHostBuffers()){
+			memcpy(segment.host.batches->data_u8 + 64 * location.index, records->data, records->size);
+		}
+
+		freeSlots.push_back({slots[i], numSlots});
+
+		i += numSlots;
+	}
+}
+
+void PointCloudLoader::spawnLoader(){
+
+	auto ref = this;
+
+	// READ STAGE
+	// - assigns tickets and keeps up to ioQueueDepth async reads in flight
+	// - mapped chunks are passed on to the decoders right away
+	readerThread = thread([ref](){
+
+		auto reader = ref->reader;
+
+		struct Reading{
+			LoadTask task;
+			double tStart;
+		};
+
+		// reads that are currently in flight, by ticket
+		map<int64_t, Reading> reading;
+		bool wasStalled = false;
+
+		auto canStartTask = [ref, reader](){
+			bool workAvailable = ref->loadTasks.size() > 0;
+			bool hasCapacity = ref->numTasksInFlight < ref->maxTasksInFlight;
+			bool hasReadSlot = reader->numInFlight < reader->queueDepth;
+
+			return workAvailable && hasCapacity && hasReadSlot;
+		};
+
+		while(true){
+
+			unique_lock<mutex> lock_load(ref->mtx_load);
+
+			bool readsPending = reader->numInFlight > 0;
+
+			bool isStalled = ref->loadTasks.size() > 0 && ref->numTasksInFlight >= ref->maxTasksInFlight;
+			if(isStalled && !wasStalled){
+				ref->numBackpressureStalls++;
+			}
+			wasStalled = isStalled;
+
+			if(!readsPending){
+				ref->cv_load.wait(lock_load, [ref, &canStartTask](){
+					return ref->isClosing || canStartTask();
+				});
+			}
+
+			if(ref->isClosing){
+				break;
+			}
+
+			if(canStartTask()){
+				auto task = ref->loadTasks.pop();
+
+				int64_t ticket = ref->nextTicket;
+				ref->nextTicket++;
+				ref->numTasksInFlight++;
+
+				// laszip reads compressed files itself, .t2g, OBJ and ASCII PLY files are always mapped, procedural sources have no file,
+				// and chunks of removed files are dropped by the decoders.
+				// binary PLY vertices are read like LAS records, unless they start beyond the 32 bits of offsetToPointData
+				auto ply = task.lasfile->ply;
+				bool isMappedPly = ply && (ply->format == PlyFormat::ASCII || ply->vertexOffset > UINT32_MAX);
+				bool isDecodedInPlace = task.readMode == ReadMode::MAPPED || task.lasfile->isCompressed || task.lasfile->cache || task.lasfile->obj || isMappedPly || task.lasfile->procedural || task.lasfile->isRemoved;
+
+				if(isDecodedInPlace){
+					lock_load.unlock();
+					ref->decodeQueue->push({task, ticket, ChunkRead()});
+				}else{
+					lock_load.unlock();
+
+					auto pc = task.lasfile;
+					int64_t byteOffset = pc->offsetToPointData + task.firstPoint * pc->bytesPerPoint;
+					int64_t byteSize = task.numPoints * pc->bytesPerPoint;
+
+					bool unbuffered = task.readMode == ReadMode::DIRECT;
+
+					reading[ticket] = {task, now()};
+					reader->submit(pc->path, byteOffset, byteSize, ticket, unbuffered);
+
+					// the file may have been removed after the check above, and its handles closed before
+					// submit() opened them again
+					if(pc->isRemoved){
+						reader->close(pc->path);
+					}
+				}
+
+				// fill the queue before waiting for completions
+				continue;
+			}
+
+			lock_load.unlock();
+
+			if(readsPending){
+				ChunkRead read = reader->wait();
+
+				auto it = reading.find(read.tag);
+				LoadTask task = it->second.task;
+				double duration = now() - it->second.tStart;
+				reading.erase(it);
+
+				ReadStats& stats = ref->readStats[int(task.readMode)];
+				stats.numChunks++;
+				stats.numBytes += read.size;
+				stats.readNanos += int64_t(duration * 1'000'000'000.0);
+
+				ref->decodeQueue->push({task, read.tag, read});
+			}
+		}
+
+		// the kernel may still write into read buffers, wait for them before they are freed
+		while(reader->numInFlight > 0){
+			ChunkRead read = reader->wait();
+			reader->release(read);
+		}
+
+	});
+
+	// DECODE STAGE
+	for(int i = 0; i < numThreads; i++){
+
+		loaderThreads.emplace_back([ref](){
+
+			while(true){
+
+				DecodeTask decodeTask;
+				
+				if(!ref->decodeQueue->pop(decodeTask)){
+					break;
+				}
+
+				LoadTask& task = decodeTask.task;
+				int64_t ticket = decodeTask.ticket;
+				ChunkRead& read = decodeTask.read;
+
+				shared_ptr<LoadResult> result = nullptr;
+				bool isCompressed = task.lasfile->isCompressed;
+				bool isCache = task.lasfile->cache != nullptr;
+				bool isObj = task.lasfile->obj != nullptr;
+				bool isPly = task.lasfile->ply != nullptr;
+				bool isProcedural = task.lasfile->procedural != nullptr;
+				ReadStats& stats = isCache ? ref->cacheStats 
+					: isObj ? ref->objStats 
+					: isPly ? ref->plyStats 
+					: isProcedural ? ref->proceduralStats 
+					: isCompressed ? ref->lazStats 
+					: ref->readStats[int(task.readMode)];
+				double tStart = now();
+
+				if(task.lasfile->isRemoved){
+					// only passed on to keep the ticket order, process() drops it
+					result = make_shared<LoadResult>();
+					result->bBatches = make_shared<Buffer>(0);
+					result->sparse_pointOffset = task.sparse_pointOffset;
+					result->numPoints = 0;
+					result->numBatches = 0;
+
+					if(read.data){
+						ref->reader->release(read);
+					}
+				}else if(isCache){
+					result = load_pointcloud_from_cache(task.lasfile, task.firstPoint, task.numPoints, task.sparse_pointOffset, ref->bufferPool);
+
+					stats.numChunks++;
+					stats.numBytes += result->bBatches->size + 16 * result->numPoints;
+				}else if(isObj){
+					result = load_pointcloud_from_obj(task.lasfile, task.firstPoint, task.numPoints, task.sparse_pointOffset, ref->bufferPool);
+
+					// lines have no fixed size, assume the average
+					double bytesPerVertex = double(task.lasfile->mappedFile->size) / double(std::max(task.lasfile->numPoints, int64_t(1)));
+
+					stats.numChunks++;
+					stats.numBytes += int64_t(bytesPerVertex * double(result->numPoints));
+				}else if(isProcedural){
+					result = load_pointcloud_from_procedural(task.lasfile, task.firstPoint, task.numPoints, task.sparse_pointOffset, ref->bufferPool);
+
+					// what a file of the same points would have to provide, xyz as doubles and colors
+					stats.numChunks++;
+					stats.numBytes += 28 * result->numPoints;
+				}else if(isPly){
+					auto ply = task.lasfile->ply;
+					const uint8_t* records = nullptr;
+					int64_t numPoints = task.numPoints;
+
+					if(read.data){
+						// the read comes up short at the end of truncated files
+						records = read.data;
+						numPoints = std::min(task.numPoints, read.size / ply->layout.stride);
+					}else if(ply->format != PlyFormat::ASCII){
+						records = ply->mappedFile->data + ply->vertexOffset + task.firstPoint * ply->layout.stride;
+						ply->mappedFile->adviseWillNeed(records - ply->mappedFile->data, numPoints * ply->layout.stride);
+					}
+
+					result = load_pointcloud_from_ply(task.lasfile, records, task.firstPoint, numPoints, task.sparse_pointOffset, ref->bufferPool);
+
+					if(read.data){
+						ref->reader->release(read);
+					}
+
+					// ASCII lines have no fixed size, assume the average
+					double bytesPerVertex = ply->format == PlyFormat::ASCII
+						? double(ply->mappedFile->size - ply->vertexOffset) / double(ply->numPoints)
+						: double(ply->layout.stride);
+
+					stats.numChunks++;
+					stats.numBytes += int64_t(bytesPerVertex * double(result->numPoints));
+				}else if(isCompressed){
+					result = load_pointcloud_from_laz(task.lasfile, task.firstPoint, task.numPoints, task.sparse_pointOffset, ref->bufferPool);
+
+					stats.numChunks++;
+					stats.numBytes += result->numPoints * task.lasfile->bytesPerPoint;
+				}else if(task.readMode == ReadMode::MAPPED){
+					result = load_pointcloud_from_file(task.lasfile, task.firstPoint, task.numPoints, task.sparse_pointOffset, ref->bufferPool);
+
+					stats.numChunks++;
+					stats.numBytes += result->numPoints * task.lasfile->bytesPerPoint;
+				}else{
+					// the read comes up short at the end of truncated files
+					int64_t numPoints = std::min(task.numPoints, read.size / int64_t(task.lasfile->bytesPerPoint));
+
+					result = encode_points(task.lasfile, read.data, task.firstPoint, numPoints, task.sparse_pointOffset, ref->bufferPool);
+
+					ref->reader->release(read);
+				}
+
+				stats.decodeNanos += int64_t((now() - tStart) * 1'000'000'000.0);
+
+				UploadTask uploadTask;
+				uploadTask.lasfile = task.lasfile;
+				uploadTask.firstPoint = task.firstPoint;
+				uploadTask.sparse_pointOffset = result->sparse_pointOffset;
+				uploadTask.numPoints = result->numPoints;
+				uploadTask.numBatches = result->numBatches;
+				uploadTask.bXyzLow = result->bXyzLow;
+				uploadTask.bXyzMed = result->bXyzMed;
+				uploadTask.bXyzHig = result->bXyzHig;
+				uploadTask.bColors = result->bColors;
+				uploadTask.bBatches = result->bBatches;
+				uploadTask.batchSlot = task.batchSlot;
+
+				ref->backlogBytes += result->bBatches->size + 16 * result->numPoints;
+				
+				unique_lock<mutex> lock_upload(ref->mtx_upload);
+
+				ref->pendingUploads[ticket] = uploadTask;
+
+				// release finished tasks in the same order in which they were dequeued
+				while(ref->pendingUploads.count(ref->nextUploadTicket) > 0){
+					auto it = ref->pendingUploads.find(ref->nextUploadTicket);
+
+					ref->uploadQueue->push(it->second);
+					ref->pendingUploads.erase(it);
+					ref->nextUploadTicket++;
+				}
+
+				lock_upload.unlock();
+			}
+			
+		});
+	}
+
+}
+
+int64_t PointCloudLoader::allocatePoints(int64_t numPoints){
+
+	// addresses of removed files first
+	for(int64_t i = 0; i < freePointRanges.size(); i++){
+		PointRange range = freePointRanges[i];
+
+		int64_t address = range.first;
+		int64_t segmentEnd = (address / POINTS_PER_SEGMENT + 1) * POINTS_PER_SEGMENT;
+
+		if(address + numPoints > segmentEnd){
+			address = segmentEnd;
+		}
+
+		if(address + numPoints > range.first + range.count){
+			continue;
+		}
+
+		PointRange before = {range.first, address - range.first};
+		PointRange after = {address + numPoints, range.first + range.count - address - numPoints};
+
+		freePointRanges.erase(freePointRanges.begin() + i);
+		if(after.count > 0) freePointRanges.insert(freePointRanges.begin() + i, after);
+		if(before.count > 0) freePointRanges.insert(freePointRanges.begin() + i, before);
+
+		return address;
+	}
+
+	int64_t address = nextPointAddress;
+	int64_t segmentEnd = (address / POINTS_PER_SEGMENT + 1) * POINTS_PER_SEGMENT;
+
+	// skip the rest of the segment rather than splitting the chunk
+	if(address + numPoints > segmentEnd){
+		address = segmentEnd;
+	}
+
+	PointRange skipped = {nextPointAddress, address - nextPointAddress};
+	nextPointAddress = address + numPoints;
+
+	// the skipped rest is free for smaller chunks, and merges with freed neighbours so that
+	// the address space shrinks back to 0 once all files are removed
+	if(skipped.count > 0){
+		freePoints(skipped);
+	}
+
+	return address;
+}
+
+void PointCloudLoader::freePoints(PointRange range){
+
+	auto it = std::lower_bound(freePointRanges.begin(), freePointRanges.end(), range, [](PointRange a, PointRange b){
+		return a.first < b.first;
+	});
+	it = freePointRanges.insert(it, range);
+
+	// merge with adjacent free ranges
+	if(it + 1 != freePointRanges.end() && it->first + it->count == (it + 1)->first){
+		it->count += (it + 1)->count;
+		freePointRanges.erase(it + 1);
+	}
+	if(it != freePointRanges.begin() && (it - 1)->first + (it - 1)->count == it->first){
+		(it - 1)->count += it->count;
+		it = freePointRanges.erase(it) - 1;
+	}
+
+	// free ranges at the end shrink the address space
+	if(it->first + it->count == nextPointAddress){
+		nextPointAddress = it->first;
+		freePointRanges.erase(it);
+	}
+}
+
+PointSegment& PointCloudLoader::getSegment(int64_t index){
+
+	while(segments.size() <= index){
+		PointSegment segment;
+
+		if(renderer){
+			// enough for a full segment, grows if it has many partially filled batches
+			int64_t numBatches = 2 * POINTS_PER_SEGMENT / POINTS_PER_WORKGROUP;
+
+			segment.ssBatches = renderer->createBuffer(64 * numBatches);
+			segment.ssXyzLow = renderer->createSparseBuffer(4 * int64_t(POINTS_PER_SEGMENT));
+			segment.ssXyzMed = renderer->createSparseBuffer(4 * int64_t(POINTS_PER_SEGMENT));
+			segment.ssXyzHig = renderer->createSparseBuffer(4 * int64_t(POINTS_PER_SEGMENT));
+			segment.ssColors = renderer->createSparseBuffer(4 * int64_t(POINTS_PER_SEGMENT));
+
+			GLuint zero = 0;
+			glClearNamedBufferData(segment.ssBatches.handle, GL_R32UI, GL_RED, GL_UNSIGNED_INT, &zero);
+		}
+
+		segments.push_back(segment);
+	}
+
+	return segments[index];
+}
+
+bool PointCloudLoader::isSlotRun(int64_t firstSlot, int64_t slot, int64_t offset){
+
+	BatchLocation first = batchLocations[firstSlot];
+	BatchLocation location = batchLocations[slot];
+
+	return slot == firstSlot + offset
+		&& location.segment == first.segment
+		&& location.index == first.index + offset;
+}
+
+int64_t PointCloudLoader::placeBatches(UploadTask& task){
+
+	// re-streamed batches go where they were before
+	if(task.batchSlot >= 0){
+		return task.batchSlot;
+	}
+
+	int64_t segmentIndex = task.sparse_pointOffset / POINTS_PER_SEGMENT;
+
+	// slots of removed files, in the batch table of the same segment
+	for(auto it = freeSlots.begin(); it != freeSlots.end(); it++){
+		if(it->numSlots < task.numBatches || batchLocations[it->firstSlot].segment != segmentIndex){
+			continue;
+		}
+
+		int64_t batchSlot = it->firstSlot;
+		it->firstSlot += task.numBatches;
+		it->numSlots -= task.numBatches;
+
+		if(it->numSlots == 0){
+			freeSlots.erase(it);
+		}
+
+		return batchSlot;
+	}
+
+	PointSegment& segment = getSegment(segmentIndex);
+	int64_t requiredSize = 64 * (segment.numBatches + task.numBatches);
+
+	if(renderer && segment.ssBatches.size < requiredSize){
+		GLBuffer grown = renderer->createBuffer(std::max(requiredSize, 2 * segment.ssBatches.size));
+
+		GLuint zero = 0;
+		glClearNamedBufferData(grown.handle, GL_R32UI, GL_RED, GL_UNSIGNED_INT, &zero);
+		glCopyNamedBufferSubData(segment.ssBatches.handle, grown.handle, 0, 0, segment.ssBatches.size);
+		glDeleteBuffers(1, &segment.ssBatches.handle);
+
+		segment.ssBatches = grown;
+	}
+
+	int64_t batchSlot = batchLocations.size();
+
+	for(int64_t i = 0; i < task.numBatches; i++){
+		batchLocations.push_back({segmentIndex, segment.numBatches + i});
+	}
+	segment.numBatches += task.numBatches;
+
+	return batchSlot;
+}
+
+// per-batch residency info of a decoded chunk
+vector<BatchResidency> residencyOf(PointCloudLoader::UploadTask& task){
+
+	vector<BatchResidency> batches;
+	auto pc = task.lasfile;
+	int64_t filePointOffset = task.firstPoint;
+	int64_t sparsePointOffset = task.sparse_pointOffset;
+
+	for(int64_t i = 0; i < task.numBatches; i++){
+		BatchResidency batch;
+		batch.pc = pc;
+		batch.numPoints = task.bBatches->get<uint32_t>(64 * i + 28);
+		batch.sparsePointOffset = sparsePointOffset;
+		batch.filePointOffset = filePointOffset;
+		batch.bounds.min = pc->boxMin + dvec3(
+			task.bBatches->get<float>(64 * i + 4),
+			task.bBatches->get<float>(64 * i + 8),
+			task.bBatches->get<float>(64 * i + 12));
+		batch.bounds.max = pc->boxMin + dvec3(
+			task.bBatches->get<float>(64 * i + 16),
+			task.bBatches->get<float>(64 * i + 20),
+			task.bBatches->get<float>(64 * i + 24));
+
+		batches.push_back(batch);
+
+		filePointOffset += batch.numPoints;
+		sparsePointOffset += batch.numPoints;
+	}
+
+	return batches;
+}
+
+void PointCloudLoader::commitPages(vector<PageRange>& pages, bool commit){
+
+	int64_t segmentSize = 4 * int64_t(POINTS_PER_SEGMENT);
+
+	for(PageRange range : pages){
+		int64_t begin = range.firstPage * PAGE_SIZE;
+		int64_t end = (range.firstPage + range.numPages) * PAGE_SIZE;
+
+		// ranges of consecutive pages may continue in the next segment
+		while(begin < end){
+			int64_t segmentIndex = begin / segmentSize;
+			int64_t offset = begin - segmentIndex * segmentSize;
+			int64_t size = std::min(end - begin, segmentSize - offset);
+
+			PointSegment& segment = getSegment(segmentIndex);
+
+			for(auto glBuffer : {segment.ssXyzLow, segment.ssXyzMed, segment.ssXyzHig, segment.ssColors}){
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, glBuffer.handle);
+				glBufferPageCommitmentARB(GL_SHADER_STORAGE_BUFFER, offset, size, commit ? GL_TRUE : GL_FALSE);
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+			}
+
+			begin += size;
+		}
+	}
+}
+
+void PointCloudLoader::updateResidency(){
+
+	ResidencyUpdate update = residency.update();
+
+	// evicted batches stay in the batch table, the shaders skip them
+	for(int64_t slot : update.evicted){
+		uint32_t state = uint32_t(BatchState::EVICTED);
+		BatchLocation location = batchLocations[slot];
+		PointSegment& segment = segments[location.segment];
+
+		if(renderer){
+			glNamedBufferSubData(segment.ssBatches.handle, 64 * location.index, 4, &state);
+		}
+
+		if(hasHostBuffers()){
+			BatchResidency& batch = residency.batches[slot];
+			int64_t segmentOffset = batch.sparsePointOffset - location.segment * POINTS_PER_SEGMENT;
+			HostBuffers& host = segment.host;
+
+			memcpy(host.batches->data_u8 + 64 * location.index, &state, 4);
+
+			// evicted points are skipped through the batch state, their memory goes back to the OS
+			for(auto& buffer : {host.xyzLow, host.xyzMed, host.xyzHig, host.colors}){
+				discardMemory(buffer->data_u8 + 4 * segmentOffset, 4 * batch.numPoints);
+			}
+		}
+	}
+
+	if(renderer){
+		commitPages(update.decommit, false);
+	}
+
+	if(update.restream.size() > 0){
+		lock_guard<mutex> lock(mtx_load);
+
+		for(RestreamRange& range : update.restream){
+			LoadTask task;
+			task.lasfile = range.pc;
+			task.readMode = range.pc->readMode;
+			task.firstPoint = range.filePointOffset;
+			task.numPoints = range.numPoints;
+			task.sparse_pointOffset = range.sparsePointOffset;
+			task.bounds = range.bounds;
+			task.order = range.sparsePointOffset;
+			task.batchSlot = range.firstSlot;
+
+			loadTasks.push(task);
+		}
+	}
+	cv_load.notify_all();
+}
+
+void PointCloudLoader::uploadToGpu(UploadTask& task, int64_t batchSlot){
+
+	int64_t segmentIndex = task.sparse_pointOffset / POINTS_PER_SEGMENT;
+	PointSegment& segment = segments[segmentIndex];
+	int64_t segmentOffset = task.sparse_pointOffset - segmentIndex * POINTS_PER_SEGMENT;
+
+	// upload batch metadata, in runs of consecutive records
+	for(int64_t i = 0; i < task.numBatches;){
+		int64_t numSlots = 1;
+		while(i + numSlots < task.numBatches && isSlotRun(batchSlot + i, batchSlot + i + numSlots, numSlots)){
+			numSlots++;
+		}
+
+		glNamedBufferSubData(segment.ssBatches.handle, 
+			64 * batchLocations[batchSlot + i].index, 
+			64 * numSlots, 
+			task.bBatches->data_u8 + 64 * i);
+
+		i += numSlots;
+	}
+
+	// upload batch points
+	glNamedBufferSubData(segment.ssXyzLow.handle, 4 * segmentOffset, 4 * task.numPoints, task.bXyzLow->data);
+	glNamedBufferSubData(segment.ssXyzMed.handle, 4 * segmentOffset, 4 * task.numPoints, task.bXyzMed->data);
+	glNamedBufferSubData(segment.ssXyzHig.handle, 4 * segmentOffset, 4 * task.numPoints, task.bXyzHig->data);
+	glNamedBufferSubData(segment.ssColors.handle, 4 * segmentOffset, 4 * task.numPoints, task.bColors->data);
+
+	//cout << "uploading, offset: " << formatNumber(4 * task.sparse_pointOffset) << ", size: " << formatNumber(4 * task.numPoints) << endl;
+}
+
+void PointCloudLoader::uploadToHost(UploadTask& task, int64_t batchSlot){
+
+	// grows to at least capacity if offset + size doesn't fit
+	auto copy = [](shared_ptr<Buffer>& target, int64_t capacity, int64_t offset, const void* source, int64_t size){
+		if(target == nullptr || target->size < offset + size){
+			auto grown = make_shared<Buffer>(std::max(capacity, offset + size));
+
+			if(target){
+				memcpy(grown->data, target->data, target->size);
+			}
+
+			target = grown;
+		}
+
+		memcpy(target->data_u8 + offset, source, size);
+	};
+
+	int64_t segmentIndex = task.sparse_pointOffset / POINTS_PER_SEGMENT;
+	HostBuffers& host = getSegment(segmentIndex).host;
+	int64_t segmentStart = segmentIndex * POINTS_PER_SEGMENT;
+	int64_t segmentOffset = task.sparse_pointOffset - segmentStart;
+
+	// sized for the points that were placed in the segment so far, grows if more files are added
+	int64_t segmentPoints = 0;
+	{
+		lock_guard<mutex> lock(mtx_load);
+		segmentPoints = std::min(nextPointAddress - segmentStart, int64_t(POINTS_PER_SEGMENT));
+	}
+	int64_t batchCapacity = host.batches ? 2 * host.batches->size : 64 * (segmentPoints / POINTS_PER_WORKGROUP + 1);
+
+	for(int64_t i = 0; i < task.numBatches; i++){
+		int64_t index = batchLocations[batchSlot + i].index;
+
+		copy(host.batches, batchCapacity, 64 * index, task.bBatches->data_u8 + 64 * i, 64);
+	}
+	copy(host.xyzLow, 4 * segmentPoints, 4 * segmentOffset, task.bXyzLow->data, 4 * task.numPoints);
+	copy(host.xyzMed, 4 * segmentPoints, 4 * segmentOffset, task.bXyzMed->data, 4 * task.numPoints);
+	copy(host.xyzHig, 4 * segmentPoints, 4 * segmentOffset, task.bXyzHig->data, 4 * task.numPoints);
+	copy(host.colors, 4 * segmentPoints, 4 * segmentOffset, task.bColors->data, 4 * task.numPoints);
+}
+
+void PointCloudLoader::process(){
+
+	double tStart = now();
+	int64_t bytesThisCall = 0;
+	int64_t tasksThisCall = 0;
+
+	while(true){
+
+		// at least one task per call, so that loading progresses even if the budget is too small for a whole chunk
+		if(tasksThisCall > 0){
+			double elapsedMillis = (now() - tStart) * 1000.0;
+			double expectedMillis = avgBytesPerTask * nanosPerByte / 1'000'000.0;
+
+			bool exceedsMillis = uploadBudget.millis > 0.0 && elapsedMillis + expectedMillis > uploadBudget.millis;
+			bool exceedsBytes = uploadBudget.bytes > 0 && bytesThisCall + avgBytesPerTask > uploadBudget.bytes;
+
+			if(exceedsMillis || exceedsBytes){
+				break;
+			}
+		}
+
+		// FETCH TASK
+		UploadTask task;
+
+		if(!uploadQueue->tryPop(task)){
+			break;
+		}
+
+		int64_t taskBytes = task.bBatches->size + 16 * task.numPoints;
+
+		if(task.lasfile->isRemoved){
+			{
+				unique_lock<mutex> lock_load(mtx_load);
+				numTasksInFlight--;
+			}
+			cv_load.notify_all();
+
+			backlogBytes -= taskBytes;
+
+			continue;
+		}
+
+		double tUpload = now();
+
+		int64_t batchSlot = placeBatches(task);
+
+		{ // commit physical memory in sparse buffers
+			vector<BatchResidency> batches = residencyOf(task);
+			vector<PageRange> pages = residency.onUpload(batchSlot, batches);
+
+			if(renderer){
+				commitPages(pages, true);
+			}
+		}
+
+		if(renderer){
+			uploadToGpu(task, batchSlot);
+		}
+
+		if(hasHostBuffers()){
+			uploadToHost(task, batchSlot);
+		}
+
+		double uploadNanos = (now() - tUpload) * 1'000'000'000.0;
+
+		if(task.batchSlot < 0){
+			this->numBatchesLoaded += task.numBatches;
+			this->numPointsLoaded += task.numPoints;
+			task.lasfile->numPointsLoaded += task.numPoints;
+		}
+
+		{ // free the slot so that loader threads can decode the next chunk
+			unique_lock<mutex> lock_load(mtx_load);
+			numTasksInFlight--;
+		}
+		cv_load.notify_all();
+
+		// smoothed, so that a single slow upload (e.g. first touch of a sparse page) doesn't stall the next frames
+		double measuredNanosPerByte = uploadNanos / double(std::max(taskBytes, int64_t(1)));
+		if(numBytesUploaded == 0){
+			nanosPerByte = measuredNanosPerByte;
+			avgBytesPerTask = double(taskBytes);
+		}else{
+			nanosPerByte = 0.8 * nanosPerByte + 0.2 * measuredNanosPerByte;
+			avgBytesPerTask = 0.8 * avgBytesPerTask + 0.2 * double(taskBytes);
+		}
+
+		backlogBytes -= taskBytes;
+		numBytesUploaded += taskBytes;
+		bytesThisCall += taskBytes;
+		tasksThisCall++;
+	}
+
+	updateResidency();
+
+	// after uploading, so that the files of all uploaded batches are known when rendering
+	publishFiles();
+
+	lastProcessMillis = (now() - tStart) * 1000.0;
+
+	{ // uploaded bytes per second, over windows of about one second
+		double tNow = now();
+
+		if(rateWindowStart == 0.0){
+			rateWindowStart = tNow;
+		}
+
+		rateWindowBytes += bytesThisCall;
+
+		double windowDuration = tNow - rateWindowStart;
+		if(windowDuration >= 1.0){
+			uploadBytesPerSecond = double(rateWindowBytes) / windowDuration;
+			rateWindowStart = tNow;
+			rateWindowBytes = 0;
+		}
+	}
+
+}
+
+bool PointCloudLoader::isIdle(){
+
+	{
+		lock_guard<mutex> lock(mtx_add);
+
+		if(addRequests.size() > 0){
+			return false;
+		}
+	}
+
+	lock_guard<mutex> lock(mtx_load);
+
+	return addedFiles.empty() && loadTasks.size() == 0 && numTasksInFlight == 0 && uploadQueue->size() == 0;
+}
+
+void PointCloudLoader::setView(dmat4 view, dmat4 proj, ivec2 imageSize){
+
+	residency.setView(view, proj, imageSize);
+
+	lock_guard<mutex> lock(mtx_load);
+
+	loadTasks.setView(view, proj);
+}
+
+void PointCloudLoader::pushFrameStats(){
+
+	auto dbg = Debug::getInstance();
+
+	dbg->pushFrameStat("#points loaded", formatNumber(numPointsLoaded) + " / " + formatNumber(numPoints));
+
+	{ // queue depths
+		int64_t numPending = 0;
+		int64_t numReprioritized = 0;
+		{
+			lock_guard<mutex> lock(mtx_load);
+			numPending = loadTasks.size();
+			numReprioritized = loadTasks.numReprioritized;
+		}
+
+		auto depth = [](auto& queue){
+			return formatNumber(queue->size()) + " / " + formatNumber(queue->capacity) 
+				+ " (max " + formatNumber(queue->maxSize.load()) + ")";
+		};
+
+		dbg->pushFrameStat("divider", "");
+		dbg->pushFrameStat("pending chunks"       , formatNumber(numPending));
+		dbg->pushFrameStat("reprioritized"        , formatNumber(numReprioritized));
+		dbg->pushFrameStat("decode queue"         , depth(decodeQueue));
+		dbg->pushFrameStat("upload queue"         , depth(uploadQueue));
+		dbg->pushFrameStat("backpressure stalls"  , formatNumber(numBackpressureStalls.load()));
+	}
+
+	{ // upload stage
+		double backlogMB = double(backlogBytes.load()) / (1024.0 * 1024.0);
+		double uploadMBs = uploadBytesPerSecond / (1024.0 * 1024.0);
+		double copyMBs = nanosPerByte > 0.0 ? 1'000'000'000.0 / nanosPerByte / (1024.0 * 1024.0) : 0.0;
+
+		dbg->pushFrameStat("divider", "");
+		dbg->pushFrameStat("upload backlog (MB)"  , formatNumber(backlogMB, 1));
+		dbg->pushFrameStat("uploaded (MB/s)"      , formatNumber(uploadMBs, 1));
+		dbg->pushFrameStat("copy rate (MB/s)"     , formatNumber(copyMBs, 1));
+		dbg->pushFrameStat("process() (ms)"       , formatNumber(lastProcessMillis, 2) + " / " + formatNumber(uploadBudget.millis, 2));
+	}
+
+	{ // residency
+		double residentMB = double(residency.residentBytes) / (1024.0 * 1024.0);
+		double budgetMB = double(residency.budgetBytes) / (1024.0 * 1024.0);
+		string budget = residency.budgetBytes > 0 ? formatNumber(budgetMB, 1) : "unlimited";
+
+		dbg->pushFrameStat("divider", "");
+		dbg->pushFrameStat("resident (MB)"        , formatNumber(residentMB, 1) + " / " + budget);
+		dbg->pushFrameStat("re-streaming (MB)"    , formatNumber(double(residency.streamingBytes) / (1024.0 * 1024.0), 1));
+		dbg->pushFrameStat("evicted batches"      , formatNumber(residency.numEvicted));
+		dbg->pushFrameStat("re-streamed batches"  , formatNumber(residency.numRestreamed));
+	}
+
+	vector<pair<string, ReadStats*>> allStats = {
+		{toString(ReadMode::MAPPED), &readStats[int(ReadMode::MAPPED)]},
+		{toString(ReadMode::ASYNC), &readStats[int(ReadMode::ASYNC)]},
+		{toString(ReadMode::DIRECT), &readStats[int(ReadMode::DIRECT)]},
+		{"laz", &lazStats},
+		{"t2g", &cacheStats},
+		{"obj", &objStats},
+		{"ply", &plyStats},
+		{"procedural", &proceduralStats},
+	};
+
+	for(auto [name, statsPtr] : allStats){
+		ReadStats& stats = *statsPtr;
+		int64_t numChunks = stats.numChunks;
+
+		if(numChunks == 0){
+			continue;
+		}
+
+		double MB = double(stats.numBytes) / (1024.0 * 1024.0);
+		double readMs = double(stats.readNanos) / 1'000'000.0;
+		double decodeMs = double(stats.decodeNanos) / 1'000'000.0;
+
+		dbg->pushFrameStat("divider", "");
+		dbg->pushFrameStat(name + " chunks"           , formatNumber(numChunks));
+		dbg->pushFrameStat(name + " MB read"          , formatNumber(MB, 1));
+		dbg->pushFrameStat(name + " avg read (ms)"    , formatNumber(readMs / double(numChunks), 2));
+		dbg->pushFrameStat(name + " avg decode (ms)"  , formatNumber(decodeMs / double(numChunks), 2));
+	}
+
+	{
+		double pooledMB = double(bufferPool->pooledBytes) / (1024.0 * 1024.0);
+
+		dbg->pushFrameStat("divider", "");
+		dbg->pushFrameStat("buffer pool hits"     , formatNumber(bufferPool->numHits.load()));
+		dbg->pushFrameStat("buffer pool misses"   , formatNumber(bufferPool->numMisses.load()));
+		dbg->pushFrameStat("buffer pool dropped"  , formatNumber(bufferPool->numDropped.load()));
+		dbg->pushFrameStat("buffer pool idle (MB)", formatNumber(pooledMB, 1));
+	}
+
+}
+
+void benchmark_loader(vector<string> files){
+
+	// LAS and LAZ files are benchmarked separately, so that their rates can be compared
+	struct Format{
+		string name;
+		vector<string> files;
+		int64_t numPoints = 0;
+		int64_t fileSize = 0;
+	};
+
+	Format las = {"las"};
+	Format laz = {"laz"};
+
+	for(string file : files){
+		auto pc = read_las_header(file);
+
+		if(!isSupportedLasFormat(pc->pointFormat, pc->bytesPerPoint)){
+			GENERATE_WARN_MESSAGE << "unsupported point format, skipping " << file << endl;
+
+			continue;
+		}
+
+		Format& format = pc->isCompressed ? laz : las;
+		format.files.push_back(file);
+		format.numPoints += pc->numPoints;
+		format.fileSize += pc->mappedFile->size;
+	}
+
+	int maxThreads = getCpuData().numProcessors;
+	vector<int> threadCounts;
+	for(int numThreads = 1; numThreads < maxThreads; numThreads *= 2){
+		threadCounts.push_back(numThreads);
+	}
+	threadCounts.push_back(maxThreads);
+
+	for(Format* format : {&las, &laz}){
+
+		if(format->files.size() == 0){
+			continue;
+		}
+
+		double fileMB = double(format->fileSize) / (1024.0 * 1024.0);
+
+		cout << "benchmark loader (" << format->name << "): " << formatNumber(format->numPoints) << " points, " 
+			<< formatNumber(fileMB, 1) << " MB in " << format->files.size() << " files" << endl;
+
+		struct Result{
+			int numThreads;
+			string allocatorName;
+			double duration;
+			int64_t numPointsLoaded;
+			int64_t numStalls;
+		};
+
+		vector<Result> results;
+
+		// each thread count runs twice, once with freshly malloc'd buffers per chunk and once with recycled buffers.
+		// a headless loader with numThreads decoders reads, decodes and uploads the files into its host buffers,
+		// like it does while rendering, only without an upload budget per frame
+		for(int numThreads : threadCounts)
+		for(string allocatorName : {"malloc", "pool"}){
+
+			auto loader = make_shared<PointCloudLoader>(nullptr, 4, numThreads);
+			loader->uploadBudget = {0.0, 0};
+
+			if(allocatorName == "malloc"){
+				loader->bufferPool = nullptr;
+			}
+
+			double tStart = now();
+
+			loader->add(format->files, [](vector<shared_ptr<PointCloud>>){});
+
+			while(!loader->isIdle()){
+				loader->process();
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+			}
+			loader->process();
+
+			double duration = now() - tStart;
+
+			results.push_back({numThreads, allocatorName, duration, loader->numPointsLoaded, loader->numBackpressureStalls.load()});
+		}
+
+		// after all runs, so that the output of the loaders doesn't get in between
+		for(Result& result : results){
+			double pointsPerSecond = double(result.numPointsLoaded) / result.duration;
+			double fileMBPerSecond = fileMB / result.duration;
+
+			cout << "threads: " << leftPad(to_string(result.numThreads), 3) 
+				<< ", " << leftPad(result.allocatorName, 6)
+				<< ", duration: " << formatNumber(result.duration, 3) << "s"
+				<< ", points/s: " << formatNumber(pointsPerSecond)
+				<< ", file MB/s: " << formatNumber(fileMBPerSecond, 1)
+				<< ", stalls: " << formatNumber(result.numStalls) << endl;
+		}
+	}
+
+}
+
+void benchmark_scheduler(vector<string> files){
+
+	struct Chunk{
+		shared_ptr<PointCloud> pc;
+		int64_t firstPoint;
+		int64_t numPoints;
+		Box bounds;
+		int64_t order = 0;
+		LoadPriority priority;
+		// points in batches that intersect the view, i.e. that the renderer doesn't cull
+		int64_t numVisiblePoints = 0;
+	};
+
+	vector<Chunk> chunks;
+	Box scene;
+	int64_t numPoints = 0;
+
+	for(int i = 0; i < files.size(); i++){
+		auto pc = read_las_header(files[i]);
+
+		if(!isSupportedLasFormat(pc->pointFormat, pc->bytesPerPoint)){
+			GENERATE_WARN_MESSAGE << "unsupported point format, skipping " << files[i] << endl;
+
+			continue;
+		}
+
+		pc->fileIndex = i;
+		pc->sparse_point_offset = numPoints;
+		numPoints += pc->numPoints;
+
+		scene.expand(pc->boxMin);
+		scene.expand(pc->boxMax);
+
+		int64_t pointsPerTask = points_per_task(pc);
+
+		for(int64_t pointOffset = 0; pointOffset < pc->numPoints; pointOffset += pointsPerTask){
+			int64_t pointsInChunk = std::min(pointsPerTask, pc->numPoints - pointOffset);
+
+			Chunk chunk;
+			chunk.pc = pc;
+			chunk.firstPoint = pointOffset;
+			chunk.numPoints = pointsInChunk;
+			chunk.bounds = estimate_chunk_bounds(pc, pointOffset, pointsInChunk);
+			chunk.order = pc->sparse_point_offset + pointOffset;
+
+			chunks.push_back(chunk);
+		}
+	}
+
+	if(chunks.size() == 0){
+		return;
+	}
+
+	// zoomed in on a small part of the scene, looking down at an angle
+	dvec3 target = scene.min + scene.size() * 0.25;
+	double radius = glm::length(scene.size()) * 0.1;
+	dvec3 position = target + radius * glm::normalize(dvec3(-0.5, -0.5, 1.0));
+
+	Camera camera;
+	camera.setSize(1920, 1080);
+	camera.far = 4.0 * glm::length(scene.size());
+	camera.world = glm::inverse(glm::lookAt(position, target, dvec3(0.0, 0.0, 1.0)));
+	camera.update();
+
+	Frustum frustum;
+	frustum.set(camera.proj * camera.view);
+
+	auto pool = make_shared<BufferPool>(512 * 1024 * 1024);
+
+	auto load = [&pool](Chunk& chunk){
+		if(chunk.pc->isCompressed){
+			return load_pointcloud_from_laz(chunk.pc, chunk.firstPoint, chunk.numPoints, chunk.order, pool);
+		}else{
+			return load_pointcloud_from_file(chunk.pc, chunk.firstPoint, chunk.numPoints, chunk.order, pool);
+		}
+	};
+
+	// decode everything once to find out which points are visible. also warms the page cache, so that
+	// all orders are measured under the same conditions
+	int64_t numVisiblePoints = 0;
+	for(Chunk& chunk : chunks){
+		auto result = load(chunk);
+
+		for(int64_t i = 0; i < result->numBatches; i++){
+			auto bBatches = result->bBatches;
+
+			Box batchBounds;
+			batchBounds.min = chunk.pc->boxMin + dvec3(
+				bBatches->get<float>(64 * i + 4), 
+				bBatches->get<float>(64 * i + 8), 
+				bBatches->get<float>(64 * i + 12));
+			batchBounds.max = chunk.pc->boxMin + dvec3(
+				bBatches->get<float>(64 * i + 16), 
+				bBatches->get<float>(64 * i + 20), 
+				bBatches->get<float>(64 * i + 24));
+
+			if(frustum.intersectsBox(batchBounds)){
+				chunk.numVisiblePoints += bBatches->get<uint32_t>(64 * i + 28);
+			}
+		}
+
+		numVisiblePoints += chunk.numVisiblePoints;
+	}
+
+	cout << "benchmark scheduler: " << formatNumber(numPoints) << " points in " << chunks.size() << " chunks, " 
+		<< formatNumber(numVisiblePoints) << " visible" << endl;
+
+	if(numVisiblePoints == 0){
+		GENERATE_WARN_MESSAGE << "no points in view, nothing to compare" << endl;
+
+		return;
+	}
+
+	vector<pair<string, vector<int64_t>>> orders;
+
+	{ // reverse order of the files, how chunks used to be popped
+		vector<int64_t> order;
+		for(int64_t i = chunks.size() - 1; i >= 0; i--){
+			order.push_back(i);
+		}
+		orders.push_back({"lifo", order});
+	}
+
+	{ // order of the files, which is what the scheduler does without a view
+		vector<int64_t> order;
+		for(int64_t i = 0; i < chunks.size(); i++){
+			order.push_back(i);
+		}
+		orders.push_back({"file order", order});
+	}
+
+	{ // view priority
+		struct Indexed{
+			int64_t index;
+			Box bounds;
+			int64_t order;
+			LoadPriority priority;
+		};
+
+		LoadScheduler<Indexed> scheduler;
+		scheduler.setView(camera.view, camera.proj);
+
+		for(int64_t i = 0; i < chunks.size(); i++){
+			scheduler.push({i, chunks[i].bounds, chunks[i].order});
+		}
+
+		vector<int64_t> order;
+		while(scheduler.size() > 0){
+			order.push_back(scheduler.pop().index);
+		}
+		orders.push_back({"view", order});
+	}
+
+	int numThreads = getCpuData().numProcessors;
+
+	for(auto& [name, order] : orders){
+
+		std::atomic<int64_t> nextChunk = 0;
+		std::atomic<int64_t> numVisibleLoaded = 0;
+		std::atomic<double> t90 = 0.0;
+		std::atomic<double> t100 = 0.0;
+		vector<thread> threads;
+
+		double tStart = now();
+
+		for(int i = 0; i < numThreads; i++){
+			threads.emplace_back([&](){
+				while(true){
+					int64_t orderIndex = nextChunk++;
+
+					if(orderIndex >= int64_t(order.size())){
+						break;
+					}
+
+					Chunk& chunk = chunks[order[orderIndex]];
+
+					load(chunk);
+
+					int64_t before = numVisibleLoaded.fetch_add(chunk.numVisiblePoints);
+					int64_t after = before + chunk.numVisiblePoints;
+					double duration = now() - tStart;
+
+					if(before < 0.9 * numVisiblePoints && after >= 0.9 * numVisiblePoints){
+						t90 = duration;
+					}
+					if(before < numVisiblePoints && after >= numVisiblePoints){
+						t100 = duration;
+					}
+				}
+			});
+		}
+
+		for(auto& t : threads){
+			t.join();
+		}
+
+		double duration = now() - tStart;
+
+		cout << leftPad(name, 10) << ", threads: " << numThreads
+			<< ", 90% of view: " << formatNumber(t90.load(), 3) << "s"
+			<< ", first full image: " << formatNumber(t100.load(), 3) << "s"
+			<< ", all points: " << formatNumber(duration, 3) << "s" << endl;
+	}
+
+}
+
+void benchmark_ingest(vector<string> files){
+
+	struct Config{
+		string name;
+		UploadBudget budget;
+	};
+
+	vector<Config> configs = {
+		// one chunk per frame, how process() used to behave
+		{"1 chunk" , {0.0, 1}},
+		{"1 ms"    , {1.0, 0}},
+		{"4 ms"    , {4.0, 0}},
+		{"64 MB"   , {0.0, 64 * 1024 * 1024}},
+	};
+
+	// the render loop at 60 fps
+	double frameDuration = 1.0 / 60.0;
+
+	for(auto& config : configs){
+
+		auto loader = make_shared<PointCloudLoader>(nullptr);
+		loader->uploadBudget = config.budget;
+
+		loader->add(files, [](vector<shared_ptr<PointCloud>>){});
+
+		if(loader->numPoints == 0){
+			return;
+		}
+
+		double tStart = now();
+		int64_t numFrames = 0;
+		double maxProcessMillis = 0.0;
+		double sumProcessMillis = 0.0;
+		int64_t maxBacklog = 0;
+
+		while(!loader->isIdle()){
+			double tFrame = now();
+
+			loader->process();
+
+			numFrames++;
+			maxProcessMillis = std::max(maxProcessMillis, loader->lastProcessMillis);
+			sumProcessMillis += loader->lastProcessMillis;
+			maxBacklog = std::max(maxBacklog, loader->backlogBytes.load());
+
+			double remaining = frameDuration - (now() - tFrame);
+			if(remaining > 0.0){
+				std::this_thread::sleep_for(std::chrono::microseconds(int64_t(remaining * 1'000'000.0)));
+			}
+		}
+
+		double duration = now() - tStart;
+		double MB = double(loader->numBytesUploaded) / (1024.0 * 1024.0);
+
+		cout << leftPad(config.name, 8) << ": " << formatNumber(numFrames) << " frames, " << formatNumber(duration, 3) << "s"
+			<< ", uploaded MB/s: " << formatNumber(MB / duration, 1)
+			<< ", process() avg: " << formatNumber(sumProcessMillis / double(numFrames), 2) << "ms"
+			<< ", max: " << formatNumber(maxProcessMillis, 2) << "ms"
+			<< ", max backlog: " << formatNumber(double(maxBacklog) / (1024.0 * 1024.0), 1) << " MB" << endl;
+	}
+
+}
+
+void convert_to_batch_cache(vector<string> files){
+
+	struct Conversion{
+		shared_ptr<PointCloud> pc;
+		string path;
+		string tmpPath;
+		BatchCacheHeader header;
+		vector<BatchCacheChunk> chunks;
+	};
+
+	struct ConvertTask{
+		shared_ptr<Conversion> conversion;
+		int64_t chunkIndex;
+	};
+
+	double tStart = now();
+	vector<shared_ptr<Conversion>> conversions;
+	vector<shared_ptr<ConvertTask>> tasks;
+	int64_t sourceBytes = 0;
+
+	for(string file : files){
+
+		if(iEndsWith(file, "t2g")){
+			continue;
+		}
+
+		auto pc = read_las_header(file);
+
+		if(!isSupportedLasFormat(pc->pointFormat, pc->bytesPerPoint)){
+			GENERATE_WARN_MESSAGE << "unsupported point format " << pc->pointFormat << ", skipping " << file << endl;
+
+			continue;
+		}
+
+		auto conversion = make_shared<Conversion>();
+		conversion->pc = pc;
+		conversion->path = batch_cache_path(file);
+		conversion->tmpPath = conversion->path + ".tmp";
+
+		BatchCacheHeader& header = conversion->header;
+		header.pointsPerBatch = POINTS_PER_WORKGROUP;
+		header.numPointsReserved = pc->numPoints;
+		header.scale[0] = pc->scale.x; header.scale[1] = pc->scale.y; header.scale[2] = pc->scale.z;
+		header.offset[0] = pc->offset.x; header.offset[1] = pc->offset.y; header.offset[2] = pc->offset.z;
+		header.boxMin[0] = pc->boxMin.x; header.boxMin[1] = pc->boxMin.y; header.boxMin[2] = pc->boxMin.z;
+		header.boxMax[0] = pc->boxMax.x; header.boxMax[1] = pc->boxMax.y; header.boxMax[2] = pc->boxMax.z;
+		header.sourceFileSize = fs::file_size(file);
+		header.sourceLastWriteTime = fs::last_write_time(file).time_since_epoch().count();
+
+		// the same chunks that the loader would decode
+		int64_t pointsPerTask = points_per_task(pc);
+		for(int64_t pointOffset = 0; pointOffset < pc->numPoints; pointOffset += pointsPerTask){
+			BatchCacheChunk chunk;
+			chunk.firstPoint = pointOffset;
+			chunk.numPoints = std::min(pointsPerTask, pc->numPoints - pointOffset);
+			chunk.firstBatch = header.numBatchesReserved;
+			chunk.numBatches = (chunk.numPoints + POINTS_PER_WORKGROUP - 1) / POINTS_PER_WORKGROUP;
+
+			header.numBatchesReserved += chunk.numBatches;
+
+			auto task = make_shared<ConvertTask>();
+			task->conversion = conversion;
+			task->chunkIndex = conversion->chunks.size();
+			tasks.push_back(task);
+
+			conversion->chunks.push_back(chunk);
+		}
+
+		header.numChunks = conversion->chunks.size();
+		layout_batch_cache(header);
+
+		{ // sections are written at their offsets, by whichever thread decoded them
+			ofstream stream(conversion->tmpPath, ios::out | ios::binary | ios::trunc);
+		}
+		fs::resize_file(conversion->tmpPath, header.fileSize);
+
+		sourceBytes += fs::file_size(file);
+		conversions.push_back(conversion);
+	}
+
+	auto bufferPool = make_shared<BufferPool>(int64_t(1024) * 1024 * 1024);
+	atomic<int64_t> numPoints = 0;
+
+	auto processor = [bufferPool, &numPoints](shared_ptr<ConvertTask> task){
+
+		auto conversion = task->conversion;
+		auto pc = conversion->pc;
+		BatchCacheHeader& header = conversion->header;
+		BatchCacheChunk& chunk = conversion->chunks[task->chunkIndex];
+
+		shared_ptr<LoadResult> result = nullptr;
+		if(pc->isCompressed){
+			result = load_pointcloud_from_laz(pc, chunk.firstPoint, chunk.numPoints, 0, bufferPool);
+		}else{
+			result = load_pointcloud_from_file(pc, chunk.firstPoint, chunk.numPoints, 0, bufferPool);
+		}
+
+		// truncated files decode fewer points
+		chunk.numPoints = result->numPoints;
+		chunk.numBatches = result->numBatches;
+
+		Box bounds;
+		for(int64_t i = 0; i < result->numBatches; i++){
+			auto bBatches = result->bBatches;
+
+			// set by the loader, see load_pointcloud_from_cache()
+			bBatches->set<uint32_t>(0, 64 * i + 32);
+			bBatches->set<uint32_t>(0, 64 * i + 36);
+			bBatches->set<uint32_t>(0, 64 * i + 40);
+
+			bounds.expand(pc->boxMin + dvec3(bBatches->get<float>(64 * i + 4), bBatches->get<float>(64 * i + 8), bBatches->get<float>(64 * i + 12)));
+			bounds.expand(pc->boxMin + dvec3(bBatches->get<float>(64 * i + 16), bBatches->get<float>(64 * i + 20), bBatches->get<float>(64 * i + 24)));
+		}
+
+		if(result->numBatches > 0){
+			chunk.min[0] = bounds.min.x; chunk.min[1] = bounds.min.y; chunk.min[2] = bounds.min.z;
+			chunk.max[0] = bounds.max.x; chunk.max[1] = bounds.max.y; chunk.max[2] = bounds.max.z;
+		}
+
+		int64_t planeSize = 4 * result->numPoints;
+		vector<pair<int64_t, shared_ptr<Buffer>>> sections = {
+			{header.batchesOffset + 64 * chunk.firstBatch, result->bBatches},
+			{header.xyzLowOffset + 4 * chunk.firstPoint, result->bXyzLow},
+			{header.xyzMedOffset + 4 * chunk.firstPoint, result->bXyzMed},
+			{header.xyzHigOffset + 4 * chunk.firstPoint, result->bXyzHig},
+			{header.colorsOffset + 4 * chunk.firstPoint, result->bColors},
+		};
+
+		fstream stream(conversion->tmpPath, ios::in | ios::out | ios::binary);
+
+		uint64_t hash = 0;
+		for(int i = 0; i < sections.size(); i++){
+			auto [offset, buffer] = sections[i];
+			int64_t size = i == 0 ? 64 * result->numBatches : planeSize;
+
+			hash = i == 0 ? checksum(buffer->data, size) : checksum(buffer->data, size, hash);
+
+			stream.seekp(offset);
+			stream.write(buffer->data_char, size);
+		}
+
+		chunk.checksum = hash;
+
+		if(!stream.good()){
+			GENERATE_ERROR_MESSAGE << "could not write " << conversion->tmpPath << endl;
+		}
+
+		numPoints += result->numPoints;
+	};
+
+	int numThreads = getCpuData().numProcessors;
+	TaskPool<ConvertTask> pool(numThreads, processor);
+
+	for(auto task : tasks){
+		pool.addTask(task);
+	}
+
+	pool.close();
+	pool.waitTillEmpty();
+
+	// the header goes last, files that weren't completely written don't open
+	int64_t cacheBytes = 0;
+	for(auto conversion : conversions){
+		BatchCacheHeader& header = conversion->header;
+
+		header.numPoints = 0;
+		for(auto& chunk : conversion->chunks){
+			header.numPoints += chunk.numPoints;
+		}
+		header.checksum = header_checksum(header, conversion->chunks);
+
+		{
+			fstream stream(conversion->tmpPath, ios::in | ios::out | ios::binary);
+			stream.seekp(0);
+			stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			stream.seekp(header.chunksOffset);
+			stream.write(reinterpret_cast<const char*>(conversion->chunks.data()), conversion->chunks.size() * sizeof(BatchCacheChunk));
+		}
+
+		std::error_code ec;
+		fs::rename(conversion->tmpPath, conversion->path, ec);
+
+		if(ec){
+			GENERATE_ERROR_MESSAGE << "could not rename " << conversion->tmpPath << ": " << ec.message() << endl;
+
+			continue;
+		}
+
+		cacheBytes += header.fileSize;
+
+		cout << conversion->path << ": " << formatNumber(header.numPoints) << " points, " 
+			<< formatNumber(double(header.fileSize) / (1024.0 * 1024.0), 1) << " MB" << endl;
+	}
+
+	double duration = now() - tStart;
+
+	cout << "converted " << conversions.size() << " files with " << numThreads << " threads in " << formatNumber(duration, 3) << "s"
+		<< ", " << formatNumber(double(numPoints) / duration / 1'000'000.0, 1) << " M points/s"
+		<< ", " << formatNumber(double(sourceBytes) / (1024.0 * 1024.0), 1) << " MB in"
+		<< ", " << formatNumber(double(cacheBytes) / (1024.0 * 1024.0), 1) << " MB out" << endl;
+}
+
+bool check_las_formats(){
+
+	// two batches, so that the second batch starts at a record offset that isn't 0
+	int64_t numPoints = POINTS_PER_WORKGROUP + 123;
+	int64_t headerSize = 375;
+	dvec3 scale = {0.001, 0.001, 0.001};
+	dvec3 offset = {1000.0, 2000.0, 10.0};
+	string path = (fs::temp_directory_path() / "check_las_formats.las").string();
+	bool allPassed = true;
+
+	cout << "check las formats: " << formatNumber(numPoints) << " synthetic records per format" << endl;
+
+	for(int format = 0; format <= MAX_LAS_POINT_FORMAT; format++){
+	for(int extraBytes : {0, 3}){
+
+		const LasRecordFormat& record = LAS_RECORD_FORMATS[format];
+		int64_t bytesPerPoint = record.recordSize + extraBytes;
+
+		// random bytes in all fields that aren't decoded, so that reading the wrong offset shows up
+		mt19937 rng(100 * format + extraBytes);
+		uniform_int_distribution<int32_t> coordinates(-500'000, 500'000);
+		vector<uint8_t> file(headerSize + numPoints * bytesPerPoint);
+		for(auto& value : file){
+			value = uint8_t(rng());
+		}
+
+		vector<int32_t> XYZ(3 * numPoints);
+		vector<uint32_t> expectedColors(numPoints);
+		dvec3 boxMin = {Infinity, Infinity, Infinity};
+		dvec3 boxMax = {-Infinity, -Infinity, -Infinity};
+
+		for(int64_t i = 0; i < numPoints; i++){
+			uint8_t* pointRecord = file.data() + headerSize + i * bytesPerPoint;
+
+			int32_t X = coordinates(rng);
+			int32_t Y = coordinates(rng);
+			int32_t Z = coordinates(rng) / 10;
+			// 8-bit and 16-bit colors, like in the wild
+			uint16_t channels[4];
+			for(auto& channel : channels){
+				channel = (rng() % 2 == 0) ? uint16_t(rng() % 256) : uint16_t(rng() % 65536);
+			}
+
+			memcpy(pointRecord + 0, &X, 4);
+			memcpy(pointRecord + 4, &Y, 4);
+			memcpy(pointRecord + 8, &Z, 4);
+			memcpy(pointRecord + record.offsetIntensity, &channels[3], 2);
+
+			auto to8bit = [](int value){ return value < 256 ? value : value / 256; };
+
+			if(record.offsetRGB >= 0){
+				memcpy(pointRecord + record.offsetRGB, channels, 6);
+
+				expectedColors[i] = to8bit(channels[0]) | (to8bit(channels[1]) << 8) | (to8bit(channels[2]) << 16);
+			}else{
+				int I = to8bit(channels[3]);
+
+				expectedColors[i] = I | (I << 8) | (I << 16);
+			}
+
+			XYZ[3 * i + 0] = X;
+			XYZ[3 * i + 1] = Y;
+			XYZ[3 * i + 2] = Z;
+
+			dvec3 position = dvec3(X, Y, Z) * scale + offset;
+			boxMin = glm::min(boxMin, position);
+			boxMax = glm::max(boxMax, position);
+		}
+
+		{ // LAS 1.4 header without VLRs
+			uint8_t* header = file.data();
+			memset(header, 0, headerSize);
+			memcpy(header, "LASF", 4);
+
+			uint16_t u16HeaderSize = uint16_t(headerSize);
+			uint32_t u32OffsetToPointData = uint32_t(headerSize);
+			uint16_t u16BytesPerPoint = uint16_t(bytesPerPoint);
+			uint32_t u32NumPoints = uint32_t(numPoints);
+			uint64_t u64NumPoints = uint64_t(numPoints);
+
+			header[24] = 1;
+			header[25] = 4;
+			memcpy(header + 94, &u16HeaderSize, 2);
+			memcpy(header + 96, &u32OffsetToPointData, 4);
+			header[104] = uint8_t(format);
+			memcpy(header + 105, &u16BytesPerPoint, 2);
+			memcpy(header + 107, &u32NumPoints, 4);
+			memcpy(header + 131, &scale, 24);
+			memcpy(header + 155, &offset, 24);
+			memcpy(header + 179, &boxMax.x, 8); memcpy(header + 187, &boxMin.x, 8);
+			memcpy(header + 195, &boxMax.y, 8); memcpy(header + 203, &boxMin.y, 8);
+			memcpy(header + 211, &boxMax.z, 8); memcpy(header + 219, &boxMin.z, 8);
+			memcpy(header + 247, &u64NumPoints, 8);
+		}
+
+		auto write = [&](){
+			ofstream stream(path, ios::out | ios::binary | ios::trunc);
+			stream.write(reinterpret_cast<const char*>(file.data()), file.size());
+		};
+
+		vector<string> failures;
+
+		{ // laszip flags compressed records in the upper 2 bits of the point format
+			file[104] = uint8_t(format) | 0b1000'0000;
+			write();
+
+			auto pc = read_las_header(path);
+
+			if(pc->pointFormat != format || !pc->isCompressed){
+				failures.push_back("masking of the compression bits");
+			}
+
+			file[104] = uint8_t(format);
+		}
+
+		write();
+
+		auto pc = read_las_header(path);
+
+		if(pc->pointFormat != format || pc->isCompressed || pc->bytesPerPoint != bytesPerPoint || pc->numPoints != numPoints){
+			failures.push_back("header");
+		}else if(!isSupportedLasFormat(pc->pointFormat, pc->bytesPerPoint)
+			|| isSupportedLasFormat(pc->pointFormat, record.recordSize - 1))
+		{
+			failures.push_back("isSupportedLasFormat");
+		}else{
+			auto result = load_pointcloud_from_file(pc, 0, numPoints, 0, nullptr);
+
+			int64_t numWrongPositions = 0;
+			int64_t numWrongColors = 0;
+
+			for(int64_t i = 0; i < result->numPoints; i++){
+				int64_t batchByteOffset = 64 * (i / POINTS_PER_WORKGROUP);
+
+				dvec3 batchMin = {
+					result->bBatches->get<float>(batchByteOffset + 4),
+					result->bBatches->get<float>(batchByteOffset + 8),
+					result->bBatches->get<float>(batchByteOffset + 12)};
+				dvec3 batchMax = {
+					result->bBatches->get<float>(batchByteOffset + 16),
+					result->bBatches->get<float>(batchByteOffset + 20),
+					result->bBatches->get<float>(batchByteOffset + 24)};
+
+				uint32_t low = result->bXyzLow->data_u32[i];
+				uint32_t med = result->bXyzMed->data_u32[i];
+				uint32_t hig = result->bXyzHig->data_u32[i];
+
+				dvec3 decoded;
+				for(int axis = 0; axis < 3; axis++){
+					int shift = 10 * axis;
+					uint32_t X30 = (((low >> shift) & MASK_10BIT) << 20) | (((med >> shift) & MASK_10BIT) << 10) | ((hig >> shift) & MASK_10BIT);
+
+					decoded[axis] = batchMin[axis] + (double(X30) / STEPS_30BIT) * (batchMax[axis] - batchMin[axis]);
+				}
+
+				dvec3 expected = dvec3(XYZ[3 * i + 0], XYZ[3 * i + 1], XYZ[3 * i + 2]) * scale + offset - pc->boxMin;
+
+				// batch bounds are floats, a point off by one record would be off by at least the scale
+				if(glm::length(decoded - expected) > 0.0001){
+					numWrongPositions++;
+				}
+
+				if(result->bColors->data_u32[i] != expectedColors[i]){
+					numWrongColors++;
+				}
+			}
+
+			if(result->numPoints != numPoints || result->numBatches != 2){
+				failures.push_back("number of points or batches");
+			}
+			if(numWrongPositions > 0){
+				failures.push_back(formatNumber(numWrongPositions) + " wrong positions");
+			}
+			if(numWrongColors > 0){
+				failures.push_back(formatNumber(numWrongColors) + " wrong colors");
+			}
+		}
+
+		// release the mapping before the next write
+		pc = nullptr;
+
+		cout << "    format " << leftPad(formatNumber(format), 2) << ", " << bytesPerPoint << " bytes per point: ";
+		if(failures.empty()){
+			cout << "ok" << endl;
+		}else{
+			for(int i = 0; i < failures.size(); i++){
+				cout << (i > 0 ? ", " : "") << failures[i];
+			}
+			cout << " FAILED" << endl;
+		}
+
+		allPassed = allPassed && failures.empty();
+	}
+	}
+
+	{ // formats beyond LAS 1.4 are rejected
+		bool rejected = !isSupportedLasFormat(MAX_LAS_POINT_FORMAT + 1, 1000) && !isSupportedLasFormat(-1, 1000);
+
+		cout << "    unknown formats rejected: " << (rejected ? "ok" : "FAILED") << endl;
+
+		allPassed = allPassed && rejected;
+	}
+
+	fs::remove(path);
+
+	return allPassed;
+}
+
+bool check_point_addressing(){
+
+	bool allPassed = true;
+
+	auto report = [&](string name, bool passed){
+		cout << "    " << name << ": " << (passed ? "ok" : "FAILED") << endl;
+
+		allPassed = allPassed && passed;
+	};
+
+	int64_t maxAddress = int64_t(1) << 33;
+
+	cout << "check point addressing: " << formatNumber(maxAddress) << " addresses, "
+		<< formatNumber(int64_t(POINTS_PER_SEGMENT)) << " points per segment" << endl;
+
+	// headless and without files, so that no buffers are allocated for the addresses
+	PointCloudLoader loader(nullptr);
+	unique_lock<mutex> lock(loader.mtx_load);
+
+	vector<PointRange> ranges;
+
+	{ // chunks of random sizes, up to whole batches of LAZ chunks, until the address space is past 2^33
+		mt19937 rng(123);
+		uniform_int_distribution<int64_t> sizes(1, 20'000'000);
+
+		bool withinSegments = true;
+
+		while(loader.nextPointAddress < maxAddress){
+			int64_t numPoints = sizes(rng);
+			int64_t address = loader.allocatePoints(numPoints);
+
+			withinSegments = withinSegments && (address / POINTS_PER_SEGMENT == (address + numPoints - 1) / POINTS_PER_SEGMENT);
+
+			ranges.push_back({address, numPoints});
+		}
+
+		// smaller chunks go into the skipped rest of earlier segments
+		vector<PointRange> sorted = ranges;
+		std::sort(sorted.begin(), sorted.end(), [](PointRange a, PointRange b){
+			return a.first < b.first;
+		});
+
+		bool disjoint = true;
+		vector<PointRange> gaps;
+		for(int64_t i = 0; i + 1 < sorted.size(); i++){
+			int64_t end = sorted[i].first + sorted[i].count;
+
+			disjoint = disjoint && end <= sorted[i + 1].first;
+
+			if(end < sorted[i + 1].first){
+				gaps.push_back({end, sorted[i + 1].first - end});
+			}
+		}
+
+		// the only gaps are the rest of segments that a chunk didn't fit into, and they are free
+		bool gapsAreFree = gaps.size() == loader.freePointRanges.size();
+		for(int64_t i = 0; i < gaps.size() && gapsAreFree; i++){
+			PointRange gap = gaps[i];
+			PointRange free = loader.freePointRanges[i];
+
+			gapsAreFree = gap.first == free.first && gap.count == free.count
+				&& (gap.first + gap.count) % POINTS_PER_SEGMENT == 0;
+		}
+
+		report("allocated chunks stay within one segment", withinSegments);
+		report("allocated chunks don't overlap", disjoint);
+		report("skipped rest of segments is free", gapsAreFree);
+		report("address space past 2^32", loader.nextPointAddress > (int64_t(1) << 32)
+			&& loader.nextPointAddress == sorted.back().first + sorted.back().count);
+
+		// the chunks before and after the first skip to the next segment
+		int64_t i = 0;
+		while(i + 2 < sorted.size() && sorted[i].first + sorted[i].count == sorted[i + 1].first){
+			i++;
+		}
+
+		PointRange before = sorted[i];
+		PointRange after = sorted[i + 1];
+
+		// merged with the rest in between, into a free range that spans the segment boundary
+		loader.freePoints(before);
+		loader.freePoints(after);
+
+		int64_t reusedBefore = loader.allocatePoints(before.count);
+		// didn't fit into the rest of the first segment when it was allocated, and still doesn't
+		int64_t reusedAfter = loader.allocatePoints(after.count);
+
+		report("freed ranges are reused", reusedBefore == before.first);
+		report("reused ranges don't span segments", reusedAfter == after.first && after.first % POINTS_PER_SEGMENT == 0);
+	}
+
+	{ // once everything is freed, in any order, the address space is empty again
+		vector<PointRange> shuffled = ranges;
+		std::shuffle(shuffled.begin(), shuffled.end(), mt19937(7));
+
+		for(PointRange range : shuffled){
+			loader.freePoints(range);
+		}
+
+		report("address space shrinks to 0", loader.nextPointAddress == 0 && loader.freePointRanges.empty());
+
+		// and is allocated like before
+		bool sameAddresses = true;
+		for(PointRange range : ranges){
+			sameAddresses = sameAddresses && loader.allocatePoints(range.count) == range.first;
+		}
+
+		report("addresses after removing everything", sameAddresses);
+	}
+
+	{ // batch records store the segment and the offset within it, for chunks just below segment boundaries and past 2^32
+		auto pc = make_shared<PointCloud>();
+		pc->pointFormat = 2;
+		pc->bytesPerPoint = LAS_RECORD_FORMATS[2].recordSize;
+		pc->fileIndex = 3;
+
+		int64_t numPoints = 2 * POINTS_PER_WORKGROUP + 17;
+		vector<uint8_t> records(numPoints * pc->bytesPerPoint, 0);
+
+		vector<int64_t> addresses = {
+			0,
+			POINTS_PER_SEGMENT - numPoints,
+			POINTS_PER_SEGMENT,
+			(int64_t(1) << 32) - numPoints,
+			int64_t(1) << 32,
+			16 * int64_t(POINTS_PER_SEGMENT) - numPoints,
+			ranges.back().first,
+		};
+
+		bool recordsMatch = true;
+		for(int64_t address : addresses){
+			auto result = encode_points(pc, records.data(), 0, numPoints, address, nullptr);
+
+			for(int64_t i = 0; i < result->numBatches; i++){
+				int64_t batchAddress = address + i * POINTS_PER_WORKGROUP;
+				int64_t offset = result->bBatches->get<uint32_t>(64 * i + 32);
+				int64_t segment = result->bBatches->get<uint32_t>(64 * i + 40);
+
+				recordsMatch = recordsMatch
+					&& segment == batchAddress / POINTS_PER_SEGMENT
+					&& offset == batchAddress % POINTS_PER_SEGMENT
+					&& segment * POINTS_PER_SEGMENT + offset == batchAddress
+					&& result->bBatches->get<uint32_t>(64 * i + 36) == pc->fileIndex;
+			}
+		}
+
+		report("batch records store segment and offset", recordsMatch);
+	}
+
+	{ // batch slots go into the batch table of the segment of their points
+		auto place = [&](int64_t address, int64_t numBatches){
+			PointCloudLoader::UploadTask task;
+			task.sparse_pointOffset = address;
+			task.numBatches = numBatches;
+
+			return loader.placeBatches(task);
+		};
+
+		int64_t segmentAbove4G = (int64_t(1) << 32) / POINTS_PER_SEGMENT;
+		vector<int64_t> addresses = {0, POINTS_PER_SEGMENT - 10, POINTS_PER_SEGMENT, int64_t(1) << 32, 0, int64_t(1) << 32};
+
+		bool locationsMatch = true;
+		vector<int64_t> numBatchesInSegment(segmentAbove4G + 1, 0);
+
+		for(int64_t address : addresses){
+			int64_t segment = address / POINTS_PER_SEGMENT;
+			int64_t slot = place(address, 5);
+
+			for(int64_t i = 0; i < 5; i++){
+				BatchLocation location = loader.batchLocations[slot + i];
+
+				locationsMatch = locationsMatch
+					&& location.segment == segment
+					&& location.index == numBatchesInSegment[segment] + i;
+			}
+
+			numBatchesInSegment[segment] += 5;
+		}
+
+		report("batch slots are in the table of their segment", locationsMatch
+			&& loader.segments.size() == segmentAbove4G + 1
+			&& loader.segments[segmentAbove4G].numBatches == 10);
+
+		// free slots of segment 0 are only reused by batches of segment 0
+		loader.freeSlots.push_back({0, 5});
+
+		int64_t slotAbove4G = place(int64_t(1) << 32, 5);
+		int64_t slotInSegment0 = place(100, 5);
+
+		report("free slots are reused within their segment", slotAbove4G != 0 && slotInSegment0 == 0 && loader.freeSlots.empty());
+	}
+
+	return allPassed;
+}
@@ -3,6 +3,10 @@
 
 #include <string>
 #include <filesystem>
+#include <deque>
+#include <map>
+#include <future>
+#include <condition_variable>
 
 #include "glm/common.hpp"
 #include "glm/matrix.hpp"
@@ -13,6 +17,12 @@
 #include "Resources.h"
 #include "TaskPool.h"
 #include "laszip_api.h"
+#include "chunk_reader.h"
+#include "buffer_pool.h"
+#include "ring_queue.h"
+#include "load_scheduler.h"
+#include "residency.h"
+#include "Camera.h"
 
 using namespace std;
 using glm::vec3;
@@ -23,6 +33,11 @@ namespace fs = std::filesystem;
 #include <string>
 using std::string;
 struct Renderer;
+struct LasCatalog;
+struct BatchCache;
+struct ObjFile;
+struct PlyFile;
+struct ProceduralSource;
 
 struct Method {
 	string name = "no name";
@@ -37,16 +52,63 @@ struct Method {
 };
 
 
+enum class ReadMode{
+	// decoders read straight from the memory-mapped file
+	MAPPED,
+	// a reader thread keeps ioQueueDepth reads in flight (io_uring or preadv) ahead of the decoders
+	ASYNC,
+	// like ASYNC, but bypasses the page cache (O_DIRECT) so that read-once bulk ingests don't evict everything else
+	DIRECT
+};
+
+inline string toString(ReadMode mode){
+	if(mode == ReadMode::MAPPED) return "mapped";
+	if(mode == ReadMode::ASYNC) return "async";
+	if(mode == ReadMode::DIRECT) return "direct";
+
+	return "unknown";
+}
+
+// per read mode (and for LAZ), so that buffered, direct and compressed reads can be compared
+struct ReadStats{
+	atomic<int64_t> numChunks = 0;
+	atomic<int64_t> numBytes = 0;
+	// submit to completion, summed over all reads. 0 for mapped reads, they fault pages in while decoding
+	atomic<int64_t> readNanos = 0;
+	atomic<int64_t> decodeNanos = 0;
+};
+
+// consecutive point addresses
+struct PointRange{
+	int64_t first = 0;
+	int64_t count = 0;
+};
+
 struct PointCloud {
 	// filesystem info
 	int64_t fileIndex = 0;
 	string path;
+	// opened once, loader threads read point records straight from the mapping
+	shared_ptr<MappedFile> mappedFile = nullptr;
+	// LAZ. decoders decompress with laszip instead of reading records from the mapping
+	bool isCompressed = false;
+	// points per LAZ chunk, 0 if chunks are variably sized
+	int64_t lazChunkSize = 0;
+	// a .t2g file. its chunks are uploaded as they are, instead of decoding the source file
+	shared_ptr<BatchCache> cache = nullptr;
+	// a Wavefront OBJ file, its vertex lines are parsed instead of reading LAS records
+	shared_ptr<ObjFile> obj = nullptr;
+	// a PLY file. binary vertices are read like LAS records, with offsetToPointData and bytesPerPoint of the vertex element
+	shared_ptr<PlyFile> ply = nullptr;
+	// generated points, there is no file
+	shared_ptr<ProceduralSource> procedural = nullptr;
 
 	// memory structure 
 	int64_t numPoints = 0;
 	int64_t numPointsLoaded = 0;
 	uint32_t offsetToPointData = 0;
 	int pointFormat = 0;
+	ReadMode readMode = ReadMode::MAPPED;
 	uint32_t bytesPerPoint = 0;
 	dvec3 scale = {1.0, 1.0, 1.0};
 	dvec3 offset = {0.0, 0.0, 0.0};
@@ -55,30 +117,97 @@ struct PointCloud {
 	
 	int64_t numBatches = 0;
 
-	// index of first point in the sparse gpu buffer
+	// address of the first point in the sparse buffers. the chunks of a file follow each other,
+	// except where a chunk skips to the next segment
 	int64_t sparse_point_offset = 0;
+	// addresses of all chunks, freed when the file is removed
+	vector<PointRange> pointRanges;
+	// chunks that are still loading are dropped
+	atomic<bool> isRemoved = false;
 
 	bool isSelected = false;
 	bool isHovered = false;
 	bool isDoubleClicked = false;
 };
 
+// limits how much process() uploads per call. 0 disables a limit.
+// at least one chunk is uploaded per call, regardless of the budget
+struct UploadBudget{
+	double millis = 2.0;
+	int64_t bytes = 0;
+};
+
+// where process() uploads to without a renderer or with keepHostCopy, same layout as the gpu buffers
+struct HostBuffers{
+	shared_ptr<Buffer> batches = nullptr;
+	shared_ptr<Buffer> xyzLow = nullptr;
+	shared_ptr<Buffer> xyzMed = nullptr;
+	shared_ptr<Buffer> xyzHig = nullptr;
+	shared_ptr<Buffer> colors = nullptr;
+};
+
+// POINTS_PER_SEGMENT points and the batches that reference them. 
+// batches store the index of their segment and a 32-bit offset to their first point within it,
+// the render pass binds and dispatches one segment at a time
+struct PointSegment{
+	GLBuffer ssBatches;
+	GLBuffer ssXyzLow;
+	GLBuffer ssXyzMed;
+	GLBuffer ssXyzHig;
+	GLBuffer ssColors;
+	// instead of the gpu buffers if headless, in addition to them with keepHostCopy
+	HostBuffers host;
+
+	int64_t numBatches = 0;
+};
+
+// where a batch slot is stored
+struct BatchLocation{
+	int64_t segment = 0;
+	// in the batch table of the segment
+	int64_t index = 0;
+};
+
+// consecutive batch slots of removed files, with consecutive records in the same batch table
+struct SlotRange{
+	int64_t firstSlot = 0;
+	int64_t numSlots = 0;
+};
+
 struct PointCloudLoader {
 
-	int64_t MAX_POINTS = 1'000'000'000;
 	int64_t PAGE_SIZE = 0;
 
 	mutex mtx_upload;
 	mutex mtx_load;
+	condition_variable cv_load;
 
 	struct LoadTask{
 		shared_ptr<PointCloud> lasfile;
 		int64_t firstPoint;
 		int64_t numPoints;
+		int64_t sparse_pointOffset = 0;
+		ReadMode readMode = ReadMode::MAPPED;
+
+		// estimated from a few sampled points, or the header bounds for LAZ files
+		Box bounds;
+		// address of the first point
+		int64_t order = 0;
+		LoadPriority priority;
+		// slot of the first batch if evicted batches are loaded again, -1 for new chunks
+		int64_t batchSlot = -1;
+	};
+
+	struct DecodeTask{
+		LoadTask task;
+		int64_t ticket;
+		// empty for mapped reads
+		ChunkRead read;
 	};
 
 	struct UploadTask{
 		shared_ptr<PointCloud> lasfile;
+		int64_t firstPoint;
 		int64_t sparse_pointOffset;
 		int64_t sparse_batchOffset;
 		int64_t numPoints;
@@ -88,11 +217,55 @@ struct PointCloudLoader {
 		shared_ptr<Buffer> bXyzHig;
 		shared_ptr<Buffer> bColors;
 		shared_ptr<Buffer> bBatches;
+		int64_t batchSlot = -1;
 	};
 
+	// files are added and removed by the thread that calls process()
 	vector<shared_ptr<PointCloud>> files;
-	vector<LoadTask> loadTasks;
-	vector<UploadTask> uploadTasks;
+	// headers that were read by add() or addAsync(), but that aren't in files yet
+	vector<shared_ptr<PointCloud>> addedFiles;
+	// pending chunks, nearest to the view first
+	LoadScheduler<LoadTask> loadTasks;
+	// decoded chunks, in ticket order, waiting for process() to upload them
+	shared_ptr<RingQueue<UploadTask>> uploadQueue = nullptr;
+
+	// decoder pool
+	// - every dequeued LoadTask gets a ticket, finished tasks are handed to
+	//   uploadTasks in ticket order so that the batch table is deterministic
+	// - at most maxTasksInFlight tasks are decoded or waiting for upload at once. if uploads fall
+	//   behind, the read stage stops taking new tasks until process() frees a slot
+	int numThreads = 1;
+	int64_t maxTasksInFlight = 0;
+	int64_t numTasksInFlight = 0;
+	int64_t nextTicket = 0;
+	int64_t nextUploadTicket = 0;
+	map<int64_t, UploadTask> pendingUploads;
+	vector<thread> loaderThreads;
+	bool isClosing = false;
+	// times the read stage had tasks but had to wait for a free slot
+	atomic<int64_t> numBackpressureStalls = 0;
+
+	// read stage, in front of the decoder pool
+	int ioQueueDepth = 0;
+	shared_ptr<ChunkReader> reader = nullptr;
+	thread readerThread;
+	shared_ptr<RingQueue<DecodeTask>> decodeQueue = nullptr;
+
+	// indexed by ReadMode
+	ReadStats readStats[3];
+	// LAZ files are decompressed by the decoders, regardless of the read mode
+	ReadStats lazStats;
+	// .t2g files are mapped, regardless of the read mode. decode is the checksum of the chunk
+	ReadStats cacheStats;
+	// OBJ files are mapped, regardless of the read mode. decode includes parsing
+	ReadStats objStats;
+	// decode of PLY files. reads of binary PLY files count towards readStats
+	ReadStats plyStats;
+	// generated points, decode includes generating them
+	ReadStats proceduralStats;
+
+	// result and LAZ record buffers of the decoders, recycled once their chunk is uploaded
+	shared_ptr<BufferPool> bufferPool = nullptr;
 
 	int64_t numPoints = 0;
 	int64_t numPointsLoaded = 0;
@@ -100,18 +273,123 @@ struct PointCloudLoader {
 	int64_t numBatchesLoaded = 0;
 	int64_t bytesReserved = 0;
 	int64_t numFiles = 0;
+	// next free point address, see allocatePoints()
+	int64_t nextPointAddress = 0;
+	// addresses and file indices of removed files, reused by files that are added later
+	vector<PointRange> freePointRanges;
+	vector<int64_t> freeFileIndices;
+
+	struct AddRequest{
+		thread worker;
+		shared_future<vector<shared_ptr<PointCloud>>> result;
+	};
+
+	mutex mtx_add;
+	vector<AddRequest> addRequests;
 
+	// upload stage
+	UploadBudget uploadBudget;
+	// measured, smoothed over the last few chunks
+	double nanosPerByte = 0.0;
+	double avgBytesPerTask = 0.0;
+	int64_t numBytesUploaded = 0;
+	double uploadBytesPerSecond = 0.0;
+	double lastProcessMillis = 0.0;
+	double rateWindowStart = 0.0;
+	int64_t rateWindowBytes = 0;
+	// decoded, but not uploaded yet
+	atomic<int64_t> backlogBytes = 0;
+
+	// if set, added files that are in it are opened without reading their headers again
+	shared_ptr<LasCatalog> catalog = nullptr;
+
+	// evicts batches once their points exceed residency.budgetBytes
+	ResidencyManager residency;
+
+	// null if headless, then chunks are uploaded to the host buffers of the segments
 	shared_ptr<Renderer> renderer = nullptr;
+	// also upload to the host buffers if there is a renderer, e.g. for the CPU rasterizer. set before adding files
+	bool keepHostCopy = false;
 
-	GLBuffer ssBatches;
-	GLBuffer ssXyzLow;
-	GLBuffer ssXyzMed;
-	GLBuffer ssXyzHig;
-	GLBuffer ssColors;
+	vector<PointSegment> segments;
+	// by batch slot
+	vector<BatchLocation> batchLocations;
+	// batch slots of removed files
+	vector<SlotRange> freeSlots;
 	GLBuffer ssLoadBuffer;
 
-	PointCloudLoader(shared_ptr<Renderer> renderer);
-	void add(vector<string> files, std::function<void(vector<shared_ptr<PointCloud>>)> callback);
+	// numThreads decoders, or a number that leaves about half the cores to the renderer if 0
+	PointCloudLoader(shared_ptr<Renderer> renderer, int ioQueueDepth = 4, int numThreads = 0);
+	~PointCloudLoader();
+	// reads the headers and queues the chunks of the files, blocks until the headers are read.
+	// call from the thread that calls process()
+	void add(vector<string> files, std::function<void(vector<shared_ptr<PointCloud>>)> callback, ReadMode readMode = ReadMode::MAPPED);
+	// like add(), but reads the headers in the background. the future is ready once the chunks are queued,
+	// the files appear in files with the next process()
+	shared_future<vector<shared_ptr<PointCloud>>> addAsync(vector<string> files, ReadMode readMode = ReadMode::MAPPED);
+	// cancels queued chunks of the file and frees its batch slots, pages and addresses.
+	// call from the thread that calls process()
+	void remove(shared_ptr<PointCloud> pc);
+	vector<shared_ptr<PointCloud>> addFiles(vector<string> files, ReadMode readMode);
+	// moves addedFiles to files
+	void publishFiles();
 	void spawnLoader();
+	// address of numPoints consecutive points within a single segment. call with mtx_load locked
+	int64_t allocatePoints(int64_t numPoints);
+	// call with mtx_load locked
+	void freePoints(PointRange range);
+	int64_t allocateFileIndex();
+	// creates the buffers of the segment on first use
+	PointSegment& getSegment(int64_t index);
+	// slot of the first batch of the task, reuses slots of removed files
+	int64_t placeBatches(UploadTask& task);
+	// whether slot is offset slots after firstSlot, in the same batch table
+	bool isSlotRun(int64_t firstSlot, int64_t slot, int64_t offset);
+	// uploads decoded chunks until uploadBudget is used up
 	void process();
-};
\ No newline at end of file
+	// whether nothing is being added, queued, read, decoded or waiting for process(). unlike numPointsLoaded == numPoints,
+	// this also becomes true if files deliver fewer points than their headers claim, e.g. truncated or corrupt files
+	bool isIdle();
+	void uploadToGpu(UploadTask& task, int64_t batchSlot);
+	void uploadToHost(UploadTask& task, int64_t batchSlot);
+	bool hasHostBuffers(){
+		return renderer == nullptr || keepHostCopy;
+	}
+	void updateResidency();
+	void commitPages(vector<PageRange>& pages, bool commit);
+	void pushFrameStats();
+	// chunks that are in or close to the view are loaded first
+	void setView(dmat4 view, dmat4 proj, ivec2 imageSize = {1920, 1080});
+};
+
+shared_ptr<PointCloud> read_las_header(string path);
+
+shared_ptr<PointCloud> point_cloud_from_cache(shared_ptr<BatchCache> cache);
+
+shared_ptr<PointCloud> point_cloud_from_obj(shared_ptr<ObjFile> obj);
+
+shared_ptr<PointCloud> point_cloud_from_ply(shared_ptr<PlyFile> ply);
+
+shared_ptr<PointCloud> point_cloud_from_procedural(shared_ptr<ProceduralSource> source);
+
+// loads the given files with headless loaders of 1 to numProcessors threads and prints points/s, separately for LAS and LAZ,
+// and with malloc'd vs. pooled result buffers
+void benchmark_loader(vector<string> files);
+
+// compares the time until all visible points are loaded when chunks are loaded in reverse file order,
+// file order and by view priority, for a camera that is zoomed in on a part of the scene
+void benchmark_scheduler(vector<string> files);
+
+// loads the files without a renderer, calling process() at 60 fps with different upload budgets
+void benchmark_ingest(vector<string> files);
+
+// decodes the files into .t2g files next to them, all chunks of all files in parallel
+void convert_to_batch_cache(vector<string> files);
+
+// writes synthetic records of each point format 0 - 10, with and without extra bytes, to a temporary LAS file,
+// decodes them like the loader does and compares positions and colors. returns false if any format fails
+bool check_las_formats();
+
+// allocates chunk addresses past 2^33 points, without any points behind them, and checks that chunks stay within
+// segments, that freed ranges are reused, and that batch records and slots point to the right segment and offset
+bool check_point_addressing();
@@ -0,0 +1,425 @@
+
+#include <cstring>
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <sstream>
+
+#include "procedural_source.h"
+
+constexpr double TERRAIN_WAVELENGTH = 1000.0;
+constexpr double TERRAIN_AMPLITUDE = 40.0;
+constexpr int TERRAIN_OCTAVES = 4;
+// sum of the amplitudes of all octaves
+constexpr double TERRAIN_MAX_HEIGHT = TERRAIN_AMPLITUDE * (1.0 + 0.5 + 0.25 + 0.125);
+
+constexpr double BLOCK_SIZE = 40.0;
+constexpr double BUILDING_MAX_HEIGHT = 60.0;
+constexpr double OUTLIER_MAX_HEIGHT = 40.0;
+
+// splitmix64 finalizer
+inline uint64_t mix64(uint64_t value){
+	value ^= value >> 30;
+	value *= 0xBF58476D1CE4E5B9ull;
+	value ^= value >> 27;
+	value *= 0x94D049BB133111EBull;
+	value ^= value >> 31;
+
+	return value;
+}
+
+inline double to_unit(uint64_t hash){
+	return double(hash >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// hash of a lattice point, for values that belong to a place rather than to a point
+inline uint64_t hash_lattice(uint64_t seed, int64_t ix, int64_t iy, uint64_t salt){
+	return mix64(seed * 0x9E3779B97F4A7C15ull ^ mix64(uint64_t(ix) * 0xD6E8FEB86659FD93ull ^ uint64_t(iy) * 0xA0761D6478BD642Full ^ salt));
+}
+
+// uniform random numbers of a point
+struct PointRandom{
+	uint64_t state;
+
+	PointRandom(uint64_t seed, int64_t pointIndex){
+		state = mix64(seed ^ mix64(uint64_t(pointIndex)));
+	}
+
+	double next(){
+		state += 0x9E3779B97F4A7C15ull;
+
+		return to_unit(mix64(state));
+	}
+};
+
+// every other bit of the Morton code
+inline uint32_t compact_bits(uint64_t value){
+	value &= 0x5555555555555555ull;
+	value = (value | (value >> 1)) & 0x3333333333333333ull;
+	value = (value | (value >> 2)) & 0x0F0F0F0F0F0F0F0Full;
+	value = (value | (value >> 4)) & 0x00FF00FF00FF00FFull;
+	value = (value | (value >> 8)) & 0x0000FFFF0000FFFFull;
+	value = (value | (value >> 16)) & 0x00000000FFFFFFFFull;
+
+	return uint32_t(value);
+}
+
+double value_noise(uint64_t seed, double x, double y, uint64_t octave){
+
+	double fx = std::floor(x);
+	double fy = std::floor(y);
+	int64_t ix = int64_t(fx);
+	int64_t iy = int64_t(fy);
+
+	// smoothstep
+	double u = x - fx;
+	double v = y - fy;
+	u = u * u * (3.0 - 2.0 * u);
+	v = v * v * (3.0 - 2.0 * v);
+
+	double v00 = to_unit(hash_lattice(seed, ix + 0, iy + 0, octave));
+	double v10 = to_unit(hash_lattice(seed, ix + 1, iy + 0, octave));
+	double v01 = to_unit(hash_lattice(seed, ix + 0, iy + 1, octave));
+	double v11 = to_unit(hash_lattice(seed, ix + 1, iy + 1, octave));
+
+	return (v00 * (1.0 - u) + v10 * u) * (1.0 - v) + (v01 * (1.0 - u) + v11 * u) * v;
+}
+
+// 0 to TERRAIN_MAX_HEIGHT
+double terrain_height(uint64_t seed, double x, double y){
+
+	double height = 0.0;
+	double amplitude = TERRAIN_AMPLITUDE;
+	double frequency = 1.0 / TERRAIN_WAVELENGTH;
+
+	for(int octave = 0; octave < TERRAIN_OCTAVES; octave++){
+		height += amplitude * value_noise(seed, x * frequency, y * frequency, octave);
+
+		amplitude *= 0.5;
+		frequency *= 2.0;
+	}
+
+	return height;
+}
+
+struct Building{
+	bool exists = false;
+	dvec3 min;
+	dvec3 max;
+	uint32_t roofColor = 0;
+};
+
+// at most one building per block, inset from the block borders so that streets remain
+Building block_building(const ProceduralSource& source, int64_t bx, int64_t by){
+
+	Building building;
+
+	uint64_t hash = hash_lattice(source.seed, bx, by, 0xB10C);
+	PointRandom random(hash, 0);
+
+	if(random.next() >= source.buildings){
+		return building;
+	}
+
+	double x0 = double(bx) * BLOCK_SIZE;
+	double y0 = double(by) * BLOCK_SIZE;
+
+	building.exists = true;
+	building.min.x = x0 + 4.0 + 8.0 * random.next();
+	building.min.y = y0 + 4.0 + 8.0 * random.next();
+	building.max.x = x0 + BLOCK_SIZE - 4.0 - 8.0 * random.next();
+	building.max.y = y0 + BLOCK_SIZE - 4.0 - 8.0 * random.next();
+
+	double height = 5.0 + (BUILDING_MAX_HEIGHT - 5.0) * std::pow(random.next(), 3.0);
+	building.min.z = terrain_height(source.seed, x0 + 0.5 * BLOCK_SIZE, y0 + 0.5 * BLOCK_SIZE);
+	building.max.z = building.min.z + height;
+
+	uint32_t roofColors[] = {0x003A4AB5, 0x00707070, 0x00404040, 0x005A6A8A};
+	building.roofColor = roofColors[hash % 4];
+
+	return building;
+}
+
+inline uint32_t rgb(double r, double g, double b){
+	auto channel = [](double value){
+		return uint32_t(std::clamp(value, 0.0, 255.0));
+	};
+
+	return channel(r) | (channel(g) << 8) | (channel(b) << 16);
+}
+
+inline uint32_t shade(uint32_t color, double brightness){
+	return rgb(
+		double((color >> 0) & 0xFF) * brightness,
+		double((color >> 8) & 0xFF) * brightness,
+		double((color >> 16) & 0xFF) * brightness);
+}
+
+bool is_procedural_path(const string& path){
+	return path.rfind("procedural:", 0) == 0;
+}
+
+shared_ptr<ProceduralSource> parse_procedural(string path, int64_t pointsPerTile){
+
+	auto source = make_shared<ProceduralSource>();
+	source->path = path;
+
+	stringstream parameters(path.substr(string("procedural:").size()));
+	string parameter;
+
+	while(std::getline(parameters, parameter, ',')){
+		size_t separator = parameter.find('=');
+
+		if(parameter.empty()){
+			continue;
+		}
+
+		string key = parameter.substr(0, separator);
+		string value = separator == string::npos ? "" : parameter.substr(separator + 1);
+		char* end = nullptr;
+		double number = std::strtod(value.c_str(), &end);
+		bool isNumber = !value.empty() && *end == 0 && std::isfinite(number);
+
+		if(isNumber && key == "points" && number >= 1.0){
+			source->numPoints = int64_t(number);
+		}else if(isNumber && key == "seed"){
+			source->seed = uint64_t(number);
+		}else if(isNumber && key == "density" && number > 0.0){
+			source->density = number;
+		}else if(isNumber && key == "buildings" && number >= 0.0 && number <= 1.0){
+			source->buildings = number;
+		}else if(isNumber && key == "noise" && number >= 0.0 && number <= 1.0){
+			source->noise = number;
+		}else{
+			GENERATE_WARN_MESSAGE << "invalid parameter \"" << parameter << "\" in " << path
+				<< ", expected points, seed, density, buildings or noise" << endl;
+
+			return nullptr;
+		}
+	}
+
+	// 256 to 1024 points per cell
+	source->pointsPerTile = pointsPerTile;
+	source->cellsPerSide = 1;
+	while(pointsPerTile / (4 * source->cellsPerSide * source->cellsPerSide) >= 256){
+		source->cellsPerSide *= 2;
+	}
+
+	int64_t numCells = source->cellsPerSide * source->cellsPerSide;
+	source->pointsPerCell = (pointsPerTile + numCells - 1) / numCells;
+	source->cellSize = std::sqrt(double(source->pointsPerCell) / source->density);
+	source->tileSize = source->cellSize * double(source->cellsPerSide);
+	source->numTiles = (source->numPoints + pointsPerTile - 1) / pointsPerTile;
+	source->tilesPerRow = int64_t(std::ceil(std::sqrt(double(source->numTiles))));
+
+	int64_t numRows = (source->numTiles + source->tilesPerRow - 1) / source->tilesPerRow;
+
+	// walls of buildings at the edge of the last tiles may extend into the next block
+	source->bounds.min = {0.0, 0.0, 0.0};
+	source->bounds.max = {
+		double(source->tilesPerRow) * source->tileSize + BLOCK_SIZE,
+		double(numRows) * source->tileSize + BLOCK_SIZE,
+		TERRAIN_MAX_HEIGHT + std::max(BUILDING_MAX_HEIGHT, OUTLIER_MAX_HEIGHT),
+	};
+
+	return source;
+}
+
+Box procedural_tile_bounds(const ProceduralSource& source, int64_t tile){
+
+	dvec3 tileMin = {
+		double(tile % source.tilesPerRow) * source.tileSize,
+		double(tile / source.tilesPerRow) * source.tileSize,
+		0.0,
+	};
+
+	// walls of buildings whose block overlaps the tile may extend beyond it
+	Box bounds;
+	bounds.min = glm::max(tileMin - dvec3(BLOCK_SIZE, BLOCK_SIZE, 0.0), source.bounds.min);
+	bounds.max = tileMin + dvec3(source.tileSize + BLOCK_SIZE, source.tileSize + BLOCK_SIZE, source.bounds.max.z);
+
+	return bounds;
+}
+
+void generate_procedural_points(const ProceduralSource& source, int64_t firstPoint, int64_t numPoints, dvec3 origin,
+	double* x, double* y, double* z, uint32_t* colors)
+{
+	// consecutive points are mostly in the same block
+	int64_t cachedBlock[2] = {-1, -1};
+	Building building;
+
+	for(int64_t i = 0; i < numPoints; i++){
+		int64_t pointIndex = firstPoint + i;
+		int64_t tile = pointIndex / source.pointsPerTile;
+		int64_t pointInTile = pointIndex % source.pointsPerTile;
+		uint64_t cell = uint64_t(pointInTile / source.pointsPerCell);
+
+		PointRandom random(source.seed, pointIndex);
+
+		dvec3 position = {
+			(double(tile % source.tilesPerRow) * double(source.cellsPerSide) + double(compact_bits(cell >> 0)) + random.next()) * source.cellSize,
+			(double(tile / source.tilesPerRow) * double(source.cellsPerSide) + double(compact_bits(cell >> 1)) + random.next()) * source.cellSize,
+			0.0,
+		};
+
+		double kind = random.next();
+		double brightness = 0.85 + 0.3 * random.next();
+		uint32_t color = 0;
+
+		int64_t bx = int64_t(position.x / BLOCK_SIZE);
+		int64_t by = int64_t(position.y / BLOCK_SIZE);
+
+		if(bx != cachedBlock[0] || by != cachedBlock[1]){
+			building = block_building(source, bx, by);
+			cachedBlock[0] = bx;
+			cachedBlock[1] = by;
+		}
+
+		bool isInBuilding = building.exists
+			&& position.x >= building.min.x && position.x <= building.max.x
+			&& position.y >= building.min.y && position.y <= building.max.y;
+
+		if(kind < source.noise){
+			// outliers, e.g. vegetation, birds and multipath returns
+			double ground = terrain_height(source.seed, position.x, position.y);
+			position.z = ground + OUTLIER_MAX_HEIGHT * random.next();
+			color = shade(0x00306040, brightness);
+		}else if(isInBuilding){
+			dvec3 size = building.max - building.min;
+			double wallArea = 2.0 * (size.x + size.y) * size.z;
+			double roofArea = size.x * size.y;
+
+			if(random.next() * (wallArea + roofArea) < wallArea){
+				// a point on the perimeter, at any height
+				double t = random.next() * 2.0 * (size.x + size.y);
+
+				if(t < size.x){
+					position.x = building.min.x + t;
+					position.y = building.min.y;
+				}else if(t < size.x + size.y){
+					position.x = building.max.x;
+					position.y = building.min.y + (t - size.x);
+				}else if(t < 2.0 * size.x + size.y){
+					position.x = building.max.x - (t - size.x - size.y);
+					position.y = building.max.y;
+				}else{
+					position.x = building.min.x;
+					position.y = building.max.y - (t - 2.0 * size.x - size.y);
+				}
+
+				position.z = building.min.z + size.z * random.next();
+				color = shade(0x00B4BEC8, brightness);
+			}else{
+				position.z = building.max.z;
+				color = shade(building.roofColor, brightness);
+			}
+		}else{
+			// green in the valleys, brown and gray on the hills
+			double ground = terrain_height(source.seed, position.x, position.y);
+			double h = ground / TERRAIN_MAX_HEIGHT;
+			position.z = ground + 0.05 * random.next();
+			color = rgb(
+				(70.0 + 100.0 * h) * brightness,
+				(110.0 + 20.0 * h) * brightness,
+				(50.0 + 60.0 * h) * brightness);
+		}
+
+		x[i] = position.x - origin.x;
+		y[i] = position.y - origin.y;
+		z[i] = position.z - origin.z;
+		colors[i] = color;
+	}
+}
+
+void benchmark_procedural(vector<string> paths){
+
+	int numThreads = getCpuData().numProcessors;
+
+	for(string path : paths){
+
+		auto source = parse_procedural(path, 1'024'000);
+
+		if(!source){
+			continue;
+		}
+
+		cout << path << ": " << formatNumber(source->numPoints) << " points, " << formatNumber(source->numTiles) << " tiles of "
+			<< formatNumber(source->tileSize, 1) << "m, " << formatNumber(source->pointsPerCell) << " points per cell" << endl;
+
+		// a few tiles per thread, generating all of a large source would take hours
+		int64_t numTiles = std::min(source->numTiles, int64_t(4 * numThreads));
+		int64_t numPoints = std::min(numTiles * source->pointsPerTile, source->numPoints);
+
+		vector<double> x(numPoints), y(numPoints), z(numPoints);
+		vector<uint32_t> colors(numPoints);
+
+		atomic<int64_t> nextTile = 0;
+		double tStart = now();
+
+		vector<thread> threads;
+		for(int i = 0; i < numThreads; i++){
+			threads.emplace_back([&](){
+				while(true){
+					int64_t tile = nextTile++;
+
+					if(tile >= numTiles){
+						break;
+					}
+
+					int64_t first = tile * source->pointsPerTile;
+					int64_t count = std::min(source->pointsPerTile, numPoints - first);
+
+					generate_procedural_points(*source, first, count, {0.0, 0.0, 0.0},
+						x.data() + first, y.data() + first, z.data() + first, colors.data() + first);
+				}
+			});
+		}
+		for(auto& t : threads){
+			t.join();
+		}
+
+		double duration = now() - tStart;
+		double pointsPerSecond = double(numPoints) / duration;
+
+		cout << "    generated " << formatNumber(numPoints) << " points in " << formatNumber(duration, 3) << "s, "
+			<< formatNumber(pointsPerSecond / 1'000'000.0, 1) << " M points/s, "
+			<< formatNumber(pointsPerSecond / double(numThreads) / 1'000'000.0, 1) << " M points/s per thread" << endl;
+
+		// the last tile again, in odd-sized parts and in reverse order
+		int64_t tileFirst = (numTiles - 1) * source->pointsPerTile;
+		int64_t tileCount = numPoints - tileFirst;
+		int64_t partSize = 7919;
+
+		vector<double> px(tileCount), py(tileCount), pz(tileCount);
+		vector<uint32_t> pcolors(tileCount);
+
+		for(int64_t partFirst = ((tileCount - 1) / partSize) * partSize; partFirst >= 0; partFirst -= partSize){
+			int64_t count = std::min(partSize, tileCount - partFirst);
+
+			generate_procedural_points(*source, tileFirst + partFirst, count, {0.0, 0.0, 0.0},
+				px.data() + partFirst, py.data() + partFirst, pz.data() + partFirst, pcolors.data() + partFirst);
+		}
+
+		int64_t numMismatches = 0;
+		int64_t numOutside = 0;
+		Box tileBounds = procedural_tile_bounds(*source, numTiles - 1);
+
+		for(int64_t i = 0; i < tileCount; i++){
+			bool isSame = memcmp(&px[i], &x[tileFirst + i], sizeof(double)) == 0
+				&& memcmp(&py[i], &y[tileFirst + i], sizeof(double)) == 0
+				&& memcmp(&pz[i], &z[tileFirst + i], sizeof(double)) == 0
+				&& pcolors[i] == colors[tileFirst + i];
+
+			dvec3 position = {px[i], py[i], pz[i]};
+			bool isInside = glm::all(glm::greaterThanEqual(position, tileBounds.min))
+				&& glm::all(glm::lessThanEqual(position, tileBounds.max));
+
+			numMismatches += isSame ? 0 : 1;
+			numOutside += isInside ? 0 : 1;
+		}
+
+		cout << "    points that differ when generated in parts: " << formatNumber(numMismatches) << endl;
+		cout << "    points outside of their tile bounds: " << formatNumber(numOutside) << endl;
+	}
+}
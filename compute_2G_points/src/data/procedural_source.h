@@ -0,0 +1,64 @@
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "glm/common.hpp"
+#include "unsuck.hpp"
+#include "Box.h"
+
+using namespace std;
+using glm::dvec3;
+
+// point clouds that are generated instead of read, for stress tests at sizes that no disk holds.
+// they're added like files, with a path like
+//
+//     procedural:points=1e12,seed=7,density=20,buildings=0.3,noise=0.01
+//
+// every point is a pure function of the seed and its index: the index picks a tile, a cell of the tile and
+// a position in the cell, counter-based hashes of the index pick everything else. chunks can be generated
+// in any order, in parallel, and always produce the same points.
+//
+// the scene is fBm terrain with boxy buildings on a block grid and a fraction of outliers above the ground.
+// tiles are laid out in rows, cells in Morton order within a tile, so that consecutive points are close to each other.
+
+struct ProceduralSource{
+	string path;
+
+	uint64_t seed = 1;
+	int64_t numPoints = 100'000'000;
+	// points per square meter
+	double density = 20.0;
+	// fraction of blocks with a building
+	double buildings = 0.3;
+	// fraction of points that are outliers
+	double noise = 0.01;
+
+	int64_t pointsPerTile = 0;
+	int64_t pointsPerCell = 0;
+	// cells per side of a tile, a power of two
+	int64_t cellsPerSide = 0;
+	double cellSize = 0.0;
+	double tileSize = 0.0;
+	int64_t tilesPerRow = 0;
+	int64_t numTiles = 0;
+
+	Box bounds;
+};
+
+bool is_procedural_path(const string& path);
+
+// null if the path has unknown or invalid parameters. tiles have pointsPerTile points
+shared_ptr<ProceduralSource> parse_procedural(string path, int64_t pointsPerTile);
+
+// bounds of all points that the tile may contain
+Box procedural_tile_bounds(const ProceduralSource& source, int64_t tile);
+
+// generates numPoints points, starting at point firstPoint, as coordinates relative to origin and colors
+void generate_procedural_points(const ProceduralSource& source, int64_t firstPoint, int64_t numPoints, dvec3 origin,
+	double* x, double* y, double* z, uint32_t* colors);
+
+// generates tiles on all cores, prints points/s and checks that tiles generated in parts match tiles generated at once
+void benchmark_procedural(vector<string> paths);
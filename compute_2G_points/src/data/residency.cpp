@@ -0,0 +1,318 @@
+
+#include <algorithm>
+
+#include "residency.h"
+#include "Resources.h"
+
+// same as getPrecisionLevel() in render.cs
+int precision_level(Box bounds, dmat4 view, dmat4 proj, ivec2 imageSize){
+
+	dvec3 center = bounds.center();
+	double radius = glm::length(bounds.size());
+
+	dvec4 viewCenter = view * dvec4(center, 1.0);
+	dvec4 viewEdge = viewCenter + dvec4(radius, 0.0, 0.0, 0.0);
+
+	dvec4 projCenter = proj * viewCenter;
+	dvec4 projEdge = proj * viewEdge;
+
+	glm::dvec2 screenCenter = glm::dvec2(imageSize) * (glm::dvec2(projCenter) / projCenter.w + 1.0) / 2.0;
+	glm::dvec2 screenEdge = glm::dvec2(imageSize) * (glm::dvec2(projEdge) / projEdge.w + 1.0) / 2.0;
+	double pixelSize = glm::distance(screenEdge, screenCenter);
+
+	if(pixelSize < 100){
+		return 4;
+	}else if(pixelSize < 200){
+		return 3;
+	}else if(pixelSize < 500){
+		return 2;
+	}else if(pixelSize < 10000){
+		return 1;
+	}else{
+		return 0;
+	}
+}
+
+void ResidencyManager::setView(dmat4 view, dmat4 proj, ivec2 imageSize){
+
+	if(hasView && view == this->view && proj == this->proj && imageSize == this->imageSize){
+		return;
+	}
+
+	this->hasView = true;
+	this->viewChanged = true;
+	this->view = view;
+	this->proj = proj;
+	this->imageSize = imageSize;
+	this->frustum.set(proj * view);
+}
+
+void ResidencyManager::updateVisibility(BatchResidency& batch){
+
+	if(!hasView){
+		batch.isVisible = false;
+
+		return;
+	}
+
+	batch.isVisible = frustum.intersectsBox(batch.bounds);
+
+	if(batch.isVisible){
+		batch.level = precision_level(batch.bounds, view, proj, imageSize);
+		batch.lastVisibleFrame = frame;
+	}
+}
+
+void ResidencyManager::acquirePages(BatchResidency& batch, vector<PageRange>& committed){
+
+	int64_t firstByte = 4 * batch.sparsePointOffset;
+	int64_t lastByte = 4 * (batch.sparsePointOffset + batch.numPoints) - 1;
+
+	for(int64_t page = firstByte / pageSize; page <= lastByte / pageSize; page++){
+		int32_t& refs = pageRefs[page];
+		refs++;
+
+		if(refs == 1){
+			if(committed.size() > 0 && committed.back().firstPage + committed.back().numPages == page){
+				committed.back().numPages++;
+			}else{
+				committed.push_back({page, 1});
+			}
+		}
+	}
+}
+
+void ResidencyManager::releasePages(BatchResidency& batch, vector<PageRange>& decommitted){
+
+	int64_t firstByte = 4 * batch.sparsePointOffset;
+	int64_t lastByte = 4 * (batch.sparsePointOffset + batch.numPoints) - 1;
+
+	for(int64_t page = firstByte / pageSize; page <= lastByte / pageSize; page++){
+		auto it = pageRefs.find(page);
+		it->second--;
+
+		if(it->second == 0){
+			pageRefs.erase(it);
+
+			if(decommitted.size() > 0 && decommitted.back().firstPage + decommitted.back().numPages == page){
+				decommitted.back().numPages++;
+			}else{
+				decommitted.push_back({page, 1});
+			}
+		}
+	}
+}
+
+vector<PageRange> ResidencyManager::onUpload(int64_t firstSlot, vector<BatchResidency>& uploaded){
+
+	vector<PageRange> committed;
+
+	if(firstSlot + int64_t(uploaded.size()) > int64_t(batches.size())){
+		// new slots start out as evicted, they become resident below
+		BatchResidency empty;
+		empty.state = BatchState::EVICTED;
+
+		batches.resize(firstSlot + uploaded.size(), empty);
+	}
+
+	for(int64_t i = 0; i < uploaded.size(); i++){
+		BatchResidency& batch = batches[firstSlot + i];
+		int64_t bytes = bytesPerPoint() * uploaded[i].numPoints;
+
+		if(batch.state == BatchState::RESIDENT){
+			continue;
+		}else if(batch.state == BatchState::STREAMING){
+			streamingBytes -= bytes;
+		}
+
+		int64_t lastVisibleFrame = batch.lastVisibleFrame;
+
+		batch = uploaded[i];
+		batch.state = BatchState::RESIDENT;
+		batch.lastVisibleFrame = lastVisibleFrame;
+
+		updateVisibility(batch);
+		acquirePages(batch, committed);
+
+		residentBytes += bytes;
+	}
+
+	return committed;
+}
+
+ResidencyUpdate ResidencyManager::update(){
+
+	frame++;
+
+	ResidencyUpdate result;
+
+	if(viewChanged){
+		for(BatchResidency& batch : batches){
+			if(batch.state != BatchState::FREE){
+				updateVisibility(batch);
+			}
+		}
+
+		viewChanged = false;
+	}
+
+	if(budgetBytes <= 0){
+		return result;
+	}
+
+	// evicted batches that are in view again
+	vector<int64_t> wanted;
+	int64_t wantedBytes = 0;
+	for(int64_t slot = 0; slot < batches.size(); slot++){
+		BatchResidency& batch = batches[slot];
+
+		if(batch.state == BatchState::EVICTED && batch.isVisible){
+			wanted.push_back(slot);
+			wantedBytes += bytesPerPoint() * batch.numPoints;
+		}
+	}
+
+	{ // EVICT
+		// make room for wanted batches, but never evict batches that are in view
+		int64_t targetBytes = std::max(budgetBytes - streamingBytes - wantedBytes, int64_t(0));
+
+		if(residentBytes > targetBytes){
+
+			vector<int64_t> candidates;
+			for(int64_t slot = 0; slot < batches.size(); slot++){
+				BatchResidency& batch = batches[slot];
+
+				if(batch.state == BatchState::RESIDENT && !batch.isVisible){
+					candidates.push_back(slot);
+				}
+			}
+
+			// least recently visible first, coarsest first among equally old batches
+			std::sort(candidates.begin(), candidates.end(), [this](int64_t a, int64_t b){
+				BatchResidency& batchA = batches[a];
+				BatchResidency& batchB = batches[b];
+
+				if(batchA.lastVisibleFrame != batchB.lastVisibleFrame){
+					return batchA.lastVisibleFrame < batchB.lastVisibleFrame;
+				}
+
+				return batchA.level > batchB.level;
+			});
+
+			for(int64_t slot : candidates){
+				if(residentBytes <= targetBytes){
+					break;
+				}
+
+				BatchResidency& batch = batches[slot];
+
+				releasePages(batch, result.decommit);
+				batch.state = BatchState::EVICTED;
+				residentBytes -= bytesPerPoint() * batch.numPoints;
+
+				result.evicted.push_back(slot);
+				numEvicted++;
+			}
+		}
+	}
+
+	{ // RE-STREAM
+		vector<RestreamRange> ranges;
+		vector<int> rangeLevels;
+		for(int64_t slot : wanted){
+			BatchResidency& batch = batches[slot];
+
+			bool extendsRange = false;
+			if(ranges.size() > 0){
+				RestreamRange& range = ranges.back();
+				BatchResidency& previous = batches[slot - 1];
+
+				extendsRange = range.firstSlot + range.numBatches == slot
+					&& range.pc == batch.pc
+					&& range.filePointOffset + range.numPoints == batch.filePointOffset
+					&& range.sparsePointOffset + range.numPoints == batch.sparsePointOffset
+					&& range.sparsePointOffset / POINTS_PER_SEGMENT == batch.sparsePointOffset / POINTS_PER_SEGMENT
+					&& previous.numPoints == POINTS_PER_WORKGROUP
+					&& range.numPoints + batch.numPoints <= MAX_POINTS_PER_BATCH;
+			}
+
+			if(extendsRange){
+				RestreamRange& range = ranges.back();
+				range.numBatches++;
+				range.numPoints += batch.numPoints;
+				range.bounds.expand(batch.bounds);
+				rangeLevels.back() = std::min(rangeLevels.back(), batch.level);
+			}else{
+				RestreamRange range;
+				range.pc = batch.pc;
+				range.firstSlot = slot;
+				range.numBatches = 1;
+				range.filePointOffset = batch.filePointOffset;
+				range.sparsePointOffset = batch.sparsePointOffset;
+				range.numPoints = batch.numPoints;
+				range.bounds = batch.bounds;
+
+				ranges.push_back(range);
+				rangeLevels.push_back(batch.level);
+			}
+		}
+
+		// finest precision first, those are closest to the camera
+		vector<int64_t> order(ranges.size());
+		for(int64_t i = 0; i < ranges.size(); i++){
+			order[i] = i;
+		}
+		std::stable_sort(order.begin(), order.end(), [&rangeLevels](int64_t a, int64_t b){
+			return rangeLevels[a] < rangeLevels[b];
+		});
+
+		for(int64_t i : order){
+			RestreamRange& range = ranges[i];
+			int64_t bytes = bytesPerPoint() * range.numPoints;
+
+			if(residentBytes + streamingBytes + bytes > budgetBytes){
+				continue;
+			}
+
+			for(int64_t slot = range.firstSlot; slot < range.firstSlot + range.numBatches; slot++){
+				batches[slot].state = BatchState::STREAMING;
+			}
+
+			streamingBytes += bytes;
+			numRestreamed += range.numBatches;
+
+			result.restream.push_back(range);
+		}
+	}
+
+	return result;
+}
+
+vector<int64_t> ResidencyManager::remove(shared_ptr<PointCloud> pc, vector<PageRange>& decommitted){
+
+	vector<int64_t> slots;
+
+	for(int64_t slot = 0; slot < batches.size(); slot++){
+		BatchResidency& batch = batches[slot];
+
+		if(batch.pc != pc){
+			continue;
+		}
+
+		int64_t bytes = bytesPerPoint() * batch.numPoints;
+
+		if(batch.state == BatchState::RESIDENT){
+			releasePages(batch, decommitted);
+			residentBytes -= bytes;
+		}else if(batch.state == BatchState::STREAMING){
+			streamingBytes -= bytes;
+		}
+
+		batch = BatchResidency();
+		batch.state = BatchState::FREE;
+
+		slots.push_back(slot);
+	}
+
+	return slots;
+}
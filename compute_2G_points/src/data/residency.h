@@ -0,0 +1,121 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#include "glm/common.hpp"
+#include "glm/matrix.hpp"
+#include "unsuck.hpp"
+#include "Frustum.h"
+#include "Box.h"
+
+using namespace std;
+using glm::dmat4;
+using glm::dvec3;
+using glm::ivec2;
+
+struct PointCloud;
+
+// matches Batch.state in render.cs
+enum class BatchState{
+	RESIDENT = 0,
+	EVICTED = 1,
+	// evicted, and a task that loads it again is queued
+	STREAMING = 2,
+	// the file of the batch was removed, the slot can be reused
+	FREE = 3,
+};
+
+struct BatchResidency{
+	shared_ptr<PointCloud> pc;
+	// first point of the batch in its file, to load it again
+	int64_t filePointOffset = 0;
+	int64_t sparsePointOffset = 0;
+	int64_t numPoints = 0;
+	Box bounds;
+
+	BatchState state = BatchState::RESIDENT;
+	bool isVisible = false;
+	int64_t lastVisibleFrame = -1;
+	// precision level, as in render.cs. 0 is full precision, 4 is the coarsest
+	int level = 4;
+};
+
+// pages of the sparse point buffers
+struct PageRange{
+	int64_t firstPage = 0;
+	int64_t numPages = 0;
+};
+
+// evicted batches that are visible again. consecutive batch slots with contiguous points,
+// which encode into the same batches as before
+struct RestreamRange{
+	shared_ptr<PointCloud> pc;
+	int64_t firstSlot = 0;
+	int64_t numBatches = 0;
+	int64_t filePointOffset = 0;
+	int64_t sparsePointOffset = 0;
+	int64_t numPoints = 0;
+	Box bounds;
+};
+
+struct ResidencyUpdate{
+	// batch slots whose state has to be set to EVICTED
+	vector<int64_t> evicted;
+	vector<PageRange> decommit;
+	vector<RestreamRange> restream;
+};
+
+// keeps the points of the sparse buffers within budgetBytes.
+// - every uploaded batch is tracked by its slot in the batch table. slots and sparse offsets never
+//   change, evicted batches keep their slot and are loaded into the same place again
+// - batches that are out of view are evicted first, least recently visible and coarsest first
+// - evicted batches that come into view again are re-streamed from their file
+// - sparse pages are reference counted, a page is decommitted once no resident batch overlaps it
+// all functions are called from the thread that calls PointCloudLoader::process()
+struct ResidencyManager{
+
+	// 0 for no limit, set with --budget
+	int64_t budgetBytes = 0;
+	int64_t pageSize = 65536;
+
+	vector<BatchResidency> batches;
+	unordered_map<int64_t, int32_t> pageRefs;
+
+	int64_t frame = 0;
+	int64_t residentBytes = 0;
+	int64_t streamingBytes = 0;
+
+	int64_t numEvicted = 0;
+	int64_t numRestreamed = 0;
+
+	bool hasView = false;
+	bool viewChanged = false;
+	dmat4 view;
+	dmat4 proj;
+	ivec2 imageSize = {1920, 1080};
+	Frustum frustum;
+
+	void setView(dmat4 view, dmat4 proj, ivec2 imageSize);
+
+	// registers or re-registers uploaded batches, starting at firstSlot.
+	// returns pages that have to be committed before their points are uploaded
+	vector<PageRange> onUpload(int64_t firstSlot, vector<BatchResidency>& uploaded);
+
+	// once per frame. updates visibility, evicts cold batches and picks evicted ones to load again
+	ResidencyUpdate update();
+
+	// frees all slots of the file. returns the slots, and adds pages that are no longer used to decommitted
+	vector<int64_t> remove(shared_ptr<PointCloud> pc, vector<PageRange>& decommitted);
+
+	static int64_t bytesPerPoint(){
+		return 16;
+	}
+
+private:
+
+	void updateVisibility(BatchResidency& batch);
+	void acquirePages(BatchResidency& batch, vector<PageRange>& committed);
+	void releasePages(BatchResidency& batch, vector<PageRange>& decommitted);
+};
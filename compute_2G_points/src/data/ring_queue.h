@@ -0,0 +1,179 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+using namespace std;
+
+// bounded multi-producer multi-consumer queue.
+// - lock-free ring of capacity slots, each with a sequence number that tells whether it is free or
+//   filled for the current lap (Vyukov)
+// - push() blocks while the queue is full and pop() while it is empty. waiters sleep on an
+//   atomic (futex / WaitOnAddress) and are only woken if there actually is a waiter
+// - after close(), blocked and future push() and pop() calls return false
+template<typename T>
+struct RingQueue{
+
+	struct Slot{
+		atomic<int64_t> sequence = 0;
+		T value;
+	};
+
+	int64_t capacity = 0;
+	unique_ptr<Slot[]> slots;
+
+	alignas(64) atomic<int64_t> enqueuePos = 0;
+	alignas(64) atomic<int64_t> dequeuePos = 0;
+
+	// bumped on every push / pop, waiters sleep until they change
+	alignas(64) atomic<uint32_t> numPushed = 0;
+	atomic<uint32_t> numPopped = 0;
+	atomic<int32_t> numWaiting = 0;
+	atomic<bool> isClosed = false;
+
+	// most items that were in the queue at once
+	atomic<int64_t> maxSize = 0;
+	// push() calls that had to wait for space
+	atomic<int64_t> numFullWaits = 0;
+
+	RingQueue(int64_t capacity){
+		this->capacity = capacity;
+		this->slots = make_unique<Slot[]>(capacity);
+
+		for(int64_t i = 0; i < capacity; i++){
+			slots[i].sequence = i;
+		}
+	}
+
+	bool tryPush(const T& value){
+
+		int64_t pos = enqueuePos.load(memory_order_relaxed);
+
+		while(true){
+			Slot& slot = slots[pos % capacity];
+			int64_t sequence = slot.sequence.load(memory_order_acquire);
+			int64_t diff = sequence - pos;
+
+			if(diff == 0){
+				if(enqueuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)){
+					slot.value = value;
+					slot.sequence.store(pos + 1, memory_order_release);
+
+					break;
+				}
+			}else if(diff < 0){
+				// full
+				return false;
+			}else{
+				pos = enqueuePos.load(memory_order_relaxed);
+			}
+		}
+
+		int64_t currentSize = size();
+		int64_t currentMax = maxSize.load(memory_order_relaxed);
+		while(currentSize > currentMax && !maxSize.compare_exchange_weak(currentMax, currentSize)){}
+
+		numPushed++;
+		if(numWaiting.load() > 0){
+			numPushed.notify_all();
+		}
+
+		return true;
+	}
+
+	bool tryPop(T& value){
+
+		int64_t pos = dequeuePos.load(memory_order_relaxed);
+
+		while(true){
+			Slot& slot = slots[pos % capacity];
+			int64_t sequence = slot.sequence.load(memory_order_acquire);
+			int64_t diff = sequence - (pos + 1);
+
+			if(diff == 0){
+				if(dequeuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)){
+					value = std::move(slot.value);
+					slot.value = T();
+					slot.sequence.store(pos + capacity, memory_order_release);
+
+					break;
+				}
+			}else if(diff < 0){
+				// empty
+				return false;
+			}else{
+				pos = dequeuePos.load(memory_order_relaxed);
+			}
+		}
+
+		numPopped++;
+		if(numWaiting.load() > 0){
+			numPopped.notify_all();
+		}
+
+		return true;
+	}
+
+	bool push(const T& value){
+
+		bool hasWaited = false;
+
+		while(!isClosed){
+			uint32_t popped = numPopped.load(memory_order_acquire);
+
+			if(tryPush(value)){
+				return true;
+			}
+
+			if(!hasWaited){
+				numFullWaits++;
+				hasWaited = true;
+			}
+
+			numWaiting++;
+			if(!isClosed){
+				numPopped.wait(popped);
+			}
+			numWaiting--;
+		}
+
+		return false;
+	}
+
+	bool pop(T& value){
+
+		while(!isClosed){
+			uint32_t pushed = numPushed.load(memory_order_acquire);
+
+			if(tryPop(value)){
+				return true;
+			}
+
+			numWaiting++;
+			if(!isClosed){
+				numPushed.wait(pushed);
+			}
+			numWaiting--;
+		}
+
+		return false;
+	}
+
+	void close(){
+		isClosed = true;
+
+		numPushed++;
+		numPopped++;
+		numPushed.notify_all();
+		numPopped.notify_all();
+	}
+
+	// approximate while other threads push or pop
+	int64_t size(){
+		int64_t size = enqueuePos.load() - dequeuePos.load();
+
+		return std::clamp(size, int64_t(0), capacity);
+	}
+
+};
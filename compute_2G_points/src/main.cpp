@@ -26,7 +26,17 @@
 #include "Runtime.h"
 
 #include "data/point_clouds_loader.h"
+#include "data/batch_encoder.h"
+#include "data/las_catalog.h"
+#include "data/obj_loader.h"
+#include "data/ply_loader.h"
+#include "data/procedural_source.h"
 #include "compute/compute_loop.h"
+#include "compute/cpu_loop.h"
+#include "compute/cpu_rasterizer.h"
+#include "compute/point_projection.h"
+#include "compute/headless_render.h"
+#include "compute/edl.h"
 
 
 
@@ -53,11 +63,25 @@ void init_debug(void) {
 	Debug::colorizeChunks = true;
 }
 
-shared_ptr<PointCloudLoader> load_point_clouds(shared_ptr<Renderer> renderer) {
+shared_ptr<PointCloudLoader> load_point_clouds(shared_ptr<Renderer> renderer, shared_ptr<LasCatalog> catalog, vector<string> lasfiles, bool keepHostCopy) {
 	auto point_clouds = make_shared<PointCloudLoader>(renderer);
-	vector<string> lasfiles = { "..\\test.las" };
+	point_clouds->keepHostCopy = keepHostCopy;
+
+	// all valid files of the catalog, their headers aren't read again
+	if(catalog){
+		point_clouds->catalog = catalog;
+
+		lasfiles.clear();
+		for(auto& entry : catalog->entries){
+			if(entry.isValid()){
+				lasfiles.push_back(entry.path);
+			}
+		}
+	}
+
+	// headers are read in the background, the first frames render while the files are added
+	point_clouds->addAsync(lasfiles);
 
-	point_clouds->add(lasfiles, [renderer](vector<shared_ptr<PointCloud>> lasfiles) {} );
 	return point_clouds;
 }
 
@@ -69,20 +93,233 @@ void update_compute_loop(shared_ptr<Renderer> renderer) {
 	}
 }
 
-int main(){
+int main(int argc, char** argv){
 
 	cout << std::setprecision(2) << std::fixed;
+
+	// ComputeRasterizer --benchmark-loader file1.las file2.laz ...
+	if(argc > 1 && string(argv[1]) == "--benchmark-loader"){
+		vector<string> files(argv + 2, argv + argc);
+		if(files.empty()){
+			files = { "..\\test.las" };
+		}
+
+		benchmark_loader(files);
+
+		return 0;
+	}
+
+	// ComputeRasterizer --benchmark-scheduler file1.las file2.laz ...
+	if(argc > 1 && string(argv[1]) == "--benchmark-scheduler"){
+		vector<string> files(argv + 2, argv + argc);
+		if(files.empty()){
+			files = { "..\\test.las" };
+		}
+
+		benchmark_scheduler(files);
+
+		return 0;
+	}
+
+	// ComputeRasterizer --benchmark-ingest file1.las file2.laz ...
+	if(argc > 1 && string(argv[1]) == "--benchmark-ingest"){
+		vector<string> files(argv + 2, argv + argc);
+		if(files.empty()){
+			files = { "..\\test.las" };
+		}
+
+		benchmark_ingest(files);
+
+		return 0;
+	}
+
+	// ComputeRasterizer --benchmark-obj file1.obj file2.obj ...
+	if(argc > 1 && string(argv[1]) == "--benchmark-obj"){
+		vector<string> files(argv + 2, argv + argc);
+		if(files.empty()){
+			files = { "..\\test.obj" };
+		}
+
+		benchmark_obj(files);
+
+		return 0;
+	}
+
+	// ComputeRasterizer --benchmark-ply file1.ply file2.ply ...
+	if(argc > 1 && string(argv[1]) == "--benchmark-ply"){
+		vector<string> files(argv + 2, argv + argc);
+		if(files.empty()){
+			files = { "..\\test.ply" };
+		}
+
+		benchmark_ply(files);
+
+		return 0;
+	}
+
+	// ComputeRasterizer --benchmark-procedural procedural:points=1e9,seed=7 ...
+	if(argc > 1 && string(argv[1]) == "--benchmark-procedural"){
+		vector<string> paths(argv + 2, argv + argc);
+		if(paths.empty()){
+			paths = { "procedural:points=100e6" };
+		}
+
+		benchmark_procedural(paths);
+
+		return 0;
+	}
+
+	// ComputeRasterizer --benchmark-cpu-render file1.las file2.las ...
+	if(argc > 1 && string(argv[1]) == "--benchmark-cpu-render"){
+		vector<string> files(argv + 2, argv + argc);
+		if(files.empty()){
+			files = { "..\\test.las" };
+		}
+
+		benchmark_cpu_render(files);
+
+		return 0;
+	}
+
+	// ComputeRasterizer --render camera_path.json output_dir file1.las file2.las ...
+	// renders with the CPU rasterizer, without a window, see headless_render.h
+	if(argc > 3 && string(argv[1]) == "--render"){
+		vector<string> files(argv + 4, argv + argc);
+		if(files.empty()){
+			files = { "..\\test.las" };
+		}
+
+		render_camera_path(files, argv[2], argv[3]);
+
+		return 0;
+	}
+
+	// ComputeRasterizer --benchmark-cpu-scaling file1.las file2.las ...
+	if(argc > 1 && string(argv[1]) == "--benchmark-cpu-scaling"){
+		vector<string> files(argv + 2, argv + argc);
+		if(files.empty()){
+			files = { "..\\test.las" };
+		}
+
+		benchmark_cpu_scaling(files);
+
+		return 0;
+	}
+
+	// ComputeRasterizer --benchmark-projection
+	if(argc > 1 && string(argv[1]) == "--benchmark-projection"){
+		benchmark_projection();
+
+		return 0;
+	}
+
+	// ComputeRasterizer --benchmark-edl
+	if(argc > 1 && string(argv[1]) == "--benchmark-edl"){
+		benchmark_edl();
+
+		return 0;
+	}
+
+	// ComputeRasterizer --benchmark-quantize
+	if(argc > 1 && string(argv[1]) == "--benchmark-quantize"){
+		benchmark_quantize();
+
+		return 0;
+	}
+
+	// ComputeRasterizer --check-las-formats
+	if(argc > 1 && string(argv[1]) == "--check-las-formats"){
+		bool passed = check_las_formats();
+
+		return passed ? 0 : 1;
+	}
+
+	// ComputeRasterizer --check-point-addressing
+	if(argc > 1 && string(argv[1]) == "--check-point-addressing"){
+		bool passed = check_point_addressing();
+
+		return passed ? 0 : 1;
+	}
+
+	// ComputeRasterizer --check-ply
+	if(argc > 1 && string(argv[1]) == "--check-ply"){
+		bool passed = check_ply();
+
+		return passed ? 0 : 1;
+	}
+
+	// ComputeRasterizer --convert file1.las file2.laz ...
+	// writes file1.las.t2g, file2.laz.t2g, ... which are loaded instead of the source files from then on
+	if(argc > 1 && string(argv[1]) == "--convert"){
+		vector<string> files(argv + 2, argv + argc);
+		if(files.empty()){
+			files = { "..\\test.las" };
+		}
+
+		convert_to_batch_cache(files);
+
+		return 0;
+	}
+
+	// ComputeRasterizer --build-catalog catalog.json dir1 file2.las ...
+	if(argc > 2 && string(argv[1]) == "--build-catalog"){
+		vector<string> paths(argv + 3, argv + argc);
+		if(paths.empty()){
+			paths = { "..\\test.las" };
+		}
+
+		update_catalog(argv[2], paths);
+
+		return 0;
+	}
+
+	// ComputeRasterizer --catalog catalog.json
+	shared_ptr<LasCatalog> catalog = nullptr;
+	if(argc > 2 && string(argv[1]) == "--catalog"){
+		catalog = load_catalog(argv[2]);
+
+		if(!catalog){
+			GENERATE_ERROR_MESSAGE << "could not load catalog " << argv[2] << endl;
+		}
+	}
+
+	vector<string> lasfiles = { "..\\test.las" };
+
+	// ComputeRasterizer --procedural points=1e10,seed=7,density=20,buildings=0.3,noise=0.01
+	if(argc > 1 && string(argv[1]) == "--procedural"){
+		lasfiles = { "procedural:" + (argc > 2 ? string(argv[2]) : string()) };
+	}
+
+	// ComputeRasterizer ... --cpu
+	// renders with CpuLoop instead of ComputeLoop
+	bool useCpu = std::find(argv + 1, argv + argc, string("--cpu")) != argv + argc;
+
+	// ComputeRasterizer ... --budget 4096
+	// keeps the loaded points within 4096 MB, batches that are out of view are evicted and loaded again when needed
+	int64_t budgetMB = 0;
+	auto budgetArg = std::find(argv + 1, argv + argc, string("--budget"));
+	if(budgetArg != argv + argc){
+		budgetMB = (budgetArg + 1 != argv + argc) ? std::atoll(*(budgetArg + 1)) : 0;
+
+		if(budgetMB <= 0){
+			GENERATE_WARN_MESSAGE << "--budget expects a size in MB, loading without a budget" << endl;
+			budgetMB = 0;
+		}
+	}
+
 	init_cuda();
 	auto renderer = make_shared<Renderer>();
 
 	auto tStart = now();
 
 	// load point clouds from file to GPU memory->isSelected
-	auto pointclouds = load_point_clouds(renderer);
+	auto pointclouds = load_point_clouds(renderer, catalog, lasfiles, useCpu);
+	pointclouds->residency.budgetBytes = budgetMB * 1024 * 1024;
 	// 4-4-4 byte format
 	Runtime::pointclouds_loader = pointclouds;
 	Runtime::addMethod((Method*)new ComputeLoop(renderer.get(), pointclouds));
-	Runtime::setSelectedMethod(Runtime::methods[0]->name);
+	Runtime::addMethod((Method*)new CpuLoop(renderer.get(), pointclouds));
+	Runtime::setSelectedMethod(Runtime::methods[useCpu ? 1 : 0]->name);
  
 	init_debug();
 
@@ -92,7 +329,9 @@ int main(){
 
 	auto points_update = [&](){
 
+		pointclouds->setView(renderer->camera->view, renderer->camera->proj, {renderer->width, renderer->height});
 		pointclouds->process();
+		pointclouds->pushFrameStats();
 		update_compute_loop(renderer);
 				
 		for(auto pc : Runtime::pointclouds_loader->files){